@@ -15,16 +15,26 @@
 //along with this program; if not, write to the Free Software
 //Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
+#include <csignal>
 #include <memory>
 
 #include "core/log/streamlogger.h"
 #include "core/log/logmanager.h"
+#include "core/exploration.h"
 #include "core/interpreter/fromfilemodule.h"
 #include "core/moduleloader.h"
 #include "core/object.h"
+#include "core/parallelexplorer.h"
+#include "core/partitionedexplorer.h"
+#include "core/parseindex.h"
+#include "core/file/mappedfile.h"
+#include "core/file/cachedfile.h"
+#include "core/file/prefetchingfile.h"
+#include "core/file/uringfile.h"
 #include "core/interpreter/programloader.h"
 #include "core/modules/default/defaultmodule.h"
 #include "core/modulesetup.h"
+#include "core/util/arena.h"
 #include "core/util/fileutil.h"
 #include "core/util/osutil.h"
 #include "core/variable/variablecollector.h"
@@ -36,6 +46,7 @@
 #elif defined(PLATFORM_LINUX) || defined(PLATFORM_APPLE)
     #include <sys/stat.h>
     #include <sys/types.h>
+    #include <unistd.h>
 #endif
 
 enum DisplayType {
@@ -55,11 +66,31 @@ struct CLIOptions {
     DisplayType displayType;
     int maxDepth;
     bool verbose;
+    bool mappedFile;
+    bool uringFile;
+    int cachePages;
+    bool prefetch;
+    bool hugePages;
+    int memoryBudget;
+    bool parseIndex;
+    int jobs;
+    int64_t maxNodes;
+    bool progress;
     CLIOptions() : filePath(),
                    leafs(),
                    displayType(DISPLAY_TYPE_DEFAULT),
                    maxDepth(-1),
-                   verbose(false)
+                   verbose(false),
+                   mappedFile(false),
+                   uringFile(false),
+                   cachePages(0),
+                   prefetch(false),
+                   hugePages(false),
+                   memoryBudget(-1),
+                   parseIndex(false),
+                   jobs(1),
+                   maxNodes(-1),
+                   progress(false)
     {
 
     }
@@ -80,7 +111,23 @@ Example: hexamonkey-cli test.mp4 1 type\n\
 This will look for a field named 'type' in the second item of the mp4 file.\n\
 \n\
 Options:\n\
-  -v, --verbose : include traces\
+  -v, --verbose : include traces\n\
+  -m, --mmap : read the file through a memory mapping\n\
+  -u, --uring : read the file asynchronously with io_uring when available\n\
+  -c, --cache PAGES : keep up to PAGES pages of 64 KiB of the file in memory\n\
+  -p, --prefetch : read ahead of the parsing position from a helper thread\n\
+  -H, --huge-pages : allocate the parsed tree in huge pages when available\n\
+  -b, --budget MB : keep the parsed tree under MB MiB, parsing again what \
+was freed when needed\n\
+  -i, --index : build the tree from the index saved next to the file, or \
+parse the whole file and save its index if it is missing or out of date\n\
+  -n, --max-nodes NODES : stop exploring once NODES objects have been \
+parsed\n\
+  -P, --progress : report the progress of the exploration, which can be \
+interrupted with Ctrl-C\n\
+  -j, --jobs THREADS : explore the whole tree on THREADS threads, all the \
+cores if 0, the packets of formats detected by a syncbyte being found by \
+splitting the file into ranges\n\
   -t, --display-type : What to display. It can be :\n\
      * fileType : file type detected using extension or magic number (leafs \
 are ignored),\n\
@@ -118,6 +165,56 @@ bool parseArgs(const int argc, const char* const argv[], CLIOptions& options)
         std::string flag(optStr.front());
         if (flag == "--verbose" || flag == "-v") {
             optStr.pop_front();
+        } else if (flag == "--mmap" || flag == "-m") {
+            optStr.pop_front();
+            options.mappedFile = true;
+        } else if (flag == "--uring" || flag == "-u") {
+            optStr.pop_front();
+            options.uringFile = true;
+        } else if (flag == "--prefetch" || flag == "-p") {
+            optStr.pop_front();
+            options.prefetch = true;
+        } else if (flag == "--huge-pages" || flag == "-H") {
+            optStr.pop_front();
+            options.hugePages = true;
+        } else if (flag == "--index" || flag == "-i") {
+            optStr.pop_front();
+            options.parseIndex = true;
+        } else if (flag == "--progress" || flag == "-P") {
+            optStr.pop_front();
+            options.progress = true;
+        } else if (flag == "--max-nodes" || flag == "-n") {
+            optStr.pop_front();
+            if(optStr.empty())
+                return false;
+
+            std::stringstream nodesStream(optStr.front());
+            nodesStream >> options.maxNodes;
+            optStr.pop_front();
+        } else if (flag == "--jobs" || flag == "-j") {
+            optStr.pop_front();
+            if(optStr.empty())
+                return false;
+
+            std::stringstream jobsStream(optStr.front());
+            jobsStream >> options.jobs;
+            optStr.pop_front();
+        } else if (flag == "--budget" || flag == "-b") {
+            optStr.pop_front();
+            if(optStr.empty())
+                return false;
+
+            std::stringstream budgetStream(optStr.front());
+            budgetStream >> options.memoryBudget;
+            optStr.pop_front();
+        } else if (flag == "--cache" || flag == "-c") {
+            optStr.pop_front();
+            if(optStr.empty())
+                return false;
+
+            std::stringstream cpStream(optStr.front());
+            cpStream >> options.cachePages;
+            optStr.pop_front();
         } else if(flag == "--display-type" || flag == "-t")
         {
             optStr.pop_front();
@@ -161,6 +258,22 @@ bool parseArgs(const int argc, const char* const argv[], CLIOptions& options)
     return true;
 }
 
+// Exploration interrupted by Ctrl-C
+Exploration* currentExploration = nullptr;
+
+void cancelExploration(int)
+{
+    if (currentExploration != nullptr) {
+        currentExploration->cancel();
+    }
+}
+
+void printProgress(const Exploration::Progress& progress)
+{
+    std::cerr << "\rexplored " << progress.nodeCount << " objects, "
+              << progress.coveredSize / (1024 * 1024) << " MiB" << std::flush;
+}
+
 int main(int argc, char *argv[])
 {
     CLIOptions options;
@@ -175,14 +288,28 @@ int main(int argc, char *argv[])
     if (options.verbose) {
         logger.reset(new StreamLogger(std::cerr));
     }
+    Arena::setUseHugePages(options.hugePages);
     ModuleSetup moduleSetup;
     moduleSetup.setup();
 
     ModuleLoader& moduleLoader = moduleSetup.moduleLoader();
 
-    RealFile file;
-    file.setPath(argv[1]);
-    if (!file.good())
+    std::unique_ptr<File> file;
+    if (options.mappedFile) {
+        file.reset(new MappedFile);
+    } else if (options.uringFile) {
+        file.reset(new UringFile);
+    } else {
+        file.reset(new RealFile);
+    }
+    file->setPath(options.filePath);
+    if (options.cachePages > 0) {
+        file.reset(new CachedFile(file.release(), 65536, options.cachePages));
+    }
+    if (options.prefetch) {
+        file.reset(new PrefetchingFile(file.release()));
+    }
+    if (!file->good())
     {
         std::cerr << "File not found" <<std::endl;
     }
@@ -190,12 +317,31 @@ int main(int argc, char *argv[])
     {
         VariableCollector collector;
 
-        const Module& module = moduleLoader.getModule(file);
+        const Module& module = moduleLoader.getModule(*file);
 
         std::vector<Object*> objs;
-        objs.push_back(module.handleFile(DefaultModule::file, file, collector));
+        const std::string indexPath = ParseIndex::sidecarPath(options.filePath);
+        ParseIndex::Key indexKey;
+        Object* root = nullptr;
+        if (options.parseIndex) {
+            indexKey = ParseIndex::key(*file, moduleLoader.fingerprint(module));
+            root = ParseIndex::load(indexPath, indexKey, module, *file, collector);
+        }
+        const bool indexMissing = options.parseIndex && root == nullptr;
+        if (root == nullptr) {
+            root = module.handleFile(DefaultModule::file, *file, collector);
+        }
+        objs.push_back(root);
+        if (options.memoryBudget >= 0) {
+            objs[0]->setMemoryBudget(int64_t(options.memoryBudget) * 1024 * 1024);
+        }
+        if (indexMissing) {
+            ParseIndex::write(*root, module, indexKey, indexPath);
+        }
 
 
+        // The objects reached are kept in memory under a budget
+        std::vector<Object::Pin> pins;
         Object*child = nullptr;
         for (auto& leaf : options.leafs)
         {
@@ -211,12 +357,37 @@ int main(int argc, char *argv[])
             }
             if(child) {
                 objs.insert(objs.begin(), child);
+                pins.push_back(Object::Pin(child));
             } else {
                 std::cerr << "Object not found" << std::endl;
                 return 1;
             }
         }
-        objs[0]->explore(options.maxDepth);
+        uint8_t syncbyte;
+        int packetLength;
+        if (options.maxDepth == -1 && options.jobs != 1 && objs[0] == root
+                && moduleLoader.syncbyte(module, syncbyte, packetLength)) {
+            PartitionedExplorer explorer(syncbyte, packetLength, options.jobs);
+            explorer.explore(*root, module);
+        } else if (options.maxDepth == -1 && options.jobs != 1) {
+            ParallelExplorer explorer(options.jobs);
+            explorer.explore(*objs[0], module);
+        } else {
+            Exploration exploration(*objs[0], options.maxDepth);
+            exploration.setNodeBudget(options.maxNodes);
+            exploration.setParseWhenStalled(true);
+            if (options.progress) {
+                exploration.setProgressCallback(printProgress, 65536);
+            }
+            currentExploration = &exploration;
+            std::signal(SIGINT, cancelExploration);
+            exploration.run();
+            std::signal(SIGINT, SIG_DFL);
+            currentExploration = nullptr;
+            if (options.progress) {
+                std::cerr << std::endl;
+            }
+        }
         switch(options.displayType)
         {
             case fileType:
@@ -240,7 +411,12 @@ int main(int argc, char *argv[])
                 break;
 
             case binary:
+#if defined(PLATFORM_WIN32)
                 objs[0]->dump(std::cout);
+#else
+                std::cout.flush();
+                objs[0]->dump(STDOUT_FILENO);
+#endif
                 break;
 
             default:
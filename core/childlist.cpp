@@ -0,0 +1,87 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <algorithm>
+
+#include "core/childlist.h"
+
+ChildList::ChildList() : _block(nullptr), _size(0)
+{
+}
+
+ChildList::~ChildList()
+{
+    clear();
+}
+
+ChildList::const_iterator ChildList::begin() const
+{
+    return const_iterator(this, 0);
+}
+
+ChildList::const_iterator ChildList::end() const
+{
+    return const_iterator(this, size());
+}
+
+void ChildList::push_back(Object *child)
+{
+    const size_t count = _size.load(std::memory_order_relaxed);
+    Block* block = _block.load(std::memory_order_relaxed);
+    if (block == nullptr || count == block->capacity) {
+        grow(std::max<size_t>(4, 2 * count));
+        block = _block.load(std::memory_order_relaxed);
+    }
+
+    block->children[count].store(child, std::memory_order_relaxed);
+    _size.store(count + 1, std::memory_order_release);
+}
+
+void ChildList::set(size_t rank, Object *child)
+{
+    _block.load(std::memory_order_relaxed)->children[rank].store(child, std::memory_order_release);
+}
+
+void ChildList::reserve(size_t count)
+{
+    const Block* block = _block.load(std::memory_order_relaxed);
+    if (block == nullptr || count > block->capacity) {
+        grow(count);
+    }
+}
+
+void ChildList::clear()
+{
+    _size.store(0, std::memory_order_relaxed);
+    delete _block.exchange(nullptr);
+}
+
+void ChildList::grow(size_t capacity)
+{
+    Block* previous = _block.load(std::memory_order_relaxed);
+    Block* block = new Block;
+    block->capacity = capacity;
+    block->children.reset(new std::atomic<Object*>[capacity]);
+
+    const size_t count = _size.load(std::memory_order_relaxed);
+    for (size_t rank = 0; rank < count; ++rank) {
+        block->children[rank].store(previous->children[rank].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    block->previous.reset(previous);
+
+    _block.store(block, std::memory_order_release);
+}
@@ -0,0 +1,135 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef CHILDLIST_H
+#define CHILDLIST_H
+
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+
+class Object;
+
+/**
+ * @brief Children of an \link Object object\endlink, appended by the thread
+ * parsing it and read by any thread without locking
+ *
+ * The children are stored in a block replaced by one twice as large when it is
+ * full. The new block is filled before it is published, and a child is published
+ * by increasing the size once it is stored, so that readers always find the
+ * children up to the size they read. The blocks replaced are kept until the list
+ * is cleared, for the readers that may still be reading them.
+ *
+ * Only one thread may append or set children at a time, and clear must not be
+ * called while other threads read the list.
+ */
+class ChildList
+{
+public:
+    /**
+     * @brief Random access iterator over the children published when it was created
+     */
+    class const_iterator
+    {
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef Object* value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Object* const* pointer;
+        typedef Object* reference;
+
+        const_iterator() : _list(nullptr), _rank(0) {}
+        const_iterator(const ChildList* list, size_t rank) : _list(list), _rank(rank) {}
+
+        Object* operator*() const {return (*_list)[_rank];}
+        Object* operator[](difference_type n) const {return (*_list)[_rank + n];}
+
+        const_iterator& operator++() {++_rank; return *this;}
+        const_iterator operator++(int) {const_iterator dup(*this); ++_rank; return dup;}
+        const_iterator& operator--() {--_rank; return *this;}
+        const_iterator operator--(int) {const_iterator dup(*this); --_rank; return dup;}
+        const_iterator& operator+=(difference_type n) {_rank += n; return *this;}
+        const_iterator& operator-=(difference_type n) {_rank -= n; return *this;}
+        const_iterator operator+(difference_type n) const {return const_iterator(_list, _rank + n);}
+        const_iterator operator-(difference_type n) const {return const_iterator(_list, _rank - n);}
+        difference_type operator-(const const_iterator& other) const {return _rank - other._rank;}
+
+        bool operator==(const const_iterator& other) const {return _rank == other._rank && _list == other._list;}
+        bool operator!=(const const_iterator& other) const {return !(*this == other);}
+        bool operator<(const const_iterator& other) const {return _rank < other._rank;}
+
+    private:
+        const ChildList* _list;
+        size_t _rank;
+    };
+
+    ChildList();
+    ~ChildList();
+
+    /** @brief Number of children published*/
+    inline size_t size() const {
+        return _size.load(std::memory_order_acquire);
+    }
+
+    inline bool empty() const {
+        return size() == 0;
+    }
+
+    /** @brief Child at a rank lower than a size read before*/
+    inline Object* operator[](size_t rank) const {
+        return _block.load(std::memory_order_acquire)->children[rank].load(std::memory_order_acquire);
+    }
+
+    inline Object* back() const {
+        return (*this)[size() - 1];
+    }
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    /** @brief Append and publish a child*/
+    void push_back(Object* child);
+
+    /** @brief Replace a child, to compact or expand it*/
+    void set(size_t rank, Object* child);
+
+    /** @brief Make room for children up to the count at once*/
+    void reserve(size_t count);
+
+    /** @brief Remove every child, and free the blocks*/
+    void clear();
+
+private:
+    struct Block
+    {
+        size_t capacity;
+        std::unique_ptr<std::atomic<Object*>[]> children;
+        // Replaced by this one
+        std::unique_ptr<Block> previous;
+    };
+
+    void grow(size_t capacity);
+
+    std::atomic<Block*> _block;
+    std::atomic<size_t> _size;
+
+    ChildList& operator=(const ChildList&) = delete;
+    ChildList(const ChildList&) = delete;
+};
+
+#endif // CHILDLIST_H
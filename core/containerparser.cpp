@@ -19,6 +19,7 @@
 #include "core/module.h"
 #include "core/log/logmanager.h"
 #include "core/parsingexception.h"
+#include "core/virtualchildren.h"
 
 ContainerParser::ContainerParser(Object &object, const Module &module)
     : Parser(object),
@@ -31,9 +32,13 @@ ContainerParser::ContainerParser(Object &object, const Module &module)
 void ContainerParser::addChild(Object *child)
 {
     if (child != nullptr) {
+        if (object()._virtualChildren) {
+            object().materializeVirtualChildren();
+        }
+
         std::streamoff pos = object().pos();
         if (child->size() == -1LL) {
-            if (object().size() != -1LL && child->isSetToExpandOnAddition()) {
+            if (child->isSetToExpandOnAddition() && object().size() != -1LL) {
                 child->setSize(object().size() - pos);
             } else {
                 child->parse();
@@ -44,20 +49,20 @@ void ContainerParser::addChild(Object *child)
 
 
         int64_t newSize = pos + child->size();
-        if (_autogrow && newSize > object().size()) {
+        if (_autogrow && newSize > object()._size) {
             object().setSize(newSize);
         }
 
         std::streamoff newPos;
         const bool fileGood = object().file().good();
-        const int64_t objectSize = object().size();
+        // A size still to be taken from the file is left unknown, the file bounds the children
+        const int64_t objectSize = object()._size;
         const int64_t newAbsolutePosition = object().beginningPos() + newSize;
-        const int64_t fileSize = object().file().size();
-        const bool outOfFile = (!fileGood || newAbsolutePosition > fileSize);
+        const bool outOfFile = (!fileGood || !object().file().reaches(newAbsolutePosition));
         const bool outOfParent = (objectSize != -1 && newSize > objectSize);
         if (outOfFile || outOfParent) {
-            if (object().size() != -1) {
-                newPos = object().size();
+            if (objectSize != -1) {
+                newPos = objectSize;
             } else {
                 newPos = 0;
             }
@@ -75,15 +80,15 @@ void ContainerParser::addChild(Object *child)
             object()._contentSize = newSize;
         }
 
-        if(!child->name().empty()) {
-            object()._lookUpTable[child->name()] = child;
+        if(!child->nameAtom().empty()) {
+            object()._lookUpTable.set(child->nameAtom(), object()._children.size());
         }
 
+        // Set before the child is added, for the threads reading the children
         child->_parent = &object();
+        child->_rank = static_cast<int64_t>(object()._children.size());
 
         object()._children.push_back(child);
-        object()._ownedChildren.push_back(std::unique_ptr<Object>(child));
-        child->_rank = _object._children.size() - 1;
         object()._lastChild = nullptr;
 
         if (!(child->isValid())) {
@@ -195,6 +200,20 @@ void ContainerParser::setAutogrow()
     }
 }
 
+void ContainerParser::addVirtualChildren(const ObjectType &elementType, std::streamoff elementSize, int64_t count,
+                                         const std::vector<std::string> &nameParts)
+{
+    Object& parent = object();
+    parent._virtualChildren.reset(new VirtualChildren(_module, elementType, parent.pos(), elementSize, count, nameParts));
+
+    const std::streamoff end = parent.pos() + count * elementSize;
+    parent.setPos(end);
+    parent.seekObjectEnd();
+    if (parent._contentSize < end) {
+        parent._contentSize = end;
+    }
+}
+
 void ContainerParser::throwChildError(const Object &child, ParsingException::Type type, const std::string reason) const
 {
     throw ParsingException(type, concat("Child ", child, " cannot be added to ", object(), " : ", reason));
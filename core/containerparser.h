@@ -79,6 +79,15 @@ protected:
      */
     void setAutogrow();
 
+    /**
+     * @brief Add a run of elements of the same fixed size at once, each one only built
+     * when accessed
+     *
+     * The object must have no children yet.
+     */
+    void addVirtualChildren(const ObjectType& elementType, std::streamoff elementSize, int64_t count,
+                            const std::vector<std::string>& nameParts);
+
 private:
     /**
      * @brief Generate an \link Object object\endlink to be subsequently added (or not)
@@ -5,16 +5,28 @@ SOURCES += \
     ../core/parser.cpp \
     ../core/objecttypetemplate.cpp \
     ../core/objecttype.cpp \
+    ../core/childlist.cpp \
+    ../core/leafstore.cpp \
+    ../core/parallelexplorer.cpp \
+    ../core/partitionedexplorer.cpp \
+    ../core/parseindex.cpp \
+    ../core/virtualchildren.cpp \
     ../core/object.cpp \
     ../core/moduleloader.cpp \
     ../core/module.cpp \
     ../core/mapmodule.cpp \
     ../core/containerparser.cpp \
+    ../core/exploration.cpp \
     ../core/file/esfragmentedfile.cpp \
     ../core/file/file.cpp \
     ../core/file/psifragmentedfile.cpp \
     ../core/file/fragmentedfile.cpp \
     ../core/file/realfile.cpp \
+    ../core/file/mappedfile.cpp \
+    ../core/file/cachedfile.cpp \
+    ../core/file/bitreader.cpp \
+    ../core/file/prefetchingfile.cpp \
+    ../core/file/uringfile.cpp \
     ../core/formatdetector/syncbyteformatdetector.cpp \
     ../core/formatdetector/standardformatdetector.cpp \
     ../core/formatdetector/magicformatdetector.cpp \
@@ -53,12 +65,15 @@ SOURCES += \
     ../core/modules/mkv/mkvmodule.cpp \
     ../core/modules/stream/streammodule.cpp \
     ../core/modules/stream/parentpidparser.cpp \
+    ../core/modules/stream/pidindex.cpp \
     ../core/util/strutil.cpp \
     ../core/util/iterutil.cpp \
     ../core/util/fileutil.cpp \
     ../core/util/csvreader.cpp \
     ../core/util/bitutil.cpp \
     ../core/util/osutil.cpp \
+    ../core/util/arena.cpp \
+    ../core/util/atom.cpp \
     ../core/variable/variable.cpp \
     ../core/variable/variablecollector.cpp \
     ../core/variable/commonvariable.cpp \
@@ -81,16 +96,28 @@ HEADERS  += \
     ../core/parser.h \
     ../core/objecttypetemplate.h \
     ../core/objecttype.h \
+    ../core/childlist.h \
+    ../core/leafstore.h \
+    ../core/parallelexplorer.h \
+    ../core/partitionedexplorer.h \
+    ../core/parseindex.h \
+    ../core/virtualchildren.h \
     ../core/object.h \
     ../core/moduleloader.h \
     ../core/module.h \
     ../core/mapmodule.h \
     ../core/containerparser.h \
+    ../core/exploration.h \
     ../core/file/esfragmentedfile.h \
     ../core/file/file.h \
     ../core/file/fragmentedfile.h \
     ../core/file/psifragmentedfile.h \
     ../core/file/realfile.h \
+    ../core/file/mappedfile.h \
+    ../core/file/cachedfile.h \
+    ../core/file/bitreader.h \
+    ../core/file/prefetchingfile.h \
+    ../core/file/uringfile.h \
     ../core/formatdetector/syncbyteformatdetector.h \
     ../core/formatdetector/standardformatdetector.h \
     ../core/formatdetector/magicformatdetector.h \
@@ -129,6 +156,7 @@ HEADERS  += \
     ../core/modules/mkv/mkvmodule.h \
     ../core/modules/stream/streammodule.h \
     ../core/modules/stream/parentpidparser.h \
+    ../core/modules/stream/pidindex.h \
     ../core/util/unused.h \
     ../core/util/strutil.h \
     ../core/util/iterutil.h \
@@ -137,6 +165,8 @@ HEADERS  += \
     ../core/util/bitutil.h \
     ../core/util/ptrutil.h \
     ../core/util/osutil.h \
+    ../core/util/arena.h \
+    ../core/util/atom.h \
     ../core/util/rapidxml/rapidxml_utils.hpp \
     ../core/util/rapidxml/rapidxml_print.hpp \
     ../core/util/rapidxml/rapidxml_iterators.hpp \
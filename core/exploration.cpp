@@ -0,0 +1,223 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <chrono>
+
+#include "core/exploration.h"
+#include "core/object.h"
+#include "core/virtualchildren.h"
+
+// Batches adding no child before the exploration stalls
+#define MAX_STALLED_BATCHES 8
+
+Exploration::Exploration(Object &object, int depth)
+    : _object(object),
+      _cancelled(false),
+      _batchSize(128),
+      _nodeBudget(-1),
+      _timeBudget(-1),
+      _parseWhenStalled(false),
+      _progressInterval(4096),
+      _lastReport(0),
+      _progress{0, 0},
+      _status(complete)
+{
+    if (depth != 0) {
+        push(object, depth);
+    }
+}
+
+Exploration::~Exploration()
+{
+    for (const Frame& frame : _frames) {
+        if (frame.parsed) {
+            --frame.object->_busyCount;
+        }
+    }
+}
+
+Exploration::Status Exploration::run()
+{
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(_timeBudget);
+
+    while (!_frames.empty()) {
+        if (_cancelled) {
+            _status = cancelled;
+            reportProgress(true);
+            return _status;
+        }
+        if ((_nodeBudget >= 0 && _progress.nodeCount >= _nodeBudget)
+                || (_timeBudget >= 0 && Clock::now() >= deadline)) {
+            _status = outOfBudget;
+            reportProgress(true);
+            return _status;
+        }
+
+        Frame& frame = _frames.back();
+        if (!frame.parsed) {
+            if (parseSome(frame)) {
+                frame.parsed = true;
+                ++frame.object->_busyCount;
+            } else if (frame.stalledBatches >= MAX_STALLED_BATCHES) {
+                // The object is given as many batches again when run again
+                frame.stalledBatches = 0;
+                _status = stalled;
+                reportProgress(true);
+                return _status;
+            }
+            reportProgress(false);
+            continue;
+        }
+
+        const int depth = frame.depth;
+        Object* child = nextChild(frame);
+        if (child == nullptr) {
+            pop();
+        } else if (depth != 1) {
+            push(*child, depth == -1 ? -1 : depth - 1);
+        }
+    }
+
+    _status = complete;
+    reportProgress(true);
+    return _status;
+}
+
+void Exploration::cancel()
+{
+    _cancelled = true;
+}
+
+bool Exploration::isCancelled() const
+{
+    return _cancelled;
+}
+
+void Exploration::setBatchSize(int size)
+{
+    _batchSize = size > 0 ? size : 1;
+}
+
+void Exploration::setNodeBudget(int64_t count)
+{
+    _nodeBudget = count;
+}
+
+void Exploration::setTimeBudget(int64_t milliseconds)
+{
+    _timeBudget = milliseconds;
+}
+
+void Exploration::setParseWhenStalled(bool parse)
+{
+    _parseWhenStalled = parse;
+}
+
+void Exploration::setProgressCallback(const Exploration::ProgressCallback &callback, int64_t interval)
+{
+    _progressCallback = callback;
+    _progressInterval = interval > 0 ? interval : 1;
+}
+
+const Exploration::Progress &Exploration::progress() const
+{
+    return _progress;
+}
+
+Exploration::Status Exploration::status() const
+{
+    return _status;
+}
+
+void Exploration::push(Object &object, int depth)
+{
+    // Only the children added from now on are counted
+    const int64_t childCount = object.numberOfChildren();
+    _frames.push_back(Frame{&object, depth, 0, -1, childCount, 0, false});
+}
+
+bool Exploration::parseSome(Exploration::Frame &frame)
+{
+    Object& object = *frame.object;
+    object.makeResident();
+
+    bool done = object.parsed() || object.exploreSome(_batchSize);
+    int64_t count = object.numberOfChildren();
+
+    if (done || count > frame.childCount) {
+        frame.stalledBatches = 0;
+    } else if (++frame.stalledBatches >= MAX_STALLED_BATCHES && _parseWhenStalled) {
+        // Parsers unable to parse by batches are run to the end
+        object.seekObjectEnd();
+        object.parse();
+        count = object.numberOfChildren();
+        done = true;
+    }
+
+    _progress.nodeCount += count - frame.childCount;
+    frame.childCount = count;
+    return done;
+}
+
+Object *Exploration::nextChild(Exploration::Frame &frame)
+{
+    Object& object = *frame.object;
+
+    // Compact leaves have nothing left to explore
+    for (; frame.rank < static_cast<int64_t>(object._children.size()); ++frame.rank) {
+        Object* child = object._children[frame.rank];
+        if (child != nullptr) {
+            ++frame.rank;
+            return child;
+        }
+    }
+
+    // Only the virtual children built so far are explored
+    if (object._virtualChildren) {
+        const auto& elements = object._virtualChildren->elements();
+        const auto it = elements.upper_bound(frame.element);
+        if (it != elements.end()) {
+            frame.element = it->first;
+            return it->second.object;
+        }
+    }
+    return nullptr;
+}
+
+void Exploration::pop()
+{
+    Object& object = *_frames.back().object;
+    --object._busyCount;
+    _frames.pop_back();
+
+    if (object.size() != -1) {
+        const int64_t end = (static_cast<int64_t>(object.beginningPos()) + object.size()
+                             - static_cast<int64_t>(_object.beginningPos())) / 8;
+        if (end > _progress.coveredSize) {
+            _progress.coveredSize = end;
+        }
+    }
+}
+
+void Exploration::reportProgress(bool force)
+{
+    if (_progressCallback && (force || _progress.nodeCount - _lastReport >= _progressInterval)) {
+        _lastReport = _progress.nodeCount;
+        _progressCallback(_progress);
+    }
+}
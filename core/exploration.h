@@ -0,0 +1,145 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef EXPLORATION_H
+#define EXPLORATION_H
+
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+#include <vector>
+
+class Object;
+
+/**
+ * @brief Exploration of an \link Object object\endlink and its descendants,
+ * run iteratively from a frontier of objects
+ *
+ * The objects are explored in the same order as by Object::explore, depth first,
+ * but the descendants left to explore are kept in a stack of their own rather
+ * than on the call stack, so that deep trees cannot overflow it. Each object is
+ * parsed by batches of children, between which the exploration can be
+ * \link cancel() cancelled\endlink, report its \link setProgressCallback progress\endlink
+ * or stop when it runs out of its budgets. It also stops as stalled when an object
+ * adds no child for several batches in a row, unless such objects are to be
+ * \link setParseWhenStalled parsed at once\endlink. A stopped exploration goes on
+ * from where it stopped when \link run() run\endlink again.
+ *
+ * The objects on the frontier are kept from being evicted by the
+ * \link Object::setMemoryBudget memory budget\endlink until they are explored.
+ */
+class Exploration
+{
+public:
+    enum Status {
+        complete,
+        cancelled,
+        outOfBudget,
+        stalled
+    };
+
+    struct Progress
+    {
+        // Bytes of the file covered by the objects fully explored
+        int64_t coveredSize;
+        // Children added by the exploration, not counting those the objects had when reached
+        int64_t nodeCount;
+    };
+
+    typedef std::function<void (const Progress&)> ProgressCallback;
+
+    /**
+     * @param depth is the depth of the exploration, as for Object::explore, -1 to explore everything
+     */
+    explicit Exploration(Object& object, int depth = -1);
+    ~Exploration();
+
+    /**
+     * @brief Explore until done, cancelled, out of budget or stalled
+     */
+    Status run();
+
+    /**
+     * @brief Make the exploration stop at the next batch
+     *
+     * Can be called from any thread, or from a signal handler.
+     */
+    void cancel();
+    bool isCancelled() const;
+
+    /** @brief Number of children parsed at once, 128 by default*/
+    void setBatchSize(int size);
+
+    /** @brief Stop once this many children have been added, -1 for no limit*/
+    void setNodeBudget(int64_t count);
+
+    /** @brief Stop each run after this duration, -1 for no limit*/
+    void setTimeBudget(int64_t milliseconds);
+
+    /**
+     * @brief Parse at once the objects adding no child for several batches,
+     * rather than stopping as stalled, false by default
+     */
+    void setParseWhenStalled(bool parse);
+
+    /**
+     * @brief Call the function every time interval more children have been added,
+     * and when the run stops
+     */
+    void setProgressCallback(const ProgressCallback& callback, int64_t interval = 4096);
+
+    const Progress& progress() const;
+    Status status() const;
+
+private:
+    struct Frame
+    {
+        Object* object;
+        int depth;
+        // Next child to explore, the virtual ones coming after the others
+        int64_t rank;
+        int64_t element;
+        // Children the object had when reached, or counted in the progress since
+        int64_t childCount;
+        int stalledBatches;
+        bool parsed;
+    };
+
+    void push(Object& object, int depth);
+    bool parseSome(Frame& frame);
+    Object* nextChild(Frame& frame);
+    void pop();
+    void reportProgress(bool force);
+
+    Object& _object;
+    std::vector<Frame> _frames;
+    std::atomic<bool> _cancelled;
+    int _batchSize;
+    int64_t _nodeBudget;
+    int64_t _timeBudget;
+    bool _parseWhenStalled;
+    ProgressCallback _progressCallback;
+    int64_t _progressInterval;
+    int64_t _lastReport;
+    Progress _progress;
+    Status _status;
+
+    Exploration& operator=(const Exploration&) = delete;
+    Exploration(const Exploration&) = delete;
+};
+
+#endif // EXPLORATION_H
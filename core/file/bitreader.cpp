@@ -0,0 +1,204 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <algorithm>
+#include <cstring>
+
+#include "core/file/bitreader.h"
+
+BitReader::BitReader(std::istream &stream, size_t bufferSize)
+    : _stream(stream),
+      _buffer(bufferSize > 0 ? bufferSize : 1),
+      _bufferBase(0),
+      _bufferLength(0),
+      _bufferPos(0),
+      _accumulator(0),
+      _accumulatorBits(0),
+      _fail(false)
+{
+}
+
+void BitReader::reset()
+{
+    _stream.clear();
+    _stream.seekg(0, std::ios_base::beg);
+    _bufferBase = 0;
+    _bufferLength = 0;
+    _bufferPos = 0;
+    _accumulator = 0;
+    _accumulatorBits = 0;
+    _fail = false;
+}
+
+void BitReader::seek(int64_t position)
+{
+    if (position < 0) {
+        _fail = true;
+        return;
+    }
+
+    const int64_t byte = position / 8;
+    if (byte >= _bufferBase && byte <= _bufferBase + static_cast<int64_t>(_bufferLength)) {
+        // Already buffered, or right after the buffer where the stream already is
+        _bufferPos = byte - _bufferBase;
+    } else {
+        _stream.clear();
+        _stream.seekg(byte, std::ios_base::beg);
+        _bufferBase = byte;
+        _bufferLength = 0;
+        _bufferPos = 0;
+    }
+    _accumulator = 0;
+    _accumulatorBits = 0;
+
+    if (position & 0x7) {
+        readBits(position & 0x7);
+    }
+}
+
+int64_t BitReader::position() const
+{
+    return 8 * (_bufferBase + static_cast<int64_t>(_bufferPos)) - _accumulatorBits;
+}
+
+uint64_t BitReader::readBits(int count)
+{
+    if (count <= 0) {
+        return 0;
+    }
+
+    // Leave enough room in the accumulator to fit a whole byte
+    if (count > 56) {
+        const uint64_t high = readBits(count - 32);
+        return (high << 32) | readBits(32);
+    }
+
+    while (_accumulatorBits < count) {
+        if (_bufferPos == _bufferLength && !refill()) {
+            // Missing bits are read as zeros
+            _fail = true;
+            const uint64_t result = _accumulator >> (64 - count);
+            _accumulator = 0;
+            _accumulatorBits = 0;
+            return result;
+        }
+
+        while (_accumulatorBits <= 56 && _bufferPos < _bufferLength) {
+            _accumulator |= static_cast<uint64_t>(_buffer[_bufferPos]) << (56 - _accumulatorBits);
+            _accumulatorBits += 8;
+            ++_bufferPos;
+        }
+    }
+
+    const uint64_t result = _accumulator >> (64 - count);
+    _accumulator <<= count;
+    _accumulatorBits -= count;
+    return result;
+}
+
+void BitReader::read(char *s, int64_t count)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    if ((_accumulatorBits & 0x7) == 0 && (count & 0x7) == 0) {
+        readBytes(s, count / 8);
+        return;
+    }
+
+    const int64_t resultSize = (count + 7) / 8;
+    s[0] = static_cast<char>(readBits(count - 8 * (resultSize - 1)));
+
+    // Then by blocks of 8 bytes
+    for (int64_t i = 1; i < resultSize;) {
+        const int n = static_cast<int>(std::min<int64_t>(8, resultSize - i));
+        uint64_t value = readBits(8 * n);
+        for (int j = n - 1; j >= 0; --j) {
+            s[i + j] = static_cast<char>(value & 0xff);
+            value >>= 8;
+        }
+        i += n;
+    }
+}
+
+bool BitReader::fail() const
+{
+    return _fail;
+}
+
+void BitReader::clear()
+{
+    _fail = false;
+}
+
+bool BitReader::refill()
+{
+    _bufferBase += _bufferLength;
+    _bufferPos = 0;
+    _stream.read(reinterpret_cast<char*>(_buffer.data()), _buffer.size());
+    _bufferLength = _stream.gcount();
+    if (!_stream) {
+        // Keep the stream usable for the next seek
+        _stream.clear();
+    }
+    return _bufferLength > 0;
+}
+
+void BitReader::readBytes(char *s, int64_t count)
+{
+    // The accumulator holds whole bytes when the position is aligned
+    while (count > 0 && _accumulatorBits > 0) {
+        *s = static_cast<char>(readBits(8));
+        ++s;
+        --count;
+    }
+
+    while (count > 0) {
+        if (_bufferPos == _bufferLength) {
+            if (count >= static_cast<int64_t>(_buffer.size())) {
+                // Big reads skip the buffer
+                _bufferBase += _bufferLength;
+                _bufferLength = 0;
+                _bufferPos = 0;
+                _stream.read(s, count);
+                const int64_t readCount = _stream.gcount();
+                if (!_stream) {
+                    _stream.clear();
+                }
+                _bufferBase += readCount;
+                if (readCount < count) {
+                    std::memset(s + readCount, 0, count - readCount);
+                    _fail = true;
+                }
+                return;
+            }
+
+            if (!refill()) {
+                std::memset(s, 0, count);
+                _fail = true;
+                return;
+            }
+        }
+
+        const int64_t n = std::min<int64_t>(count, _bufferLength - _bufferPos);
+        std::memcpy(s, _buffer.data() + _bufferPos, n);
+        _bufferPos += n;
+        s += n;
+        count -= n;
+    }
+}
@@ -0,0 +1,80 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef BITREADER_H
+#define BITREADER_H
+
+#include <istream>
+#include <stdint.h>
+#include <vector>
+
+/** @brief Bit precise reader over an input stream
+ *
+ * Bytes are read from the stream by blocks into a buffer, and moved from the
+ * buffer into a 64-bit accumulator from which reads of 1 to 64 bits are served
+ * with shifts and masks. The stream is only read forward : it is repositioned
+ * only when seeking outside of the buffered block.
+ */
+class BitReader
+{
+public:
+    BitReader(std::istream& stream, size_t bufferSize = 16384);
+
+    /** @brief Drops the buffered data and moves to the beginning of the stream*/
+    void reset();
+
+    /** @brief Moves to the given position in bits*/
+    void seek(int64_t position);
+
+    /** @brief Returns the current position in bits*/
+    int64_t position() const;
+
+    /** @brief Reads count bits, between 1 and 64, most significant bit first*/
+    uint64_t readBits(int count);
+
+    /** @brief Extracts count bits
+
+    Puts the result in a byte array already allocated
+    the result is right aligned and zero padded*/
+    void read(char* s, int64_t count);
+
+    /** @brief Checks if a read went past the end of the stream or a seek failed*/
+    bool fail() const;
+
+    /** @brief Clears the error flag*/
+    void clear();
+
+private:
+    BitReader& operator=(const BitReader&) = delete;
+    BitReader(const BitReader&) = delete;
+
+    bool refill();
+    void readBytes(char* s, int64_t count);
+
+    std::istream& _stream;
+    std::vector<uint8_t> _buffer;
+    int64_t _bufferBase;
+    size_t _bufferLength;
+    size_t _bufferPos;
+
+    uint64_t _accumulator;
+    int _accumulatorBits;
+
+    bool _fail;
+};
+
+#endif // BITREADER_H
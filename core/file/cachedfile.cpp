@@ -0,0 +1,249 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+#include "core/file/cachedfile.h"
+#include "core/util/bitutil.h"
+
+// Reads up to this size (in bytes) are assembled on the stack
+#define SMALL_READ_SIZE 16
+
+namespace {
+// Size of the underlying file not asked for yet
+const int64_t unknownSize = -1;
+}
+
+CachedFile::CachedFile(File *file, size_t pageSize, size_t pageCount)
+    : File(),
+      _file(file),
+      _pageSize(pageSize > 0 ? pageSize : 1),
+      _pageCount(pageCount > 0 ? pageCount : 1),
+      _size(unknownSize),
+      _position(0),
+      _fail(false),
+      _hitCount(0),
+      _missCount(0)
+{
+}
+
+void CachedFile::setPath(const std::string &path)
+{
+    _file->setPath(path);
+    dropPages();
+    _size.store(unknownSize, std::memory_order_release);
+    _position = 0;
+    _fail = false;
+}
+
+const std::string &CachedFile::path() const
+{
+    return _file->path();
+}
+
+void CachedFile::open()
+{
+    _file->open();
+    dropPages();
+    _size.store(_file->size(), std::memory_order_release);
+}
+
+void CachedFile::close()
+{
+    _file->close();
+}
+
+void CachedFile::clear()
+{
+    _file->clear();
+    _fail = false;
+}
+
+void CachedFile::read(char *s, int64_t count)
+{
+    if(count == 0)
+        return;
+
+    const int64_t end = _position + count;
+    const bool outOfFile = end > size();
+
+    if ((_position & 0x7) == 0 && (count & 0x7) == 0) {
+        copyBytes(reinterpret_cast<uint8_t*>(s), _position / 8, count / 8);
+    } else {
+        const int64_t byteCount = ((_position & 0x7) + count + 7) / 8;
+        if (byteCount <= SMALL_READ_SIZE) {
+            uint8_t buffer[SMALL_READ_SIZE];
+            copyBytes(buffer, _position / 8, byteCount);
+            copyBits(s, buffer, _position & 0x7, count);
+        } else {
+            std::vector<uint8_t> buffer(byteCount);
+            copyBytes(buffer.data(), _position / 8, byteCount);
+            copyBits(s, buffer.data(), _position & 0x7, count);
+        }
+    }
+
+    if (outOfFile) {
+        _fail = true;
+        _position = std::max(_position, size());
+    } else {
+        _position = end;
+    }
+}
+
+bool CachedFile::prefetch(int64_t position, int64_t size)
+{
+    return _file->prefetch(position, size);
+}
+
+void CachedFile::seekg(int64_t off, std::ios_base::seekdir dir)
+{
+    int64_t newPosition;
+    switch (dir)
+    {
+        case std::ios_base::beg :
+            newPosition = off;
+        break;
+        case std::ios_base::end :
+            newPosition = size() + off;
+        break;
+        default:
+            newPosition = _position + off;
+        break;
+    }
+
+    if (newPosition < 0) {
+        _fail = true;
+    } else {
+        _position = newPosition;
+    }
+}
+
+int64_t CachedFile::tellg()
+{
+    return _position;
+}
+
+int64_t CachedFile::size()
+{
+    int64_t size = _size.load(std::memory_order_acquire);
+    if (size == unknownSize) {
+        // Asked for once the underlying file is set up, as it may not be opened yet
+        size = _file->size();
+        _size.store(size, std::memory_order_release);
+    }
+    return size;
+}
+
+bool CachedFile::good()
+{
+    return !_fail && _file->good();
+}
+
+uint64_t CachedFile::hitCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _hitCount;
+}
+
+uint64_t CachedFile::missCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _missCount;
+}
+
+File &CachedFile::underlyingFile()
+{
+    return *_file;
+}
+
+int64_t CachedFile::readBytesAt(int64_t firstByte, char *s, int64_t byteCount)
+{
+    copyBytes(reinterpret_cast<uint8_t*>(s), firstByte, byteCount);
+    return std::max<int64_t>(0, std::min(byteCount, size() / 8 - firstByte));
+}
+
+int64_t CachedFile::copyBytesTo(int64_t firstByte, int64_t byteCount, int descriptor)
+{
+    const int64_t copyCount = std::max<int64_t>(0, std::min(byteCount, size() / 8 - firstByte));
+    return _file->copyTo(8 * firstByte, copyCount, descriptor) ? copyCount : 0;
+}
+
+const CachedFile::Page &CachedFile::page(int64_t index)
+{
+    auto it = _pageTable.find(index);
+    if (it != _pageTable.end()) {
+        ++_hitCount;
+        // Move the page to the front of the list
+        _pages.splice(_pages.begin(), _pages, it->second);
+        return _pages.front();
+    }
+
+    ++_missCount;
+    if (_pages.size() >= _pageCount) {
+        // Recycle the least recently used page
+        _pageTable.erase(_pages.back().index);
+        _pages.splice(_pages.begin(), _pages, std::prev(_pages.end()));
+    } else {
+        _pages.emplace_front();
+    }
+
+    Page& page = _pages.front();
+    page.index = index;
+
+    const int64_t begin = index * _pageSize;
+    const int64_t length = std::max<int64_t>(0, std::min<int64_t>(_pageSize, size() / 8 - begin));
+    page.data.resize(length);
+    if (length > 0) {
+        _file->readAt(8 * begin, reinterpret_cast<char*>(page.data.data()), 8 * length);
+    }
+    _pageTable[index] = _pages.begin();
+    return page;
+}
+
+void CachedFile::copyBytes(uint8_t *destination, int64_t firstByte, int64_t byteCount)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    while (byteCount > 0) {
+        if (8 * firstByte >= size()) {
+            // Past the end of the file
+            std::memset(destination, 0, byteCount);
+            return;
+        }
+
+        const int64_t index = firstByte / _pageSize;
+        const int64_t offset = firstByte % _pageSize;
+        const int64_t chunkSize = std::min<int64_t>(byteCount, _pageSize - offset);
+
+        const Page& current = page(index);
+        const int64_t available = std::max<int64_t>(0, std::min<int64_t>(chunkSize, static_cast<int64_t>(current.data.size()) - offset));
+        std::memcpy(destination, current.data.data() + offset, available);
+        std::memset(destination + available, 0, chunkSize - available);
+
+        destination += chunkSize;
+        firstByte += chunkSize;
+        byteCount -= chunkSize;
+    }
+}
+
+void CachedFile::dropPages()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pages.clear();
+    _pageTable.clear();
+}
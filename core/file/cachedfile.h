@@ -0,0 +1,141 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef CACHEDFILE_H
+#define CACHEDFILE_H
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "core/file/file.h"
+
+/** @brief Decorator keeping the most recently used pages of a \link File file\endlink
+ * in memory.
+ *
+ * The underlying file is read by fixed-size pages, kept in a least recently used
+ * cache, and every read and seek is then served from memory. This makes the many
+ * byte-at-a-time reads done by format detectors and parsers nearly free.
+ *
+ * Pages are filled with positional reads on the underlying file, and the
+ * cache is shared by read and readAt under a lock.
+ *
+ * The cached file takes ownership of the underlying file.
+ */
+class CachedFile : public File
+{
+public:
+    /**
+     * @param file underlying file, must not be nullptr
+     * @param pageSize size of a page in bytes
+     * @param pageCount maximum number of pages kept in memory
+     */
+    CachedFile(File* file, size_t pageSize = 65536, size_t pageCount = 16);
+
+    /** @brief Sets the path to the underlying file*/
+    virtual void setPath(const std::string& path) override;
+
+    /** @brief Returns the path to the underlying file*/
+    virtual const std::string& path() const override;
+
+    /** @brief Opens the underlying file and drops the cached pages*/
+    virtual void open() override;
+
+    /** @brief Closes the underlying file*/
+    virtual void close() override;
+
+    /** @brief Clears the file error flags*/
+    virtual void clear() override;
+
+
+    /** @brief Extracts bits from the cached pages
+
+    Puts the result in a byte array already allocated
+    the result is right aligned and zero padded*/
+    virtual void read(char* s, int64_t size) override;
+
+    /** @brief Forwards the hint to the underlying file*/
+    virtual bool prefetch(int64_t position, int64_t size) override;
+
+    /** @brief Offsets the position
+
+     * \param off Offset to apply in bits.
+     * \param dir Where to start from to apply the offset.
+     * begin (std::ios_base::beg), current (std::ios_base::cur) or
+     * end (std::ios_base::end).
+     */
+    virtual void seekg(int64_t off, std::ios_base::seekdir dir) override;
+
+    /** @brief Returns the current stream position */
+    virtual int64_t tellg() override;
+
+    /** @brief Returns the size of the file*/
+    virtual int64_t size() override;
+
+    /** @brief Checks if data can be recovered from the file*/
+    virtual bool good() override;
+
+    /** @brief Number of page lookups served from memory*/
+    uint64_t hitCount() const;
+
+    /** @brief Number of page lookups that had to read the underlying file*/
+    uint64_t missCount() const;
+
+    File& underlyingFile();
+
+protected:
+    virtual int64_t readBytesAt(int64_t firstByte, char* s, int64_t byteCount) override;
+
+    /** @brief Copies from the underlying file, bypassing the pages*/
+    virtual int64_t copyBytesTo(int64_t firstByte, int64_t byteCount, int descriptor) override;
+
+private:
+    CachedFile& operator=(const CachedFile&) = delete;
+    CachedFile(const CachedFile&) = delete;
+
+    struct Page
+    {
+        int64_t index;
+        std::vector<uint8_t> data;
+    };
+    typedef std::list<Page> PageList;
+
+    const Page& page(int64_t index);
+    void copyBytes(uint8_t* destination, int64_t firstByte, int64_t byteCount);
+    void dropPages();
+
+    std::unique_ptr<File> _file;
+    const size_t _pageSize;
+    const size_t _pageCount;
+
+    mutable std::mutex _mutex;
+    PageList _pages;
+    std::unordered_map<int64_t, PageList::iterator> _pageTable;
+
+    // Read from the underlying file when first asked for
+    std::atomic<int64_t> _size;
+    int64_t _position;
+    bool _fail;
+
+    uint64_t _hitCount;
+    uint64_t _missCount;
+};
+
+#endif // CACHEDFILE_H
@@ -1,4 +1,3 @@
-
 #ifndef ES_FRAGMENTED_FILE_H
 #define ES_FRAGMENTED_FILE_H
 
@@ -11,8 +10,8 @@ public:
 private:
     virtual bool importNextFragment() override;
     int _pid;
-    uint32_t _n;
-    static uint32_t maxFragmentNumber;
+    // Rank of the last packet imported
+    int _rank;
 };
 
-#endif // ES_FRAGMENTED_FILE
\ No newline at end of file
+#endif // ES_FRAGMENTED_FILE_H
@@ -1,7 +1,163 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
 #include "core/file/file.h"
+#include "core/util/bitutil.h"
+#include "core/util/osutil.h"
+
+#if defined(PLATFORM_WIN32)
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
+
+// Unaligned reads up to this size (in bytes) are assembled on the stack
+#define SMALL_READ_SIZE 16
+// Size (in bytes) of the chunks of copies going through a buffer
+#define COPY_BUFFER_SIZE 1048576
 
 File::File() : _bitPosition(0) {}
 
+bool File::readAt(int64_t position, char *s, int64_t size)
+{
+    if (size <= 0) {
+        return true;
+    }
+    if (position < 0) {
+        return false;
+    }
+
+    const int64_t firstByte = position / 8;
+    const int bitOffset = position & 0x7;
+    const int64_t byteCount = (bitOffset + size + 7) / 8;
+
+    if (bitOffset == 0 && (size & 0x7) == 0) {
+        const int64_t readCount = readBytesAt(firstByte, s, byteCount);
+        std::memset(s + readCount, 0, byteCount - readCount);
+        return readCount == byteCount;
+    }
+
+    uint8_t smallBuffer[SMALL_READ_SIZE];
+    std::vector<uint8_t> bigBuffer;
+    uint8_t* buffer = smallBuffer;
+    if (byteCount > SMALL_READ_SIZE) {
+        bigBuffer.resize(byteCount);
+        buffer = bigBuffer.data();
+    }
+
+    const int64_t readCount = readBytesAt(firstByte, reinterpret_cast<char*>(buffer), byteCount);
+    std::memset(buffer + readCount, 0, byteCount - readCount);
+    copyBits(s, buffer, bitOffset, size);
+    return readCount == byteCount;
+}
+
+bool File::copyTo(int64_t position, int64_t byteCount, int descriptor)
+{
+    if (byteCount <= 0) {
+        return true;
+    }
+    if (position < 0) {
+        return false;
+    }
+
+    if ((position & 0x7) == 0) {
+        return copyBytesTo(position / 8, byteCount, descriptor) == byteCount;
+    }
+
+    std::vector<char> buffer(std::min<int64_t>(byteCount, COPY_BUFFER_SIZE));
+    for (int64_t copyCount = 0; copyCount < byteCount;) {
+        const int64_t chunkCount = std::min<int64_t>(byteCount - copyCount, buffer.size());
+        if (!readAt(position + 8 * copyCount, buffer.data(), 8 * chunkCount)
+         || writeBytes(descriptor, buffer.data(), chunkCount) != chunkCount) {
+            return false;
+        }
+        copyCount += chunkCount;
+    }
+    return true;
+}
+
+bool File::copyTo(int64_t position, int64_t byteCount, std::ostream &out)
+{
+    if (byteCount <= 0) {
+        return true;
+    }
+
+    std::vector<char> buffer(std::min<int64_t>(byteCount, COPY_BUFFER_SIZE));
+    for (int64_t copyCount = 0; copyCount < byteCount;) {
+        const int64_t chunkCount = std::min<int64_t>(byteCount - copyCount, buffer.size());
+        if (!readAt(position + 8 * copyCount, buffer.data(), 8 * chunkCount)) {
+            return false;
+        }
+        out.write(buffer.data(), chunkCount);
+        copyCount += chunkCount;
+    }
+    return out.good();
+}
+
+const char *File::bytesInMemory(int64_t /*firstByte*/, int64_t /*byteCount*/)
+{
+    return nullptr;
+}
+
+bool File::prefetch(int64_t /*position*/, int64_t /*size*/)
+{
+    return false;
+}
+
+int64_t File::knownSize()
+{
+    return size();
+}
+
+bool File::hasKnownSize()
+{
+    return true;
+}
+
+bool File::reaches(int64_t position)
+{
+    return position <= size();
+}
+
+File *File::duplicate() const
+{
+    return nullptr;
+}
+
+int64_t File::copyBytesTo(int64_t firstByte, int64_t byteCount, int descriptor)
+{
+    std::vector<char> buffer(std::min<int64_t>(byteCount, COPY_BUFFER_SIZE));
+    int64_t copyCount = 0;
+    while (copyCount < byteCount) {
+        const int64_t readCount = readBytesAt(firstByte + copyCount, buffer.data(),
+                                              std::min<int64_t>(byteCount - copyCount, buffer.size()));
+        const int64_t writeCount = writeBytes(descriptor, buffer.data(), readCount);
+        copyCount += writeCount;
+        if (readCount == 0 || writeCount < readCount) {
+            break;
+        }
+    }
+    return copyCount;
+}
+
+int64_t File::writeBytes(int descriptor, const char *s, int64_t byteCount)
+{
+    int64_t writeCount = 0;
+    while (writeCount < byteCount) {
+        const int64_t chunkCount = write(descriptor, s + writeCount,
+                                         std::min<int64_t>(byteCount - writeCount, 1 << 30));
+        if (chunkCount < 0 && errno == EINTR) {
+            continue;
+        } else if (chunkCount <= 0) {
+            break;
+        }
+        writeCount += chunkCount;
+    }
+    return writeCount;
+}
+
 FileAnchor::FileAnchor(File &file)
     :file(file),
      position(file.tellg())
@@ -16,6 +16,7 @@ class File
 {
 public:
     File();
+    virtual ~File() {}
 
     /** @brief Sets the path to the file*/
     virtual void setPath(const std::string& path) = 0;
@@ -39,6 +40,45 @@ public:
     the result is right aligned and zero padded*/
     virtual void read(char* s, int64_t size) = 0;
 
+    /** @brief Extracts bits at an absolute position without using nor moving
+    the current position
+
+    Puts the result in a byte array already allocated
+    the result is right aligned and zero padded.
+
+    The call relies on no shared state and can be made from several threads
+    at once, but not concurrently with open, close or setPath.
+    \return false if the bits requested are not all in the file*/
+    virtual bool readAt(int64_t position, char* s, int64_t size);
+
+    /** @brief Writes bytes starting at an absolute bit position to a file
+    descriptor, without using nor moving the current position
+
+    Byte-aligned ranges are handed to copyBytesTo, which files may implement
+    without copying the bytes through user space. Unaligned ranges are shifted
+    through a buffer. Same thread-safety rules as readAt.
+    \return false if the bytes could not all be written*/
+    bool copyTo(int64_t position, int64_t byteCount, int descriptor);
+
+    /** @brief Writes bytes starting at an absolute bit position to a stream,
+    without using nor moving the current position
+
+    \return false if the bytes could not all be written*/
+    bool copyTo(int64_t position, int64_t byteCount, std::ostream& out);
+
+    /** @brief Returns the bytes in place when the file holds them in memory
+
+    Same thread-safety rules as readAt.
+    \return nullptr if the bytes are not all in memory*/
+    virtual const char* bytesInMemory(int64_t firstByte, int64_t byteCount);
+
+    /** @brief Hints that the bits in the given range are about to be read
+
+    Files able to read asynchronously start reading the range and return
+    immediately. Same thread-safety rules as readAt.
+    \return false if the hint is ignored*/
+    virtual bool prefetch(int64_t position, int64_t size);
+
     /** @brief Offsets the position
 
      * \param off Offset to apply in bits.
@@ -54,10 +94,44 @@ public:
     /** @brief Returns the size of the file*/
     virtual int64_t size() = 0;
 
+    /** @brief Returns a lower bound of the size known without reading further
+
+    Equals the size for files whose size is known upfront.*/
+    virtual int64_t knownSize();
+
+    /** @brief Checks if the size can be given without reading further*/
+    virtual bool hasKnownSize();
+
+    /** @brief Checks if the file extends up to the position, reading only as
+    far as needed to know it*/
+    virtual bool reaches(int64_t position);
+
     /** @brief Checks if data can be recovered from the stream*/
     virtual bool good() = 0;
 
+    /** @brief Opens another handle on the same file, with a position of its own,
+    so that the file can be parsed from several threads at once
+
+    \return nullptr if the file cannot be opened again*/
+    virtual File* duplicate() const;
+
 protected:
+    /** @brief Reads whole bytes at an absolute position in a thread-safe manner
+
+    \return the number of bytes actually read*/
+    virtual int64_t readBytesAt(int64_t firstByte, char* s, int64_t byteCount) = 0;
+
+    /** @brief Writes whole bytes at an absolute position to a file descriptor
+
+    The default implementation reads them by chunks with readBytesAt.
+    \return the number of bytes actually written*/
+    virtual int64_t copyBytesTo(int64_t firstByte, int64_t byteCount, int descriptor);
+
+    /** @brief Writes the bytes to a file descriptor, retrying on interruptions
+
+    \return the number of bytes actually written*/
+    static int64_t writeBytes(int descriptor, const char* s, int64_t byteCount);
+
     char _bitPosition;
 
 private:
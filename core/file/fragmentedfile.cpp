@@ -1,12 +1,22 @@
 
+#include <algorithm>
+#include <cerrno>
 #include <stdexcept>
 
 #include "core/file/fragmentedfile.h"
 #include "core/object.h"
 #include "core/module.h"
+#include "core/util/osutil.h"
+
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_APPLE)
+    #include <sys/uio.h>
+#endif
+
+// Maximum number of fragments gathered in a single write
+#define GATHER_COUNT 1024
 
 FragmentedFile::FragmentedFile(Object *object) :
-    File(), _parent(object), _parentFile(object->file()), _tellg(0) {}
+    File(), _parent(object), _parentFile(object->file()), _tellg(0), _fail(false), _cursor(0), _complete(false) {}
 
 void FragmentedFile::setPath(const std::string& path) {
     _path = path;
@@ -20,46 +30,209 @@ void FragmentedFile::open() {}
 
 void FragmentedFile::close() {}
 
-void FragmentedFile::clear() {}
+void FragmentedFile::clear() {
+    _fail = false;
+}
 
 void FragmentedFile::read(char* s, int64_t count) {
     if(count == 0)
         return;
 
-    int64_t beginFrag = 0;
-    auto it = _fragments.begin();
-    while(beginFrag+(*it)->size()<_tellg) {
-        if(it==_fragments.end()) {
-            if(!importNextFragment()) {
-                // requesting out of range fragment
-                return;
+    if(readAt(_tellg, s, count)) {
+        _tellg += count;
+    } else {
+        _fail = true;
+    }
+}
+
+int64_t FragmentedFile::readBytesAt(int64_t firstByte, char* s, int64_t byteCount) {
+    std::lock_guard<std::recursive_mutex> lock(_fragmentsMutex);
+
+    // Counted in bits, since fragments may end in the middle of a byte
+    const int64_t bitCount = 8*byteCount;
+    int64_t readCount = 0;
+    // Byte split between fragments, filled from the left
+    uint8_t splitByte = 0;
+    int splitBits = 0;
+    size_t index = fragmentIndex(8*firstByte);
+    while(readCount < bitCount) {
+        if(index == _fragmentEnds.size() && !importFragment()) {
+            // requesting out of range fragment
+            break;
+        }
+
+        const int64_t position = 8*firstByte + readCount;
+        const int64_t offset = position - fragmentBegin(index);
+        const int64_t available = std::min(bitCount - readCount, _fragmentEnds[index] - position);
+        if(available > 0) {
+            _cursor = index;
+            const int64_t parentPosition = _fragmentPositions[index] + offset;
+            if(splitBits > 0 || available < 8) {
+                const int count = static_cast<int>(std::min<int64_t>(available, 8 - splitBits));
+                char bits;
+                if(!_parentFile.readAt(parentPosition, &bits, count)) {
+                    break;
+                }
+                splitByte = static_cast<uint8_t>((splitByte << count) | static_cast<uint8_t>(bits));
+                splitBits += count;
+                readCount += count;
+                if(splitBits == 8) {
+                    s[readCount/8 - 1] = static_cast<char>(splitByte);
+                    splitByte = 0;
+                    splitBits = 0;
+                }
+            } else {
+                const int64_t count = available & ~int64_t(0x7);
+                if(!_parentFile.readAt(parentPosition, s + readCount/8, count)) {
+                    break;
+                }
+                readCount += count;
             }
         }
-        beginFrag += (*it)->size();
-        it++;
+
+        if(available <= 0 || 8*firstByte + readCount >= _fragmentEnds[index]) {
+            ++index;
+        }
     }
 
-    while(count > 0) {
-        if(it==_fragments.end()) {
-            if(!importNextFragment()) {
-                // requesting out of range fragment
-                return;
+    // The stream ends in the middle of the last byte, which is padded with zeros
+    if(splitBits > 0 && index == _fragmentEnds.size() && _complete) {
+        s[readCount/8] = static_cast<char>(splitByte << (8 - splitBits));
+        return readCount/8 + 1;
+    }
+    return readCount/8;
+}
+
+int64_t FragmentedFile::copyBytesTo(int64_t firstByte, int64_t byteCount, int descriptor) {
+    std::lock_guard<std::recursive_mutex> lock(_fragmentsMutex);
+
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_APPLE)
+    std::vector<iovec> gathered;
+#else
+    std::vector<std::pair<const char*, int64_t> > gathered;
+#endif
+    int64_t gatheredCount = 0;
+    int64_t copyCount = 0;
+    auto flush = [&]() {
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_APPLE)
+        size_t first = 0;
+        while(first < gathered.size()) {
+            const ssize_t writeCount = writev(descriptor, gathered.data() + first, gathered.size() - first);
+            if(writeCount < 0 && errno == EINTR) {
+                continue;
+            } else if(writeCount <= 0) {
+                break;
+            }
+            copyCount += writeCount;
+            // Skip the buffers fully written and finish the partial one
+            int64_t remaining = writeCount;
+            while(first < gathered.size() && remaining >= static_cast<int64_t>(gathered[first].iov_len)) {
+                remaining -= gathered[first].iov_len;
+                ++first;
             }
+            if(remaining > 0) {
+                gathered[first].iov_base = static_cast<char*>(gathered[first].iov_base) + remaining;
+                gathered[first].iov_len -= remaining;
+            }
+        }
+#else
+        for(const auto& buffer : gathered) {
+            copyCount += writeBytes(descriptor, buffer.first, buffer.second);
         }
-        int64_t fragmentCount = std::min(count, beginFrag+(*it)->size()-_tellg);
-        _parentFile.seekg( (*it)->beginningPos()+_tellg-beginFrag,
-                           std::ios_base::beg);
+#endif
+        const bool complete = (copyCount == gatheredCount);
+        gathered.clear();
+        return complete;
+    };
 
-        // TODO : accept also %8=0 fragments sizes
+    size_t index = fragmentIndex(8*firstByte);
+    while(gatheredCount < byteCount) {
+        if(index == _fragmentEnds.size() && !importFragment()) {
+            break;
+        }
 
-        _parentFile.read(s, fragmentCount);
-        s += fragmentCount/8;
-        _tellg += fragmentCount;
-        count -= fragmentCount;
+        const int64_t beginFrag = fragmentBegin(index);
+        const int64_t fragmentSize = _fragmentEnds[index] - beginFrag;
+        const int64_t offset = 8*(firstByte+gatheredCount) - beginFrag;
+        const int64_t fragmentCount = std::min(byteCount - gatheredCount, (fragmentSize - offset)/8);
+        if(fragmentCount <= 0 && offset < fragmentSize) {
+            // The byte is split between this fragment and the next ones
+            char byte;
+            if(!flush() || readBytesAt(firstByte + gatheredCount, &byte, 1) != 1
+               || writeBytes(descriptor, &byte, 1) != 1) {
+                return copyCount;
+            }
+            ++gatheredCount;
+            ++copyCount;
+            index = fragmentIndex(8*(firstByte+gatheredCount));
+            continue;
+        }
+        if(fragmentCount > 0) {
+            const int64_t position = _fragmentPositions[index] + offset;
+            const char* bytes = (position & 0x7) == 0 ? _parentFile.bytesInMemory(position/8, fragmentCount) : nullptr;
+            if(bytes) {
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_APPLE)
+                gathered.push_back({const_cast<char*>(bytes), static_cast<size_t>(fragmentCount)});
+#else
+                gathered.push_back(std::make_pair(bytes, fragmentCount));
+#endif
+                gatheredCount += fragmentCount;
+                if(gathered.size() == GATHER_COUNT && !flush()) {
+                    return copyCount;
+                }
+            } else {
+                if(!flush() || !_parentFile.copyTo(position, fragmentCount, descriptor)) {
+                    return copyCount;
+                }
+                gatheredCount += fragmentCount;
+                copyCount += fragmentCount;
+            }
+        }
 
-        beginFrag += (*it)->size();
-        it++;
+        if(fragmentCount <= 0 || offset + 8*fragmentCount >= fragmentSize) {
+            ++index;
+        }
     }
+    flush();
+    return copyCount;
+}
+
+void FragmentedFile::addFragment(Object* fragment) {
+    addFragment(fragment->beginningPos(), fragment->size());
+}
+
+void FragmentedFile::addFragment(int64_t position, int64_t size) {
+    _fragmentPositions.push_back(position);
+    _fragmentEnds.push_back((_fragmentEnds.empty() ? 0 : _fragmentEnds.back()) + size);
+}
+
+size_t FragmentedFile::fragmentIndex(int64_t position) {
+    while(_fragmentEnds.empty() || _fragmentEnds.back() <= position) {
+        if(!importFragment()) {
+            return _fragmentEnds.size();
+        }
+    }
+
+    // Sequential reads stay in the fragment of the previous read or move to
+    // the next one
+    for(size_t index = _cursor; index < _cursor + 2 && index < _fragmentEnds.size(); ++index) {
+        if(fragmentBegin(index) <= position && position < _fragmentEnds[index]) {
+            return index;
+        }
+    }
+
+    return std::upper_bound(_fragmentEnds.begin(), _fragmentEnds.end(), position) - _fragmentEnds.begin();
+}
+
+int64_t FragmentedFile::fragmentBegin(size_t index) const {
+    return index == 0 ? 0 : _fragmentEnds[index-1];
+}
+
+bool FragmentedFile::importFragment() {
+    if(!_complete && !importNextFragment()) {
+        _complete = true;
+    }
+    return !_complete;
 }
 
 void FragmentedFile::seekg(int64_t off, std::ios_base::seekdir dir) {
@@ -82,23 +255,41 @@ int64_t FragmentedFile::tellg() {
 }
 
 int64_t FragmentedFile::size() {
-    while(importNextFragment());
-    int64_t size = 0;
-    for(auto &p : _fragments) {
-        size += p->size();
+    std::lock_guard<std::recursive_mutex> lock(_fragmentsMutex);
+    while(importFragment());
+    return knownSize();
+}
+
+int64_t FragmentedFile::knownSize() {
+    std::lock_guard<std::recursive_mutex> lock(_fragmentsMutex);
+    return _fragmentEnds.empty() ? 0 : _fragmentEnds.back();
+}
+
+bool FragmentedFile::hasKnownSize() {
+    std::lock_guard<std::recursive_mutex> lock(_fragmentsMutex);
+    return _complete;
+}
+
+bool FragmentedFile::reaches(int64_t position) {
+    std::lock_guard<std::recursive_mutex> lock(_fragmentsMutex);
+    while(knownSize() < position) {
+        if(!importFragment()) {
+            return false;
+        }
     }
-    return size;
+    return true;
 }
 
 bool FragmentedFile::good() {
-    return true;
+    return !_fail;
 }
 
 void FragmentedFile::dump(std::ostream &out) {
-    while(importNextFragment());
-    for(auto &p : _fragments) {
-        p->dump(out);
-    }
+    copyTo(0, size()/8, out);
+}
+
+void FragmentedFile::dump(int descriptor) {
+    copyTo(0, size()/8, descriptor);
 }
 
 Object& FragmentedFile::parent() {
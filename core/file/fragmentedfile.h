@@ -3,6 +3,7 @@
 #ifndef FRAGMENTED_FILE_H
 #define FRAGMENTED_FILE_H
 
+#include <mutex>
 #include <vector>
 
 #include "core/file/file.h"
@@ -27,7 +28,7 @@ public:
     // do nothing
     virtual void close() override;
 
-    // do nothing
+    // Clears the failure of the last read
     virtual void clear() override;
 
     // Read count bits from the fragments, beginning at the position of _tellg
@@ -40,24 +41,79 @@ public:
     // Returns the current stream position
     virtual int64_t tellg() override;
 
-    // Returns the sum of the fragments size
+    // Returns the sum of the fragments size, importing all the fragments
     virtual int64_t size() override;
 
-    // Always returns true...
+    // Returns the sum of the size of the fragments imported so far
+    virtual int64_t knownSize() override;
+
+    // Returns true once every fragment has been imported
+    virtual bool hasKnownSize() override;
+
+    // Imports fragments until their sizes add up to the position
+    virtual bool reaches(int64_t position) override;
+
+    // Returns false once a read failed, until the file is cleared
     virtual bool good() override;
 
+    // Write the whole reassembled stream
     void dump(std::ostream &out);
+    void dump(int descriptor);
 
     Object& parent();
 
 protected:
+    // Look up the fragments holding the bytes and read them from the parent
+    // file with positional reads. Bytes split between fragments are put back
+    // together bit by bit, and a last byte cut by the end of the stream is
+    // padded with zeros. Fragments are imported as needed, which
+    // parses the parent object: this must not race with other parsing of the
+    // parent tree.
+    virtual int64_t readBytesAt(int64_t firstByte, char* s, int64_t byteCount) override;
+
+    // Hand the fragments to the parent file, gathering those it holds in
+    // memory into a single writev
+    virtual int64_t copyBytesTo(int64_t firstByte, int64_t byteCount, int descriptor) override;
+
     virtual bool importNextFragment() = 0;
 
+    // Appends a fragment, whose size must be known, and its end position to
+    // the offset index. Implementations of importNextFragment must use one of
+    // them.
+    void addFragment(Object* fragment);
+
+    // Appends the bits at the position in the parent file, without an object
+    // to parse for them
+    void addFragment(int64_t position, int64_t size);
+
     Object*       _parent;
     File&         _parentFile;
     std::string   _path;
     int64_t       _tellg;
-    std::vector<Object*> _fragments;
+    bool          _fail;
+    std::recursive_mutex _fragmentsMutex;
+
+private:
+    // Index of the fragment holding the bit at position, importing fragments
+    // as needed. Returns the number of fragments if position is out of range.
+    size_t fragmentIndex(int64_t position);
+
+    int64_t fragmentBegin(size_t index) const;
+
+    // Imports the next fragment unless all of them have been imported
+    bool importFragment();
+
+    // Position in bits of each fragment in the parent file
+    std::vector<int64_t> _fragmentPositions;
+    // End position in bits of each fragment, that is the sum of the sizes of
+    // the fragments up to it
+    std::vector<int64_t> _fragmentEnds;
+    // Fragment of the last read, tried first for sequential reads
+    size_t _cursor;
+    // Set once importNextFragment has no fragment left, so that the parent
+    // is not searched again
+    bool _complete;
+
     FragmentedFile& operator=(const FragmentedFile&) = delete;
     FragmentedFile(const FragmentedFile&) = delete;
 };
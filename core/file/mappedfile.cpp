@@ -0,0 +1,291 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "core/file/mappedfile.h"
+#include "core/util/bitutil.h"
+#include "core/log/logmanager.h"
+
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_APPLE)
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+// Seeks further than this distance (in bits) count as a jump
+#define JUMP_THRESHOLD 8388608LL
+// Number of consecutive jumps before switching to random access advice
+#define MAX_JUMP_COUNT 16
+
+MappedFile::MappedFile()
+    : File(),
+      _data(nullptr),
+      _size(0),
+      _position(0),
+      _open(false),
+      _fail(false),
+      _pattern(sequential),
+      _jumpCount(0)
+#if defined(PLATFORM_WIN32)
+      ,
+      _fileHandle(INVALID_HANDLE_VALUE),
+      _mappingHandle(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+void MappedFile::setPath(const std::string& path)
+{
+    _path = path;
+    open();
+}
+
+const std::string& MappedFile::path() const
+{
+    return _path;
+}
+
+void MappedFile::open()
+{
+    close();
+    int64_t byteSize = 0;
+    void* data = nullptr;
+
+#if defined(PLATFORM_WIN32)
+    _fileHandle = CreateFileA(_path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER fileSize;
+    if (_fileHandle == INVALID_HANDLE_VALUE || !GetFileSizeEx(_fileHandle, &fileSize)) {
+        Log::error("Unable to open file", _path);
+        close();
+        return;
+    }
+    byteSize = fileSize.QuadPart;
+    if (byteSize > 0) {
+        _mappingHandle = CreateFileMappingA(_fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+        data = _mappingHandle ? MapViewOfFile(_mappingHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (data == nullptr) {
+            Log::error("Unable to map file", _path);
+            close();
+            return;
+        }
+    }
+#elif defined(PLATFORM_LINUX) || defined(PLATFORM_APPLE)
+    int fd = ::open(_path.c_str(), O_RDONLY);
+    struct stat fileStat;
+    if (fd == -1 || fstat(fd, &fileStat) != 0) {
+        Log::error("Unable to open file", _path);
+        if (fd != -1) {
+            ::close(fd);
+        }
+        return;
+    }
+    byteSize = fileStat.st_size;
+    if (byteSize > 0) {
+        data = mmap(nullptr, byteSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            Log::error("Unable to map file", _path);
+            ::close(fd);
+            return;
+        }
+    }
+    // The mapping stays valid once the descriptor is closed
+    ::close(fd);
+#endif
+
+    _data = static_cast<const uint8_t*>(data);
+    _size = 8 * byteSize;
+    _position = 0;
+    _open = true;
+    _fail = false;
+    _jumpCount = 0;
+    advise(sequential);
+}
+
+void MappedFile::close()
+{
+#if defined(PLATFORM_WIN32)
+    if (_data) {
+        UnmapViewOfFile(_data);
+    }
+    if (_mappingHandle) {
+        CloseHandle(_mappingHandle);
+        _mappingHandle = nullptr;
+    }
+    if (_fileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(_fileHandle);
+        _fileHandle = INVALID_HANDLE_VALUE;
+    }
+#elif defined(PLATFORM_LINUX) || defined(PLATFORM_APPLE)
+    if (_data) {
+        munmap(const_cast<uint8_t*>(_data), _size / 8);
+    }
+#endif
+    _data = nullptr;
+    _open = false;
+}
+
+void MappedFile::clear()
+{
+    _fail = false;
+}
+
+void MappedFile::read(char* s, int64_t count)
+{
+    if(count == 0)
+        return;
+
+    if (!_open) {
+        _fail = true;
+        return;
+    }
+
+    int64_t end = _position + count;
+    const bool outOfFile = end > _size;
+
+    if ((_position & 0x7) == 0 && (count & 0x7) == 0 && !outOfFile) {
+        std::memcpy(s, _data + _position / 8, count / 8);
+    } else if (!outOfFile) {
+        copyBits(s, _data + _position / 8, _position & 0x7, count);
+    } else {
+        //Pad the missing part of the file with zeros
+        std::vector<uint8_t> buffer((count + 7) / 8 + 1, 0);
+        if (_position < _size) {
+            const int64_t firstByte = _position / 8;
+            std::memcpy(buffer.data(), _data + firstByte, std::min<int64_t>(buffer.size(), _size / 8 - firstByte));
+        }
+        copyBits(s, buffer.data(), _position & 0x7, count);
+    }
+
+    if (outOfFile) {
+        _fail = true;
+        _position = std::max(_position, _size);
+    } else {
+        _position = end;
+    }
+}
+
+void MappedFile::seekg(int64_t off, std::ios_base::seekdir dir)
+{
+    int64_t newPosition;
+    switch (dir)
+    {
+        case std::ios_base::beg :
+            newPosition = off;
+        break;
+        case std::ios_base::end :
+            newPosition = _size + off;
+        break;
+        default:
+            newPosition = _position + off;
+        break;
+    }
+
+    if (newPosition < 0) {
+        _fail = true;
+        return;
+    }
+
+    registerJump(_position, newPosition);
+    _position = newPosition;
+}
+
+int64_t MappedFile::tellg()
+{
+    return _position;
+}
+
+int64_t MappedFile::size()
+{
+    return _size;
+}
+
+bool MappedFile::good()
+{
+    return _open && !_fail;
+}
+
+File *MappedFile::duplicate() const
+{
+    MappedFile* file = new MappedFile;
+    file->setPath(_path);
+    return file;
+}
+
+int64_t MappedFile::readBytesAt(int64_t firstByte, char *s, int64_t byteCount)
+{
+    const int64_t readCount = std::max<int64_t>(0, std::min(byteCount, _size / 8 - firstByte));
+    if (readCount > 0) {
+        std::memcpy(s, _data + firstByte, readCount);
+    }
+    return readCount;
+}
+
+int64_t MappedFile::copyBytesTo(int64_t firstByte, int64_t byteCount, int descriptor)
+{
+    const int64_t copyCount = std::max<int64_t>(0, std::min(byteCount, _size / 8 - firstByte));
+    if (copyCount > 0) {
+        return writeBytes(descriptor, reinterpret_cast<const char*>(_data) + firstByte, copyCount);
+    }
+    return 0;
+}
+
+const char *MappedFile::bytesInMemory(int64_t firstByte, int64_t byteCount)
+{
+    if (_data && firstByte >= 0 && firstByte + byteCount <= _size / 8) {
+        return reinterpret_cast<const char*>(_data) + firstByte;
+    }
+    return nullptr;
+}
+
+void MappedFile::advise(AccessPattern pattern)
+{
+    _pattern = pattern;
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_APPLE)
+    if (_data) {
+        madvise(const_cast<uint8_t*>(_data), _size / 8,
+                pattern == sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+    }
+#endif
+}
+
+void MappedFile::registerJump(int64_t from, int64_t to)
+{
+    const int64_t distance = to > from ? to - from : from - to;
+    if (distance > JUMP_THRESHOLD) {
+        if (_jumpCount < MAX_JUMP_COUNT) {
+            ++_jumpCount;
+        }
+    } else if (_jumpCount > 0) {
+        --_jumpCount;
+    }
+
+    if (_pattern == sequential && _jumpCount >= MAX_JUMP_COUNT) {
+        advise(random);
+    } else if (_pattern == random && _jumpCount == 0) {
+        advise(sequential);
+    }
+}
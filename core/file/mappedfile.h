@@ -0,0 +1,120 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include "core/file/file.h"
+#include "core/util/osutil.h"
+
+/** @brief High-level input stream operations on files with bit precision,
+ * served from a read-only memory mapping of the whole file.
+ *
+ * Drop-in replacement for RealFile : reads, seeks and position queries never
+ * go through a system call once the file is mapped. The kernel is advised of
+ * a sequential access pattern by default, and of a random one when the
+ * position starts jumping around the file (e.g. when browsing a big file in
+ * the gui).
+ */
+class MappedFile : public File
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    /** @brief Sets the path to the file and maps it*/
+    void setPath(const std::string& path);
+
+    /** @brief Returns the path to the file*/
+    const std::string& path() const;
+
+    /** @brief Maps the file with the given path*/
+    virtual void open() override;
+
+    /** @brief Unmaps the file*/
+    virtual void close() override;
+
+    /** @brief Clears the file error flags*/
+    virtual void clear() override;
+
+
+    /** @brief Extracts bits from the mapping
+
+    Puts the result in a byte array already allocated
+    the result is right aligned and zero padded*/
+    virtual void read(char* s, int64_t size) override;
+
+    /** @brief Offsets the position
+
+     * \param off Offset to apply in bits.
+     * \param dir Where to start from to apply the offset.
+     * begin (std::ios_base::beg), current (std::ios_base::cur) or
+     * end (std::ios_base::end).
+     */
+    virtual void seekg(int64_t off, std::ios_base::seekdir dir) override;
+
+    /** @brief Returns the current stream position */
+    virtual int64_t tellg() override;
+
+    /** @brief Returns the size of the file*/
+    virtual int64_t size() override;
+
+    /** @brief Checks if data can be recovered from the file*/
+    virtual bool good() override;
+
+    /** @brief Opens the file again*/
+    virtual File* duplicate() const override;
+
+    /** @brief Returns the bytes in the mapping*/
+    virtual const char* bytesInMemory(int64_t firstByte, int64_t byteCount) override;
+
+protected:
+    /** @brief Copies straight from the mapping*/
+    virtual int64_t readBytesAt(int64_t firstByte, char* s, int64_t byteCount) override;
+
+    /** @brief Writes straight from the mapping*/
+    virtual int64_t copyBytesTo(int64_t firstByte, int64_t byteCount, int descriptor) override;
+
+private:
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(const MappedFile&) = delete;
+
+    enum AccessPattern {
+        sequential,
+        random
+    };
+
+    void advise(AccessPattern pattern);
+    void registerJump(int64_t from, int64_t to);
+
+    std::string _path;
+    const uint8_t* _data;
+    int64_t _size;
+    int64_t _position;
+    bool _open;
+    bool _fail;
+
+    AccessPattern _pattern;
+    int _jumpCount;
+
+#if defined(PLATFORM_WIN32)
+    void* _fileHandle;
+    void* _mappingHandle;
+#endif
+};
+
+#endif // MAPPEDFILE_H
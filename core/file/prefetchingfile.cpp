@@ -0,0 +1,264 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <algorithm>
+#include <vector>
+
+#include "core/file/prefetchingfile.h"
+
+// Number of consecutive accesses following a pattern before reading ahead
+#define PATTERN_THRESHOLD 4
+// Pending ranges beyond this count are dropped, oldest first
+#define MAX_PENDING_RANGES 64
+
+PrefetchingFile::PrefetchingFile(File *file, size_t windowSize, size_t windowCount)
+    : File(),
+      _file(file),
+      _windowSize(windowSize > 0 ? windowSize : 1),
+      _windowCount(windowCount > 0 ? windowCount : 1),
+      _lastEnd(0),
+      _lastJump(0),
+      _recordSize(0),
+      _stride(0),
+      _sequentialCount(0),
+      _strideCount(0),
+      _prefetchedEnd(0),
+      _busy(false),
+      _stop(false),
+      _prefetchedSize(0),
+      _thread(&PrefetchingFile::run, this)
+{
+}
+
+PrefetchingFile::~PrefetchingFile()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _ranges.clear();
+        _stop = true;
+    }
+    _requested.notify_all();
+    _thread.join();
+}
+
+void PrefetchingFile::setPath(const std::string &path)
+{
+    cancel();
+    _file->setPath(path);
+}
+
+const std::string &PrefetchingFile::path() const
+{
+    return _file->path();
+}
+
+void PrefetchingFile::open()
+{
+    cancel();
+    _file->open();
+}
+
+void PrefetchingFile::close()
+{
+    cancel();
+    _file->close();
+}
+
+void PrefetchingFile::clear()
+{
+    _file->clear();
+}
+
+void PrefetchingFile::read(char *s, int64_t count)
+{
+    if (count > 0) {
+        const int64_t position = _file->tellg();
+        registerAccess(position / 8, (position + count + 7) / 8);
+    }
+    _file->read(s, count);
+}
+
+bool PrefetchingFile::prefetch(int64_t position, int64_t size)
+{
+    return _file->prefetch(position, size);
+}
+
+void PrefetchingFile::seekg(int64_t off, std::ios_base::seekdir dir)
+{
+    _file->seekg(off, dir);
+}
+
+int64_t PrefetchingFile::tellg()
+{
+    return _file->tellg();
+}
+
+int64_t PrefetchingFile::size()
+{
+    return _file->size();
+}
+
+int64_t PrefetchingFile::knownSize()
+{
+    return _file->knownSize();
+}
+
+bool PrefetchingFile::hasKnownSize()
+{
+    return _file->hasKnownSize();
+}
+
+bool PrefetchingFile::reaches(int64_t position)
+{
+    return _file->reaches(position);
+}
+
+bool PrefetchingFile::good()
+{
+    return _file->good();
+}
+
+uint64_t PrefetchingFile::prefetchedSize() const
+{
+    return _prefetchedSize;
+}
+
+File &PrefetchingFile::underlyingFile()
+{
+    return *_file;
+}
+
+int64_t PrefetchingFile::readBytesAt(int64_t firstByte, char *s, int64_t byteCount)
+{
+    _file->readAt(8 * firstByte, s, 8 * byteCount);
+    return std::max<int64_t>(0, std::min(byteCount, _file->size() / 8 - firstByte));
+}
+
+int64_t PrefetchingFile::copyBytesTo(int64_t firstByte, int64_t byteCount, int descriptor)
+{
+    const int64_t copyCount = std::max<int64_t>(0, std::min(byteCount, size() / 8 - firstByte));
+    return _file->copyTo(8 * firstByte, copyCount, descriptor) ? copyCount : 0;
+}
+
+void PrefetchingFile::registerAccess(int64_t firstByte, int64_t endByte)
+{
+    const int64_t distance = firstByte - _lastEnd;
+    if (distance >= -_windowSize && distance <= _windowSize) {
+        if (distance >= 0 && _sequentialCount < PATTERN_THRESHOLD) {
+            ++_sequentialCount;
+        }
+        _lastEnd = endByte;
+
+        if (_sequentialCount >= PATTERN_THRESHOLD && _strideCount < PATTERN_THRESHOLD) {
+            // Keep windowCount windows read ahead, requesting whole windows
+            _prefetchedEnd = std::max(_prefetchedEnd, endByte);
+            const int64_t target = endByte + _windowCount * _windowSize;
+            while (_prefetchedEnd + _windowSize <= target && 8 * _prefetchedEnd < _file->size()) {
+                request(_prefetchedEnd, _prefetchedEnd + _windowSize);
+                _prefetchedEnd += _windowSize;
+            }
+        }
+        return;
+    }
+
+    // Jump: the previous record ends, compare its beginning with the new one
+    const int64_t stride = firstByte - _lastJump;
+    _recordSize = std::min(_windowSize, std::max<int64_t>(1, _lastEnd - _lastJump));
+    if (stride == _stride) {
+        if (_strideCount < PATTERN_THRESHOLD) {
+            ++_strideCount;
+        }
+    } else {
+        _stride = stride;
+        _strideCount = 0;
+        _prefetchedEnd = 0;
+    }
+    _lastJump = firstByte;
+    _lastEnd = endByte;
+    _sequentialCount = 0;
+
+    if (_strideCount >= PATTERN_THRESHOLD && _stride > 0) {
+        // Read ahead the beginning of the next records along the stride
+        _prefetchedEnd = std::max(_prefetchedEnd, firstByte + _stride);
+        const int64_t target = firstByte + _windowCount * _stride;
+        for (; _prefetchedEnd <= target && 8 * _prefetchedEnd < _file->size(); _prefetchedEnd += _stride) {
+            request(_prefetchedEnd, _prefetchedEnd + _recordSize);
+        }
+    }
+}
+
+void PrefetchingFile::request(int64_t begin, int64_t end)
+{
+    end = std::min(end, _file->size() / 8);
+    if (end <= begin) {
+        return;
+    }
+
+    if (_file->prefetch(8 * begin, 8 * (end - begin))) {
+        _prefetchedSize += end - begin;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_ranges.size() >= MAX_PENDING_RANGES) {
+            // The position already moved past the oldest requests
+            _ranges.pop_front();
+        }
+        _ranges.push_back(Range{begin, end});
+    }
+    _requested.notify_one();
+}
+
+void PrefetchingFile::cancel()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _ranges.clear();
+    _idle.wait(lock, [this]{return !_busy;});
+
+    _lastEnd = 0;
+    _lastJump = 0;
+    _recordSize = 0;
+    _stride = 0;
+    _sequentialCount = 0;
+    _strideCount = 0;
+    _prefetchedEnd = 0;
+}
+
+void PrefetchingFile::run()
+{
+    std::vector<char> buffer(_windowSize);
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _requested.wait(lock, [this]{return _stop || !_ranges.empty();});
+        if (_stop) {
+            return;
+        }
+
+        const Range range = _ranges.front();
+        _ranges.pop_front();
+        _busy = true;
+        lock.unlock();
+
+        _file->readAt(8 * range.begin, buffer.data(), 8 * (range.end - range.begin));
+        _prefetchedSize += range.end - range.begin;
+
+        lock.lock();
+        _busy = false;
+        _idle.notify_all();
+    }
+}
@@ -0,0 +1,160 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef PREFETCHINGFILE_H
+#define PREFETCHINGFILE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "core/file/file.h"
+
+/** @brief Decorator reading ahead of the position of a \link File file\endlink
+ * from a helper thread.
+ *
+ * Every read is registered to detect the access pattern :
+ * - reads staying close to the previous one, which includes small strides such
+ * as transport stream packets, are sequential and the next windows following
+ * the position are read ahead.
+ * - jumps repeated with a constant stride are strided and the next records
+ * along the stride are read ahead.
+ *
+ * Reading ahead is given as a prefetch hint to the underlying file when it
+ * handles them, and otherwise done with positional reads, which bring the data
+ * in the system page cache for a RealFile, or in the pages of a CachedFile,
+ * before the parser asks for it.
+ *
+ * The prefetching file takes ownership of the underlying file.
+ */
+class PrefetchingFile : public File
+{
+public:
+    /**
+     * @param file underlying file, must not be nullptr
+     * @param windowSize size of a read ahead window in bytes
+     * @param windowCount number of windows kept read ahead of the position
+     */
+    PrefetchingFile(File* file, size_t windowSize = 262144, size_t windowCount = 4);
+    ~PrefetchingFile();
+
+    /** @brief Sets the path to the underlying file*/
+    virtual void setPath(const std::string& path) override;
+
+    /** @brief Returns the path to the underlying file*/
+    virtual const std::string& path() const override;
+
+    /** @brief Opens the underlying file*/
+    virtual void open() override;
+
+    /** @brief Closes the underlying file*/
+    virtual void close() override;
+
+    /** @brief Clears the file error flags*/
+    virtual void clear() override;
+
+
+    /** @brief Extracts bits from the underlying file and registers the access
+
+    Puts the result in a byte array already allocated
+    the result is right aligned and zero padded*/
+    virtual void read(char* s, int64_t size) override;
+
+    /** @brief Forwards the hint to the underlying file*/
+    virtual bool prefetch(int64_t position, int64_t size) override;
+
+    /** @brief Offsets the position
+
+     * \param off Offset to apply in bits.
+     * \param dir Where to start from to apply the offset.
+     * begin (std::ios_base::beg), current (std::ios_base::cur) or
+     * end (std::ios_base::end).
+     */
+    virtual void seekg(int64_t off, std::ios_base::seekdir dir) override;
+
+    /** @brief Returns the current stream position */
+    virtual int64_t tellg() override;
+
+    /** @brief Returns the size of the file*/
+    virtual int64_t size() override;
+
+    /** @brief Forwards to the underlying file*/
+    virtual int64_t knownSize() override;
+
+    /** @brief Forwards to the underlying file*/
+    virtual bool hasKnownSize() override;
+
+    /** @brief Forwards to the underlying file*/
+    virtual bool reaches(int64_t position) override;
+
+    /** @brief Checks if data can be recovered from the file*/
+    virtual bool good() override;
+
+    /** @brief Number of bytes read ahead so far*/
+    uint64_t prefetchedSize() const;
+
+    File& underlyingFile();
+
+protected:
+    virtual int64_t readBytesAt(int64_t firstByte, char* s, int64_t byteCount) override;
+
+    /** @brief Copies from the underlying file*/
+    virtual int64_t copyBytesTo(int64_t firstByte, int64_t byteCount, int descriptor) override;
+
+private:
+    PrefetchingFile& operator=(const PrefetchingFile&) = delete;
+    PrefetchingFile(const PrefetchingFile&) = delete;
+
+    struct Range
+    {
+        int64_t begin;
+        int64_t end;
+    };
+
+    void registerAccess(int64_t firstByte, int64_t endByte);
+    void request(int64_t begin, int64_t end);
+    void cancel();
+    void run();
+
+    std::unique_ptr<File> _file;
+    const int64_t _windowSize;
+    const int64_t _windowCount;
+
+    // Access pattern, only used by the reading thread
+    int64_t _lastEnd;
+    int64_t _lastJump;
+    int64_t _recordSize;
+    int64_t _stride;
+    int _sequentialCount;
+    int _strideCount;
+    int64_t _prefetchedEnd;
+
+    // Shared with the helper thread
+    std::mutex _mutex;
+    std::condition_variable _requested;
+    std::condition_variable _idle;
+    std::deque<Range> _ranges;
+    bool _busy;
+    bool _stop;
+    std::atomic<uint64_t> _prefetchedSize;
+    std::thread _thread;
+};
+
+#endif // PREFETCHINGFILE_H
@@ -1,5 +1,5 @@
-
 #include "psifragmentedfile.h"
+#include "core/modules/stream/pidindex.h"
 
 PsiFragmentedFile::PsiFragmentedFile(Object *object) : FragmentedFile(object)
 {
@@ -7,8 +7,9 @@ PsiFragmentedFile::PsiFragmentedFile(Object *object) : FragmentedFile(object)
     _n = object->lookUp("psi_syntax_section", true)
                   ->lookUp("last_section_number", true)
                   ->value().toInteger();
+    _rank = object->parent()->rank();
     object->explore(-1);
-    _fragments.push_back(object);
+    addFragment(object);
 }
 
 bool PsiFragmentedFile::importNextFragment() {
@@ -16,26 +17,16 @@ bool PsiFragmentedFile::importNextFragment() {
         return false;
 
     auto main_obj = _parent->parent()->parent();
-    int previousRank = 0;
-    if(_fragments.size()==1) {
-        previousRank = _fragments.back()->parent()->rank();
-    } else {
-        previousRank = _fragments.back()->parent()->parent()->rank();
-    }
-    int currentRank = previousRank+1;
-    while(true) {
-        if(currentRank >= main_obj->numberOfChildren()) {
-            main_obj->exploreSome(128);
-            if(currentRank >= main_obj->numberOfChildren())
-                return false;
-        }
-        auto it = main_obj->begin()+currentRank;
-        if((*it)->lookUp("PID", true)->value().toInteger() == _pid) {
-            _fragments.push_back((*it)->lookUp("psi_fragment", true));
-            _n--;
-            return true;
-        }
-        currentRank++;
-    }
-    return false;
-}
\ No newline at end of file
+    _rank = main_obj->pidIndex().nextPacket(_pid, _rank);
+    if(_rank == -1)
+        return false;
+
+    static const Atom fragmentName("psi_fragment");
+    Object* fragment = (*(main_obj->begin()+_rank))->lookUp(fragmentName, true);
+    if(fragment == nullptr)
+        return false;
+
+    addFragment(fragment);
+    _n--;
+    return true;
+}
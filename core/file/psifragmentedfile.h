@@ -1,4 +1,3 @@
-
 #ifndef PSI_FRAGMENTED_FILE_H
 #define PSI_FRAGMENTED_FILE_H
 
@@ -12,6 +11,8 @@ private:
     virtual bool importNextFragment() override;
     int _pid;
     int _n;
+    // Rank of the last packet imported
+    int _rank;
 };
 
 #endif // PSI_FRAGMENTED_FILE_H
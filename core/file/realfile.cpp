@@ -15,16 +15,37 @@
 //along with this program; if not, write to the Free Software
 //Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
+#include <algorithm>
+
 #include "core/file/realfile.h"
 #include "core/formatdetector/formatdetector.h"
 #include "core/util/strutil.h"
-#include "core/util/bitutil.h"
 #include "core/log/logmanager.h"
 
-RealFile::RealFile() : File()
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_APPLE)
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#if defined(PLATFORM_LINUX)
+    #include <sys/sendfile.h>
+#endif
+
+RealFile::RealFile() : File(), _reader(_file), _size(0),
+#if defined(PLATFORM_WIN32)
+    _handle(INVALID_HANDLE_VALUE)
+#else
+    _descriptor(-1)
+#endif
 {
 }
 
+RealFile::~RealFile()
+{
+    close();
+}
+
 void RealFile::setPath(const std::string& path)
 {
     _path = path;
@@ -42,64 +63,47 @@ void RealFile::open()
     if(!good()) {
         Log::error("Unable to open file", _path);
     } else {
-        FileAnchor fileAnchor(*this);
         _file.seekg(0, std::ios::end);
-        _size = tellg();
+        _size = 8 * static_cast<int64_t>(_file.tellg());
+        _reader.reset();
+
+#if defined(PLATFORM_WIN32)
+        _handle = CreateFileA(_path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+#elif defined(PLATFORM_LINUX) || defined(PLATFORM_APPLE)
+        _descriptor = ::open(_path.c_str(), O_RDONLY);
+#endif
     }
 }
 
 void RealFile::close()
 {
     _file.close();
+
+#if defined(PLATFORM_WIN32)
+    if (_handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(_handle);
+        _handle = INVALID_HANDLE_VALUE;
+    }
+#elif defined(PLATFORM_LINUX) || defined(PLATFORM_APPLE)
+    if (_descriptor != -1) {
+        ::close(_descriptor);
+        _descriptor = -1;
+    }
+#endif
 }
 
 void RealFile::clear()
 {
     _file.clear();
+    _reader.clear();
 }
 
 void RealFile::read(char* s, int64_t count )
 {
     if(count == 0)
         return;
-    if (_bitPosition == 0 && count % 8 == 0)
-        _file.read(s,count/8);
-    else
-    {
-        int64_t bitCount = (count + _bitPosition);
-        int64_t byteCount = (bitCount&7)? bitCount/8 + 1 : bitCount/8;
-        int8_t shift = byteCount*8 - bitCount;
-        uint8_t mask = lsbMask(8-_bitPosition);
-
-        uint8_t buffer[byteCount];
-        _file.read(reinterpret_cast<char*>(buffer),byteCount);
-
-        //Delete first bits
-        buffer[0] &= mask;
-
-        //Shift bits
-        buffer[byteCount-1] >>= shift;
-
-        for(int i = byteCount-2; i>=0; i--)
-        {
-            buffer[i+1] |= buffer[i] << (8-shift) ;
-            buffer[i] >>= shift;
-        }
-
-        //Copy bits
-        int firstByte = (_bitPosition+shift>=8)? 1 : 0;
-        for(int i = firstByte; i < byteCount; ++i)
-        {
-            s[i-firstByte] = buffer[i];
-        }
-
-        //Set new file position
-        if ((bitCount & 0x7) != 0)
-        {
-            _file.seekg(-1,std::ios_base::cur);
-        }
-        _bitPosition = (count + _bitPosition)  & 0x7;
-    }
+    _reader.read(s, count);
 }
 
 
@@ -107,21 +111,50 @@ void RealFile::seekg(int64_t off, std::ios_base::seekdir dir) {
     switch (dir)
     {
         case std::ios_base::beg :
-            _bitPosition = off & 0x7; // & 0x7 stands for % 8
+            _reader.seek(off);
         break;
         case std::ios_base::end :
-            _bitPosition =  off & 0x7;
+            _reader.seek(_size + off);
         break;
         default:
-            _bitPosition = (_bitPosition + off) & 0x7;
-            off += _bitPosition;
+            _reader.seek(_reader.position() + off);
         break;
     }
-    _file.seekg(off / 8, dir);
 }
 
 
-int64_t RealFile::tellg() {return _file.tellg() * 8 + _bitPosition;}
+int64_t RealFile::readBytesAt(int64_t firstByte, char *s, int64_t byteCount)
+{
+    int64_t readCount = 0;
+#if defined(PLATFORM_WIN32)
+    while (_handle != INVALID_HANDLE_VALUE && readCount < byteCount) {
+        OVERLAPPED overlapped = {};
+        const int64_t offset = firstByte + readCount;
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD chunkCount = 0;
+        if (!ReadFile(_handle, s + readCount, static_cast<DWORD>(std::min<int64_t>(byteCount - readCount, 1 << 30)),
+                      &chunkCount, &overlapped) || chunkCount == 0) {
+            break;
+        }
+        readCount += chunkCount;
+    }
+#elif defined(PLATFORM_LINUX) || defined(PLATFORM_APPLE)
+    while (_descriptor != -1 && readCount < byteCount) {
+        const ssize_t chunkCount = pread(_descriptor, s + readCount, byteCount - readCount, firstByte + readCount);
+        if (chunkCount < 0 && errno == EINTR) {
+            continue;
+        } else if (chunkCount <= 0) {
+            break;
+        }
+        readCount += chunkCount;
+    }
+#endif
+    return readCount;
+}
+
+
+int64_t RealFile::tellg() {return _reader.position();}
 
 
 int64_t RealFile::size()
@@ -131,5 +164,47 @@ int64_t RealFile::size()
 
 bool RealFile::good()
 {
-    return _file.is_open()&&!_file.fail()&&!_file.bad()&&!_file.eof();
+    return _file.is_open()&&!_file.bad()&&!_reader.fail();
+}
+
+File *RealFile::duplicate() const
+{
+    RealFile* file = new RealFile;
+    file->setPath(_path);
+    return file;
+}
+
+int64_t RealFile::copyBytesTo(int64_t firstByte, int64_t byteCount, int descriptor)
+{
+    int64_t copyCount = 0;
+#if defined(PLATFORM_LINUX)
+    // Between regular files, the filesystem may even share the extents
+    while (_descriptor != -1 && copyCount < byteCount) {
+        loff_t offset = firstByte + copyCount;
+        const ssize_t chunkCount = copy_file_range(_descriptor, &offset, descriptor, nullptr,
+                                                   byteCount - copyCount, 0);
+        if (chunkCount < 0 && errno == EINTR) {
+            continue;
+        } else if (chunkCount <= 0) {
+            break;
+        }
+        copyCount += chunkCount;
+    }
+
+    while (_descriptor != -1 && copyCount < byteCount) {
+        off_t offset = firstByte + copyCount;
+        const ssize_t chunkCount = sendfile(descriptor, _descriptor, &offset,
+                                            std::min<int64_t>(byteCount - copyCount, 1 << 30));
+        if (chunkCount < 0 && errno == EINTR) {
+            continue;
+        } else if (chunkCount <= 0) {
+            break;
+        }
+        copyCount += chunkCount;
+    }
+#endif
+    if (copyCount < byteCount) {
+        copyCount += File::copyBytesTo(firstByte + copyCount, byteCount - copyCount, descriptor);
+    }
+    return copyCount;
 }
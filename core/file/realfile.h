@@ -19,15 +19,19 @@
 #define REALFILE_H
 
 #include "core/file/file.h"
+#include "core/file/bitreader.h"
+#include "core/util/osutil.h"
 
 /** @brief High-level input stream operations on files with bit precision
 
 The class is implemented as an adaptor for a std::ifstream instance that
-reimplements common operation with bit precision instead of byte precision*/
+reimplements common operation with bit precision instead of byte precision.
+Reads are buffered through a BitReader.*/
 class RealFile : public File
 {
 public:
     RealFile();
+    ~RealFile();
 
     /** @brief Sets the path to the file*/
     void setPath(const std::string& path);
@@ -69,6 +73,18 @@ public:
     /** @brief Checks if data can be recovered from the stream*/
     virtual bool good() override;
 
+    /** @brief Opens the file again*/
+    virtual File* duplicate() const override;
+
+protected:
+    /** @brief Reads with pread on a descriptor dedicated to positional reads*/
+    virtual int64_t readBytesAt(int64_t firstByte, char* s, int64_t byteCount) override;
+
+    /** @brief Has the kernel copy the bytes when possible
+
+    copy_file_range is tried first, then sendfile, which also writes to pipes
+    and sockets, before falling back to buffered reads.*/
+    virtual int64_t copyBytesTo(int64_t firstByte, int64_t byteCount, int descriptor) override;
 
 private:
     RealFile& operator=(const RealFile&) = delete;
@@ -76,7 +92,14 @@ private:
 
     std::string _path;
     std::ifstream _file;
+    BitReader _reader;
     int64_t _size;
+
+#if defined(PLATFORM_WIN32)
+    void* _handle;
+#else
+    int _descriptor;
+#endif
 };
 
 #endif // REALFILE_H
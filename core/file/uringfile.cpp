@@ -0,0 +1,503 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <algorithm>
+#include <cstring>
+
+#include "core/file/uringfile.h"
+#include "core/log/logmanager.h"
+
+#if defined(PLATFORM_LINUX)
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+        #include <linux/io_uring.h>
+        #define HAS_IO_URING
+    #endif
+#endif
+
+#if defined(HAS_IO_URING)
+
+/** @brief Submission and completion rings of an io_uring instance, used
+ * through the raw system calls
+ */
+struct UringFile::Ring
+{
+    Ring()
+        : descriptor(-1),
+          ringDescriptor(-1),
+          sqRing(nullptr),
+          cqRing(nullptr),
+          sqes(nullptr),
+          sqRingSize(0),
+          cqRingSize(0),
+          sqesSize(0),
+          queuedCount(0)
+    {
+    }
+
+    ~Ring()
+    {
+        if (sqes) {
+            munmap(sqes, sqesSize);
+        }
+        if (cqRing && cqRing != sqRing) {
+            munmap(cqRing, cqRingSize);
+        }
+        if (sqRing) {
+            munmap(sqRing, sqRingSize);
+        }
+        if (ringDescriptor != -1) {
+            ::close(ringDescriptor);
+        }
+        if (descriptor != -1) {
+            ::close(descriptor);
+        }
+    }
+
+    bool setup(const std::string& path, unsigned entries)
+    {
+        descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor == -1) {
+            return false;
+        }
+
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ringDescriptor = syscall(__NR_io_uring_setup, entries, &params);
+        if (ringDescriptor < 0) {
+            ringDescriptor = -1;
+            return false;
+        }
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap) {
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+
+        sqRing = map(sqRingSize, IORING_OFF_SQ_RING);
+        cqRing = singleMap ? sqRing : map(cqRingSize, IORING_OFF_CQ_RING);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = map(sqesSize, IORING_OFF_SQES);
+        if (!sqRing || !cqRing || !sqes) {
+            return false;
+        }
+
+        char* sq = static_cast<char*>(sqRing);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sqEntries = params.sq_entries;
+
+        char* cq = static_cast<char*>(cqRing);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    bool queueRead(void* buffer, unsigned length, int64_t offset, uint64_t userData)
+    {
+        const unsigned tail = *sqTail;
+        if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+            return false;
+        }
+
+        const unsigned slot = tail & sqMask;
+        io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqes) + slot;
+        std::memset(sqe, 0, sizeof(io_uring_sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = descriptor;
+        sqe->addr = reinterpret_cast<uint64_t>(buffer);
+        sqe->len = length;
+        sqe->off = offset;
+        sqe->user_data = userData;
+        sqArray[slot] = slot;
+
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        ++queuedCount;
+        return true;
+    }
+
+    bool submit(unsigned waitCount)
+    {
+        while (true) {
+            const int result = syscall(__NR_io_uring_enter, ringDescriptor, queuedCount, waitCount,
+                                       waitCount > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (result >= 0) {
+                queuedCount -= std::min<unsigned>(result, queuedCount);
+                return true;
+            } else if (errno != EINTR) {
+                return false;
+            }
+        }
+    }
+
+    bool reap(uint64_t& userData, int& result)
+    {
+        const unsigned head = *cqHead;
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+
+        const io_uring_cqe& cqe = cqes[head & cqMask];
+        userData = cqe.user_data;
+        result = cqe.res;
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    void* map(size_t size, off_t offset)
+    {
+        void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringDescriptor, offset);
+        return address == MAP_FAILED ? nullptr : address;
+    }
+
+    int descriptor;
+    int ringDescriptor;
+
+    void* sqRing;
+    void* cqRing;
+    void* sqes;
+    size_t sqRingSize;
+    size_t cqRingSize;
+    size_t sqesSize;
+
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned sqMask;
+    unsigned* sqArray;
+    unsigned sqEntries;
+    unsigned queuedCount;
+
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned cqMask;
+    io_uring_cqe* cqes;
+};
+
+#else
+
+struct UringFile::Ring
+{
+    bool setup(const std::string& /*path*/, unsigned /*entries*/) {return false;}
+    bool queueRead(void* /*buffer*/, unsigned /*length*/, int64_t /*offset*/, uint64_t /*userData*/) {return false;}
+    bool submit(unsigned /*waitCount*/) {return false;}
+    bool reap(uint64_t& /*userData*/, int& /*result*/) {return false;}
+};
+
+#endif
+
+UringFile::UringFile(size_t pageSize, size_t pageCount)
+    : File(),
+      _pageSize(pageSize > 0 ? pageSize : 1),
+      _pageCount(pageCount > 1 ? pageCount : 2),
+      _position(0),
+      _fail(false),
+      _pendingCount(0),
+      _useCount(0)
+{
+}
+
+UringFile::~UringFile()
+{
+    close();
+}
+
+void UringFile::setPath(const std::string &path)
+{
+    close();
+    _file.setPath(path);
+    setupRing();
+}
+
+const std::string &UringFile::path() const
+{
+    return _file.path();
+}
+
+void UringFile::open()
+{
+    close();
+    _file.open();
+    setupRing();
+}
+
+void UringFile::close()
+{
+    dropPages();
+    _ring.reset();
+    _file.close();
+}
+
+void UringFile::clear()
+{
+    _file.clear();
+    _fail = false;
+}
+
+void UringFile::read(char *s, int64_t count)
+{
+    if(count == 0)
+        return;
+
+    if (readAt(_position, s, count)) {
+        _position += count;
+    } else {
+        _fail = true;
+        _position = std::max(_position, size());
+    }
+}
+
+bool UringFile::prefetch(int64_t position, int64_t size)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_ring || size <= 0 || position < 0) {
+        return false;
+    }
+
+    const int64_t firstPage = position / (8 * _pageSize);
+    const int64_t lastPage = std::min(position + size - 1, _file.size() - 1) / (8 * _pageSize);
+    // Leave half of the pages to the reads
+    for (int64_t index = firstPage; index <= lastPage && _pendingCount < _pageCount / 2; ++index) {
+        if (_pages.find(index) == _pages.end()) {
+            queuePage(index);
+        }
+    }
+    _ring->submit(0);
+    return true;
+}
+
+void UringFile::seekg(int64_t off, std::ios_base::seekdir dir)
+{
+    int64_t newPosition;
+    switch (dir)
+    {
+        case std::ios_base::beg :
+            newPosition = off;
+        break;
+        case std::ios_base::end :
+            newPosition = size() + off;
+        break;
+        default:
+            newPosition = _position + off;
+        break;
+    }
+
+    if (newPosition < 0) {
+        _fail = true;
+    } else {
+        _position = newPosition;
+    }
+}
+
+int64_t UringFile::tellg()
+{
+    return _position;
+}
+
+int64_t UringFile::size()
+{
+    return _file.size();
+}
+
+bool UringFile::good()
+{
+    return !_fail && _file.good();
+}
+
+bool UringFile::asynchronous() const
+{
+    return _ring != nullptr;
+}
+
+int64_t UringFile::readBytesAt(int64_t firstByte, char *s, int64_t byteCount)
+{
+    const int64_t readCount = std::max<int64_t>(0, std::min(byteCount, _file.size() / 8 - firstByte));
+    if (readCount == 0) {
+        return 0;
+    }
+    if (readCount > static_cast<int64_t>(_pageSize * _pageCount / 2)) {
+        // Big reads skip the pages
+        _file.readAt(8 * firstByte, s, 8 * readCount);
+        return readCount;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    const int64_t firstPage = firstByte / _pageSize;
+    const int64_t lastPage = (firstByte + readCount - 1) / _pageSize;
+
+    // Queue all the missing pages in a single batch
+    bool queued = false;
+    for (int64_t index = firstPage; index <= lastPage; ++index) {
+        auto it = _pages.find(index);
+        if (it == _pages.end()) {
+            queuePage(index);
+            queued = true;
+        } else {
+            it->second.lastUse = ++_useCount;
+        }
+    }
+    if (queued && _ring) {
+        _ring->submit(0);
+    }
+
+    for (int64_t index = firstPage; index <= lastPage; ++index) {
+        auto it = _pages.find(index);
+        while (it == _pages.end() || it->second.pending) {
+            if (it == _pages.end()) {
+                queuePage(index);
+            } else {
+                waitCompletion();
+            }
+            it = _pages.find(index);
+        }
+
+        const int64_t begin = std::max(firstByte, index * static_cast<int64_t>(_pageSize));
+        const int64_t end = std::min(firstByte + readCount, (index + 1) * static_cast<int64_t>(_pageSize));
+        std::memcpy(s + begin - firstByte, it->second.data.data() + begin - index * _pageSize, end - begin);
+    }
+    return readCount;
+}
+
+int64_t UringFile::copyBytesTo(int64_t firstByte, int64_t byteCount, int descriptor)
+{
+    const int64_t copyCount = std::max<int64_t>(0, std::min(byteCount, size() / 8 - firstByte));
+    return _file.copyTo(8 * firstByte, copyCount, descriptor) ? copyCount : 0;
+}
+
+void UringFile::queuePage(int64_t index)
+{
+    if (_pages.size() >= _pageCount) {
+        evictPage();
+    }
+
+    Page& page = _pages[index];
+    const int64_t begin = index * _pageSize;
+    page.length = std::max<int64_t>(0, std::min<int64_t>(_pageSize, _file.size() / 8 - begin));
+    page.data.resize(page.length);
+    page.lastUse = ++_useCount;
+    page.pending = false;
+
+    if (_ring && (_ring->queueRead(page.data.data(), page.length, begin, index)
+                  // The submission ring is full, submit it and try again
+                  || (_ring->submit(0) && _ring->queueRead(page.data.data(), page.length, begin, index)))) {
+        page.pending = true;
+        ++_pendingCount;
+    } else {
+        fillPage(index, page, 0);
+    }
+}
+
+bool UringFile::evictPage()
+{
+    while (true) {
+        auto oldest = _pages.end();
+        for (auto it = _pages.begin(); it != _pages.end(); ++it) {
+            if (!it->second.pending && (oldest == _pages.end() || it->second.lastUse < oldest->second.lastUse)) {
+                oldest = it;
+            }
+        }
+
+        if (oldest != _pages.end()) {
+            _pages.erase(oldest);
+            return true;
+        } else if (_pendingCount == 0) {
+            return false;
+        }
+        waitCompletion();
+    }
+}
+
+void UringFile::setupRing()
+{
+    _position = 0;
+    _fail = false;
+    if (!_file.good()) {
+        return;
+    }
+
+    std::unique_ptr<Ring> ring(new Ring);
+    if (ring->setup(_file.path(), _pageCount)) {
+        _ring = std::move(ring);
+    }
+}
+
+void UringFile::fillPage(int64_t index, Page &page, int64_t offset)
+{
+    const int64_t begin = index * _pageSize + offset;
+    _file.readAt(8 * begin, reinterpret_cast<char*>(page.data.data()) + offset, 8 * (page.length - offset));
+    page.pending = false;
+}
+
+void UringFile::complete(int64_t index, int result)
+{
+    auto it = _pages.find(index);
+    if (it == _pages.end() || !it->second.pending) {
+        return;
+    }
+    --_pendingCount;
+
+    Page& page = it->second;
+    if (result < 0) {
+        Log::warning("Asynchronous read failed", _file.path(), std::strerror(-result));
+        fillPage(index, page, 0);
+    } else if (result < page.length) {
+        // Short read, complete the page synchronously
+        fillPage(index, page, result);
+    } else {
+        page.pending = false;
+    }
+}
+
+void UringFile::waitCompletion()
+{
+    uint64_t index;
+    int result;
+    while (!_ring->reap(index, result)) {
+        if (!_ring->submit(1)) {
+            Log::error("Unable to wait for asynchronous reads", _file.path());
+            for (auto& pair : _pages) {
+                if (pair.second.pending) {
+                    fillPage(pair.first, pair.second, 0);
+                }
+            }
+            _pendingCount = 0;
+            return;
+        }
+    }
+
+    do {
+        complete(index, result);
+    } while (_ring->reap(index, result));
+}
+
+void UringFile::dropPages()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    while (_pendingCount > 0) {
+        waitCompletion();
+    }
+    _pages.clear();
+}
@@ -0,0 +1,137 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef URINGFILE_H
+#define URINGFILE_H
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "core/file/file.h"
+#include "core/file/realfile.h"
+
+/** @brief File backend reading pages asynchronously with io_uring
+
+The file is read by fixed-size pages. Prefetch hints queue page reads on an
+io_uring submission ring without waiting, so that several requests are in
+flight at once, and a read queues all the pages it misses in a single batch
+before waiting for their completion.
+
+When io_uring is not available (older kernels, other platforms, or a ring
+that can not be set up) pages are read synchronously with positional reads.*/
+class UringFile : public File
+{
+public:
+    /**
+     * @param pageSize size of a page in bytes
+     * @param pageCount maximum number of pages kept in memory, and of reads
+     * in flight
+     */
+    UringFile(size_t pageSize = 65536, size_t pageCount = 64);
+    ~UringFile();
+
+    /** @brief Sets the path to the file*/
+    virtual void setPath(const std::string& path) override;
+
+    /** @brief Returns the path to the file*/
+    virtual const std::string& path() const override;
+
+    /** @brief Opens the file and sets up the ring*/
+    virtual void open() override;
+
+    /** @brief Waits for the reads in flight and closes the file*/
+    virtual void close() override;
+
+    /** @brief Clears the file error flags*/
+    virtual void clear() override;
+
+
+    /** @brief Extracts bits from the pages
+
+    Puts the result in a byte array already allocated
+    the result is right aligned and zero padded*/
+    virtual void read(char* s, int64_t size) override;
+
+    /** @brief Queues the reads of the pages of the range without waiting*/
+    virtual bool prefetch(int64_t position, int64_t size) override;
+
+    /** @brief Offsets the position
+
+     * \param off Offset to apply in bits.
+     * \param dir Where to start from to apply the offset.
+     * begin (std::ios_base::beg), current (std::ios_base::cur) or
+     * end (std::ios_base::end).
+     */
+    virtual void seekg(int64_t off, std::ios_base::seekdir dir) override;
+
+    /** @brief Returns the current stream position */
+    virtual int64_t tellg() override;
+
+    /** @brief Returns the size of the file*/
+    virtual int64_t size() override;
+
+    /** @brief Checks if data can be recovered from the file*/
+    virtual bool good() override;
+
+    /** @brief Checks if pages are read through io_uring rather than
+    synchronous positional reads*/
+    bool asynchronous() const;
+
+protected:
+    virtual int64_t readBytesAt(int64_t firstByte, char* s, int64_t byteCount) override;
+
+    /** @brief Copies from the underlying file, bypassing the pages*/
+    virtual int64_t copyBytesTo(int64_t firstByte, int64_t byteCount, int descriptor) override;
+
+private:
+    UringFile& operator=(const UringFile&) = delete;
+    UringFile(const UringFile&) = delete;
+
+    struct Ring;
+
+    struct Page
+    {
+        std::vector<uint8_t> data;
+        int64_t length;
+        bool pending;
+        uint64_t lastUse;
+    };
+
+    void queuePage(int64_t index);
+    bool evictPage();
+    void setupRing();
+    void fillPage(int64_t index, Page& page, int64_t offset);
+    void complete(int64_t index, int result);
+    void waitCompletion();
+    void dropPages();
+
+    RealFile _file;
+    const size_t _pageSize;
+    const size_t _pageCount;
+    int64_t _position;
+    bool _fail;
+
+    std::mutex _mutex;
+    std::unique_ptr<Ring> _ring;
+    std::unordered_map<int64_t, Page> _pages;
+    size_t _pendingCount;
+    uint64_t _useCount;
+};
+
+#endif // URINGFILE_H
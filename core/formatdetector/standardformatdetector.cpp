@@ -30,6 +30,11 @@ StandardFormatDetector::Adder *StandardFormatDetector::newAdder(const std::strin
     return new Adder(*this, format);
 }
 
+const SyncbyteFormatDetector &StandardFormatDetector::syncbyteDetector() const
+{
+    return _syncbyteDetector;
+}
+
 
 void StandardFormatDetector::Adder::addMagicNumber(const std::string &magicNumber)
 {
@@ -68,6 +68,11 @@ public:
      */
     Adder* newAdder(const std::string& format);
 
+    /**
+     * @brief Access the \link SyncbyteFormatDetector syncbyte detector\endlink
+     */
+    const SyncbyteFormatDetector& syncbyteDetector() const;
+
 
 private:
     ExtensionFormatDetector _extensionDetector;
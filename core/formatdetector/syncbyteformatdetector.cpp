@@ -28,6 +28,17 @@ void SyncbyteFormatDetector::addSyncbyte(const std::string& format, uint8_t sync
     _formats[format] = std::make_pair(syncbyte, packetlength);
 }
 
+bool SyncbyteFormatDetector::syncbyte(const std::string &format, uint8_t &syncbyte, int &packetlength) const
+{
+    auto it = _formats.find(format);
+    if(it == _formats.end())
+        return false;
+
+    syncbyte = it->second.first;
+    packetlength = it->second.second;
+    return true;
+}
+
 std::string SyncbyteFormatDetector::doGetFormat(File &file) const
 {
     for(const auto& entry:_formats)
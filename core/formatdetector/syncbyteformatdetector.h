@@ -44,6 +44,13 @@ public:
      * @brief Map a syncbyte to a format
      */
     void addSyncbyte(const std::string &format, uint8_t syncbyte, int packetlength);
+
+    /**
+     * @brief Get the syncbyte and packet length mapped to a format
+     *
+     * Returns false if the format is not mapped to any.
+     */
+    bool syncbyte(const std::string &format, uint8_t& syncbyte, int& packetlength) const;
 protected:
     virtual std::string doGetFormat(File& file) const override;
 private:
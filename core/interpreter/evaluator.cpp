@@ -10,7 +10,21 @@
 #include "core/variable/mapscope.h"
 
 const Variant emptyString("");
-const Module emptyModule;
+
+namespace {
+// Handles nothing, for evaluations without a module
+class EmptyModule : public Module
+{
+public:
+    EmptyModule() {}
+
+private:
+    void doGetParserNames(std::vector<std::string>& /*names*/) const override {}
+    void doGetFunctionNames(std::vector<std::string>& /*names*/) const override {}
+};
+}
+
+const EmptyModule emptyModule;
 
 
 Evaluator::Evaluator(const Variable &scope)
@@ -140,22 +154,23 @@ ObjectType Evaluator::type(const Program &program) const
 {
     const std::string& name = program.node(0).payload().toString();
     const ObjectTypeTemplate& parentTemplate = module.getTemplate(name);
-    ObjectType type(parentTemplate);
-    if(type.isNull())
+    if(parentTemplate.isNull())
     {
         Log::error("Type not found ", name);
-        return type;
+        return ObjectType(parentTemplate);
     }
 
+    // Interned once with all of its parameters
     Program arguments = program.node(1);
+    std::vector<Variant> parameterValues(arguments.size());
     for(int i = 0; i < arguments.size(); ++i)
     {
         if(arguments.node(i).tag() == HMC_RIGHT_VALUE)
         {
-            type.setParameter(i, rightValue(arguments.node(i)).value());
+            parameterValues[i] = rightValue(arguments.node(i)).value();
         }
     }
-    return type;
+    return ObjectType(parentTemplate, parameterValues);
 }
 
 VariableCollector &Evaluator::collector() const
@@ -32,6 +32,7 @@
 //#define LOAD_TRACE 1
 
 const VariablePath sizeDescriptor = {"@size"};
+const VariablePath rootDescriptor = {"@root"};
 const std::vector<VariablePath> headerOnlyVars = {
     sizeDescriptor,
     {"@args"},
@@ -45,10 +46,46 @@ const std::vector<std::string> emptyParameterNames;
 const std::vector<bool> emptyParameterModifiables;
 const std::vector<Variant> emptyParameterDefaults;
 
+namespace {
+
+// Variables of one evaluation, for the module to be used from several threads at once
+struct LocalEvaluation
+{
+    explicit LocalEvaluation(const Module& module)
+        : scope(collector.null()),
+          evaluator(scope, module)
+    {
+    }
+
+    VariableCollector collector;
+    Variable scope;
+    Evaluator evaluator;
+};
+
+template<class Map>
+bool findCached(std::mutex& mutex, const Map& cache, const std::string& name, typename Map::mapped_type& value)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = cache.find(name);
+    if(it == cache.end())
+        return false;
+    value = it->second;
+    return true;
+}
+
+// Computed outside of the lock since it may need other entries, the first entry inserted wins
+template<class Map>
+typename Map::mapped_type insertCached(std::mutex& mutex, Map& cache, const std::string& name, const typename Map::mapped_type& value)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache.insert(std::make_pair(name, value)).first->second;
+}
+
+}
+
 FromFileModule::FromFileModule(Program program)
     : _program(program),
-      _scope(_collector.null()),
-      _evaluator(_scope, *this)
+      _writesToRoot(false)
 {
     UNUSED(hmcElemNames);
 }
@@ -80,6 +117,7 @@ bool FromFileModule::doLoad()
     nameScan(classDeclarations);
     loadExtensions(classDeclarations);
     loadSpecifications(classDeclarations);
+    _writesToRoot = writesToRoot();
     return true;
 }
 
@@ -101,10 +139,10 @@ Parser *FromFileModule::getParser(const ObjectType &type, Object &object, const
 int64_t FromFileModule::doGetFixedSize(const ObjectType &type, const Module &module) const
 {
     const std::string& name = type.typeTemplate().name();
-    auto alreadyIt = _fixedSizes.find(name);
-    if(alreadyIt != _fixedSizes.end())
+    int64_t cachedSize;
+    if(findCached(_cacheMutex, _fixedSizes, name, cachedSize))
     {
-        return alreadyIt->second;
+        return cachedSize;
     }
 
     auto definitionIt = _definitions.find(name);
@@ -120,30 +158,50 @@ int64_t FromFileModule::doGetFixedSize(const ObjectType &type, const Module &mod
 #ifdef LOAD_TRACE
         std::cerr<<type.typeTemplate().name()<<" unknown size"<<std::endl;
 #endif
-        _fixedSizes[type.typeTemplate().name()] = HM_UNKNOWN_SIZE;
-        return HM_UNKNOWN_SIZE;
+        return insertCached(_cacheMutex, _fixedSizes, name, HM_UNKNOWN_SIZE);
     }
 
     if(!type.typeTemplate().isVirtual() && module.getFather(type).isNull())
     {
-        VariableCollectionGuard guard(_collector);
+        LocalEvaluation evaluation(*this);
 
-        int64_t size = guessSize(definition);
+        int64_t size = guessSize(definition, evaluation.evaluator);
         if(size>=0)
         {
 #ifdef LOAD_TRACE
             std::cerr<<type.typeTemplate().name()<<" guessed size "<<size<<std::endl;
 #endif
-            _fixedSizes[type.typeTemplate().name()] = size;
-            return size;
+            return insertCached(_cacheMutex, _fixedSizes, name, size);
         }
     }
 #ifdef LOAD_TRACE
     std::cerr<<type.typeTemplate().name()<<" father's size"<<std::endl;
 #endif
 
-    _fixedSizes[type.typeTemplate().name()] = HM_PARENT_SIZE;
-    return HM_PARENT_SIZE;
+    return insertCached(_cacheMutex, _fixedSizes, name, HM_PARENT_SIZE);
+}
+
+bool FromFileModule::doIsThreadSafe() const
+{
+    // Every evaluation has its own variables and the caches are locked, but the state
+    // kept in the root by a subtree is read by the next ones, in the order they are parsed
+    return !_writesToRoot;
+}
+
+void FromFileModule::doGetParserNames(std::vector<std::string> &names) const
+{
+    for(const auto& entry : _definitions)
+    {
+        names.push_back(entry.first);
+    }
+}
+
+void FromFileModule::doGetFunctionNames(std::vector<std::string> &names) const
+{
+    for(const auto& entry : _functions)
+    {
+        names.push_back(entry.first);
+    }
 }
 
 bool FromFileModule::doCanHandleFunction(const std::string &name) const
@@ -153,14 +211,14 @@ bool FromFileModule::doCanHandleFunction(const std::string &name) const
 
 Variable FromFileModule::doExecuteFunction(const std::string &name, const Variable &params, const Module &fromModule) const
 {
-    auto it = functionDescriptor(name);
+    const FunctionDescriptor* descriptor = functionDescriptor(name);
 
-    if(it == _functionDescriptors.end())
+    if(descriptor == nullptr)
         return Variable();
 
     Variable scope(new LocalScope(params), true);
 
-    const Program& definition = std::get<3>(it->second);
+    const Program& definition = std::get<3>(*descriptor);
     Evaluator eval(scope, fromModule);
     BlockExecution blockExecution(definition, eval, scope, nullptr);
 
@@ -171,32 +229,32 @@ Variable FromFileModule::doExecuteFunction(const std::string &name, const Variab
 
 const std::vector<std::string> &FromFileModule::doGetFunctionParameterNames(const std::string &name) const
 {
-    auto it = functionDescriptor(name);
+    const FunctionDescriptor* descriptor = functionDescriptor(name);
 
-    if(it == _functionDescriptors.end())
+    if(descriptor == nullptr)
         return emptyParameterNames;
 
-    return std::get<0>(it->second);
+    return std::get<0>(*descriptor);
 }
 
 const std::vector<bool> &FromFileModule::doGetFunctionParameterModifiables(const std::string &name) const
 {
-    auto it = functionDescriptor(name);
+    const FunctionDescriptor* descriptor = functionDescriptor(name);
 
-    if(it == _functionDescriptors.end())
+    if(descriptor == nullptr)
         return emptyParameterModifiables;
 
-    return std::get<1>(it->second);
+    return std::get<1>(*descriptor);
 }
 
 const std::vector<Variant> &FromFileModule::doGetFunctionParameterDefaults(const std::string &name) const
 {
-    auto it = functionDescriptor(name);
+    const FunctionDescriptor* descriptor = functionDescriptor(name);
 
-    if(it == _functionDescriptors.end())
+    if(descriptor == nullptr)
         return emptyParameterDefaults;
 
-    return std::get<2>(it->second);
+    return std::get<2>(*descriptor);
 }
 
 void FromFileModule::loadFormatDetections(Program &formatDetections, StandardFormatDetector::Adder &formatAdder)
@@ -268,8 +326,8 @@ void FromFileModule::nameScan(Program& declarations)
                 Program program = typeAttribute.node(1);
                 auto generator = [this, program]objectTypeAttributeLambda
                 {
-                    VariableCollectionGuard guard(_collector);
-                    return Evaluator(Variable(new TypeScope(_collector, type), false), *this).rightValue(program).value();
+                    VariableCollector collector;
+                    return Evaluator(Variable(new TypeScope(collector, type), false), *this).rightValue(program).value();
                 };
 
                 auto it = _attributes.find(name);
@@ -326,8 +384,8 @@ void FromFileModule::loadExtensions(Program &classDeclarations)
            Program program = extension.node(0);
            setExtension(childTemplate,[this, program](const ObjectType& type)
            {
-               VariableCollectionGuard guard(_collector);
-               return Evaluator(Variable(new TypeScope(_collector, type), false), *this).type(program);
+               VariableCollector collector;
+               return Evaluator(Variable(new TypeScope(collector, type), false), *this).type(program);
            });
 #ifdef LOAD_TRACE
            std::cerr<<"    "<<childTemplate<<" extends "<<program.node(0).payload()<<"(...)"<<std::endl;
@@ -345,7 +403,7 @@ void FromFileModule::loadSpecifications(Program &classDeclarations)
     std::cerr<<"Load specifications :"<<std::endl;
 #endif
 
-    VariableCollectionGuard guard(_collector);
+    LocalEvaluation evaluation(*this);
 
     for(Program classDeclaration : classDeclarations)
     {
@@ -354,7 +412,7 @@ void FromFileModule::loadSpecifications(Program &classDeclarations)
             ObjectType child = getTemplate(classDeclaration.node(0).node(0).node(0).payload().toString())();
             for(Program type : classDeclaration.node(0).node(2))
             {
-                ObjectType parent(_evaluator.type(type));
+                ObjectType parent(evaluation.evaluator.type(type));
                 setSpecification(parent, child);
 #ifdef LOAD_TRACE
         std::cerr<<"    "<<child<<" specifies "<<parent<<std::endl;
@@ -363,8 +421,8 @@ void FromFileModule::loadSpecifications(Program &classDeclarations)
         }
         else if(classDeclaration.tag() == HMC_FORWARD)
         {
-            ObjectType parent(_evaluator.type(classDeclaration.node(0)));
-            ObjectType child(_evaluator.type(classDeclaration.node(1)));
+            ObjectType parent(evaluation.evaluator.type(classDeclaration.node(0)));
+            ObjectType child(evaluation.evaluator.type(classDeclaration.node(1)));
             setSpecification(parent, child);
 #ifdef LOAD_TRACE
         std::cerr<<"    "<<child<<" specifies "<<parent<<std::endl;
@@ -378,9 +436,9 @@ void FromFileModule::loadSpecifications(Program &classDeclarations)
 
 bool FromFileModule::sizeDependency(const std::string &name) const
 {
-    auto alreadyIt = _sizeDependency.find(name);
-    if(alreadyIt != _sizeDependency.end())
-        return alreadyIt->second;
+    bool cachedResult;
+    if(findCached(_cacheMutex, _sizeDependency, name, cachedResult))
+        return cachedResult;
 
     auto definitionIt = _definitions.find(name);
     if(definitionIt == _definitions.end())
@@ -390,11 +448,27 @@ bool FromFileModule::sizeDependency(const std::string &name) const
     std::set<VariablePath> dependencies = variableDependencies(definition, true);
 
     bool result = dependencies.find(sizeDescriptor) != dependencies.end();
-    _sizeDependency[name] = result;
-    return result;
+    return insertCached(_cacheMutex, _sizeDependency, name, result);
 }
 
-int64_t FromFileModule::guessSize(const Program &instructions) const
+bool FromFileModule::writesToRoot() const
+{
+    for(const auto& entry : _definitions)
+    {
+        const Program& definition = entry.second;
+        for(const Program& block : {definition.node(0), definition.node(1)})
+        {
+            for(const VariablePath& path : variableDependencies(block, true))
+            {
+                if(path.inScopeOf(rootDescriptor))
+                    return true;
+            }
+        }
+    }
+    return false;
+}
+
+int64_t FromFileModule::guessSize(const Program &instructions, const Evaluator &evaluator) const
 {
     int64_t size = 0;
     for(const Program& line : instructions)
@@ -402,7 +476,7 @@ int64_t FromFileModule::guessSize(const Program &instructions) const
         switch(line.tag())
         {
         case HMC_EXECUTION_BLOCK:
-            size += guessSize(line);
+            size += guessSize(line, evaluator);
             break;
 
         case HMC_DECLARATION:
@@ -410,7 +484,7 @@ int64_t FromFileModule::guessSize(const Program &instructions) const
                 if(!variableDependencies(line.node(0),false).empty())
                     return HM_UNKNOWN_SIZE;
 
-                ObjectType type = _evaluator.rightValue(line.node(0)).value().toObjectType();
+                ObjectType type = evaluator.rightValue(line.node(0)).value().toObjectType();
                 if(type.isNull())
                     return HM_UNKNOWN_SIZE;
 
@@ -424,16 +498,16 @@ int64_t FromFileModule::guessSize(const Program &instructions) const
 
         case HMC_LOOP:
         case HMC_DO_LOOP:
-            if(guessSize(line.node(1)) != 0)
+            if(guessSize(line.node(1), evaluator) != 0)
                 return HM_UNKNOWN_SIZE;
             break;
 
         case HMC_CONDITIONAL_STATEMENT:
             {
-                int64_t size1 = guessSize(line.node(1));
+                int64_t size1 = guessSize(line.node(1), evaluator);
                 if(size1 == -1)
                     return HM_UNKNOWN_SIZE;
-                int64_t size2 = guessSize(line.node(2));
+                int64_t size2 = guessSize(line.node(2), evaluator);
                 if(size2 == -1 ||size2 != size1)
                     return HM_UNKNOWN_SIZE;
                 size += size1;
@@ -453,9 +527,9 @@ int64_t FromFileModule::guessSize(const Program &instructions) const
 
 Program::const_iterator FromFileModule::headerEnd(const std::string &name) const
 {
-    auto alreadyIt = _headerEnd.find(name);
-    if(alreadyIt != _headerEnd.end())
-        return alreadyIt->second;
+    Program::const_iterator cachedHeaderEnd;
+    if(findCached(_cacheMutex, _headerEnd, name, cachedHeaderEnd))
+        return cachedHeaderEnd;
 
     Program bodyBlock = _definitions.find(name)->second.node(0);
 
@@ -477,15 +551,14 @@ Program::const_iterator FromFileModule::headerEnd(const std::string &name) const
 
     Program::const_iterator headerEnd = bodyBlock.begin();
     std::advance(headerEnd, std::distance(reverseHeaderEnd, bodyBlock.rend()));
-    _headerEnd[name] = headerEnd;
-    return headerEnd;
+    return insertCached(_cacheMutex, _headerEnd, name, headerEnd);
 }
 
 bool FromFileModule::needTailParsing(const std::string &name) const
 {
-    auto alreadyIt = _needTailParsing.find(name);
-    if(alreadyIt != _needTailParsing.end())
-        return alreadyIt->second;
+    bool cachedResult;
+    if(findCached(_cacheMutex, _needTailParsing, name, cachedResult))
+        return cachedResult;
 
     Program tailBlock = _definitions.find(name)->second.node(1);
 
@@ -497,19 +570,22 @@ bool FromFileModule::needTailParsing(const std::string &name) const
         }
     }
 
-    _needTailParsing[name] = result;
-    return result;
+    return insertCached(_cacheMutex, _needTailParsing, name, result);
 }
 
-FromFileModule::FunctionDescriptorMap::iterator FromFileModule::functionDescriptor(const std::string &name) const
+const FromFileModule::FunctionDescriptor* FromFileModule::functionDescriptor(const std::string &name) const
 {
-    auto alreadyIt = _functionDescriptors.find(name);
-    if(alreadyIt != _functionDescriptors.end())
-        return alreadyIt;
+    {
+        // The entries stay in place when the map grows, so they can be used without the lock
+        std::lock_guard<std::mutex> lock(_cacheMutex);
+        auto alreadyIt = _functionDescriptors.find(name);
+        if(alreadyIt != _functionDescriptors.end())
+            return &alreadyIt->second;
+    }
 
     auto it = _functions.find(name);
     if(it == _functions.end())
-        return _functionDescriptors.end();
+        return nullptr;
 
     const Program& declaration = it->second;
     const Program& arguments = declaration.node(1);
@@ -519,15 +595,17 @@ FromFileModule::FunctionDescriptorMap::iterator FromFileModule::functionDescript
     std::vector<bool> parameterModifiables;
     std::vector<Variant> parameterDefaults;
 
+    LocalEvaluation evaluation(*this);
     for(const Program& argument: arguments)
     {
         parameterNames.push_back(argument.node(1).payload().toString());
         parameterModifiables.push_back(argument.node(0).payload().toBool());
-        parameterDefaults.push_back(_evaluator.rightValue(argument.node(2)).value());
+        parameterDefaults.push_back(evaluation.evaluator.rightValue(argument.node(2)).value());
     }
 
     auto functionDescriptor = std::forward_as_tuple(parameterNames, parameterModifiables, parameterDefaults, definition);
-    return _functionDescriptors.insert(std::make_pair(name, functionDescriptor)).first;
+    std::lock_guard<std::mutex> lock(_cacheMutex);
+    return &_functionDescriptors.insert(std::make_pair(name, functionDescriptor)).first->second;
 }
 
 const Program &FromFileModule::program() const
@@ -542,7 +620,7 @@ bool FromFileModule::hasParser(const ObjectType &type) const
 }
 
 
-void FromFileModule::buildDependencies(const Program &instructions, bool modificationOnly, std::set<VariablePath> &descriptors, bool areVariablesModified) const
+void FromFileModule::buildDependencies(const Program &instructions, bool modificationOnly, const Evaluator &evaluator, std::set<VariablePath> &descriptors, bool areVariablesModified) const
 {
     switch(instructions.tag())
     {
@@ -551,24 +629,24 @@ void FromFileModule::buildDependencies(const Program &instructions, bool modific
         case HMC_LOOP:
         case HMC_DO_LOOP:
             for(Program elem : instructions) {
-                buildDependencies(elem, modificationOnly, descriptors);
+                buildDependencies(elem, modificationOnly, evaluator, descriptors);
             }
             break;
 
         case HMC_TYPE:
             for(Program arg : instructions.node(1)) {
-                buildDependencies(arg, modificationOnly, descriptors);
+                buildDependencies(arg, modificationOnly, evaluator, descriptors);
             }
             break;
 
         case HMC_DECLARATION:
-            buildDependencies(instructions.node(0), modificationOnly, descriptors);
+            buildDependencies(instructions.node(0), modificationOnly, evaluator, descriptors);
             break;
 
         case HMC_LOCAL_DECLARATIONS:
             for (const Program& localDeclaration : instructions) {
                 if(localDeclaration.size()>=2) {
-                    buildDependencies(localDeclaration.node(1), modificationOnly, descriptors);
+                    buildDependencies(localDeclaration.node(1), modificationOnly, evaluator, descriptors);
                 }
             }
             break;
@@ -577,18 +655,18 @@ void FromFileModule::buildDependencies(const Program &instructions, bool modific
             if(instructions.node(0).tag() == HMC_OPERATOR) {
                 int op = instructions.node(0).payload().toInteger();
                 for(int i = 0; i < operatorParameterCount[op]; ++i) {
-                    buildDependencies(instructions.node(1+i), modificationOnly, descriptors, areVariablesModified || !((1<<i)&operatorParameterRelease[op]));
+                    buildDependencies(instructions.node(1+i), modificationOnly, evaluator, descriptors, areVariablesModified || !((1<<i)&operatorParameterRelease[op]));
                 }
             } else if(instructions.node(0).tag() == HMC_VARIABLE) {
-                buildDependencies(instructions.node(0), modificationOnly, descriptors, areVariablesModified);
+                buildDependencies(instructions.node(0), modificationOnly, evaluator, descriptors, areVariablesModified);
             } else if(instructions.node(0).tag() == HMC_TYPE) {
-                buildDependencies(instructions.node(0), modificationOnly, descriptors);
+                buildDependencies(instructions.node(0), modificationOnly, evaluator, descriptors);
             }
             break;
 
         case HMC_VARIABLE:
             if (!modificationOnly || areVariablesModified) {
-                descriptors.insert(_evaluator.variablePath(instructions));
+                descriptors.insert(evaluator.variablePath(instructions));
             }
             break;
 
@@ -625,7 +703,7 @@ bool FromFileModule::checkHeaderOnlyVar(const Program &line) const
 std::set<VariablePath> FromFileModule::variableDependencies(const Program &instructions, bool modificationOnly) const
 {
     std::set<VariablePath> dependencies;
-    VariableCollectionGuard guard(_collector);
-    buildDependencies(instructions, modificationOnly, dependencies);
+    LocalEvaluation evaluation(*this);
+    buildDependencies(instructions, modificationOnly, evaluation.evaluator, dependencies);
     return dependencies;
 }
@@ -19,6 +19,7 @@
 #define FROMFILEMODULE_H
 
 #include <memory>
+#include <mutex>
 
 #include "core/mapmodule.h"
 #include "core/interpreter/program.h"
@@ -45,6 +46,9 @@ private:
     virtual Parser* getParser(const ObjectType &type, Object& object, const Module& fromModule) const final;
     virtual bool hasParser(const ObjectType &type) const final;
     virtual int64_t doGetFixedSize(const ObjectType &type, const Module &module) const final;
+    virtual bool doIsThreadSafe() const final;
+    virtual void doGetParserNames(std::vector<std::string>& names) const final;
+    virtual void doGetFunctionNames(std::vector<std::string>& names) const final;
 
     virtual bool doCanHandleFunction(const std::string& name) const final;
     virtual Variable doExecuteFunction(const std::string& name, const Variable &params, const Module &fromModule) const final;
@@ -63,20 +67,22 @@ private:
     void loadExtensions(Program &classDeclarations);
     void loadSpecifications(Program &classDeclarations);
     bool sizeDependency(const std::string& name) const;
+    bool writesToRoot() const;
 
-    int64_t guessSize(const Program& instructions) const;
+    int64_t guessSize(const Program& instructions, const Evaluator& evaluator) const;
 
     std::set<VariablePath> variableDependencies(const Program& instructions, bool modificationOnly) const;
-    void buildDependencies(const Program& instructions, bool modificationOnly, std::set<VariablePath>& descriptors, bool areVariablesModified = false) const;
+    void buildDependencies(const Program& instructions, bool modificationOnly, const Evaluator& evaluator, std::set<VariablePath>& descriptors, bool areVariablesModified = false) const;
 
     bool checkHeaderOnlyVar(const Program& line) const;
     Program::const_iterator headerEnd(const std::string& name) const;
     bool needTailParsing(const std::string& name) const;
-    FunctionDescriptorMap::iterator functionDescriptor(const std::string& name) const;
+    const FunctionDescriptor* functionDescriptor(const std::string& name) const;
 
     const Program& program() const;
 
     Program _program;
+    bool _writesToRoot;
 
     std::unordered_map<std::string, Program> _definitions;
     std::unordered_map<std::string, Program> _functions;
@@ -86,10 +92,8 @@ private:
     mutable std::unordered_map<std::string, bool> _sizeDependency;
     mutable std::unordered_map<std::string, Program::const_iterator> _headerEnd;
     mutable std::unordered_map<std::string, bool> _needTailParsing;
-
-    mutable VariableCollector _collector;
-    Variable _scope;
-    Evaluator _evaluator;
+    // Guards the caches above, filled lazily by the parsing threads
+    mutable std::mutex _cacheMutex;
 
 };
 
@@ -32,7 +32,6 @@ Program::Program(Object &object, std::shared_ptr<Memory> memory)
     : _object(&object),
       _memory(memory)
 {
-    _object->explore();
 }
 
 bool Program::isValid() const
@@ -42,12 +41,14 @@ bool Program::isValid() const
 
 uint32_t Program::tag() const
 {
-    return _object->lookUp("id")->value().toInteger();
+    static const Atom idName("id");
+    return _object->lookUp(idName)->value().toInteger();
 }
 
 const Variant &Program::payload() const
 {
-    Object* object = _object->lookUp("payload", true);
+    static const Atom payloadName("payload");
+    Object* object = _object->lookUp(payloadName, true);
     if(object == nullptr)
         object = _object;
     return object->value();
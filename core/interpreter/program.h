@@ -31,7 +31,8 @@
  * The root of a \link Program program\endlink can be loaded by the
  * \link ProgramLoader program loader\endlink. The children nodes can then be generated
  * by iterating over the node or accessing them by their index. Leaf nodes
- * and memory of the whole tree is shared by all the nodes generated.
+ * and memory of the whole tree is shared by all the nodes generated. The tree is
+ * explored whole when loaded, so that the nodes can be read from several threads at once.
  */
 class Program
 {
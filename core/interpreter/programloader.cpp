@@ -119,7 +119,8 @@ Program ProgramLoader::fromHMC(const std::string &path) const
     file.setPath(path);
 
     Object& fileObject = memory.setFileObject(_module.handleFile(DefaultModule::file(), file, memory.collector()));
-    fileObject.explore(1);
+    // Explored whole once, for the nodes to be only read by the parsing threads
+    fileObject.explore(-1);
 
     if(fileObject.numberOfChildren() >= 2)
     {
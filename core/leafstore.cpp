@@ -0,0 +1,383 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "core/leafstore.h"
+
+uint32_t LeafDictionary::typeIndex(const ObjectType &type)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto insertion = _typeIndices.insert(std::make_pair(type, _types.size()));
+    if (insertion.second) {
+        _types.push_back(&insertion.first->first);
+    }
+    return insertion.first->second;
+}
+
+const ObjectType &LeafDictionary::type(uint32_t index) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return *_types[index];
+}
+
+namespace {
+// Base of a store without leaves yet
+const int64_t unsetBase = std::numeric_limits<int64_t>::min();
+
+size_t leafSize(bool wide)
+{
+    return sizeof(uint64_t) + (wide ? 2 * sizeof(int64_t) : 2 * sizeof(uint32_t))
+         + sizeof(uint32_t) + sizeof(Atom) + sizeof(uint8_t);
+}
+}
+
+LeafStore::LeafStore()
+    : _arena(Arena::current()),
+      _block(nullptr)
+{
+}
+
+LeafStore::~LeafStore()
+{
+    free();
+}
+
+LeafStore::LeafStore(LeafStore &&other)
+    : LeafStore()
+{
+    *this = std::move(other);
+}
+
+LeafStore &LeafStore::operator=(LeafStore &&other)
+{
+    using std::swap;
+
+    swap(_arena, other._arena);
+    swap(_block, other._block);
+    return *this;
+}
+
+void LeafStore::reserve(int64_t firstRank, int64_t lastRank)
+{
+    if (_block == nullptr) {
+        if (lastRank >= firstRank) {
+            resize(firstRank, lastRank - firstRank + 1);
+        }
+    } else if (lastRank - _block->firstRank + 1 > static_cast<int64_t>(_block->count)) {
+        resize(_block->firstRank, lastRank - _block->firstRank + 1);
+    }
+}
+
+void LeafStore::add(int64_t rank, int64_t beginningPos, int64_t size, uint32_t typeIndex, Atom name, Variant &&value)
+{
+    // Ranks in between belong to children kept as objects
+    if (_block == nullptr) {
+        resize(rank, 1);
+    } else if (rank - _block->firstRank >= static_cast<int64_t>(_block->count)) {
+        resize(_block->firstRank, rank - _block->firstRank + 1);
+    }
+
+    const size_t i = index(rank);
+    setPosition(i, beginningPos, size);
+    typeIndices()[i] = typeIndex;
+    names()[i] = name;
+    setValue(i, std::move(value));
+}
+
+int64_t LeafStore::beginningPos(int64_t rank) const
+{
+    const size_t i = index(rank);
+    return _block->base + (_block->wide ? wideOffsets()[i] : offsets()[i]);
+}
+
+int64_t LeafStore::size(int64_t rank) const
+{
+    const size_t i = index(rank);
+    return _block->wide ? wideSizes()[i] : sizes()[i];
+}
+
+uint32_t LeafStore::typeIndex(int64_t rank) const
+{
+    return typeIndices()[index(rank)];
+}
+
+Atom LeafStore::name(int64_t rank) const
+{
+    return names()[index(rank)];
+}
+
+Variant LeafStore::value(int64_t rank) const
+{
+    const size_t i = index(rank);
+    const uint8_t tag = valueTags()[i];
+    if (tag == otherValueTag) {
+        return otherValue(i)->second;
+    }
+
+    Variant value;
+    const uint64_t bits = values()[i];
+    switch (tag & 0x0f) {
+        case Variant::integerType:
+            value = Variant(static_cast<long long>(bits));
+            break;
+
+        case Variant::unsignedIntegerType:
+            value = Variant(static_cast<unsigned long long>(bits));
+            break;
+
+        case Variant::floatingType:
+        {
+            double floating;
+            std::memcpy(&floating, &bits, sizeof(floating));
+            value = Variant(floating);
+            break;
+        }
+
+        case Variant::nullType:
+            value = Variant::null();
+            break;
+
+        default:
+            break;
+    }
+    value.setDisplayType(static_cast<Variant::Display>(tag & 0x30));
+    return value;
+}
+
+Variant LeafStore::takeValue(int64_t rank)
+{
+    const size_t i = index(rank);
+    if (valueTags()[i] == otherValueTag) {
+        return std::move(otherValue(i)->second);
+    }
+    return value(rank);
+}
+
+size_t LeafStore::count() const
+{
+    return _block == nullptr ? 0 : _block->count;
+}
+
+size_t LeafStore::byteCount() const
+{
+    size_t bytes = sizeof(LeafStore);
+    if (_block != nullptr) {
+        bytes += sizeof(Block) + _block->capacity * leafSize(_block->wide);
+        if (_block->otherValues != nullptr) {
+            bytes += sizeof(OtherValues) + _block->otherValues->capacity() * sizeof(OtherValues::value_type);
+        }
+    }
+    return bytes;
+}
+
+size_t LeafStore::index(int64_t rank) const
+{
+    return rank - _block->firstRank;
+}
+
+// Columns by decreasing alignment
+uint64_t *LeafStore::values() const
+{
+    return reinterpret_cast<uint64_t*>(_block + 1);
+}
+
+uint32_t *LeafStore::offsets() const
+{
+    return reinterpret_cast<uint32_t*>(values() + _block->capacity);
+}
+
+uint32_t *LeafStore::sizes() const
+{
+    return offsets() + _block->capacity;
+}
+
+int64_t *LeafStore::wideOffsets() const
+{
+    return reinterpret_cast<int64_t*>(values() + _block->capacity);
+}
+
+int64_t *LeafStore::wideSizes() const
+{
+    return wideOffsets() + _block->capacity;
+}
+
+uint32_t *LeafStore::typeIndices() const
+{
+    return _block->wide ? reinterpret_cast<uint32_t*>(wideSizes() + _block->capacity)
+                        : sizes() + _block->capacity;
+}
+
+Atom *LeafStore::names() const
+{
+    return reinterpret_cast<Atom*>(typeIndices() + _block->capacity);
+}
+
+uint8_t *LeafStore::valueTags() const
+{
+    return reinterpret_cast<uint8_t*>(names() + _block->capacity);
+}
+
+LeafStore::OtherValues::iterator LeafStore::otherValue(size_t i) const
+{
+    OtherValues& otherValues = *_block->otherValues;
+    return std::lower_bound(otherValues.begin(), otherValues.end(), static_cast<uint32_t>(i),
+                            [](const std::pair<uint32_t, Variant>& entry, uint32_t i) {
+        return entry.first < i;
+    });
+}
+
+bool LeafStore::fits(int64_t beginningPos, int64_t size) const
+{
+    const int64_t offset = beginningPos - _block->base;
+    return offset >= 0 && offset <= std::numeric_limits<uint32_t>::max()
+        && size >= 0 && size <= std::numeric_limits<uint32_t>::max();
+}
+
+void LeafStore::setPosition(size_t i, int64_t beginningPos, int64_t size)
+{
+    if (_block->base == unsetBase) {
+        _block->base = beginningPos;
+    }
+    if (!_block->wide && !fits(beginningPos, size)) {
+        reallocate(_block->firstRank, _block->capacity, true);
+    }
+
+    if (_block->wide) {
+        wideOffsets()[i] = beginningPos - _block->base;
+        wideSizes()[i] = size;
+    } else {
+        offsets()[i] = static_cast<uint32_t>(beginningPos - _block->base);
+        sizes()[i] = static_cast<uint32_t>(size);
+    }
+}
+
+void LeafStore::setValue(size_t i, Variant &&value)
+{
+    uint64_t& bits = values()[i];
+    uint8_t& tag = valueTags()[i];
+    if (tag == otherValueTag) {
+        _block->otherValues->erase(otherValue(i));
+    }
+
+    if (value.hasNumericalType()) {
+        if (value.type() == Variant::floatingType) {
+            const double floating = value.toDouble();
+            std::memcpy(&bits, &floating, sizeof(bits));
+        } else {
+            bits = value.toUnsignedInteger();
+        }
+        tag = value.type() | value.displayType();
+    } else if (value.isValueless()) {
+        bits = 0;
+        tag = value.type() | value.displayType();
+    } else {
+        bits = 0;
+        tag = otherValueTag;
+        if (_block->otherValues == nullptr) {
+            _block->otherValues = new OtherValues;
+        }
+        _block->otherValues->insert(otherValue(i), std::make_pair(static_cast<uint32_t>(i), std::move(value)));
+    }
+}
+
+void LeafStore::resize(int64_t firstRank, size_t count)
+{
+    const size_t capacity = _block == nullptr ? 0 : _block->capacity;
+    if (count > capacity) {
+        reallocate(firstRank, std::max(count, 2 * capacity), _block != nullptr && _block->wide);
+    }
+
+    const bool wide = _block->wide;
+    for (size_t i = _block->count; i < count; ++i) {
+        if (wide) {
+            wideOffsets()[i] = 0;
+            wideSizes()[i] = 0;
+        } else {
+            offsets()[i] = 0;
+            sizes()[i] = 0;
+        }
+        typeIndices()[i] = 0;
+        names()[i] = Atom();
+        values()[i] = 0;
+        valueTags()[i] = Variant::undefinedType;
+    }
+    _block->count = count;
+}
+
+void LeafStore::reallocate(int64_t firstRank, size_t capacity, bool wide)
+{
+    Block* old = _block;
+    _block = static_cast<Block*>(Arena::allocateIn(_arena, sizeof(Block) + capacity * leafSize(wide)));
+    _block->firstRank = firstRank;
+    _block->capacity = capacity;
+    _block->wide = wide;
+    if (old == nullptr) {
+        _block->base = unsetBase;
+        _block->count = 0;
+        _block->otherValues = nullptr;
+        return;
+    }
+    _block->base = old->base;
+    _block->count = old->count;
+    _block->otherValues = old->otherValues;
+
+    // Columns of the old block, read through the store while it still points to it
+    Block* block = _block;
+    _block = old;
+    const uint64_t* oldValues = values();
+    const uint32_t* oldOffsets = old->wide ? nullptr : offsets();
+    const uint32_t* oldSizes = old->wide ? nullptr : sizes();
+    const int64_t* oldWideOffsets = old->wide ? wideOffsets() : nullptr;
+    const int64_t* oldWideSizes = old->wide ? wideSizes() : nullptr;
+    const uint32_t* oldTypeIndices = typeIndices();
+    const Atom* oldNames = names();
+    const uint8_t* oldValueTags = valueTags();
+    _block = block;
+
+    const size_t count = _block->count;
+    for (size_t i = 0; i < count; ++i) {
+        const int64_t offset = old->wide ? oldWideOffsets[i] : oldOffsets[i];
+        const int64_t size = old->wide ? oldWideSizes[i] : oldSizes[i];
+        if (wide) {
+            wideOffsets()[i] = offset;
+            wideSizes()[i] = size;
+        } else {
+            offsets()[i] = static_cast<uint32_t>(offset);
+            sizes()[i] = static_cast<uint32_t>(size);
+        }
+    }
+    if (count > 0) {
+        std::memcpy(values(), oldValues, count * sizeof(uint64_t));
+        std::memcpy(typeIndices(), oldTypeIndices, count * sizeof(uint32_t));
+        std::memcpy(names(), oldNames, count * sizeof(Atom));
+        std::memcpy(valueTags(), oldValueTags, count * sizeof(uint8_t));
+    }
+
+    Arena::deallocate(old);
+}
+
+void LeafStore::free()
+{
+    if (_block != nullptr) {
+        delete _block->otherValues;
+        Arena::deallocate(_block);
+        _block = nullptr;
+    }
+}
@@ -0,0 +1,138 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef LEAFSTORE_H
+#define LEAFSTORE_H
+
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+#include "core/objecttype.h"
+#include "core/util/arena.h"
+#include "core/util/atom.h"
+#include "core/variant.h"
+
+/**
+ * @brief Types of the compact leaves and evictable objects of a tree, each
+ * stored once and referred to by index
+ *
+ * The dictionary is shared by the subtrees explored in parallel, so it is locked.
+ */
+class LeafDictionary
+{
+public:
+    uint32_t typeIndex(const ObjectType& type);
+    const ObjectType& type(uint32_t index) const;
+
+private:
+    mutable std::mutex _mutex;
+    std::map<ObjectType, uint32_t> _typeIndices;
+    std::vector<const ObjectType*> _types;
+};
+
+/**
+ * @brief Compact representation of the leaf children of an \link Object object\endlink
+ *
+ * Once an object is parsed, its children without children, parsers, scope,
+ * context or attributes are only kept as their position, size, type, name and
+ * value, stored by rank. Types are indices in the \link LeafDictionary
+ * dictionary\endlink of the tree. The object expands the leaves back into full
+ * objects when they are accessed.
+ *
+ * The leaves are stored by columns in a single block of the \link Arena arena\endlink,
+ * after a header with their first rank and count:
+ * positions as 32 bits offsets from the first leaf and 32 bits sizes, unless one
+ * of them does not fit, type indices, names, and values as their 64 bits and a
+ * tag with their type and display. Values other than numbers and valueless ones,
+ * such as strings, are kept aside as variants.
+ */
+class LeafStore
+{
+public:
+    LeafStore();
+    ~LeafStore();
+    LeafStore(LeafStore&& other);
+    LeafStore& operator=(LeafStore&& other);
+
+    /** @brief Makes room for leaves up to the given rank at once*/
+    void reserve(int64_t firstRank, int64_t lastRank);
+
+    void add(int64_t rank, int64_t beginningPos, int64_t size,
+             uint32_t typeIndex, Atom name, Variant&& value);
+
+    int64_t beginningPos(int64_t rank) const;
+    int64_t size(int64_t rank) const;
+    uint32_t typeIndex(int64_t rank) const;
+    Atom name(int64_t rank) const;
+    Variant value(int64_t rank) const;
+    /** @brief Value of the leaf, moved out when it is expanded*/
+    Variant takeValue(int64_t rank);
+
+    /** @brief Number of ranks the store has room for, from the first leaf to the last one*/
+    size_t count() const;
+
+    /** @brief Memory held by the store, in bytes*/
+    size_t byteCount() const;
+
+private:
+    // Values kept aside, sorted by index
+    typedef std::vector<std::pair<uint32_t, Variant> > OtherValues;
+
+    // Header of the block, followed by the columns
+    struct Block
+    {
+        int64_t firstRank;
+        // Position of the first leaf, from which the offsets are counted
+        int64_t base;
+        size_t count;
+        size_t capacity;
+        // Set once a position or a size does not fit in 32 bits
+        bool wide;
+        OtherValues* otherValues;
+    };
+
+    // Tag of the values kept aside
+    static const uint8_t otherValueTag = 0xff;
+
+    size_t index(int64_t rank) const;
+    uint64_t* values() const;
+    uint32_t* offsets() const;
+    uint32_t* sizes() const;
+    int64_t* wideOffsets() const;
+    int64_t* wideSizes() const;
+    uint32_t* typeIndices() const;
+    Atom* names() const;
+    uint8_t* valueTags() const;
+    OtherValues::iterator otherValue(size_t index) const;
+    bool fits(int64_t beginningPos, int64_t size) const;
+    void setPosition(size_t index, int64_t beginningPos, int64_t size);
+    void setValue(size_t index, Variant&& value);
+    void resize(int64_t firstRank, size_t count);
+    void reallocate(int64_t firstRank, size_t capacity, bool wide);
+    void free();
+
+    // The store itself only holds the block, so that objects without leaves stay small
+    Arena* _arena;
+    Block* _block;
+
+    LeafStore& operator=(const LeafStore&) = delete;
+    LeafStore(const LeafStore&) = delete;
+};
+
+#endif // LEAFSTORE_H
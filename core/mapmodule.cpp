@@ -27,6 +27,7 @@ const MapModule::ParserGenerator& MapModule::nullGenerator = []parserLambda{retu
 void MapModule::addParser(const std::string &name, const MapModule::ParserGenerator &parserGenerator)
 {
     _map[name] = parserGenerator;
+    objectModelChanged();
 }
 
 void MapModule::addParser(const std::string &name)
@@ -38,11 +39,13 @@ void MapModule::addParser(const std::string &name)
 void MapModule::setFixedSize(const std::string &name, const FixedSizeGenerator &fixedSizeFunction)
 {
     _sizes[name] = fixedSizeFunction;
+    objectModelChanged();
 }
 
 void MapModule::setFixedSize(const std::string &name, int64_t fixedSize)
 {
     _sizes[name] = [fixedSize] fixedSizeLambda {return fixedSize;};
+    objectModelChanged();
 }
 
 void MapModule::setFixedSizeFromArg(const std::string &name, int arg)
@@ -52,6 +55,7 @@ void MapModule::setFixedSizeFromArg(const std::string &name, int arg)
                  return type.parameterValue(arg).toInteger();
              return -1;
     };
+    objectModelChanged();
 }
 
 void MapModule::addFunction(const std::string &name,
@@ -61,6 +65,7 @@ void MapModule::addFunction(const std::string &name,
                             const MapModule::Functor &functor)
 {
     _functions[name] = std::make_tuple(parameterNames, parameterModifiables, parameterDefaults, functor);
+    objectModelChanged();
 }
 
 bool MapModule::hasParser(const ObjectType &type) const
@@ -94,6 +99,22 @@ int64_t MapModule::doGetFixedSize(const ObjectType &type, const Module &module)
     }
 }
 
+void MapModule::doGetParserNames(std::vector<std::string> &names) const
+{
+    for(const auto& entry : _map)
+    {
+        names.push_back(entry.first);
+    }
+}
+
+void MapModule::doGetFunctionNames(std::vector<std::string> &names) const
+{
+    for(const auto& entry : _functions)
+    {
+        names.push_back(entry.first);
+    }
+}
+
 bool MapModule::doCanHandleFunction(const std::string &name) const
 {
     return _functions.find(name) != _functions.end();
@@ -87,6 +87,9 @@ private:
 
     int64_t doGetFixedSize(const ObjectType &type, const Module &module) const override;
 
+    void doGetParserNames(std::vector<std::string>& names) const override;
+    void doGetFunctionNames(std::vector<std::string>& names) const override;
+
     bool doCanHandleFunction(const std::string& name) const override;
     Variable doExecuteFunction(const std::string& name, const Variable &params, const Module &fromModule) const override;
     const std::vector<std::string>& doGetFunctionParameterNames(const std::string& name) const override;
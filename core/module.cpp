@@ -15,6 +15,8 @@
 //along with this program; if not, write to the Free Software
 //Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
+#include <limits>
+
 #include "core/module.h"
 #include "core/object.h"
 #include "core/objecttypetemplate.h"
@@ -27,6 +29,30 @@ const std::vector<std::string> emptyParameterNames;
 const std::vector<bool> emptyParameterModifiables;
 const std::vector<Variant> emptyParameterDefaults;
 
+namespace {
+// Fixed size of a plan not asked for yet
+const int64_t uncomputedFixedSize = std::numeric_limits<int64_t>::min();
+
+// Beyond it the least recently used plans are dropped, as types with parameters such as sizes can be countless
+const size_t maxParserPlanCount = 4096;
+
+// Order of the parameters of types with the same template, in which specifications are looked for
+bool parametersLess(const ObjectType& a, const ObjectType& b)
+{
+    for (int i = 0; i < a.typeTemplate().numberOfParameters(); ++i) {
+        if (a.parameterValue(i) != b.parameterValue(i)) {
+            return a.parameterValue(i) < b.parameterValue(i);
+        }
+    }
+    return false;
+}
+}
+
+Module::ParserPlan::ParserPlan()
+    : fixedSize(uncomputedFixedSize)
+{
+}
+
 Module::Module()
     :_loaded(false)
 {
@@ -35,6 +61,8 @@ Module::Module()
 void Module::import(const Module &module)
 {
     _importedModules.push_back(&module);
+    module._dependentModules.push_back(this);
+    objectModelChanged();
 }
 
 bool Module::isExtension(const ObjectType& child, const ObjectType& parent) const
@@ -53,6 +81,7 @@ bool Module::isExtension(const ObjectType& child, const ObjectType& parent) cons
 void Module::setExtension(const ObjectTypeTemplate &childTemplate, const std::function<ObjectType (const ObjectType &)> &parentFunction)
 {
     _extensions.insert(std::make_pair(&childTemplate, parentFunction));
+    objectModelChanged();
 }
 
 void Module::setExtension(const ObjectTypeTemplate &childTemplate, const ObjectType &parent)
@@ -67,11 +96,23 @@ void Module::setExtension(const ObjectTypeTemplate &childTemplate, const ObjectT
 {
     setExtension(childTemplate, [parent, parameterMapping](const ObjectType& type)
     {
-        ObjectType father = parent;
+        std::vector<Variant> parameterValues;
+        for(int i = 0; i < parent.numberOfParameters(); ++i)
+        {
+            parameterValues.push_back(parent.parameterValue(i));
+        }
         for(const auto& binding : parameterMapping)
         {
-            father.setParameter(binding.second, type.parameterValue(binding.first));
+            if(static_cast<size_t>(binding.second) >= parameterValues.size())
+            {
+                parameterValues.resize(binding.second + 1);
+            }
+            parameterValues[binding.second] = type.parameterValue(binding.first);
         }
+
+        // Interned once with all of its parameters
+        ObjectType father = parent;
+        father.setParameters(parameterValues);
         return father;
     });
 }
@@ -80,6 +121,23 @@ void Module::setExtension(const ObjectTypeTemplate &childTemplate, const ObjectT
 
 ObjectType Module::getFather(const ObjectType &child) const
 {
+    if(_loaded)
+    {
+        const auto it = _extensionTable.find(&child.typeTemplate());
+        if(it != _extensionTable.end())
+        {
+            for(const Extension* extension : it->second)
+            {
+                ObjectType father = (*extension)(child);
+                if(!father.isNull())
+                {
+                    return father;
+                }
+            }
+        }
+        return ObjectType();
+    }
+
     //Searching locally
     auto it = _extensions.find(&child.typeTemplate());
     if(it != _extensions.end())
@@ -105,7 +163,27 @@ ObjectType Module::getFather(const ObjectType &child) const
 
 ObjectType Module::specify(const ObjectType &parent) const
 {
-    ObjectType child = specifyLocally(parent);
+    if(_loaded)
+    {
+        const auto it = _specificationTable.find(&parent.typeTemplate());
+        if(it != _specificationTable.end())
+        {
+            for(const Specifications* specifications : it->second)
+            {
+                ObjectType child = specify(*specifications, parent);
+                if(!child.isNull())
+                    return child;
+            }
+        }
+        return ObjectType();
+    }
+
+    ObjectType child;
+    const auto it = _automaticSpecifications.find(&parent.typeTemplate());
+    if(it != _automaticSpecifications.end())
+    {
+        child = specify(it->second, parent);
+    }
 
     if(child.isNull())
     {
@@ -120,17 +198,14 @@ ObjectType Module::specify(const ObjectType &parent) const
 }
 
 
-ObjectType Module::specifyLocally(const ObjectType& parent) const
+ObjectType Module::specify(const Specifications &specifications, const ObjectType& parent)
 {
     ObjectType type;
-    ObjectType rangeBegin(parent.typeTemplate());
-    for(SpecificationMap::const_iterator it = _automaticSpecifications.lower_bound(&rangeBegin);
-        it != _automaticSpecifications.end() && it->first->typeTemplate() == parent.typeTemplate();
-        ++it)
+    for(const auto& specification : specifications)
     {
-        if(parent.extendsDirectly(*(it->first)))
+        if(parent.extendsDirectly(specification.first))
         {
-            type = it->second;
+            type = specification.second;
             type.importParameters(parent);
             break;
         }
@@ -138,9 +213,69 @@ ObjectType Module::specifyLocally(const ObjectType& parent) const
     return type;
 }
 
-void Module::addParsers(Object &object, const ObjectType &type, const Module &fromModule, const ObjectType &lastType) const
+std::shared_ptr<const Module::ParserPlan> Module::parserPlan(const ObjectType &type) const
+{
+    std::shared_ptr<const ParserPlan> plan = findParserPlan(type);
+    if (plan) {
+        return plan;
+    }
+
+    // Checked again once the plans are worked out one at a time, another thread may have been faster
+    std::lock_guard<std::recursive_mutex> buildLock(_parserPlanBuildMutex);
+    plan = findParserPlan(type);
+    if (plan) {
+        return plan;
+    }
+
+    // Worked out without the lock on the plans, since extensions may evaluate types needing other plans
+    std::shared_ptr<ParserPlan> newPlan = std::make_shared<ParserPlan>();
+    for (ObjectType currentType = type; !currentType.isNull(); currentType = getFather(currentType)) {
+        newPlan->chain.emplace_back(currentType, handler(currentType));
+    }
+    newPlan->specification = specify(type);
+
+    std::lock_guard<std::mutex> lock(_parserPlansMutex);
+    // The other plans worked out meanwhile may be this one
+    const auto it = _parserPlans.find(type);
+    if (it != _parserPlans.end()) {
+        return it->second->second;
+    }
+    if (_parserPlans.size() >= maxParserPlanCount) {
+        _parserPlans.erase(_parserPlanOrder.back().first);
+        _parserPlanOrder.pop_back();
+    }
+    _parserPlanOrder.emplace_front(type, std::move(newPlan));
+    _parserPlans.emplace(type, _parserPlanOrder.begin());
+    return _parserPlanOrder.front().second;
+}
+
+std::shared_ptr<const Module::ParserPlan> Module::findParserPlan(const ObjectType &type) const
+{
+    std::lock_guard<std::mutex> lock(_parserPlansMutex);
+    const auto it = _parserPlans.find(type);
+    if (it == _parserPlans.end()) {
+        return nullptr;
+    }
+    _parserPlanOrder.splice(_parserPlanOrder.begin(), _parserPlanOrder, it->second);
+    return it->second->second;
+}
+
+void Module::clearParserPlans()
+{
+    std::lock_guard<std::mutex> lock(_parserPlansMutex);
+    _parserPlans.clear();
+    _parserPlanOrder.clear();
+}
+
+size_t Module::parserPlanCount() const
+{
+    std::lock_guard<std::mutex> lock(_parserPlansMutex);
+    return _parserPlans.size();
+}
+
+void Module::addParsers(Object &object, const ObjectType &type, const ObjectType &lastType) const
 {
-    addParsersRecursive(object, type, fromModule, lastType);
+    addParsersRecursive(object, type, lastType);
 
     const auto& parsers = object._parsers;
     if (std::any_of(parsers.begin(), parsers.end(), [](const std::unique_ptr<Parser>& parser) {
@@ -154,33 +289,35 @@ void Module::addParsers(Object &object, const ObjectType &type, const Module &fr
     };
 }
 
-void Module::addParsersRecursive(Object &object, const ObjectType &type, const Module &fromModule, const ObjectType &lastType) const
+void Module::addParsersRecursive(Object &object, const ObjectType &type, const ObjectType &lastType) const
 {
-    //Building the father list
-    std::list<ObjectType> fathers;
-    ObjectType currentType = type;
-    while(currentType.typeTemplate() != lastType.typeTemplate() && !currentType.isNull())
+    const std::shared_ptr<const ParserPlan> plan = parserPlan(type);
+
+    //Fathers up to the last type, whose parsers are already added
+    size_t fatherCount = 0;
+    while(fatherCount < plan->chain.size() && plan->chain[fatherCount].first.typeTemplate() != lastType.typeTemplate())
     {
-        fathers.push_front(currentType);
-        currentType = fromModule.getFather(currentType);
+        ++fatherCount;
     }
 
     //Adding the fathers' parsers
-    for(ObjectType father : fathers)
+    for(size_t i = fatherCount; i > 0; --i)
     {
+        const ObjectType& father = plan->chain[i - 1].first;
+        const Module* module = plan->chain[i - 1].second;
         object.setType(father);
-        const Module* module = handler(father);
         if(module!=nullptr)
         {
-            Parser* parser = module->getParser(father, object, fromModule);
+            Parser* parser = module->getParser(father, object, *this);
             object.addParser(parser);
         }
     }
-    //Type specification
-    ObjectType specification = specify(object.type());
+    //Type specification, the parsers may have changed the type
+    const ObjectType specification = object.type().isIdentical(type) ? plan->specification
+                                                                     : parserPlan(object.type())->specification;
     if(!specification.isNull())
     {
-        addParsersRecursive(object, specification, fromModule, object.type());
+        addParsersRecursive(object, specification, object.type());
     }
 }
 
@@ -189,65 +326,93 @@ void Module::setSpecification(const ObjectType& parent, const ObjectType& child)
     if (!parent.typeTemplate().isVirtual()) {
         Log::error("Cannot forward ",parent," to ",child," because ",parent.typeTemplate(), " is not virtual ");
     }
-    const ObjectType* parentPtr = new ObjectType(parent);
-    _automaticSpecifications.insert(std::make_pair(parentPtr, child));
+    std::vector<std::pair<ObjectType, ObjectType> >& specifications = _automaticSpecifications[&parent.typeTemplate()];
+    const auto it = std::lower_bound(specifications.begin(), specifications.end(), parent,
+                                     [](const std::pair<ObjectType, ObjectType>& specification, const ObjectType& type) {
+        return parametersLess(specification.first, type);
+    });
+    // The first specification set for a parent is kept
+    if (it == specifications.end() || parametersLess(parent, it->first)) {
+        specifications.insert(it, std::make_pair(parent, child));
+    }
+    objectModelChanged();
 }
 
 Object* Module::handleFile(const ObjectType& type, File &file, VariableCollector &collector) const
 {
-    return handle(type, file, nullptr, collector, *this);
+    return handle(type, file, nullptr, collector);
 }
 
 Object* Module::handle(const ObjectType& type, Object &parent) const
 {
-    return handle(type, parent.file(), &parent, parent.collector(), *this);
+    return handle(type, parent.file(), &parent, parent.collector());
 }
 
 
 bool Module::canHandle(const ObjectType &type) const
 {
-    if(hasParser(type))
-        return true;
-    for(std::list<const Module*>::const_reverse_iterator it = _importedModules.rbegin();
-        it != _importedModules.rend();
-        ++it)
-    {
-        if((*it)->canHandle(type))
-            return true;
-    }
-    return false;
+    return handler(type) != nullptr;
 }
 
 const Module *Module::handler(const ObjectType &type) const
 {
+    if(_loaded)
+    {
+        const auto it = _parserTable.find(type.typeTemplate().name());
+        return it != _parserTable.end() ? it->second : nullptr;
+    }
+
     if(hasParser(type))
         return this;
 
     for(const Module* module : reverse(_importedModules))
     {
-        if(module->canHandle(type))
-            return module->handler(type);
+        const Module* result = module->handler(type);
+        if(result != nullptr)
+            return result;
     }
     return nullptr;
 }
 
-Object* Module::handle(const ObjectType& type, File& file, Object* parent, VariableCollector &collector, const Module& fromModule) const
+Object* Module::handle(const ObjectType& type, File& file, Object* parent, VariableCollector &collector) const
 {
     Object* object;
 
     if(parent != nullptr) {
+        Arena::Scope scope(parent->root()._arena.get());
         object = new Object(file, parent->beginningPos() + parent->pos(), parent, collector);
         parent->_lastChild = object;
+        if (object->_memoryBudget) {
+            // Kept to parse the object again once evicted
+            object->_module = this;
+            object->_handledType = parent->root()._leafDictionary->typeIndex(type);
+        }
     } else {
+        // The root owns the arena of the tree, so it cannot live in it
+        Arena::Scope scope(nullptr);
         object = new Object(file, 0, nullptr, collector);
+        object->_arena.reset(new Arena);
     }
 
-    addParsers(*object, type, fromModule);
+    Arena::Scope scope(object->root()._arena.get());
+    addParsers(*object, type);
     return object;
 }
 
+void Module::handleAgain(Object &object, const ObjectType &type) const
+{
+    Arena::Scope scope(object.root()._arena.get());
+    addParsers(object, type);
+}
+
 const ObjectTypeTemplate& Module::getTemplate(const std::string &name) const
 {
+    if(_loaded)
+    {
+        const auto it = _templateTable.find(name);
+        return it != _templateTable.end() ? *it->second : nullTypeTemplate;
+    }
+
     const auto it = _templates.find(name);
 
     if(it != _templates.end())
@@ -270,35 +435,43 @@ bool Module::hasTemplate(const std::string& name) const
 
 int64_t Module::getFixedSize(const ObjectType &type) const
 {
-    const Module* module = handler(type);
+    const std::shared_ptr<const ParserPlan> plan = parserPlan(type);
 
-    if(module == nullptr)
-        return HM_UNKNOWN_SIZE;
+    int64_t size = plan->fixedSize.load(std::memory_order_acquire);
+    if(size != uncomputedFixedSize)
+        return size;
 
-    int64_t size = module->doGetFixedSize(type, *this);
+    const Module* module = plan->chain.empty() ? nullptr : plan->chain.front().second;
 
-    if(size == HM_PARENT_SIZE)
-        return getFixedSize(getFather(type));
+    if(module == nullptr)
+    {
+        size = HM_UNKNOWN_SIZE;
+    }
+    else
+    {
+        size = module->doGetFixedSize(type, *this);
+
+        if(size == HM_PARENT_SIZE)
+            size = getFixedSize(plan->chain.size() > 1 ? plan->chain[1].first : ObjectType());
+    }
 
+    plan->fixedSize.store(size, std::memory_order_release);
     return size;
 }
 
 bool Module::canHandleFunction(const std::string& name) const
 {
-    if(doCanHandleFunction(name))
-        return true;
-
-    for(const Module* importedModule: _importedModules)
-    {
-        if(importedModule->canHandleFunction(name))
-            return true;
-    }
-
-    return false;
+    return functionHandler(name) != nullptr;
 }
 
 const Module *Module::functionHandler(const std::string &name) const
 {
+    if(_loaded)
+    {
+        const auto it = _functionTable.find(name);
+        return it != _functionTable.end() ? it->second : nullptr;
+    }
+
     if(doCanHandleFunction(name))
         return this;
 
@@ -336,10 +509,117 @@ bool Module::load()
     if(!_loaded)
     {
         _loaded = doLoad();
+        objectModelChanged();
     }
     return _loaded;
 }
 
+void Module::objectModelChanged()
+{
+    clearParserPlans();
+    if(_loaded)
+    {
+        buildDispatchTables();
+    }
+
+    // Their tables and plans merge those of this module
+    for(Module* module : _dependentModules)
+    {
+        module->objectModelChanged();
+    }
+}
+
+void Module::buildDispatchTables()
+{
+    _templateTable.clear();
+    _parserTable.clear();
+    _functionTable.clear();
+    _extensionTable.clear();
+    _specificationTable.clear();
+
+    collectTemplates(_templateTable);
+    collectParsers(_parserTable);
+    collectFunctions(_functionTable);
+    collectExtensions(_extensionTable);
+    collectSpecifications(_specificationTable);
+}
+
+// Each collector goes through the modules in the order the lookups used to, the first entry found being kept
+
+void Module::collectTemplates(TemplateTable &templates) const
+{
+    templates.insert(_templates.begin(), _templates.end());
+
+    for(const Module* module : reverse(_importedModules))
+    {
+        module->collectTemplates(templates);
+    }
+}
+
+void Module::collectParsers(HandlerTable &handlers) const
+{
+    std::vector<std::string> names;
+    doGetParserNames(names);
+    for(const std::string& name : names)
+    {
+        handlers.insert(std::make_pair(name, this));
+    }
+
+    for(const Module* module : reverse(_importedModules))
+    {
+        module->collectParsers(handlers);
+    }
+}
+
+void Module::collectFunctions(HandlerTable &handlers) const
+{
+    std::vector<std::string> names;
+    doGetFunctionNames(names);
+    for(const std::string& name : names)
+    {
+        handlers.insert(std::make_pair(name, this));
+    }
+
+    for(const Module* module : _importedModules)
+    {
+        module->collectFunctions(handlers);
+    }
+}
+
+void Module::collectExtensions(ExtensionTable &extensions) const
+{
+    for(const auto& extension : _extensions)
+    {
+        std::vector<const Extension*>& candidates = extensions[extension.first];
+        if(std::find(candidates.begin(), candidates.end(), &extension.second) == candidates.end())
+        {
+            candidates.push_back(&extension.second);
+        }
+    }
+
+    for(const Module* module : reverse(_importedModules))
+    {
+        module->collectExtensions(extensions);
+    }
+}
+
+void Module::collectSpecifications(SpecificationTable &specifications) const
+{
+    for(const auto& entry : _automaticSpecifications)
+    {
+        std::vector<const Specifications*>& candidates = specifications[entry.first];
+        if(std::find(candidates.begin(), candidates.end(), &entry.second) == candidates.end())
+        {
+            candidates.push_back(&entry.second);
+        }
+    }
+
+    for(const Module* module : reverse(_importedModules))
+    {
+        module->collectSpecifications(specifications);
+    }
+}
+
 Parser *Module::getParser(const ObjectType &/*type*/, Object &/*object*/, const Module &/*fromModule*/) const
 {
     return nullptr;
@@ -355,6 +635,11 @@ int64_t Module::doGetFixedSize(const ObjectType &/*type*/, const Module &/*modul
     return -1;
 }
 
+bool Module::doIsThreadSafe() const
+{
+    return true;
+}
+
 bool Module::doCanHandleFunction(const std::string &/*name*/) const
 {
     return false;
@@ -421,10 +706,19 @@ bool Module::isLoaded() const
     return _loaded;
 }
 
+bool Module::isThreadSafe() const
+{
+    return doIsThreadSafe()
+        && std::all_of(_importedModules.begin(), _importedModules.end(), [](const Module* module) {
+               return module->isThreadSafe();
+           });
+}
+
 
 void Module::addTemplate(const ObjectTypeTemplate& typeTemplate)
 {
     _templates[typeTemplate.name()] = &typeTemplate;
+    objectModelChanged();
 }
 
 ObjectTypeTemplate &Module::newTemplate(const std::string &name, const std::vector<std::string> &parameters)
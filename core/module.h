@@ -25,7 +25,10 @@
 #include <map>
 #include <set>
 #include <algorithm>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include "core/objecttype.h"
 #include "core/objecttypetemplate.h"
@@ -54,6 +57,8 @@ class Variable;
  *
  * Other modules can be imported, in which case if a \link ObjectType type\endlink or a function can not be handle by the \link Module module\endlink,
  * then the imported \link Module modules\endlink will serve as fallback with priority for the last loaded.
+ * Once the \link Module module\endlink is loaded, templates, parsers, functions, extensions and specifications of the
+ * \link Module module\endlink and of the imported ones are merged into tables, so that finding one takes a single lookup.
  *
  * The life cycle of the \link Module module\endlink is handled by a \link ModuleLoader module loader\endlink : on construction the \link Module module\endlink must
  * have the smallest memory footprint possible abd the shortest runtime, when added to the \link ModuleLoader module loader\endlink format detection will be added so
@@ -61,6 +66,11 @@ class Variable;
  * module loader\endlink uses the module for the first time, it first ask for importation request to see which \link Module modules\endlink must be loaded and imported
  * (reimplement requestImportations) and then the actual loading is done (reimplement doLoad).
  *
+ * The fathers of a \link ObjectType type\endlink, the modules handling them, its specification and its fixed size are
+ * worked out the first time an object of this \link ObjectType type\endlink is handled, and then reused for every
+ * other object of the same \link ObjectType type\endlink, until the \link Module module\endlink is loaded again or its
+ * object model modified.
+ *
  * The class is virtual and must be subclassed to be used. For most usages MapModule is the right class to subclass.
  */
 class Module
@@ -73,6 +83,9 @@ public:
      *
      * If a \link ObjectType type\endlink or a function is not handled by the the \link Module module\endlink, then a handler will be searched among the
      * imported modules, with a priority for the lastest \link Module module\endlink imported
+     *
+     * The lookups are updated whenever the imported \link Module module\endlink gets new templates,
+     * extensions, specifications or imports.
      */
     void import(const Module& module);
 
@@ -195,6 +208,17 @@ public:
      */
     bool isLoaded() const;
 
+    /**
+     * @brief Check if objects can be parsed with the module and the imported ones from several
+     * threads at once
+     */
+    bool isThreadSafe() const;
+
+    /**
+     * @brief Get the number of parser plans kept by the \link Module module\endlink
+     */
+    size_t parserPlanCount() const;
+
 protected:
     /**
      * @brief [Pure Virtual] Use the \link StandardFormatDetector::Adder format adder\endlink to add format detection methods, so that the
@@ -236,6 +260,27 @@ protected:
     virtual int64_t doGetFixedSize(const ObjectType& type, const Module& module) const;
 
 
+    /**
+     * @brief Check if the parsers of the module rely on no state shared between objects, which
+     * is the case by default
+     */
+    virtual bool doIsThreadSafe() const;
+
+    /**
+     * @brief [Pure Virtual] Add the names of the \link ObjectTypeTemplate type templates\endlink whose
+     * \link ObjectType types\endlink can be handled by the \link Module module\endlink directly
+     *
+     * Once the \link Module module\endlink is loaded, the handlers are found from these names rather than with hasParser.
+     */
+    virtual void doGetParserNames(std::vector<std::string>& names) const = 0;
+
+    /**
+     * @brief [Pure Virtual] Add the names of the functions that can be handled by the \link Module module\endlink directly
+     *
+     * Once the \link Module module\endlink is loaded, the handlers are found from these names rather than with doCanHandleFunction.
+     */
+    virtual void doGetFunctionNames(std::vector<std::string>& names) const = 0;
+
     virtual bool doCanHandleFunction(const std::string& name) const;
     virtual Variable doExecuteFunction(const std::string& name, const Variable &params, const Module &fromModule) const;
     virtual const std::vector<std::string>& doGetFunctionParameterNames(const std::string& name) const;
@@ -257,34 +302,71 @@ protected:
      */
     ObjectTypeTemplate& newTemplate(const std::string& name, const std::vector<std::string>& parameters = std::vector<std::string>());
 
+    /**
+     * @brief Drop the parser plans and rebuild the lookups of the \link Module module\endlink and of those importing it
+     *
+     * To be called by subclasses whenever their parsers, sizes or functions change after loading.
+     */
+    void objectModelChanged();
+
 private:
     friend class ModuleLoader;
-    template<class T>
-    struct UnrefCompare : public std::binary_function<T, T, bool>
+    friend class Object;
+    // Specifications by template of the parent, ordered by the parameters of the parent
+    typedef std::vector<std::pair<ObjectType, ObjectType> > Specifications;
+    typedef std::unordered_map<const ObjectTypeTemplate*, Specifications> SpecificationMap;
+
+    typedef std::function<ObjectType(const ObjectType&)> Extension;
+    typedef std::unordered_map<const ObjectTypeTemplate*, Extension> ExtensionMap;
+
+    // Merged from the module and the imported ones, by decreasing priority
+    typedef std::unordered_map<std::string, const ObjectTypeTemplate*> TemplateTable;
+    typedef std::unordered_map<std::string, const Module*> HandlerTable;
+    typedef std::unordered_map<const ObjectTypeTemplate*, std::vector<const Extension*> > ExtensionTable;
+    typedef std::unordered_map<const ObjectTypeTemplate*, std::vector<const Specifications*> > SpecificationTable;
+
+    /**
+     * @brief What handling an object of a type involves, worked out once per type
+     */
+    struct ParserPlan
     {
-        bool operator()(T x, T y) const
-        {
-            return *x < *y;
-        }
+        ParserPlan();
+
+        // The type and then its fathers, each with the module providing its parser if any
+        std::vector<std::pair<ObjectType, const Module*> > chain;
+        ObjectType specification;
+        // Computed on first use, since it may depend on other plans
+        mutable std::atomic<int64_t> fixedSize;
     };
 
-    typedef std::map<const ObjectType*, ObjectType, UnrefCompare<const ObjectType*> > SpecificationMap;
+    bool load();
 
-    typedef std::map<const ObjectTypeTemplate*, std::function<ObjectType(const ObjectType&)>, UnrefCompare<const ObjectTypeTemplate*> > ExtensionMap;
+    // Shared, so that the plan stays valid while used even if the plans are cleared meanwhile
+    std::shared_ptr<const ParserPlan> parserPlan(const ObjectType& type) const;
+    std::shared_ptr<const ParserPlan> findParserPlan(const ObjectType& type) const;
+    void clearParserPlans();
 
-    bool load();
+    void buildDispatchTables();
+    void collectTemplates(TemplateTable& templates) const;
+    void collectParsers(HandlerTable& handlers) const;
+    void collectFunctions(HandlerTable& handlers) const;
+    void collectExtensions(ExtensionTable& extensions) const;
+    void collectSpecifications(SpecificationTable& specifications) const;
 
-    ObjectType specifyLocally(const ObjectType& parent) const;
-    void addParsers(Object& data, const ObjectType &type, const Module& fromModule, const ObjectType &lastType = ObjectType()) const;
-    void addParsersRecursive(Object& object, const ObjectType &type, const Module& fromModule, const ObjectType &lastType) const;
+    static ObjectType specify(const Specifications& specifications, const ObjectType& parent);
+    void addParsers(Object& data, const ObjectType &type, const ObjectType &lastType = ObjectType()) const;
+    void addParsersRecursive(Object& object, const ObjectType &type, const ObjectType &lastType) const;
 
-    Object* handle(const ObjectType& type, File& file, Object *parent, VariableCollector& collector, const Module& fromModule) const;
+    Object* handle(const ObjectType& type, File& file, Object *parent, VariableCollector& collector) const;
+    void handleAgain(Object& object, const ObjectType& type) const;
 
     Variable executeFunction(const std::string& name, const Variable &params, const Module& fromModule) const;
 
     bool _loaded;
 
     std::list<const Module*> _importedModules;
+    // Importing this module, to be rebuilt when it changes
+    mutable std::list<Module*> _dependentModules;
 
     ExtensionMap _extensions;
 
@@ -292,6 +374,31 @@ private:
 
     std::unordered_map<std::string, const ObjectTypeTemplate*> _templates;
     std::list<std::unique_ptr<ObjectTypeTemplate> > _ownedTemplates;
+
+    // Only used once the module is loaded
+    TemplateTable _templateTable;
+    HandlerTable _parserTable;
+    HandlerTable _functionTable;
+    ExtensionTable _extensionTable;
+    SpecificationTable _specificationTable;
+
+    // Guards the plans of this module only, each module having its own.
+    // The plans are dropped when the object model changes, and the least recently used when there are too many
+    mutable std::mutex _parserPlansMutex;
+    // Held while a plan is worked out, so that each is worked out once.
+    // Recursive, as working out a plan may need others
+    mutable std::recursive_mutex _parserPlanBuildMutex;
+    struct IdenticalTypes
+    {
+        bool operator()(const ObjectType& a, const ObjectType& b) const
+        {
+            return a.isIdentical(b);
+        }
+    };
+    typedef std::list<std::pair<ObjectType, std::shared_ptr<const ParserPlan> > > ParserPlanList;
+    // Most recently used first
+    mutable ParserPlanList _parserPlanOrder;
+    mutable std::unordered_map<ObjectType, ParserPlanList::iterator, std::hash<ObjectType>, IdenticalTypes> _parserPlans;
 };
 
 #endif // MODULE_H
@@ -23,6 +23,7 @@
 #include "core/interpreter/programloader.h"
 #include "core/modules/default/defaultmodule.h"
 #include "core/modules/hmc/hmcmodule.h"
+#include "core/util/bitutil.h"
 #include "core/util/fileutil.h"
 #include "core/util/strutil.h"
 
@@ -119,7 +120,46 @@ void ModuleLoader::refreshDirectories(const ProgramLoader &programLoader)
     for(const auto& entry: selected)
     {
         addModule(entry.first, new FromFileModule(programLoader.fromFile(entry.second)));
+        sourcePaths[entry.first] = entry.second;
     }
 }
 
+uint64_t ModuleLoader::fingerprint(const Module &module) const
+{
+    uint64_t hash = hashBytes(nullptr, 0);
+    for(const auto& entry : modules)
+    {
+        if(entry.second.get() != &module)
+            continue;
+
+        hash = hashBytes(entry.first.data(), entry.first.size(), hash);
+        auto it = sourcePaths.find(entry.first);
+        if(it != sourcePaths.end())
+        {
+            for(const char* extension : {".hm", ".hmc"})
+            {
+                const uint64_t digest = fileDigest(it->second + extension);
+                hash = hashBytes(&digest, sizeof(digest), hash);
+            }
+        }
+    }
+
+    for(const Module* importedModule : module._importedModules)
+    {
+        const uint64_t importedHash = fingerprint(*importedModule);
+        hash = hashBytes(&importedHash, sizeof(importedHash), hash);
+    }
+    return hash;
+}
+
+bool ModuleLoader::syncbyte(const Module &module, uint8_t &syncbyte, int &packetLength) const
+{
+    for(const auto& entry : modules)
+    {
+        if(entry.second.get() == &module)
+            return formatDetector.syncbyteDetector().syncbyte(entry.first, syncbyte, packetLength);
+    }
+    return false;
+}
+
 
@@ -19,6 +19,7 @@
 #define MODULELOADER_H
 
 #include <map>
+#include <stdint.h>
 #include <string>
 #include <functional>
 #include <memory>
@@ -82,8 +83,26 @@ public:
      */
     const Module& getModule(File &file) const;
 
+    /**
+     * @brief Hash identifying a module and the ones it imports, along with the content of
+     * the HMDL files they are generated from
+     *
+     * The hash changes whenever the files are modified, which invalidates the
+     * \link ParseIndex parse indices\endlink of the files parsed with the module.
+     */
+    uint64_t fingerprint(const Module& module) const;
+
+    /**
+     * @brief Get the syncbyte and packet length the module registered for its format, if any
+     *
+     * Returns false if the module does not detect its format by a syncbyte.
+     */
+    bool syncbyte(const Module& module, uint8_t& syncbyte, int& packetLength) const;
+
 private:
     std::unordered_map<std::string, std::shared_ptr<Module> > modules;
+    // Paths of the HMDL files without extension, by module key
+    std::unordered_map<std::string, std::string> sourcePaths;
 
     StandardFormatDetector formatDetector;
 
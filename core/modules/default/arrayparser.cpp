@@ -34,6 +34,10 @@ void ArrayParser::doParseHead()
 
 void ArrayParser::doParse()
 {
+    if (addVirtualElems()) {
+        return;
+    }
+
     while(availableSize())
     {
         addElem();
@@ -42,6 +46,10 @@ void ArrayParser::doParse()
 
 bool ArrayParser::doParseSome(int hint)
 {
+    if (addVirtualElems()) {
+        return true;
+    }
+
     for(int count = 0; count < hint; ++count)
     {
         if(availableSize()<=0)
@@ -37,3 +37,29 @@ int64_t ElementaryContainerParser::getElemFixedSize() const
 {
     return module().getFixedSize(elementType);
 }
+
+bool ElementaryContainerParser::addVirtualElems(int64_t count)
+{
+    const int64_t elemSize = getElemFixedSize();
+    if (elemSize <= 0 || object().numberOfChildren() != 0) {
+        return false;
+    }
+
+    if (count == -1) {
+        const int64_t available = availableSize();
+        if (object().size() == -1 || available <= 0 || available % elemSize != 0) {
+            return false;
+        }
+        count = available / elemSize;
+    }
+
+    // Elements out of the file are left to be added one by one, which reports them
+    const int64_t end = object().beginningPos() + object().pos() + count * elemSize;
+    if (count <= 0 || !object().file().reaches(end)) {
+        return false;
+    }
+
+    addVirtualChildren(elementType, elemSize, count,
+                       hasFixedName ? std::vector<std::string>(1, fixedName) : nameParts);
+    return true;
+}
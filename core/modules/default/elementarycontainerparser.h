@@ -15,6 +15,13 @@ protected:
     Object* addElem();
     int64_t getElemFixedSize() const;
 
+    /**
+     * @brief Add count elements, or as many as fill the object if count is -1, as
+     * virtual children if they have a fixed size
+     * @return false if the elements must be added one by one
+     */
+    bool addVirtualElems(int64_t count = -1);
+
 private:
     ObjectType elementType;
     bool hasFixedName;
@@ -25,7 +25,11 @@ FileParser::FileParser(Object &object) : SimpleParser(object)
 
 void FileParser::doParseHead()
 {
-    int64_t size = object().file().size();
-    object().setSize(size);
+    // Files made of fragments import all of them to know their size
+    if (object().file().hasKnownSize()) {
+        object().setSize(object().file().size());
+    } else {
+        object().setSizeFromFile();
+    }
     object().attributes(true)->addNamed("path")->setValue(object().file().path());
 }
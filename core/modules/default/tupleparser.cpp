@@ -34,6 +34,9 @@ void TupleParser::doParseHead()
         if(t > 0)
         {
             object().setSize(count*t);
+            if (addVirtualElems(count)) {
+                setParsed();
+            }
         }
         else
         {
@@ -0,0 +1,101 @@
+#include <algorithm>
+
+#include "core/modules/stream/pidindex.h"
+#include "core/object.h"
+
+// Size in bits of a packet after the sync byte
+#define PACKET_TAIL_SIZE (8*187)
+
+PidIndex::PidIndex(Object &root) : _root(root), _indexedCount(0)
+{
+}
+
+int PidIndex::nextPacket(int pid, int previousRank, bool unitStartOnly)
+{
+    const std::vector<int>& ranks = unitStartOnly ? _unitStartRanks[pid] : _ranks[pid];
+    while(true) {
+        auto it = std::upper_bound(ranks.begin(), ranks.end(), previousRank);
+        if(it != ranks.end()) {
+            return *it;
+        }
+        if(!indexSome()) {
+            return -1;
+        }
+    }
+}
+
+bool PidIndex::indexSome()
+{
+    if(_indexedCount >= _root.numberOfChildren()) {
+        _root.exploreSome(128);
+        if(_indexedCount >= _root.numberOfChildren())
+            return false;
+    }
+
+    for(; _indexedCount < _root.numberOfChildren(); ++_indexedCount) {
+        indexPacket(**(_root.begin() + _indexedCount));
+    }
+    return true;
+}
+
+const PidIndex::Payload &PidIndex::payload(int rank) const
+{
+    return _payloads[rank];
+}
+
+void PidIndex::indexPacket(Object &packet)
+{
+    _payloads.push_back(Payload{0, 0});
+    Payload& payload = _payloads.back();
+
+    int pid;
+    bool unitStart;
+    if(packet.size() >= PACKET_TAIL_SIZE + 8) {
+        // The header follows the sync byte, which ends PACKET_TAIL_SIZE bits
+        // before the end of the packet
+        uint8_t header[5];
+        const int64_t end = static_cast<int64_t>(packet.beginningPos()) + packet.size();
+        const int64_t position = end - PACKET_TAIL_SIZE - 8;
+        if(!packet.file().readAt(position, reinterpret_cast<char*>(header), 40)) {
+            return;
+        }
+        // Not a transport packet where expected
+        if(header[0] != 0x47) {
+            return;
+        }
+        unitStart = header[1] & 0x40;
+        pid = ((header[1] & 0x1f) << 8) | header[2];
+
+        const int adaptationFieldControl = (header[3] >> 4) & 0x3;
+        int64_t payloadPosition = position + 32;
+        if(adaptationFieldControl & 0x2) {
+            payloadPosition += 8*(header[4] + 1);
+        }
+        if((adaptationFieldControl & 0x1) && payloadPosition < end) {
+            payload.position = payloadPosition;
+            payload.size = end - payloadPosition;
+        }
+    } else {
+        static const Atom pidName("PID");
+        static const Atom unitStartName("payload_unit_start_indicator");
+        static const Atom payloadName("payload");
+        Object* pidObject = packet.lookUp(pidName, true);
+        Object* unitStartObject = packet.lookUp(unitStartName, true);
+        if(pidObject == nullptr || unitStartObject == nullptr) {
+            return;
+        }
+        pid = pidObject->value().toInteger();
+        unitStart = unitStartObject->value().toInteger() == 1;
+
+        Object* payloadObject = packet.lookUp(payloadName, true);
+        if(payloadObject != nullptr) {
+            payload.position = payloadObject->beginningPos();
+            payload.size = payloadObject->size();
+        }
+    }
+
+    _ranks[pid].push_back(_indexedCount);
+    if(unitStart) {
+        _unitStartRanks[pid].push_back(_indexedCount);
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef PID_INDEX_H
+#define PID_INDEX_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class Object;
+
+/** @brief Ranks and payloads of the packets of a transport stream, by PID
+ *
+ * The packets are indexed in a single pass as the root object is explored.
+ * Their PID, payload_unit_start_indicator and the position of their payload
+ * are read straight from the file rather than by parsing them, and every
+ * stream demultiplexed from the file shares the same index, which is cached on
+ * the root object.
+ *
+ * The index is used by the thread parsing the root.
+ */
+class PidIndex
+{
+public:
+    /** @brief Bits of a packet following its header and adaptation field*/
+    struct Payload
+    {
+        int64_t position;
+        // 0 if the packet carries no payload
+        int64_t size;
+    };
+
+    PidIndex(Object& root);
+
+    /**
+     * @brief Rank of the first packet with the PID after previousRank
+     *
+     * Explores the root as needed.
+     * @param unitStartOnly only consider packets with the
+     * payload_unit_start_indicator set
+     * @return -1 if there is no such packet
+     */
+    int nextPacket(int pid, int previousRank, bool unitStartOnly = false);
+
+    /** @brief Payload of a packet whose rank was given by nextPacket*/
+    const Payload& payload(int rank) const;
+
+private:
+    // Explores and indexes more packets, returns false if there is none left
+    bool indexSome();
+    void indexPacket(Object& packet);
+
+    Object& _root;
+    int _indexedCount;
+    std::unordered_map<int, std::vector<int> > _ranks;
+    std::unordered_map<int, std::vector<int> > _unitStartRanks;
+    // By rank
+    std::vector<Payload> _payloads;
+};
+
+#endif // PID_INDEX_H
@@ -13,7 +13,8 @@ FragmentedFile* StreamModule::getFragmentedFile(Object& object)
         const Variant *streamTypeAttribute = attributes->getNamed("_stream_type");
 
         if (streamTypeAttribute) {
-            const std::string& streamType = streamTypeAttribute->toString();
+            std::string buffer;
+            const std::string& streamType = streamTypeAttribute->toString(buffer);
             if (!streamType.compare("psi")) {
                 return new PsiFragmentedFile(&object);
             } else if (!streamType.compare("es")) {
@@ -31,7 +32,8 @@ std::string StreamModule::getFragmentedModule(Object& object)
         const Variant *streamTypeAttribute = attributes->getNamed("_stream_type");
 
         if (streamTypeAttribute) {
-            const std::string& streamType = streamTypeAttribute->toString();
+            std::string buffer;
+            const std::string& streamType = streamTypeAttribute->toString(buffer);
             if (!streamType.compare("psi")) {
                 return "psi_table";
             } else if (!streamType.compare("es")) {
@@ -52,3 +54,9 @@ bool StreamModule::doLoad()
     setFixedSize("ParentPID", 0);
     return true;
 }
+
+bool StreamModule::doIsThreadSafe() const
+{
+    // Streams are parsed from files made of fragments of other objects
+    return false;
+}
@@ -14,6 +14,7 @@ public:
     static std::string getFragmentedModule(Object &object);
 protected:
     bool doLoad() override;
+    bool doIsThreadSafe() const override;
 };
 
 
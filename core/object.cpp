@@ -16,22 +16,86 @@
 //Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include <algorithm>
+#include <condition_variable>
+#include <mutex>
 #include <stdexcept>
 
 #include "core/object.h"
+#include "core/exploration.h"
 #include "core/parser.h"
 #include "core/log/logmanager.h"
+#include "core/modules/stream/pidindex.h"
 #include "core/modules/stream/streammodule.h"
 #include "core/variable/objectcontext.h"
 #include "core/variable/objectattributes.h"
 #include "core/variable/objectscope.h"
 #include "core/variable/typescope.h"
+#include "core/variable/variablecollector.h"
+#include "core/parseindex.h"
+#include "core/virtualchildren.h"
+#include "core/util/osutil.h"
 
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_APPLE)
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
 
-#define BUFFER_SIZE 1048576
+// Slots shared by the objects for the threads waiting for one of them
+#define WAIT_SLOT_COUNT 64
+
+namespace {
+/**
+ * @brief Where threads wait for an object to be released by the others, shared
+ * by the objects rather than held by each of them
+ */
+struct WaitSlot
+{
+    WaitSlot() : waiterCount(0) {}
+
+    std::mutex mutex;
+    std::condition_variable released;
+    // Threads waiting, so that releasing an object nobody waits for takes no lock
+    std::atomic<int> waiterCount;
+};
+
+WaitSlot& waitSlot(const Object* object)
+{
+    static WaitSlot slots[WAIT_SLOT_COUNT];
+    return slots[(reinterpret_cast<uintptr_t>(object) >> 4) % WAIT_SLOT_COUNT];
+}
+
+void notifyWaiters(const Object* object)
+{
+    WaitSlot& slot = waitSlot(object);
+    if (slot.waiterCount > 0) {
+        // Taking the lock orders the notification after the waiters' checks
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        slot.released.notify_all();
+    }
+}
+
+template<typename Predicate>
+void waitFor(const Object* object, Predicate predicate)
+{
+    if (predicate()) {
+        return;
+    }
+    WaitSlot& slot = waitSlot(object);
+    std::unique_lock<std::mutex> lock(slot.mutex);
+    ++slot.waiterCount;
+    slot.released.wait(lock, predicate);
+    --slot.waiterCount;
+}
+
+Atom anonymousName()
+{
+    static const Atom name("*");
+    return name;
+}
+}
 
 Object::Object(File& file, std::streampos beginningPos, Object *parent, VariableCollector &collector) :
-    _file(file),
+    _file(&file),
     _beginningPos(beginningPos),
     _size(-1),
     _contentSize(0),
@@ -39,12 +103,24 @@ Object::Object(File& file, std::streampos beginningPos, Object *parent, Variable
     _parent(parent),
     _lastChild(nullptr),
     _rank(parent ? parent->numberOfChildren() : -1),
-    _name("*"),
+    _name(anonymousName()),
     _value(Variant::null()),
-    _children(0),
+    _readerCount(0),
+    _compacting(false),
+    _memoryBudget(parent ? parent->_memoryBudget : nullptr),
+    _tracked(false),
+    _module(nullptr),
+    _handledType(0),
+    _evicted(false),
+    _busyCount(0),
+    _indexNode(-1),
     _expandOnAddition(false),
+    _sizeFromFile(false),
     _parsedCount(0),
-    _parsingInProgress(false),
+    _parsingThread(std::thread::id()),
+    _handedOut(false),
+    _pinCount(0),
+    _scope(nullptr),
     _context(nullptr),
     _attributes(nullptr),
     _valid(true),
@@ -53,80 +129,153 @@ Object::Object(File& file, std::streampos beginningPos, Object *parent, Variable
 {
 }
 
+Object::~Object()
+{
+    for (Object* child : _children) {
+        delete child;
+    }
+    if (_scope.load() != nullptr) {
+        _collector.synchronize([this] {
+            ObjectScope* scope = _scope.load();
+            if (scope != nullptr) {
+                scope->detach();
+            }
+        });
+    }
+    if (_tracked) {
+        _memoryBudget->objects.erase(_recentUse);
+    }
+}
+
+void *Object::operator new(size_t size)
+{
+    return Arena::allocateIn(Arena::current(), size);
+}
+
+void Object::operator delete(void *pointer)
+{
+    Arena::deallocate(pointer);
+}
+
+const Arena *Object::arena() const
+{
+    return _arena.get();
+}
+
+void Object::setMemoryBudget(int64_t size)
+{
+    Object& rootObject = root();
+    if (!rootObject._ownMemoryBudget) {
+        rootObject._ownMemoryBudget.reset(new MemoryBudget);
+        rootObject._ownMemoryBudget->arena = rootObject._arena.get();
+        rootObject._ownMemoryBudget->evictionCount = 0;
+        rootObject._memoryBudget = rootObject._ownMemoryBudget.get();
+        if (!rootObject._leafDictionary) {
+            rootObject._leafDictionary.reset(new LeafDictionary);
+        }
+    }
+    rootObject._memoryBudget->size = size;
+    rootObject.enforceMemoryBudget();
+}
+
+int64_t Object::memoryBudget() const
+{
+    const MemoryBudget* budget = root()._ownMemoryBudget.get();
+    return budget ? budget->size : -1;
+}
+
+int64_t Object::evictionCount() const
+{
+    const MemoryBudget* budget = root()._ownMemoryBudget.get();
+    return budget ? budget->evictionCount : 0;
+}
+
 
 Object::iterator Object::begin()
 {
-    return _children.begin();
+    makeResident();
+    return iterator(this, 0);
 }
 
 Object::iterator Object::end()
 {
-    return _children.end();
+    return iterator(this, numberOfChildren());
 }
 
 Object::iterator Object::last()
 {
-    if(_children.begin() != _children.end())
+    const int count = numberOfChildren();
+    if(count > 0)
     {
-        Object::iterator it = _children.end();
-        --it;
-        return  it;
+        return iterator(this, count - 1);
     }
     else
-        return _children.end();
+        return end();
 }
 
 Object::const_iterator Object::begin() const
 {
-    return _children.begin();
+    makeResident();
+    return const_iterator(this, 0);
 }
 
 Object::const_iterator Object::end() const
 {
-    return _children.end();
+    return const_iterator(this, numberOfChildren());
 }
 
 Object::const_iterator Object::last() const
 {
-    if(_children.begin() != _children.end()) {
-        Object::const_iterator it = _children.end();
-        --it;
-        return  it;
+    const int count = numberOfChildren();
+    if(count > 0) {
+        return const_iterator(this, count - 1);
     } else {
-        return _children.end();
+        return end();
     }
 }
 
 Object::reverse_iterator Object::rbegin()
 {
-    return _children.rbegin();
+    return reverse_iterator(end());
 }
 
 Object::reverse_iterator Object::rend()
 {
-    return _children.rend();
+    return reverse_iterator(begin());
 }
 
 Object::const_reverse_iterator Object::rbegin() const
 {
-    return _children.rbegin();
+    return const_reverse_iterator(end());
 }
 
 Object::const_reverse_iterator Object::rend() const
 {
-    return _children.rend();
+    return const_reverse_iterator(begin());
 }
 
 int Object::numberOfChildren() const
 {
+    makeResident();
+    if (_virtualChildren) {
+        return _virtualChildren->count();
+    }
     return _children.size();
 }
 
+int64_t Object::publishedChildCount() const
+{
+    return static_cast<int64_t>(_children.size());
+}
+
 Object *Object::access(int64_t index, bool forceParse)
 {
-    if(index >=0 && index < numberOfChildren()) {
-        return _children[index];
-    } else if(forceParse && !parsed()) {
+    while (index < 0 || index >= numberOfChildren()) {
+        if (!forceParse || parsed()) {
+            Log::error("Requested variable not in range");
+            return nullptr;
+        }
+
         int64_t pos = file().tellg();
         int n = numberOfChildren();
         exploreSome(128);
@@ -136,44 +285,82 @@ Object *Object::access(int64_t index, bool forceParse)
             return nullptr;
         }
         file().seekg(pos, std::ios_base::beg);
-        return access(index, true);
-    } else {
-        Log::error("Requested variable not in range");
-        return nullptr;
     }
+    return child(index);
 }
 
 Object* Object::lookUp(const std::string &name, bool forceParse)
 {
-    auto it = _lookUpTable.find(name);
-    if (it != _lookUpTable.end()) {
+    makeResident();
+    if (_virtualChildren) {
+        const int64_t index = _virtualChildren->elementIndex(name);
+        return index != -1 ? child(index) : nullptr;
+    }
 
-        return it->second;
+    // A name never interned is not the name of any child yet
+    Atom atom;
+    while (!Atom::find(name, atom)) {
+        if (!forceParse || !exploreForLookUp(name)) {
+            return nullptr;
+        }
+    }
+    return lookUp(atom, forceParse);
+}
 
-    } else if (forceParse && !parsed()) {
+Object* Object::lookUp(Atom name, bool forceParse)
+{
+    makeResident();
+    if (_virtualChildren) {
+        const int64_t index = _virtualChildren->elementIndex(name.str());
+        return index != -1 ? child(index) : nullptr;
+    }
 
-        int64_t pos = file().tellg();
-        int n = numberOfChildren();
-        exploreSome(128);
-        if(n == numberOfChildren())
-        {
-            Log::error("Parsing locked for look up ", name);
+    const int64_t* rank;
+    while ((rank = _lookUpTable.find(name)) == nullptr) {
+        if (!forceParse || !exploreForLookUp(name.str())) {
             return nullptr;
         }
-        file().seekg(pos, std::ios_base::beg);
-        return lookUp(name, true);
+    }
+    return child(*rank);
+}
 
-    } else {
+bool Object::exploreForLookUp(const std::string &name)
+{
+    if (parsed()) {
+        return false;
+    }
 
-        return nullptr;
+    int64_t pos = file().tellg();
+    int n = numberOfChildren();
+    exploreSome(128);
+    if(n == numberOfChildren())
+    {
+        Log::error("Parsing locked for look up ", name);
+        return false;
     }
+    file().seekg(pos, std::ios_base::beg);
+    return true;
 }
 
 Object* Object::lookForType(const ObjectType &targetType, bool forceParse)
 {
-    for (Object::iterator it = begin(); it != end(); ++it) {
-        if ((*it)->type().extendsDirectly(targetType)) {
-            return *it;
+    makeResident();
+    if (_virtualChildren) {
+        for (int64_t rank = 0; rank < _virtualChildren->count(); ++rank) {
+            Object* element = child(rank);
+            if (element->type().extendsDirectly(targetType)) {
+                return element;
+            }
+        }
+        return nullptr;
+    }
+
+    const LeafDictionary* dictionary = root()._leafDictionary.get();
+    for (size_t rank = 0; rank < _children.size(); ++rank) {
+        const ObjectType& childType = _children[rank] ? _children[rank]->type()
+                                                      : dictionary->type(_leaves.typeIndex(rank));
+        if (childType.extendsDirectly(targetType)) {
+            return child(rank);
         }
     }
 
@@ -187,35 +374,88 @@ Object* Object::lookForType(const ObjectType &targetType, bool forceParse)
     }
 }
 
-void Object::dump(std::ostream &out) const
+Object *Object::childAtPosition(int64_t bitPos, bool forceParse)
 {
-    // make sure it is not packetised ?
-    std::ifstream in  (file().path(), std::ios::in | std::ios::binary);
+    for (int hint = 16; true; hint *= 2) {
+        const int64_t count = numberOfChildren();
 
-    if (size() == -1) {
-        return;
+        // First child beginning past the position
+        int64_t low = 0;
+        int64_t high = count;
+        while (low < high) {
+            const int64_t middle = low + (high - low) / 2;
+            if (childBeginningPos(middle) <= bitPos) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+
+        if (low > 0) {
+            const int64_t rank = low - 1;
+            const std::streamoff size = childSize(rank);
+            if (size != -1 && bitPos < childBeginningPos(rank) + size) {
+                return child(rank);
+            }
+        }
+
+        if (low < count || !forceParse || parsed() || (_size != -1 && !includesPos(bitPos))) {
+            return nullptr;
+        }
+
+        int64_t pos = file().tellg();
+        exploreSome(hint);
+        file().seekg(pos, std::ios_base::beg);
+        if (numberOfChildren() == count && !parsed()) {
+            Log::error("Parsing locked for position ", bitPos);
+            return nullptr;
+        }
     }
+}
 
-    size_t done = 0;
-    size_t n = size()/8;
+Object *Object::descendantAtPosition(int64_t bitPos, bool forceParse)
+{
+    if (_size != -1 && !includesPos(bitPos)) {
+        return nullptr;
+    }
 
-    in.seekg(beginningPos()/8);
+    Object* descendant = this;
+    for (Object* child = childAtPosition(bitPos, forceParse);
+         child != nullptr;
+         child = child->childAtPosition(bitPos, forceParse)) {
+        descendant = child;
+    }
+    return descendant;
+}
 
-    char buffer[BUFFER_SIZE];
-    //Copy file part by chunks
-    while(done < n) {
-        size_t chunkSize = std::min<size_t>(n - done, BUFFER_SIZE);
-        in.read(buffer, chunkSize);
+void Object::dump(std::ostream &out) const
+{
+    if (size() != -1) {
+        _file->copyTo(beginningPos(), size()/8, out);
+    }
+}
 
-        out.write(buffer, chunkSize);
-        done += chunkSize;
+void Object::dump(int descriptor) const
+{
+    if (size() != -1) {
+        _file->copyTo(beginningPos(), size()/8, descriptor);
     }
 }
 
 void Object::dumpToFile(const std::string &path) const
 {
+#if defined(PLATFORM_WIN32)
     std::ofstream out (path, std::ios::out | std::ios::binary);
     dump(out);
+#else
+    const int descriptor = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (descriptor == -1) {
+        Log::error("Cannot open ", path, " for writing");
+        return;
+    }
+    dump(descriptor);
+    ::close(descriptor);
+#endif
 }
 
 bool Object::hasStream() const
@@ -230,25 +470,59 @@ bool Object::hasStream() const
 
 void Object::dumpStream(std::ostream &out)
 {
-    FragmentedFile* file = StreamModule::getFragmentedFile(*this);
+    std::unique_ptr<FragmentedFile> file(StreamModule::getFragmentedFile(*this));
     if(file) {
         file->dump(out);
     }
 }
 
+void Object::dumpStream(int descriptor)
+{
+    std::unique_ptr<FragmentedFile> file(StreamModule::getFragmentedFile(*this));
+    if(file) {
+        file->dump(descriptor);
+    }
+}
+
 void Object::dumpStreamToFile(const std::string &path)
 {
+#if defined(PLATFORM_WIN32)
     std::ofstream out (path, std::ios::out | std::ios::binary);
     dumpStream(out);
+#else
+    const int descriptor = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (descriptor == -1) {
+        Log::error("Cannot open ", path, " for writing");
+        return;
+    }
+    dumpStream(descriptor);
+    ::close(descriptor);
+#endif
 }
 
-const Variable &Object::variable()
+PidIndex &Object::pidIndex()
 {
-    if (!_variable.isDefined()) {
-        _variable = Variable((VariableImplementation *) new ObjectScope(*this), true);
+    // Created once, by the first thread to get the parsing lock
+    Parsing parsing(*this);
+    if (!_pidIndex) {
+        _pidIndex.reset(new PidIndex(*this));
     }
+    return *_pidIndex;
+}
 
-    return _variable;
+Variable Object::variable()
+{
+    // The scope is only kept by the variables referring to it, and revived once collected
+    Variable variable;
+    _collector.synchronize([this, &variable] {
+        ObjectScope* scope = _scope.load();
+        if (scope == nullptr) {
+            scope = new ObjectScope(*this);
+            _scope = scope;
+        }
+        variable = Variable(scope, true);
+    });
+    return variable;
 }
 
 const Variable &Object::contextVariable(bool createIfNeeded)
@@ -292,7 +566,7 @@ void Object::invalidate()
 
 void Object::seekBeginning()
 {
-    _file.seekg(_beginningPos,std::ios::beg);
+    _file->seekg(_beginningPos,std::ios::beg);
 }
 
 void Object::seekEnd()
@@ -303,12 +577,12 @@ void Object::seekEnd()
     } else {
         newPos = _beginningPos;
     }
-    _file.seekg(_beginningPos, std::ios::beg);
+    _file->seekg(_beginningPos, std::ios::beg);
 }
 
 void Object::seekObjectEnd(std::streamoff offset)
 {
-    _file.seekg(_beginningPos+static_cast<std::streamoff>(_pos)+offset, std::ios::beg);
+    _file->seekg(_beginningPos+static_cast<std::streamoff>(_pos)+offset, std::ios::beg);
 }
 
 std::streamoff Object::pos() const
@@ -331,7 +605,7 @@ void Object::setPos(std::streamoff pos)
                 Log::warning("Trying to set a position ", pos," outside of the bounds of the object");
             }
         } else {
-            if (_beginningPos + pos <= file().size()) {
+            if (file().reaches(_beginningPos + pos)) {
                 _pos = pos;
             } else {
                 Log::warning("Trying to set a position ", _beginningPos + pos," outside of the bounds of the file");
@@ -453,48 +727,410 @@ void Object::parseTail()
             parser.reset();
         }
     }
+
+    if (_valid) {
+        compactLeaves();
+        trackMemory();
+    }
 }
 
-Object::Endianness Object::endianness() const
+Object *Object::child(int64_t rank) const
 {
-    return _endianness;
+    makeResident();
+    useRecently();
+    if (_virtualChildren) {
+        Object* element = _virtualChildren->element(rank);
+        if (element == nullptr) {
+            element = buildVirtualChild(rank);
+            _virtualChildren->setElement(rank, element);
+            _virtualChildren->freeElements([element](const Object& other) {
+                return &other != element && !other.isReferenced() && !other.holdsState() && other.isIdle();
+            });
+        }
+        element->_handedOut = true;
+        return element;
+    }
+    return publishedChild(rank);
 }
 
-void Object::setEndianness(const Object::Endianness &endianness)
+Object *Object::publishedChild(int64_t rank) const
 {
-    _endianness = endianness;
+    // Handed out before compaction can look at it
+    ++_readerCount;
+    Object* child = _compacting ? nullptr : _children[rank];
+    if (child != nullptr) {
+        child->_handedOut = true;
+    }
+    if (--_readerCount == 0 && _compacting) {
+        notifyWaiters(this);
+    }
+    if (child != nullptr) {
+        return child;
+    }
+
+    // Expanded by one thread, once the compaction is over
+    Parsing parsing(const_cast<Object&>(*this));
+    child = _children[rank];
+    if (child == nullptr) {
+        child = expandLeaf(rank);
+        _children.set(rank, child);
+    }
+    child->_handedOut = true;
+    return child;
 }
 
+Object *Object::expandLeaf(int64_t rank) const
+{
+    const Object& rootObject = root();
+    Arena::Scope scope(rootObject._arena.get());
 
-void Object::explore(int depth)
+    const int64_t size = _leaves.size(rank);
+    Object* leaf = new Object(*_file, _leaves.beginningPos(rank), const_cast<Object*>(this), _collector);
+    leaf->_size = size;
+    leaf->_contentSize = size;
+    leaf->_pos = size;
+    leaf->_rank = rank;
+    leaf->_type = rootObject._leafDictionary->type(_leaves.typeIndex(rank));
+    leaf->_name = _leaves.name(rank);
+    leaf->_value = _leaves.takeValue(rank);
+    return leaf;
+}
+
+Object *Object::buildVirtualChild(int64_t rank) const
+{
+    Object& object = const_cast<Object&>(*this);
+    FileAnchor anchor(*object._file);
+
+    // Elements are handled as if they had just been parsed
+    const std::streamoff pos = _pos;
+    Object* const lastChild = _lastChild;
+    object._pos = _virtualChildren->elementPos(rank);
+    object.seekObjectEnd();
+    ++object._busyCount;
+    Object* element = _virtualChildren->module().handle(_virtualChildren->elementType(), object);
+    --object._busyCount;
+    object._pos = pos;
+    object._lastChild = lastChild;
+
+    if (element->_size == -1) {
+        element->_size = _virtualChildren->elementSize();
+    }
+    element->_rank = rank;
+    element->setName(_virtualChildren->elementName(rank));
+    return element;
+}
+
+std::streamoff Object::childBeginningPos(int64_t rank) const
+{
+    if (_virtualChildren) {
+        return _beginningPos + _virtualChildren->elementPos(rank);
+    } else if (_children[rank]) {
+        return _children[rank]->_beginningPos;
+    } else {
+        return _leaves.beginningPos(rank);
+    }
+}
+
+std::streamoff Object::childSize(int64_t rank) const
 {
-    if(depth == 0) {
+    if (_virtualChildren) {
+        return _virtualChildren->elementSize();
+    } else if (_children[rank]) {
+        return _children[rank]->_size;
+    } else {
+        return _leaves.size(rank);
+    }
+}
+
+void Object::materializeVirtualChildren()
+{
+    const int64_t count = _virtualChildren->count();
+    _children.reserve(count);
+    for (int64_t rank = 0; rank < count; ++rank) {
+        Object* element = _virtualChildren->element(rank);
+        if (element == nullptr) {
+            element = buildVirtualChild(rank);
+        }
+        _children.push_back(element);
+        if (!element->nameAtom().empty()) {
+            _lookUpTable.set(element->nameAtom(), rank);
+        }
+    }
+    _virtualChildren->releaseElements();
+    _virtualChildren.reset();
+}
+
+bool Object::isCompactLeaf() const
+{
+    return !_handedOut
+        && _pinCount == 0
+        && _valid
+        && _children.empty()
+        && _size != -1
+        && _parent
+        && _endianness == _parent->_endianness
+        && _context == nullptr
+        && _attributes == nullptr
+        && _linkTo.isValueless()
+        && !_pidIndex
+        && _type.name() == _type.typeTemplate().name()
+        && std::all_of(_parsers.begin(), _parsers.end(), [](const std::unique_ptr<Parser>& parser) {
+               return !parser || parser->tailParsed();
+           });
+}
+
+void Object::compactLeaves()
+{
+    Parsing parsing(*this);
+    // The children being handed out are pinned first
+    _compacting = true;
+    waitFor(this, [this] {
+        return _readerCount == 0;
+    });
+
+    int64_t firstRank = -1;
+    int64_t lastRank = -1;
+    for (size_t rank = 0; rank < _children.size(); ++rank) {
+        Object* child = _children[rank];
+        if (child && child->isCompactLeaf()) {
+            if (firstRank == -1) {
+                firstRank = rank;
+            }
+            lastRank = rank;
+        }
+    }
+    if (firstRank == -1) {
+        _compacting = false;
         return;
     }
 
-    if (!parsed()) {
-        if (!file().good()) {
-            _file.clear();
-            std::cerr<<"clearing file"<<std::endl;
+    Object& rootObject = root();
+    if (!rootObject._leafDictionary) {
+        rootObject._leafDictionary.reset(new LeafDictionary);
+    }
+    LeafDictionary& dictionary = *rootObject._leafDictionary;
+
+    _leaves.reserve(firstRank, lastRank);
+    for (int64_t rank = firstRank; rank <= lastRank; ++rank) {
+        Object* child = _children[rank];
+        if (child && child->isCompactLeaf()) {
+            _leaves.add(rank, child->_beginningPos, child->_size,
+                        dictionary.typeIndex(child->_type), child->_name,
+                        std::move(child->_value));
+            _children.set(rank, nullptr);
+            delete child;
         }
-        seekObjectEnd();
-        parse();
+    }
+    _compacting = false;
+}
+
+void Object::useRecently() const
+{
+    if (_tracked) {
+        std::list<Object*>& objects = _memoryBudget->objects;
+        objects.splice(objects.begin(), objects, _recentUse);
+    }
+}
+
+void Object::trackMemory()
+{
+    // Roots are never evicted
+    if (_memoryBudget == nullptr || _parent == nullptr
+     || (_module == nullptr && _indexNode == -1) || _children.empty()) {
+        return;
     }
 
-    for (Object::iterator it = begin(); it != end(); ++it) {
-        if(depth == -1) {
-            (*it)->explore(-1);
+    if (_tracked) {
+        useRecently();
+    } else {
+        _memoryBudget->objects.push_front(this);
+        _recentUse = _memoryBudget->objects.begin();
+        _tracked = true;
+    }
+
+    // The object is about to be used, so it is kept this time
+    ++_busyCount;
+    enforceMemoryBudget();
+    --_busyCount;
+}
+
+void Object::enforceMemoryBudget()
+{
+    MemoryBudget* budget = _memoryBudget;
+    if (budget == nullptr || budget->size < 0) {
+        return;
+    }
+
+    std::list<Object*>& objects = budget->objects;
+    // Objects in use go back to the front, so that each one is looked at once
+    for (size_t remaining = objects.size();
+         remaining > 0 && !objects.empty() && static_cast<int64_t>(budget->arena->liveSize()) > budget->size;
+         --remaining) {
+        Object* object = objects.back();
+        const int64_t rank = object->rank();
+        const container& siblings = object->_parent->_children;
+        if (object->_busyCount > 0
+         || rank >= static_cast<int64_t>(siblings.size()) || siblings[rank] != object) {
+            object->useRecently();
+        } else if (!object->isEvictable()) {
+            objects.pop_back();
+            object->_tracked = false;
+        } else if (!object->isIdle() || object->hasReferencedChildren()) {
+            // Pins are released eventually, so the object is looked at again later
+            object->useRecently();
         } else {
-            (*it)->explore(depth-1);
+            object->evict();
+        }
+    }
+}
+
+bool Object::isEvictable() const
+{
+    if (!_valid || _size == -1 || (_module == nullptr && _indexNode == -1) || _context != nullptr || _pidIndex) {
+        return false;
+    }
+
+    // Parsing again must not depend on what the parsing of other objects may have changed
+    for (const Object* ancestor = _parent; ancestor != nullptr; ancestor = ancestor->_parent) {
+        if (ancestor->_context != nullptr) {
+            return false;
         }
     }
+
+    return std::none_of(_children.begin(), _children.end(), [](const Object* child) {
+        return child && child->holdsState();
+    });
+}
+
+bool Object::holdsState() const
+{
+    return _context != nullptr
+        || _pidIndex
+        || std::any_of(_children.begin(), _children.end(), [](const Object* child) {
+               return child && child->holdsState();
+           });
+}
+
+bool Object::hasReferencedChildren() const
+{
+    return std::any_of(_children.begin(), _children.end(), [](const Object* child) {
+        return child && child->isReferenced();
+    });
+}
+
+bool Object::isReferenced() const
+{
+    return _pinCount > 0
+        || (_virtualChildren && std::any_of(_virtualChildren->elements().begin(), _virtualChildren->elements().end(),
+                                            [](const std::pair<const int64_t, VirtualChildren::Element>& element) {
+               return element.second.object->isReferenced();
+           }))
+        || hasReferencedChildren();
+}
+
+bool Object::isIdle() const
+{
+    return _busyCount == 0
+        && _parsingThread.load() == std::thread::id()
+        && std::all_of(_parsers.begin(), _parsers.end(), [](const std::unique_ptr<Parser>& parser) {
+               return !parser || parser->tailParsed();
+           })
+        && std::all_of(_children.begin(), _children.end(), [](const Object* child) {
+               return !child || child->isIdle();
+           });
+}
+
+void Object::evict()
+{
+    for (Object* child : _children) {
+        delete child;
+    }
+    _children.clear();
+    _lookUpTable = AtomMap<int64_t>();
+    _leaves = LeafStore();
+    _lastChild = nullptr;
+    _evicted = true;
+
+    _memoryBudget->objects.erase(_recentUse);
+    _tracked = false;
+    ++_memoryBudget->evictionCount;
+}
+
+void Object::restore() const
+{
+    Object& object = const_cast<Object&>(*this);
+    object._evicted = false;
+    if (_indexNode != -1) {
+        root()._parseIndex->loadChildren(object);
+        object.trackMemory();
+        return;
+    }
+
+    ++object._busyCount;
+    {
+        FileAnchor anchor(*object._file);
+
+        // Only the children are taken from the new parsing
+        const ObjectType type = _type;
+        const Variant value = _value;
+        const std::streamoff size = _size;
+        const std::streamoff pos = _pos;
+        const Endianness endianness = _endianness;
+        ObjectAttributes* const attributes = _attributes;
+        const Variable attributesVariable = _attributesVariable;
+
+        object._attributes = nullptr;
+        object._attributesVariable = Variable();
+        object._parsers.clear();
+        object._parsedCount = 0;
+        object._contentSize = 0;
+        object._pos = 0;
+        object._endianness = _parent->_endianness;
+
+        object.seekObjectEnd();
+        _module->handleAgain(object, root()._leafDictionary->type(_handledType));
+        // Only fully parsed objects are evicted
+        object.explore(-1);
+        if (!_valid) {
+            Log::warning("Evicted object ", object, " cannot be parsed again");
+        }
+
+        object._type = type;
+        object._value = value;
+        object._size = size;
+        object._pos = pos;
+        object._endianness = endianness;
+        object._attributes = attributes;
+        object._attributesVariable = attributesVariable;
+    }
+    --object._busyCount;
+    object.trackMemory();
+}
+
+Object::Endianness Object::endianness() const
+{
+    return _endianness;
+}
+
+void Object::setEndianness(const Object::Endianness &endianness)
+{
+    _endianness = endianness;
+}
+
+
+void Object::explore(int depth)
+{
+    Exploration exploration(*this, depth);
+    exploration.setParseWhenStalled(true);
+    exploration.run();
 }
 
 bool Object::exploreSome(int hint)
 {
+    makeResident();
     if(!parsed()) {
         if(!file().good()) {
-            _file.clear();
+            _file->clear();
             std::cerr<<"clearing file"<<std::endl;
         }
         seekObjectEnd();
@@ -536,24 +1172,34 @@ void Object::setType(const ObjectType &type)
     }
 }
 
-const std::string &Object::name() const
+std::string Object::name() const
+{
+    return _name.str();
+}
+
+Atom Object::nameAtom() const
 {
     return _name;
 }
 
 void Object::setName(const std::string &name)
+{
+    _name = Atom(name);
+}
+
+void Object::setName(Atom name)
 {
     _name = name;
 }
 
 File &Object::file()
 {
-    return _file;
+    return *_file;
 }
 
 const File &Object::file() const
 {
-    return _file;
+    return *_file;
 }
 
 std::streampos Object::beginningPos() const
@@ -563,18 +1209,46 @@ std::streampos Object::beginningPos() const
 
 std::streamoff Object::size() const
 {
+    if (_sizeFromFile.load(std::memory_order_acquire)) {
+        // Left unknown rather than reading the whole file to know it
+        return _file->hasKnownSize() ? _file->knownSize() : -1;
+    }
+    return _size;
+}
+
+std::streamoff Object::fullSize()
+{
+    if (_sizeFromFile.load(std::memory_order_acquire)) {
+        _size = _file->size();
+        _sizeFromFile.store(false, std::memory_order_release);
+    }
     return _size;
 }
 
+std::streamoff Object::remainingSize() const
+{
+    if (_sizeFromFile.load(std::memory_order_acquire) && !_file->hasKnownSize()) {
+        const int64_t position = _beginningPos + _pos;
+        return _file->reaches(position + 1) ? _file->knownSize() - position : 0;
+    }
+    return size() - _pos;
+}
+
 void Object::setSize(std::streamoff size)
 {
     if (size >= 0) {
         _size = size;
+        _sizeFromFile.store(false, std::memory_order_release);
     } else {
         Log::warning("Trying to set a negative value for a size");
     }
 }
 
+void Object::setSizeFromFile()
+{
+    _sizeFromFile.store(true, std::memory_order_release);
+}
+
 bool Object::isSetToExpandOnAddition() const
 {
     return _expandOnAddition;
@@ -650,7 +1324,8 @@ std::ostream &Object::displayTree(std::ostream &out, std::string prefix) const
     {
         for(Object::const_iterator it = begin(); it != end(); ++it)
         {
-            (*it)->displayTree(out, prefix+"    ");
+            Pin child(*it);
+            child.get()->displayTree(out, prefix+"    ");
         }
     }
     return out;
@@ -673,6 +1348,44 @@ bool Object::parsed()
     return true;
 }
 
+Object::Pin::Pin()
+    : _object(nullptr)
+{
+}
+
+Object::Pin::Pin(Object *object)
+    : _object(nullptr)
+{
+    reset(object);
+}
+
+Object::Pin::Pin(const Object::Pin &other)
+    : Pin(other._object)
+{
+}
+
+Object::Pin &Object::Pin::operator=(const Object::Pin &other)
+{
+    reset(other._object);
+    return *this;
+}
+
+Object::Pin::~Pin()
+{
+    reset();
+}
+
+void Object::Pin::reset(Object *object)
+{
+    if (object != nullptr) {
+        ++object->_pinCount;
+    }
+    if (_object != nullptr) {
+        --_object->_pinCount;
+    }
+    _object = object;
+}
+
 std::ostream& operator <<(std::ostream& out, const Object& object)
 {
     return object.display(out);
@@ -681,15 +1394,21 @@ std::ostream& operator <<(std::ostream& out, const Object& object)
 
 Object::Parsing::Parsing(Object &object)
     :_object(object),
-      _isAvailable(!object._parsingInProgress)
+      _isAvailable(object._parsingThread.load() != std::this_thread::get_id())
 {
-    object._parsingInProgress = true;
+    if (_isAvailable) {
+        waitFor(&object, [&object] {
+            std::thread::id none;
+            return object._parsingThread.compare_exchange_strong(none, std::this_thread::get_id());
+        });
+    }
 }
 
 Object::Parsing::~Parsing()
 {
     if (_isAvailable) {
-        _object._parsingInProgress = false;
+        _object._parsingThread = std::thread::id();
+        notifyWaiters(&_object);
     }
 }
 
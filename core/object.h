@@ -18,22 +18,37 @@
 #ifndef OBJECT_H_INCLUDED
 #define OBJECT_H_INCLUDED
 
+#include <atomic>
 #include <iostream>
+#include <iterator>
 #include <list>
 #include <vector>
 #include <map>
 #include <memory>
+#include <thread>
 #include <unordered_map>
 
+#include "core/childlist.h"
 #include "core/file/realfile.h"
+#include "core/leafstore.h"
 #include "core/objecttype.h"
+#include "core/util/arena.h"
+#include "core/util/atom.h"
 #include "core/variant.h"
 #include "core/util/strutil.h"
 #include "core/variable/variable.h"
 
 class Parser;
+class Module;
+class Exploration;
 class ObjectContext;
 class ObjectAttributes;
+class ObjectScope;
+class ParallelExplorer;
+class PartitionedExplorer;
+class ParseIndex;
+class PidIndex;
+class VirtualChildren;
 
 /** @brief Node of the tree structure associated with a \link File file\endlink
  *
@@ -48,6 +63,30 @@ class ObjectAttributes;
  * It is part of a tree structure, it can threfore have a \link parent() parent\endlink and be subdivided
  * into children. The children can be access through iteration of the object or by using access functions.
  * It can also have a \link value() value\endlink.
+ *
+ * Once the object is parsed, the children that are plain leaves are kept in a \link LeafStore
+ * compact form\endlink, and expanded back into objects when they are accessed. Runs of
+ * elements of a fixed size can also be \link VirtualChildren virtual\endlink, and only
+ * built when accessed.
+ *
+ * The memory held by a tree can be bounded by a \link setMemoryBudget() budget\endlink,
+ * in which case the children of the least recently used parsed objects are freed, and
+ * parsed again when they are accessed. The objects held across explorations must then
+ * be \link Pin pinned\endlink.
+ *
+ * A tree can also be built from a \link ParseIndex parse index\endlink, in which case
+ * the children of an object are only read from the index when it is accessed.
+ *
+ * While one thread explores a tree, other threads can read the part already built
+ * through the \link publishedChild() children published\endlink in the child lists,
+ * and the beginning position, size, name and rank of these children, which are set
+ * before they are published. Anything else, such as the values of an object still
+ * being parsed, iteration, \link access() access\endlink or \link lookUp() look ups\endlink,
+ * must wait until the tree is explored: virtual children in particular are built when
+ * accessed, through the file the exploration reads. Reading a tree while it is
+ * explored is not supported either when it has a \link setMemoryBudget() memory
+ * budget\endlink or is built from a \link ParseIndex parse index\endlink. Only one
+ * thread may explore a tree at a time, or \link ParallelExplorer disjoint subtrees\endlink of it.
  */
 class Object
 {
@@ -57,19 +96,86 @@ class Object
             littleEndian = 1
         };
 
-        typedef std::vector<Object*> container;
-        typedef container::iterator iterator;
-        typedef container::const_iterator const_iterator;
-        typedef container::reverse_iterator reverse_iterator;
-        typedef container::const_reverse_iterator const_reverse_iterator;
+        typedef ChildList container;
+
+        /**
+         * @brief Random access iterator over the children, expanding the
+         * compact leaves it reaches into full objects
+         */
+        class ChildIterator
+        {
+        public:
+            typedef std::random_access_iterator_tag iterator_category;
+            typedef Object* value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef Object* const* pointer;
+            typedef Object* reference;
+
+            ChildIterator() : _object(nullptr), _rank(0) {}
+            ChildIterator(const Object* object, int64_t rank) : _object(object), _rank(rank) {}
+
+            Object* operator*() const {return _object->child(_rank);}
+            Object* operator[](difference_type n) const {return _object->child(_rank + n);}
+
+            ChildIterator& operator++() {++_rank; return *this;}
+            ChildIterator operator++(int) {ChildIterator dup(*this); ++_rank; return dup;}
+            ChildIterator& operator--() {--_rank; return *this;}
+            ChildIterator operator--(int) {ChildIterator dup(*this); --_rank; return dup;}
+            ChildIterator& operator+=(difference_type n) {_rank += n; return *this;}
+            ChildIterator& operator-=(difference_type n) {_rank -= n; return *this;}
+            ChildIterator operator+(difference_type n) const {return ChildIterator(_object, _rank + n);}
+            ChildIterator operator-(difference_type n) const {return ChildIterator(_object, _rank - n);}
+            difference_type operator-(const ChildIterator& other) const {return _rank - other._rank;}
+
+            bool operator==(const ChildIterator& other) const {return _rank == other._rank && _object == other._object;}
+            bool operator!=(const ChildIterator& other) const {return !(*this == other);}
+            bool operator<(const ChildIterator& other) const {return _rank < other._rank;}
+            bool operator>(const ChildIterator& other) const {return _rank > other._rank;}
+            bool operator<=(const ChildIterator& other) const {return _rank <= other._rank;}
+            bool operator>=(const ChildIterator& other) const {return _rank >= other._rank;}
+
+        private:
+            const Object* _object;
+            int64_t _rank;
+        };
+
+        typedef ChildIterator iterator;
+        typedef ChildIterator const_iterator;
+        typedef std::reverse_iterator<iterator> reverse_iterator;
+        typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
 
         typedef std::unordered_map<std::string, Variable> contextContainer;
         typedef contextContainer::iterator contextIterator;
         typedef contextContainer::const_iterator const_contextIterator;
 
+        /**
+         * @brief Reference keeping an object in memory, with its ancestors
+         *
+         * Objects whose descendants are pinned are not evicted. Other pointers to the
+         * objects of such a tree only stay valid until the tree is explored further, and
+         * pointers to the elements of \link VirtualChildren virtual children\endlink until
+         * many other elements are accessed.
+         */
+        class Pin
+        {
+        public:
+            Pin();
+            explicit Pin(Object* object);
+            Pin(const Pin& other);
+            Pin& operator=(const Pin& other);
+            ~Pin();
+
+            Object* get() const {return _object;}
+            void reset(Object* object = nullptr);
+
+        private:
+            Object* _object;
+        };
+
         friend class Parsing;
         /**
-         * @brief RAII object used to lock parsing to avoid reentrency
+         * @brief RAII object used to lock parsing, waiting for the other threads parsing
+         * the object, and unavailable when the thread is already parsing it, to avoid reentrency
          */
         class Parsing
         {
@@ -82,6 +188,36 @@ class Object
             bool _isAvailable;
         };
 
+        ~Object();
+
+        /** @brief Objects are allocated in the current \link Arena arena\endlink,
+         * that of the tree they belong to when created by a \link Module module\endlink*/
+        static void* operator new(size_t size);
+        static void operator delete(void* pointer);
+
+        /** @brief Arena holding the objects and parsers of the tree, set on root objects*/
+        const Arena* arena() const;
+
+        /**
+         * @brief Bound the memory held by the tree, in bytes
+         *
+         * Whenever the \link arena() arena\endlink of the tree holds more, the least recently
+         * used objects which are fully parsed, have a known size and whose descendants are
+         * not \link Pin pinned\endlink are evicted: their children are freed, and parsed again through
+         * the \link Module module\endlink that created them, or read again from the \link ParseIndex index\endlink
+         * they were built from, when they are accessed. Only objects created after the
+         * budget is set can be evicted. A negative budget lifts the bound.
+         *
+         * The size bound is that of the blocks of the arena, that is the objects, their
+         * parsers and their compact leaves. What they hold on the heap, such as long
+         * strings, child lists, name tables and virtual children, is not counted.
+         */
+        void setMemoryBudget(int64_t size);
+        int64_t memoryBudget() const;
+
+        /** @brief Number of objects of the tree evicted since the budget was set*/
+        int64_t evictionCount() const;
+
         /** @brief Access the file associated. */
         File& file();
 
@@ -97,6 +233,27 @@ class Object
          */
         std::streamoff size() const;
         void setSize(std::streamoff size);
+
+        /** @brief Access the size, reading the \link file() file\endlink through if the size is to be taken from it.
+         *
+         *  Must only be called by the thread parsing the object.
+         */
+        std::streamoff fullSize();
+
+        /** @brief Take the size of the \link file() file\endlink, left unknown until the file knows it
+         *
+         *  Used by roots whose file has to be read through to know its size.
+         */
+        void setSizeFromFile();
+
+        /** @brief Size left after the \link pos() position\endlink.
+         *
+         *  While the size is to be taken from a \link file() file\endlink that does not know it yet,
+         *  the file is read only as far as the next bit, and the size known so far is given,
+         *  which is 0 only at the end of the file.
+         */
+        std::streamoff remainingSize() const;
+
         bool isSetToExpandOnAddition() const;
         void setToExpandOnAddition();
 
@@ -126,6 +283,11 @@ class Object
 
         /**
          * @brief Use the parsers to add the children of the object
+         *
+         * The descendants are explored iteratively by an \link Exploration exploration\endlink,
+         * which can also be run directly to be cancelled, bounded or to report its progress.
+         * \link VirtualChildren Virtual children\endlink are not built by the exploration: only
+         * the elements already accessed are explored, the others are parsed when accessed.
          * @param depth is the recursive depth of the exploration. If it is set to -1 the exploration won't stop until all is explored.
          */
         void explore(int depth = 1);
@@ -160,8 +322,10 @@ class Object
         /**
          * @brief Name
          */
-        const std::string &name() const;
+        std::string name() const;
+        Atom nameAtom() const;
         void setName(const std::string& name);
+        void setName(Atom name);
 
         /**
          * @brief Value of the object set during parsing
@@ -222,6 +386,17 @@ class Object
          */
         int numberOfChildren() const;
 
+        /**
+         * @brief Number of children published in the child list, which other threads
+         * can read while the object is parsed
+         *
+         * Virtual children are not published until they are all built.
+         */
+        int64_t publishedChildCount() const;
+
+        /** @brief Child published at a rank lower than the count read before, expanded if compact*/
+        Object* publishedChild(int64_t rank) const;
+
         /**
          * @brief Iterator pointing to the beginning of the children container
          */
@@ -260,6 +435,7 @@ class Object
          * name is found or the parsing is done.
          */
         Object* lookUp(const std::string& name, bool forceParse = false);
+        Object* lookUp(Atom name, bool forceParse = false);
 
         /**
          * @brief Access a child by its type
@@ -270,18 +446,55 @@ class Object
          */
         Object* lookForType(const ObjectType& type, bool forceParse = false);
 
+        /**
+         * @brief Access the child including a file position, in bits
+         *
+         * The children being ordered by position, they are binary searched. If the position
+         * lies past the children parsed, the parsing is not done and forceParse is set then the
+         * object will be parsed by growing batches until the position is reached or the parsing
+         * is done. Returns nullptr if no child includes the position.
+         */
+        Object* childAtPosition(int64_t bitPos, bool forceParse = false);
+
+        /**
+         * @brief Access the deepest descendant including a file position, in bits
+         *
+         * Returns the object itself if none of its children includes the position, and nullptr
+         * if the object does not include it either.
+         */
+        Object* descendantAtPosition(int64_t bitPos, bool forceParse = false);
+
+        /**
+         * @brief Write the bytes of the object
+         *
+         * Writing to a file descriptor lets the \link File file\endlink copy
+         * them without going through user space when it can.
+         */
         void dump(std::ostream &outStream) const;
+        void dump(int descriptor) const;
 
         void dumpToFile(const std::string& path) const;
 
         bool hasStream() const;
 
         void dumpStream(std::ostream &outStream);
+        void dumpStream(int descriptor);
 
         void dumpStreamToFile(const std::string& path);
 
+        /**
+         * @brief Index of the transport stream packets among the children,
+         * built as they are explored and shared by the streams of the object
+         */
+        PidIndex& pidIndex();
+
 
-        const Variable& variable();
+        /**
+         * @brief Variable of the object for the scripts
+         *
+         * The object is pinned while the collector keeps the variable.
+         */
+        Variable variable();
         const Variable& contextVariable(bool createIfNeeded = false);
         const Variable& attributesVariable(bool createIfNeeded = false);
 
@@ -302,6 +515,11 @@ class Object
     private:
         friend class Module;
         friend class ContainerParser;
+        friend class Exploration;
+        friend class ParseIndex;
+        friend class ParallelExplorer;
+        friend class PartitionedExplorer;
+        friend class ObjectScope;
 
         Object(File& file, std::streampos beginningPos, Object* parent, VariableCollector& collector);
 
@@ -310,9 +528,52 @@ class Object
         bool parseSome(int hint);
         void parseTail();
 
-        File& _file;
+        Object* child(int64_t rank) const;
+        // Parses more children for a look up, returns false if none could be
+        bool exploreForLookUp(const std::string& name);
+        Object* expandLeaf(int64_t rank) const;
+        Object* buildVirtualChild(int64_t rank) const;
+        std::streamoff childBeginningPos(int64_t rank) const;
+        std::streamoff childSize(int64_t rank) const;
+        void materializeVirtualChildren();
+        bool isCompactLeaf() const;
+        void compactLeaves();
+
+        struct MemoryBudget
+        {
+            const Arena* arena;
+            int64_t size;
+            int64_t evictionCount;
+            // Most recently used first
+            std::list<Object*> objects;
+        };
+
+        inline void makeResident() const {
+            if (_evicted) {
+                restore();
+            }
+        }
+        void useRecently() const;
+        void trackMemory();
+        void enforceMemoryBudget();
+        // Whether the object can ever be evicted
+        bool isEvictable() const;
+        // Whether the subtree holds a context or an index, kept for the lifetime of the tree
+        bool holdsState() const;
+        // Whether the subtree, virtual elements included, is pinned
+        bool isReferenced() const;
+        bool hasReferencedChildren() const;
+        bool isIdle() const;
+        void evict();
+        void restore() const;
+
+        // Declared first, so that it is destroyed after everything it holds
+        ArenaOwner _arena;
+
+        // Set to a file of their own for the subtrees explored in parallel
+        File* _file;
         std::streampos _beginningPos;
-        std::streamoff _size;
+        mutable std::streamoff _size;
         std::streamoff _contentSize;
         std::streamoff _pos;
 
@@ -321,21 +582,59 @@ class Object
         Variant _rank;
 
         ObjectType _type;
-        std::string _name;
+        Atom _name;
         Variant _value;
         Variant _linkTo;
 
-        container _children;
-        std::vector<std::unique_ptr<Object> > _ownedChildren;
-        std::unordered_map<std::string, Object*> _lookUpTable;
+        // Compact leaves are null until expanded
+        mutable container _children;
+        // Threads reading a child, that compaction waits for
+        mutable std::atomic<int> _readerCount;
+        // Set while the children are compacted, for the readers to wait
+        std::atomic<bool> _compacting;
+        AtomMap<int64_t> _lookUpTable;
+        mutable LeafStore _leaves;
+        // Set on root objects
+        std::unique_ptr<LeafDictionary> _leafDictionary;
+        // Set instead of the children for runs of fixed size elements
+        std::unique_ptr<VirtualChildren> _virtualChildren;
+
+        std::vector<std::unique_ptr<Parser>, ArenaAllocator<std::unique_ptr<Parser> > > _parsers;
+
+        std::unique_ptr<PidIndex> _pidIndex;
+
+        // Set on root objects, and shared with the objects created afterwards
+        std::unique_ptr<MemoryBudget> _ownMemoryBudget;
+        MemoryBudget* _memoryBudget;
+        mutable std::list<Object*>::iterator _recentUse;
+        bool _tracked;
+        // Module and type in the dictionary of the tree the object was created with
+        const Module* _module;
+        uint32_t _handledType;
+        bool _evicted;
+        // Set while the children are iterated over or parsed again
+        int _busyCount;
+
+        // Set on root objects built from an index
+        std::unique_ptr<ParseIndex> _parseIndex;
+        // Node of the index the children are read from, -1 if parsed
+        int64_t _indexNode;
 
-        std::vector<std::unique_ptr<Parser> > _parsers;
         bool _expandOnAddition;
+        // Set while the size is the one of the file, still to be read
+        std::atomic<bool> _sizeFromFile;
 
         size_t _parsedCount;
-        bool _parsingInProgress;
+        // Thread holding the parsing lock, none if not parsed
+        std::atomic<std::thread::id> _parsingThread;
+
+        // Set once handed out, an object cannot be compacted anymore
+        mutable std::atomic<bool> _handedOut;
+        // Pins held on the object, which keep its ancestors from being evicted
+        mutable std::atomic<int> _pinCount;
 
-        Variable _variable;
+        // Scope of the variable, owned by the collector which resets it when it destroys it
+        std::atomic<ObjectScope*> _scope;
 
         ObjectContext* _context;
         Variable _contextVariable;
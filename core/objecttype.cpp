@@ -15,90 +15,395 @@
 //along with this program; if not, write to the Free Software
 //Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <unordered_map>
+
 #include "core/objecttype.h"
 #include "core/objecttypetemplate.h"
+#include "core/varianthash.h"
 
 #include "core/log/logmanager.h"
 
 Variant undefinedVariant;
 Variant nullVariant = Variant::null();
 
-ObjectType::ObjectType() : _typeTemplate(&nullTypeTemplate)
+namespace {
+const int attributeCount = 5;
+const size_t shardCount = 16;
+std::atomic<size_t> liveNodeCount(0);
+}
+
+struct ObjectType::Key
 {
+    Key() : typeTemplate(nullptr), canonical(false) {}
+
+    const ObjectTypeTemplate* typeTemplate;
+    std::vector<Variant> parametersValue;
+    // Set explicitly
+    Variant name;
+    Variant elementType;
+    Variant elementCount;
+    // Holds only the parameters of the template, compared by value
+    bool canonical;
+
+    bool hasAttributes() const
+    {
+        return !name.isValueless() || !elementType.isValueless() || !elementCount.isValueless();
+    }
+
+    /**
+     * @brief Key of the values of the parameters of the template, to which the
+     * types compare equal
+     */
+    Key canonicalKey() const
+    {
+        Key key;
+        key.typeTemplate = typeTemplate;
+        key.canonical = true;
+        const size_t count = typeTemplate->numberOfParameters();
+        key.parametersValue.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            key.parametersValue.push_back(i < parametersValue.size() ? parametersValue[i] : undefinedVariant);
+        }
+        return key;
+    }
+
+    size_t hash() const
+    {
+        size_t result = std::hash<const ObjectTypeTemplate*>()(typeTemplate);
+        for (const Variant& value : parametersValue) {
+            result = result * 31 + (canonical ? valueHash(value) : std::hash<Variant>()(value));
+        }
+        return result * 2 + (canonical ? 1 : 0);
+    }
+
+    friend bool operator==(const Key& a, const Key& b)
+    {
+        if (a.typeTemplate != b.typeTemplate
+         || a.canonical != b.canonical
+         || a.parametersValue.size() != b.parametersValue.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.parametersValue.size(); ++i) {
+            if (a.canonical ? a.parametersValue[i] != b.parametersValue[i]
+                            : !sameValue(a.parametersValue[i], b.parametersValue[i])) {
+                return false;
+            }
+        }
+        return sameValue(a.name, b.name)
+            && sameValue(a.elementType, b.elementType)
+            && sameValue(a.elementCount, b.elementCount);
+    }
+
+    // Values equal but of different types or displays are kept apart, as they are displayed differently
+    static bool sameValue(const Variant& a, const Variant& b)
+    {
+        return a.type() == b.type() && a.displayType() == b.displayType() && a == b;
+    }
+
+    // Equal for the numbers equal whatever their types, as they compare equal
+    static size_t valueHash(const Variant& value)
+    {
+        if (!value.hasNumericalType()) {
+            return std::hash<Variant>()(value);
+        }
+        if (value.type() == Variant::floatingType) {
+            const double floating = value.toDouble();
+            if (std::trunc(floating) != floating || std::fabs(floating) >= 9.2e18) {
+                return std::hash<double>()(floating);
+            }
+        }
+        return std::hash<long long>()(value.toInteger());
+    }
+};
+
+struct ObjectType::Node : public ObjectType::Key
+{
+    Node(Key&& key, size_t hash, const Node* base)
+        : Key(std::move(key)),
+          hash(hash),
+          base(base ? base : this),
+          referenceCount(1),
+          permanent(false),
+          interned(true)
+    {
+        for (std::atomic<bool>& generated : attributeGenerated) {
+            generated = false;
+        }
+        ++liveNodeCount;
+    }
+
+    ~Node()
+    {
+        --liveNodeCount;
+    }
+
+    const size_t hash;
+    // Canonical node of the values of the parameters, to which the node compares equal,
+    // referenced by the node unless it is the node itself
+    const Node* const base;
+
+    // Types and nodes referring to the node, which goes from 1 to 0 only under the lock of its shard
+    mutable std::atomic<long> referenceCount;
+    // Not counted, as it is referred to by every type until it is set to another
+    mutable std::atomic<bool> permanent;
+    // Found in the table, until its template is forgotten; guarded by the lock of its shard
+    mutable bool interned;
+
+    // Generated by the template once, and kept
+    mutable std::mutex mutex;
+    mutable std::atomic<bool> attributeGenerated[attributeCount];
+    mutable Variant generatedAttributes[attributeCount];
+};
+
+/**
+ * @brief Set of the nodes of the types, split in shards locked separately
+ *
+ * The nodes are counted references to, and freed once no type or other node refers
+ * to them: one canonical node for each template and values of its parameters, plus
+ * one for each other combination of parameter types, displays and attributes set,
+ * which refers to its canonical node.
+ */
+class ObjectType::Table
+{
+public:
+    static Table& instance()
+    {
+        // Never destroyed, as types can be destroyed after it otherwise
+        static Table* table = new Table;
+        return *table;
+    }
+
+    /** @brief Node of the key, with a reference taken for the caller*/
+    const Node* intern(Key&& key)
+    {
+        key.canonical = false;
+        const Node* base = internCanonical(key.canonicalKey());
+        // Shares the canonical node when it holds exactly the same values
+        if (!key.hasAttributes() && key.parametersValue.size() == base->parametersValue.size()) {
+            bool same = true;
+            for (size_t i = 0; same && i < key.parametersValue.size(); ++i) {
+                same = Key::sameValue(key.parametersValue[i], base->parametersValue[i]);
+            }
+            if (same) {
+                return base;
+            }
+        }
+        return find(std::move(key), base);
+    }
+
+    const Node* internCanonical(Key&& key)
+    {
+        return find(std::move(key), nullptr);
+    }
+
+    static void retain(const Node* node)
+    {
+        if (!node->permanent.load(std::memory_order_relaxed)) {
+            node->referenceCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void release(const Node* node)
+    {
+        if (node->permanent.load(std::memory_order_relaxed)) {
+            return;
+        }
+        long count = node->referenceCount.load(std::memory_order_relaxed);
+        while (count > 1) {
+            if (node->referenceCount.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel)) {
+                return;
+            }
+        }
+
+        // The last reference may be taken again by find meanwhile, under the lock
+        {
+            Shard& shard = _shards[node->hash % shardCount];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (node->referenceCount.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                return;
+            }
+            if (node->interned) {
+                auto range = shard.nodes.equal_range(node->hash);
+                for (auto it = range.first; it != range.second; ++it) {
+                    if (it->second == node) {
+                        shard.nodes.erase(it);
+                        break;
+                    }
+                }
+            }
+        }
+
+        // Freed without the lock, as its values can hold other types
+        const Node* base = node->base;
+        delete node;
+        if (base != node) {
+            release(base);
+        }
+    }
+
+    void forgetTemplate(const ObjectTypeTemplate& typeTemplate)
+    {
+        for (Shard& shard : _shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (auto it = shard.nodes.begin(); it != shard.nodes.end();) {
+                if (it->second->typeTemplate == &typeTemplate) {
+                    // Freed when the types left, if any, are
+                    it->second->interned = false;
+                    it = shard.nodes.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+
+private:
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_multimap<size_t, const Node*> nodes;
+    };
+
+    // Takes over the reference to the base if the node is created, and releases it otherwise
+    const Node* find(Key&& key, const Node* base)
+    {
+        const size_t hash = key.hash();
+        const Node* found = nullptr;
+        {
+            Shard& shard = _shards[hash % shardCount];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto range = shard.nodes.equal_range(hash);
+            for (auto it = range.first; it != range.second && found == nullptr; ++it) {
+                if (*it->second == key) {
+                    found = it->second;
+                    retain(found);
+                }
+            }
+            if (found == nullptr) {
+                const Node* node = new Node(std::move(key), hash, base);
+                shard.nodes.insert(std::make_pair(hash, node));
+                return node;
+            }
+        }
+
+        // Released without the lock, as the base can be in the same shard
+        if (base != nullptr) {
+            release(base);
+        }
+        return found;
+    }
+
+    Shard _shards[shardCount];
+};
+
+ObjectType::ObjectType() : _node(nullNode())
+{
+}
+
+ObjectType::ObjectType(const ObjectTypeTemplate& typeTemplate)
+{
+    Key key;
+    key.typeTemplate = &typeTemplate;
+    key.parametersValue.resize(typeTemplate.numberOfParameters());
+    _node = Table::instance().intern(std::move(key));
 }
 
-ObjectType::ObjectType(const ObjectTypeTemplate& _typeTemplate)
-    : _typeTemplate(&_typeTemplate),
-      _parametersValue(_typeTemplate.numberOfParameters())
+ObjectType::ObjectType(const ObjectTypeTemplate &typeTemplate, const std::vector<Variant> &parameterValues)
 {
+    Key key;
+    key.typeTemplate = &typeTemplate;
+    key.parametersValue.resize(std::max<size_t>(typeTemplate.numberOfParameters(), parameterValues.size()));
+    std::copy(parameterValues.begin(), parameterValues.end(), key.parametersValue.begin());
+    _node = Table::instance().intern(std::move(key));
+}
+
+ObjectType::ObjectType(const ObjectType &other) : _node(other._node)
+{
+    Table::retain(_node);
+}
+
+ObjectType::ObjectType(ObjectType &&other) noexcept : _node(other._node)
+{
+    other._node = nullNode();
+}
+
+ObjectType::~ObjectType()
+{
+    Table::instance().release(_node);
 }
 
 const ObjectTypeTemplate& ObjectType::typeTemplate() const
 {
-    return *_typeTemplate;
+    return *_node->typeTemplate;
 }
 
 const Variant& ObjectType::parameterValue(size_t index) const
 {
-    if (index < _parametersValue.size()) {
-        return _parametersValue[index];
+    if (index < _node->parametersValue.size()) {
+        return _node->parametersValue[index];
     } else {
         return undefinedVariant;
     }
 }
 
-Variant &ObjectType::parameterValue(size_t index)
-{
-    return _parametersValue[index];
-}
-
 bool ObjectType::parameterSpecified(size_t index) const
 {
-    return (index < _parametersValue.size()) && (!_parametersValue[index].isUndefined());
+    return (index < _node->parametersValue.size()) && (!_node->parametersValue[index].isUndefined());
 }
 
 void ObjectType::setParameter(size_t index, const Variant &value)
 {
-    while(index >= _parametersValue.size()) {
-        _parametersValue.push_back(undefinedVariant);
+    Key key(*_node);
+    if (index >= key.parametersValue.size()) {
+        key.parametersValue.resize(index + 1, undefinedVariant);
     }
+    key.parametersValue[index].setValue(value);
+    setNode(Table::instance().intern(std::move(key)));
+}
 
-    _parametersValue[index].setValue(value);
+void ObjectType::setParameters(const std::vector<Variant> &values)
+{
+    if (values.empty()) {
+        return;
+    }
+    Key key(*_node);
+    if (values.size() > key.parametersValue.size()) {
+        key.parametersValue.resize(values.size(), undefinedVariant);
+    }
+    std::copy(values.begin(), values.end(), key.parametersValue.begin());
+    setNode(Table::instance().intern(std::move(key)));
 }
 
-const std::string &ObjectType::name() const
+std::string ObjectType::name() const
 {
-    if (_name.isValueless()) {
-        const ObjectTypeTemplate::Attribute attribute = ObjectTypeTemplate::Attribute::name;
-        if (typeTemplate().hasAttributeGenerator(attribute)) {
-            const Variant nameValue = typeTemplate().attributeGenerator(attribute)(*this);
-            if (!nameValue.isValueless()) {
-                return nameValue.toString();
-            }
+    if (_node->name.isValueless()) {
+        const Variant& nameValue = generatedAttribute(static_cast<int>(ObjectTypeTemplate::Attribute::name));
+        if (!nameValue.isValueless()) {
+            return nameValue.toString();
         }
 
         return typeTemplate().name();
 
     } else {
-        return _name.toString();
+        return _node->name.toString();
     }
 }
 
 void ObjectType::setName(const std::string &name)
 {
-    _name.setValue(name);
+    Key key(*_node);
+    key.name.setValue(name);
+    setNode(Table::instance().intern(std::move(key)));
 }
 
 const ObjectType &ObjectType::displayAs() const
 {
-    const ObjectTypeTemplate::Attribute attribute = ObjectTypeTemplate::Attribute::displayAs;
-    if (typeTemplate().hasAttributeGenerator(attribute)) {
-        _displayAs = typeTemplate().attributeGenerator(attribute)(*this);
-        if (!_displayAs.isValueless()) {
-            return _displayAs.toObjectType();
-        } else {
-            return *this;
-        }
+    const Variant& displayAs = generatedAttribute(static_cast<int>(ObjectTypeTemplate::Attribute::displayAs));
+    if (!displayAs.isValueless()) {
+        return displayAs.toObjectType();
     } else {
         return *this;
     }
@@ -109,13 +414,15 @@ bool ObjectType::hasDisplayMode() const
     return !vDisplayMode().isValueless();
 }
 
-const std::string &ObjectType::displayMode() const
+std::string ObjectType::displayMode() const
 {
     return vDisplayMode().toString();
 }
 
 const ObjectType& ObjectType::importParameters(const ObjectType& other)
 {
+    Key key(*_node);
+    bool imported = false;
     for(int i = 0; i < typeTemplate().numberOfParameters();++i)
     {
         if(!parameterSpecified(i))
@@ -124,18 +431,24 @@ const ObjectType& ObjectType::importParameters(const ObjectType& other)
             {
                 if(typeTemplate().parameterName(i) == other.typeTemplate().parameterName(j))
                 {
-
-                    setParameter(i, other.parameterValue(j));
+                    if (static_cast<size_t>(i) >= key.parametersValue.size()) {
+                        key.parametersValue.resize(i + 1, undefinedVariant);
+                    }
+                    key.parametersValue[i].setValue(other.parameterValue(j));
+                    imported = true;
                 }
             }
         }
     }
+    if (imported) {
+        setNode(Table::instance().intern(std::move(key)));
+    }
     return *this;
 }
 
 bool ObjectType::extendsDirectly(const ObjectType& other) const
 {
-    if(*_typeTemplate != *other._typeTemplate)
+    if(typeTemplate() != other.typeTemplate())
     {
         return false;
     }
@@ -163,7 +476,9 @@ const ObjectType &ObjectType::elementType() const
 
 void ObjectType::setElementType(const ObjectType &type)
 {
-    _elementType.setValue(type);
+    Key key(*_node);
+    key.elementType.setValue(type);
+    setNode(Table::instance().intern(std::move(key)));
 }
 
 bool ObjectType::hasElementCount() const
@@ -180,7 +495,9 @@ size_t ObjectType::elementCount() const
 void ObjectType::setElementCount(long long count)
 {
     if (count >= 0) {
-        _elementCount.setValue(count);
+        Key key(*_node);
+        key.elementCount.setValue(count);
+        setNode(Table::instance().intern(std::move(key)));
     } else {
         Log::error("Trying to set negative value for element count of type ", *this);
     }
@@ -188,17 +505,33 @@ void ObjectType::setElementCount(long long count)
 
 bool ObjectType::isNull() const
 {
-    return (*_typeTemplate == nullTypeTemplate);
+    return typeTemplate().isNull();
+}
+
+size_t ObjectType::hash() const
+{
+    return _node->base->hash;
+}
+
+bool ObjectType::isIdentical(const ObjectType &other) const
+{
+    return _node == other._node;
+}
+
+void ObjectType::forgetTemplate(const ObjectTypeTemplate &typeTemplate)
+{
+    Table::instance().forgetTemplate(typeTemplate);
+}
+
+size_t ObjectType::nodeCount()
+{
+    return liveNodeCount;
 }
 
 void swap(ObjectType& a, ObjectType& b)
 {
     using std::swap;
-    swap(a._typeTemplate,b._typeTemplate);
-    swap(a._parametersValue, b._parametersValue);
-    swap(a._elementCount, b._elementCount);
-    swap(a._name, b._name);
-
+    swap(a._node, b._node);
 }
 
 ObjectType& ObjectType::operator =(ObjectType other)
@@ -207,50 +540,69 @@ ObjectType& ObjectType::operator =(ObjectType other)
     return *this;
 }
 
+const ObjectType::Node *ObjectType::nullNode()
+{
+    // Set up without looking into the template, that may not be constructed yet
+    static const Node* const node = []() {
+        Key key;
+        key.typeTemplate = &nullTypeTemplate;
+        key.canonical = true;
+        const Node* node = Table::instance().internCanonical(std::move(key));
+        node->permanent = true;
+        return node;
+    }();
+    return node;
+}
+
+void ObjectType::setNode(const Node *node)
+{
+    Table::instance().release(_node);
+    _node = node;
+}
+
 const Variant &ObjectType::vElementType() const
 {
-    const ObjectTypeTemplate::Attribute attribute = ObjectTypeTemplate::Attribute::elementType;
-    if (_elementType.isValueless()
-            && _typeTemplate
-            && _typeTemplate->hasAttributeGenerator(attribute)) {
-        _elementType.setValue(typeTemplate().attributeGenerator(attribute)(*this));
+    if (!_node->elementType.isValueless()) {
+        return _node->elementType;
     }
-    return _elementType;
+    return generatedAttribute(static_cast<int>(ObjectTypeTemplate::Attribute::elementType));
 }
 
 const Variant &ObjectType::vElementCount() const
 {
-    const ObjectTypeTemplate::Attribute attribute = ObjectTypeTemplate::Attribute::elementCount;
-    if (_elementCount.isValueless()
-            && _typeTemplate
-            && _typeTemplate->hasAttributeGenerator(attribute)) {
-        _elementCount.setValue(typeTemplate().attributeGenerator(attribute)(*this));
+    if (!_node->elementCount.isValueless()) {
+        return _node->elementCount;
     }
-    return _elementCount;
+    return generatedAttribute(static_cast<int>(ObjectTypeTemplate::Attribute::elementCount));
 }
 
 const Variant &ObjectType::vDisplayMode() const
 {
-    const ObjectTypeTemplate::Attribute attribute = ObjectTypeTemplate::Attribute::displayMode;
-    if (_displayMode.isValueless()
-            && _typeTemplate
-            && _typeTemplate->hasAttributeGenerator(attribute)) {
-        _displayMode.setValue(typeTemplate().attributeGenerator(attribute)(*this));
-    }
-    return _displayMode;
+    return generatedAttribute(static_cast<int>(ObjectTypeTemplate::Attribute::displayMode));
 }
 
-bool operator==(const ObjectType& a, const ObjectType& b)
+const Variant &ObjectType::generatedAttribute(int attribute) const
 {
-    if(a.typeTemplate() != b.typeTemplate())
-        return false;
+    const ObjectTypeTemplate::Attribute templateAttribute = static_cast<ObjectTypeTemplate::Attribute>(attribute);
+    if (!typeTemplate().hasAttributeGenerator(templateAttribute)) {
+        return undefinedVariant;
+    }
 
-    for(int i = 0; i < a.typeTemplate().numberOfParameters();++i)
-    {
-        if(a.parameterValue(i) != b.parameterValue(i))
-            return false;
+    if (!_node->attributeGenerated[attribute].load(std::memory_order_acquire)) {
+        // Generated without the lock, as the generator can look at the other attributes
+        Variant value = typeTemplate().attributeGenerator(templateAttribute)(*this);
+        std::lock_guard<std::mutex> lock(_node->mutex);
+        if (!_node->attributeGenerated[attribute].load(std::memory_order_relaxed)) {
+            _node->generatedAttributes[attribute] = std::move(value);
+            _node->attributeGenerated[attribute].store(true, std::memory_order_release);
+        }
     }
-    return true;
+    return _node->generatedAttributes[attribute];
+}
+
+bool operator==(const ObjectType& a, const ObjectType& b)
+{
+    return a._node->base == b._node->base;
 }
 
 bool operator!=(const ObjectType& a, const ObjectType& b)
@@ -260,13 +612,19 @@ bool operator!=(const ObjectType& a, const ObjectType& b)
 
 bool operator< (const ObjectType& a, const ObjectType& b)
 {
-    if(a.typeTemplate() != b.typeTemplate())
-        return (a.typeTemplate() < b.typeTemplate());
-
-    for(int i = 0; i < a.typeTemplate().numberOfParameters();++i)
-    {
-        if(a.parameterValue(i) != b.parameterValue(i))
-            return (a.parameterValue(i) < b.parameterValue(i));
+    const ObjectType::Node& x = *a._node->base;
+    const ObjectType::Node& y = *b._node->base;
+    if (&x == &y) {
+        return false;
+    }
+    if (x.typeTemplate != y.typeTemplate) {
+        return *x.typeTemplate < *y.typeTemplate;
+    }
+    // Same template, so as many parameters
+    for (size_t i = 0; i < x.parametersValue.size(); ++i) {
+        if (x.parametersValue[i] != y.parametersValue[i]) {
+            return x.parametersValue[i] < y.parametersValue[i];
+        }
     }
     return false;
 }
@@ -320,7 +678,7 @@ std::ostream& ObjectType::simpleDisplay(std::ostream& out) const
 
 int ObjectType::numberOfParameters() const
 {
-    return _parametersValue.size();
+    return _node->parametersValue.size();
 }
 
 int ObjectType::numberOfDisplayableParameters() const
@@ -337,8 +695,3 @@ std::ostream& operator<<(std::ostream& out, const ObjectType& type)
 {
     return type.display(out);
 }
-
-
-void ObjectType::_setParameters(int first)
-{
-}
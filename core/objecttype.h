@@ -18,6 +18,7 @@
 #ifndef OBJECTTYPE_H
 #define OBJECTTYPE_H
 
+#include <cstdint>
 #include <vector>
 #include <functional>
 
@@ -35,6 +36,15 @@ class ObjectTypeTemplate;
  * and values stored as \link Variant variants\endlink specified for some of its parameters. The easiest way to construct a
  * \link ObjectType type\endlink is to use the \link ObjectTypeTemplate type template\endlink's
  * operator().
+ *
+ * Types are interned: every type with the same template and parameters shares one
+ * immutable node, with its hash computed once, so that types are copied, compared and
+ * hashed in constant time. Setting a parameter or an attribute points the type to
+ * another node. Types compare equal when their templates are the same and the values
+ * of the template's parameters are equal, whatever their types and displays, and
+ * whatever the name, element type or element count set. The attributes generated by
+ * the template are computed once per node. The nodes are freed once no type refers
+ * to them any more.
  */
 class ObjectType
 {
@@ -52,6 +62,15 @@ public:
      * set to other values subsequently.
      */
     ObjectType(const ObjectTypeTemplate& typeTemplate);
+    /**
+     * @brief Construct a \link ObjectType type\endlink with the
+     * \link ObjectTypeTemplate type template\endlink given and values for its first parameters
+     */
+    ObjectType(const ObjectTypeTemplate& typeTemplate, const std::vector<Variant>& parameterValues);
+
+    ObjectType(const ObjectType& other);
+    ObjectType(ObjectType&& other) noexcept;
+    ~ObjectType();
 
     /**
      * @brief Get the \link ObjectTypeTemplate type template\endlink the \link ObjectType type\endlink implements
@@ -64,7 +83,6 @@ public:
      * Raise an exception if out of bound
      */
     const Variant& parameterValue(size_t index) const;
-    Variant& parameterValue(size_t index);
 
     /**
      * @brief Check if a parameter is non-null
@@ -81,7 +99,7 @@ public:
     /**
      * @brief Get type name (by default @link ObjectTypeTemplate template\endlink's name)
      */
-    const std::string& name() const;
+    std::string name() const;
     void setName(const std::string& name);
 
     /**
@@ -92,7 +110,8 @@ public:
     /**
      * @brief Set a value for the first parameters
      */
-    template<typename... Args> void setParameters(Args... args){return _setParameters(0, args...);}
+    template<typename... Args> void setParameters(Args... args){return setParameters(std::vector<Variant>{Variant(args)...});}
+    void setParameters(const std::vector<Variant>& values);
 
     /**
      * @brief Set the parameters not specified (i.e. with a null value)
@@ -140,7 +159,7 @@ public:
      * @brief display mode
      */
     bool hasDisplayMode() const;
-    const std::string& displayMode() const;
+    std::string displayMode() const;
 
     /**
      * @brief Output a representation of the \link ObjectType type\endlink into a stream
@@ -160,35 +179,49 @@ public:
 
     int numberOfDisplayableParameters() const;
 
+    /**
+     * @brief Hash of the \link ObjectTypeTemplate type template\endlink and the parameters
+     */
+    size_t hash() const;
+
+    /**
+     * @brief Check if the \link ObjectType type\endlink has the same template and parameters, and
+     * also the same name, element type and element count, which equality ignores
+     */
+    bool isIdentical(const ObjectType& other) const;
+
     friend void swap(ObjectType& a, ObjectType& b);
     ObjectType& operator=(ObjectType other);
 
-    bool isVirtual() const;
-    void setVirtual(bool value);
+    friend bool operator==(const ObjectType& a, const ObjectType& b);
+    friend bool operator< (const ObjectType& a, const ObjectType& b);
+
+    /**
+     * @brief Remove the types of a \link ObjectTypeTemplate type template\endlink about to be
+     * destroyed from the types interned, so that no type is found for another template at its address
+     */
+    static void forgetTemplate(const ObjectTypeTemplate& typeTemplate);
+
+    /**
+     * @brief Number of nodes the types refer to, canonical ones included
+     */
+    static size_t nodeCount();
 
 private:
+    struct Key;
+    struct Node;
+    class Table;
+
+    static const Node* nullNode();
+    // Points to a node interned for the type, releasing the previous one
+    void setNode(const Node* node);
+
     const Variant& vElementType() const;
     const Variant& vElementCount() const;
     const Variant& vDisplayMode() const;
+    const Variant& generatedAttribute(int attribute) const;
 
-    const ObjectTypeTemplate* _typeTemplate;
-    std::vector<Variant> _parametersValue;
-    Variant _name;
-    mutable Variant _elementType;
-    mutable Variant _elementCount;
-    mutable Variant _displayMode;
-    mutable Variant _displayAs;
-
-    bool _virtual;
-
-    void _setParameters(int first);
-
-    template<typename... Args>
-    void _setParameters(int first, const Variant& v, Args... args)
-    {
-        setParameter(first, v);
-        _setParameters(first+1, args...);
-    }
+    const Node* _node;
 };
 
 bool operator==(const ObjectType& a, const ObjectType& b);
@@ -197,4 +230,15 @@ bool operator< (const ObjectType& a, const ObjectType& b);
 
 std::ostream& operator<<(std::ostream& out, const ObjectType& type);
 
+namespace std {
+    template<>
+    struct hash<ObjectType>
+    {
+        size_t operator()(const ObjectType& type) const
+        {
+            return type.hash();
+        }
+    };
+}
+
 #endif // OBJECTTYPE_H
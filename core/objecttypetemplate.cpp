@@ -22,6 +22,7 @@ const uint8_t ObjectTypeTemplate::_nameAttribute = 0x1;
 const uint8_t ObjectTypeTemplate::_elementTypeAttribute = 0x2;
 const uint8_t ObjectTypeTemplate::_elementCountAttribute = 0x4;
 
+const ObjectTypeTemplate nullTypeTemplate("");
 
 ObjectTypeTemplate::ObjectTypeTemplate(const std::string &name,
                                        const std::vector<std::string> &parameterNames,
@@ -50,6 +51,11 @@ ObjectTypeTemplate::ObjectTypeTemplate(const std::string& name)
 {
 }
 
+ObjectTypeTemplate::~ObjectTypeTemplate()
+{
+    ObjectType::forgetTemplate(*this);
+}
+
 
 const std::string& ObjectTypeTemplate::name() const
 {
@@ -54,6 +54,7 @@ public:
     ObjectTypeTemplate(const std::string &name,
                        const std::vector<std::string>& parameterNames);
     ObjectTypeTemplate(const std::string &name);
+    ~ObjectTypeTemplate();
 
     /**
      * @brief Get the name used as a unique identifiers
@@ -105,9 +106,7 @@ public:
      */
     template<typename... Args> ObjectType operator()(Args... args) const
     {
-        ObjectType type(*this);
-        type.setParameters(args...);
-        return type;
+        return ObjectType(*this, std::vector<Variant>{Variant(args)...});
     }
 
     void setAttributeGenerator(Attribute attribute, const AttributeGenerator& generator);
@@ -143,7 +142,7 @@ private:
     ObjectTypeTemplate& operator=(const ObjectTypeTemplate&) = delete;
 };
 
-const ObjectTypeTemplate nullTypeTemplate("");
+extern const ObjectTypeTemplate nullTypeTemplate;
 
 bool operator!=(const ObjectTypeTemplate& a, const ObjectTypeTemplate& b);
 bool operator<=(const ObjectTypeTemplate& a, const ObjectTypeTemplate& b);
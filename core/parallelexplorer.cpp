@@ -0,0 +1,196 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include <algorithm>
+#include <thread>
+
+#include "core/parallelexplorer.h"
+#include "core/file/file.h"
+#include "core/module.h"
+#include "core/object.h"
+#include "core/virtualchildren.h"
+
+ParallelExplorer::ParallelExplorer(int threadCount)
+    : _threadCount(threadCount > 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency())),
+      _pendingCount(0),
+      _queuedCount(0)
+{
+}
+
+ParallelExplorer::~ParallelExplorer()
+{
+}
+
+int ParallelExplorer::threadCount() const
+{
+    return _threadCount;
+}
+
+void ParallelExplorer::explore(Object &object, const Module &module)
+{
+    File& file = object.file();
+    if (_threadCount > 1 && module.isThreadSafe() && object._memoryBudget == nullptr) {
+        for (int i = 0; i < _threadCount; ++i) {
+            std::unique_ptr<Worker> worker(new Worker);
+            worker->file.reset(file.duplicate());
+            if (!worker->file || !worker->file->good()) {
+                _workers.clear();
+                break;
+            }
+            _workers.push_back(std::move(worker));
+        }
+    }
+
+    if (_workers.empty()) {
+        object.explore(-1);
+        return;
+    }
+
+    push(0, &object);
+    std::vector<std::thread> threads;
+    for (size_t index = 1; index < _workers.size(); ++index) {
+        threads.push_back(std::thread(&ParallelExplorer::run, this, index));
+    }
+    run(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    setFile(object, file);
+    _workers.clear();
+}
+
+void ParallelExplorer::run(size_t index)
+{
+    while (true) {
+        Object* object = pop(index);
+        if (object != nullptr) {
+            exploreSubtree(index, *object);
+            if (--_pendingCount == 0) {
+                notify(true);
+            }
+            continue;
+        }
+
+        // Sleeps until a subtree is pushed or every one is explored
+        std::unique_lock<std::mutex> lock(_idleMutex);
+        _idle.wait(lock, [this] {
+            return _pendingCount == 0 || _queuedCount > 0;
+        });
+        if (_pendingCount == 0) {
+            return;
+        }
+    }
+}
+
+void ParallelExplorer::push(size_t index, Object *object)
+{
+    Worker& worker = *_workers[index];
+    ++_pendingCount;
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.subtrees.push_back(object);
+    }
+    ++_queuedCount;
+    notify(false);
+}
+
+void ParallelExplorer::notify(bool all)
+{
+    // Taking the lock orders the notification after the check of a thread going idle
+    std::lock_guard<std::mutex> lock(_idleMutex);
+    if (all) {
+        _idle.notify_all();
+    } else {
+        _idle.notify_one();
+    }
+}
+
+Object *ParallelExplorer::pop(size_t index)
+{
+    // The last subtree added first, so that the thread stays in the same part of the file
+    {
+        Worker& worker = *_workers[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.subtrees.empty()) {
+            Object* object = worker.subtrees.back();
+            worker.subtrees.pop_back();
+            --_queuedCount;
+            return object;
+        }
+    }
+
+    // The first ones added by the other threads, which are likely the biggest
+    for (size_t offset = 1; offset < _workers.size(); ++offset) {
+        Worker& worker = *_workers[(index + offset) % _workers.size()];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.subtrees.empty()) {
+            Object* object = worker.subtrees.front();
+            worker.subtrees.pop_front();
+            --_queuedCount;
+            return object;
+        }
+    }
+    return nullptr;
+}
+
+void ParallelExplorer::exploreSubtree(size_t index, Object &object)
+{
+    setFile(object, *_workers[index]->file);
+    object.explore(1);
+
+    for (Object* child : object._children) {
+        if (child == nullptr) {
+            continue;
+        } else if (isIndependent(*child)) {
+            push(index, child);
+        } else {
+            child->explore(-1);
+        }
+    }
+
+    if (object._virtualChildren) {
+        for (const auto& element : object._virtualChildren->elements()) {
+            element.second.object->explore(-1);
+        }
+    }
+}
+
+bool ParallelExplorer::isIndependent(Object &object)
+{
+    return object._size != -1
+        && object._valid
+        && object._context == nullptr
+        && !object._pidIndex
+        && !object.parsed();
+}
+
+void ParallelExplorer::setFile(Object &object, File &file)
+{
+    object._file = &file;
+    for (Object* child : object._children) {
+        if (child != nullptr) {
+            setFile(*child, file);
+        }
+    }
+    if (object._virtualChildren) {
+        for (const auto& element : object._virtualChildren->elements()) {
+            setFile(*element.second.object, file);
+        }
+    }
+}
@@ -0,0 +1,92 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef PARALLELEXPLORER_H
+#define PARALLELEXPLORER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class File;
+class Module;
+class Object;
+
+/**
+ * @brief Explores a tree on several threads
+ *
+ * Once parsed, the children of an \link Object object\endlink whose size is known
+ * can be parsed independently from one another. Each of these subtrees is handed
+ * to a pool of threads, every thread reading through a \link File::duplicate handle
+ * of its own\endlink on the file and stealing work from the others when it runs out
+ * of it. The tree built is the same as the one built by Object::explore.
+ */
+class ParallelExplorer
+{
+public:
+    /**
+     * @param threadCount is the number of threads, that of the machine if 0
+     */
+    explicit ParallelExplorer(int threadCount = 0);
+    ~ParallelExplorer();
+
+    int threadCount() const;
+
+    /**
+     * @brief Explore the object fully, as Object::explore(-1) does
+     *
+     * The exploration stays on the calling thread if the \link Module module\endlink
+     * is not \link Module::isThreadSafe thread safe\endlink, the file cannot be opened
+     * again or the tree has a \link Object::setMemoryBudget memory budget\endlink.
+     */
+    void explore(Object& object, const Module& module);
+
+private:
+    struct Worker
+    {
+        std::unique_ptr<File> file;
+        std::mutex mutex;
+        std::deque<Object*> subtrees;
+    };
+
+    void run(size_t index);
+    void push(size_t index, Object* object);
+    Object* pop(size_t index);
+    void exploreSubtree(size_t index, Object& object);
+    void notify(bool all);
+
+    static bool isIndependent(Object& object);
+    static void setFile(Object& object, File& file);
+
+    int _threadCount;
+    std::vector<std::unique_ptr<Worker> > _workers;
+    // Subtrees waiting or being explored
+    std::atomic<int64_t> _pendingCount;
+    // Subtrees waiting, for idle threads to wake up
+    std::atomic<int64_t> _queuedCount;
+    std::mutex _idleMutex;
+    std::condition_variable _idle;
+
+    ParallelExplorer& operator=(const ParallelExplorer&) = delete;
+    ParallelExplorer(const ParallelExplorer&) = delete;
+};
+
+#endif // PARALLELEXPLORER_H
@@ -0,0 +1,803 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+
+#include "core/parseindex.h"
+#include "core/file/file.h"
+#include "core/leafstore.h"
+#include "core/log/logmanager.h"
+#include "core/module.h"
+#include "core/object.h"
+#include "core/objecttypetemplate.h"
+#include "core/virtualchildren.h"
+#include "core/variable/objectattributes.h"
+#include "core/util/bitutil.h"
+#include "core/util/fileutil.h"
+#include "core/util/osutil.h"
+
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_APPLE)
+    #include <sys/stat.h>
+#endif
+
+#define INDEX_MAGIC "HMIX"
+#define INDEX_VERSION 2
+#define INDEX_EXTENSION ".hmi"
+// Pages hashed to tell whether the file changed
+#define SAMPLE_COUNT 64
+#define SAMPLE_SIZE 4096
+
+struct ParseIndex::Value
+{
+    uint64_t payload;
+    uint8_t type;
+    uint8_t display;
+    uint8_t padding[6];
+};
+
+struct ParseIndex::Node
+{
+    int64_t beginningPos;
+    int64_t size;
+    uint64_t firstChild;
+    uint64_t childCount;
+    uint32_t type;
+    uint32_t name;
+    Value value;
+    uint8_t endianness;
+    uint8_t padding[3];
+    // Offset of the extra record plus one, zero if there is none
+    uint32_t extra;
+};
+
+struct ParseIndex::Header
+{
+    char magic[4];
+    uint32_t version;
+    Key key;
+    uint64_t nodeCount;
+    uint64_t typeOffset;
+    uint64_t typeSize;
+    uint64_t stringOffset;
+    uint64_t stringSize;
+    uint64_t extraOffset;
+    uint64_t extraSize;
+};
+
+namespace {
+
+// Followed by the values of the parameters
+struct TypeRecord
+{
+    uint32_t templateName;
+    uint32_t name;
+    uint32_t parameterCount;
+    uint32_t padding;
+};
+
+// Attributes and link of an object, followed by the numbered attributes and
+// the named ones
+struct ExtraRecord
+{
+    uint64_t linkTo;
+    uint32_t numberedCount;
+    uint32_t namedCount;
+    uint8_t hasLink;
+    uint8_t padding[7];
+};
+
+struct NamedRecord
+{
+    uint32_t name;
+    uint32_t padding;
+};
+
+template<typename T>
+void append(std::string& blob, const T& record)
+{
+    blob.append(reinterpret_cast<const char*>(&record), sizeof(T));
+}
+
+}
+
+class ParseIndex::Writer
+{
+public:
+    Writer(const Module& module)
+        : _module(module),
+          _typeCount(0),
+          _valid(true)
+    {
+    }
+
+    bool write(Object& root, const Key& key, const std::string& path);
+
+    std::vector<Node> nodes;
+
+private:
+    void writeNode(uint64_t index, const Object& object);
+    void writeChildren(Object& object, uint64_t index);
+    void writeValue(Value& record, const Variant& value);
+    uint32_t extra(const Object& object);
+    uint32_t type(const ObjectType& type);
+    uint32_t string(const std::string& string);
+
+    const Module& _module;
+    std::string _types;
+    std::map<ObjectType, uint32_t> _typeIndices;
+    uint32_t _typeCount;
+    std::string _strings;
+    std::unordered_map<std::string, uint32_t> _stringOffsets;
+    std::string _extras;
+    bool _valid;
+};
+
+ParseIndex::Key::Key()
+    : fileSize(-1),
+      modificationTime(-1),
+      contentHash(0),
+      moduleHash(0)
+{
+}
+
+ParseIndex::ParseIndex()
+    : _nodes(nullptr),
+      _nodeCount(0),
+      _strings(nullptr),
+      _stringSize(0),
+      _extras(nullptr),
+      _extraSize(0)
+{
+}
+
+ParseIndex::~ParseIndex()
+{
+}
+
+ParseIndex::Key ParseIndex::key(File &file, uint64_t moduleHash)
+{
+    Key key;
+    key.fileSize = file.size();
+    key.moduleHash = moduleHash;
+
+#if defined(PLATFORM_WIN32)
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (GetFileAttributesExA(file.path().c_str(), GetFileExInfoStandard, &attributes)) {
+        key.modificationTime = (static_cast<int64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32)
+                             | attributes.ftLastWriteTime.dwLowDateTime;
+    }
+#elif defined(PLATFORM_LINUX) || defined(PLATFORM_APPLE)
+    struct stat fileStat;
+    if (stat(file.path().c_str(), &fileStat) == 0) {
+        key.modificationTime = fileStat.st_mtime;
+    }
+#endif
+
+    const int64_t byteSize = key.fileSize / 8;
+    const int64_t sampleSize = std::min<int64_t>(SAMPLE_SIZE, byteSize);
+    std::vector<char> sample(sampleSize);
+    uint64_t hash = hashBytes(nullptr, 0);
+    for (int i = 0; i < SAMPLE_COUNT && sampleSize > 0; ++i) {
+        const int64_t firstByte = (byteSize - sampleSize) * i / (SAMPLE_COUNT - 1);
+        if (!file.readAt(8 * firstByte, sample.data(), 8 * sampleSize)) {
+            Log::warning("Cannot read the file to compute its index key");
+        }
+        hash = hashBytes(sample.data(), sample.size(), hash);
+    }
+    key.contentHash = hash;
+    return key;
+}
+
+std::string ParseIndex::sidecarPath(const std::string &filePath)
+{
+    return filePath + INDEX_EXTENSION;
+}
+
+bool ParseIndex::write(Object &root, const Module &module, const Key &key, const std::string &path)
+{
+    Writer writer(module);
+    return writer.write(root, key, path);
+}
+
+Object *ParseIndex::load(const std::string &path, const Key &key, const Module &module, File &file, VariableCollector &collector)
+{
+    std::unique_ptr<ParseIndex> index(new ParseIndex);
+    if (!index->open(path, key, module)) {
+        return nullptr;
+    }
+
+    Object* root;
+    {
+        // The root owns the arena of the tree, so it cannot live in it
+        Arena::Scope scope(nullptr);
+        root = new Object(file, index->node(0).beginningPos, nullptr, collector);
+        root->_arena.reset(new Arena);
+    }
+
+    Arena::Scope scope(root->_arena.get());
+    root->_leafDictionary.reset(new LeafDictionary);
+    for (const ObjectType& type : index->_types) {
+        index->_dictionaryIndices.push_back(root->_leafDictionary->typeIndex(type));
+    }
+    index->setUp(*root, index->node(0));
+    root->_indexNode = 0;
+    root->_evicted = true;
+    root->_parseIndex = std::move(index);
+    return root;
+}
+
+bool ParseIndex::open(const std::string &path, const Key &key, const Module &module)
+{
+    if (!fileExists(path)) {
+        return false;
+    }
+
+    _mapping.setPath(path);
+    const uint64_t byteSize = _mapping.size() / 8;
+    if (!_mapping.good() || byteSize < sizeof(Header)) {
+        Log::warning("Index ", path, " cannot be read");
+        return false;
+    }
+    const char* data = _mapping.bytesInMemory(0, byteSize);
+
+    Header header;
+    std::memcpy(&header, data, sizeof(Header));
+    if (std::memcmp(header.magic, INDEX_MAGIC, 4) != 0 || header.version != INDEX_VERSION) {
+        Log::warning("Index ", path, " has an unknown format");
+        return false;
+    }
+    if (header.key.fileSize != key.fileSize
+     || header.key.modificationTime != key.modificationTime
+     || header.key.contentHash != key.contentHash
+     || header.key.moduleHash != key.moduleHash) {
+        Log::info("Index ", path, " is out of date");
+        return false;
+    }
+    // Compared by subtracting, so that the sizes read cannot overflow
+    if (header.nodeCount == 0
+     || header.nodeCount > (byteSize - sizeof(Header)) / sizeof(Node)
+     || header.typeOffset < sizeof(Header) + header.nodeCount * sizeof(Node)
+     || header.stringOffset > byteSize
+     || header.stringSize > byteSize - header.stringOffset
+     || header.typeOffset > header.stringOffset
+     || header.typeSize > header.stringOffset - header.typeOffset
+     || header.extraOffset > byteSize
+     || header.extraSize > byteSize - header.extraOffset
+     || header.stringOffset > header.extraOffset
+     || header.stringSize > header.extraOffset - header.stringOffset) {
+        Log::warning("Index ", path, " is truncated");
+        return false;
+    }
+
+    _nodes = reinterpret_cast<const Node*>(data + sizeof(Header));
+    _nodeCount = header.nodeCount;
+    _strings = data + header.stringOffset;
+    _stringSize = header.stringSize;
+    _extras = data + header.extraOffset;
+    _extraSize = header.extraSize;
+
+    if (!readTypes(data + header.typeOffset, header.typeSize, module)) {
+        Log::warning("Index ", path, " refers to types unknown to the module");
+        return false;
+    }
+    if (!checkNodes()) {
+        Log::warning("Index ", path, " is corrupted");
+        return false;
+    }
+    return true;
+}
+
+bool ParseIndex::checkNodes() const
+{
+    for (uint64_t index = 0; index < _nodeCount; ++index) {
+        const Node& node = _nodes[index];
+        if (node.type >= _types.size()
+         || !checkValue(node.value)
+         || node.endianness > Object::littleEndian
+         || (node.extra != 0 && !checkExtra(node.extra - 1))) {
+            return false;
+        }
+
+        // Children come after their parent, so that the tree has no cycle
+        if (node.childCount != 0
+         && (node.firstChild <= index
+          || node.firstChild > _nodeCount
+          || node.childCount > _nodeCount - node.firstChild)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ParseIndex::readTypes(const char *data, uint64_t size, const Module &module)
+{
+    uint64_t offset = 0;
+    while (offset + sizeof(TypeRecord) <= size) {
+        TypeRecord record;
+        std::memcpy(&record, data + offset, sizeof(TypeRecord));
+        offset += sizeof(TypeRecord);
+
+        const std::string templateName = string(record.templateName);
+        const ObjectTypeTemplate& typeTemplate = module.getTemplate(templateName);
+        if (typeTemplate.isNull() && !templateName.empty()) {
+            return false;
+        }
+
+        std::vector<Variant> parameterValues;
+        for (uint32_t i = 0; i < record.parameterCount; ++i) {
+            if (offset + sizeof(Value) > size) {
+                return false;
+            }
+            Value parameter;
+            std::memcpy(&parameter, data + offset, sizeof(Value));
+            offset += sizeof(Value);
+            if (!checkValue(parameter)) {
+                return false;
+            }
+            if (static_cast<int>(i) < typeTemplate.numberOfParameters()) {
+                parameterValues.push_back(value(parameter));
+            }
+        }
+
+        ObjectType type(typeTemplate, parameterValues);
+
+        const std::string name = string(record.name);
+        if (name != type.name()) {
+            type.setName(name);
+        }
+        _types.push_back(type);
+    }
+    return offset == size;
+}
+
+const ParseIndex::Node &ParseIndex::node(uint64_t index) const
+{
+    return _nodes[index];
+}
+
+Variant ParseIndex::value(const Value &record) const
+{
+    Variant value;
+    switch (record.type) {
+    case Variant::nullType:
+        value = Variant::null();
+        break;
+
+    case Variant::integerType:
+        value = Variant(static_cast<long long>(record.payload));
+        break;
+
+    case Variant::unsignedIntegerType:
+        value = Variant(static_cast<unsigned long long>(record.payload));
+        break;
+
+    case Variant::floatingType:
+    {
+        double floating;
+        std::memcpy(&floating, &record.payload, sizeof(double));
+        value = Variant(floating);
+        break;
+    }
+
+    case Variant::stringType:
+        value = Variant(string(record.payload));
+        break;
+
+    case Variant::objectType:
+        value = Variant(_types[record.payload]);
+        break;
+
+    default:
+        return value;
+    }
+    value.setDisplayType(static_cast<Variant::Display>(record.display));
+    return value;
+}
+
+Atom ParseIndex::name(uint32_t offset) const
+{
+    auto it = _names.find(offset);
+    if (it == _names.end()) {
+        it = _names.insert(std::make_pair(offset, Atom(string(offset)))).first;
+    }
+    return it->second;
+}
+
+std::string ParseIndex::string(uint32_t offset) const
+{
+    uint32_t length;
+    if (offset + sizeof(length) > _stringSize) {
+        return std::string();
+    }
+    std::memcpy(&length, _strings + offset, sizeof(length));
+    if (offset + sizeof(length) + length > _stringSize) {
+        return std::string();
+    }
+    return std::string(_strings + offset + sizeof(length), length);
+}
+
+void ParseIndex::loadChildren(Object &object) const
+{
+    // The nodes were checked when the index was opened
+    const Node& parent = node(object._indexNode);
+
+    Object& rootObject = object.root();
+    Arena::Scope scope(rootObject._arena.get());
+
+    int64_t firstLeaf = -1;
+    int64_t lastLeaf = -1;
+    for (uint64_t rank = 0; rank < parent.childCount; ++rank) {
+        if (isLeaf(node(parent.firstChild + rank), parent)) {
+            if (firstLeaf == -1) {
+                firstLeaf = rank;
+            }
+            lastLeaf = rank;
+        }
+    }
+    if (firstLeaf != -1) {
+        object._leaves.reserve(firstLeaf, lastLeaf);
+    }
+
+    object._children.reserve(parent.childCount);
+    for (uint64_t rank = 0; rank < parent.childCount; ++rank) {
+        const uint64_t index = parent.firstChild + rank;
+        const Node& child = node(index);
+        const Atom childName = name(child.name);
+
+        if (isLeaf(child, parent)) {
+            object._leaves.add(rank, child.beginningPos, child.size,
+                               _dictionaryIndices[child.type], childName, value(child.value));
+            object._children.push_back(nullptr);
+        } else {
+            Object* childObject = new Object(*object._file, child.beginningPos, &object, object._collector);
+            setUp(*childObject, child);
+            childObject->_indexNode = index;
+            childObject->_evicted = true;
+            object._children.push_back(childObject);
+        }
+
+        if (!childName.empty()) {
+            object._lookUpTable.set(childName, rank);
+        }
+    }
+}
+
+bool ParseIndex::checkExtra(uint64_t offset) const
+{
+    if (offset > _extraSize || sizeof(ExtraRecord) > _extraSize - offset) {
+        return false;
+    }
+    ExtraRecord record;
+    std::memcpy(&record, _extras + offset, sizeof(ExtraRecord));
+    offset += sizeof(ExtraRecord);
+
+    const uint64_t size = record.numberedCount * sizeof(Value)
+                        + record.namedCount * (sizeof(NamedRecord) + sizeof(Value));
+    if (size > _extraSize - offset) {
+        return false;
+    }
+    for (uint32_t i = 0; i < record.numberedCount + record.namedCount; ++i) {
+        if (i >= record.numberedCount) {
+            offset += sizeof(NamedRecord);
+        }
+        Value value;
+        std::memcpy(&value, _extras + offset, sizeof(Value));
+        offset += sizeof(Value);
+        if (!checkValue(value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ParseIndex::checkValue(const Value &value) const
+{
+    if (value.type == Variant::objectType && value.payload >= _types.size()) {
+        return false;
+    }
+    // The display is or-ed into the type of the variant
+    return (value.display & ~static_cast<uint8_t>(Variant::hexadecimal)) == 0;
+}
+
+void ParseIndex::readExtra(Object &object, uint64_t offset) const
+{
+    ExtraRecord record;
+    std::memcpy(&record, _extras + offset, sizeof(ExtraRecord));
+    offset += sizeof(ExtraRecord);
+
+    if (record.hasLink) {
+        object.setLinkTo(record.linkTo);
+    }
+    if (record.numberedCount == 0 && record.namedCount == 0) {
+        return;
+    }
+
+    ObjectAttributes& attributes = *object.attributes(true);
+    Value value;
+    for (uint32_t i = 0; i < record.numberedCount; ++i) {
+        std::memcpy(&value, _extras + offset, sizeof(Value));
+        offset += sizeof(Value);
+        attributes.addNumbered() = this->value(value);
+    }
+    for (uint32_t i = 0; i < record.namedCount; ++i) {
+        NamedRecord named;
+        std::memcpy(&named, _extras + offset, sizeof(NamedRecord));
+        offset += sizeof(NamedRecord);
+        std::memcpy(&value, _extras + offset, sizeof(Value));
+        offset += sizeof(Value);
+        Variant* attribute = attributes.addNamed(string(named.name));
+        if (attribute != nullptr) {
+            *attribute = this->value(value);
+        }
+    }
+}
+
+bool ParseIndex::isLeaf(const Node &node, const Node &parent) const
+{
+    // Compact leaves take the endianness of their parent, and have no attributes nor link
+    return node.childCount == 0 && node.endianness == parent.endianness && node.extra == 0;
+}
+
+void ParseIndex::setUp(Object &object, const Node &node) const
+{
+    object._size = node.size;
+    object._endianness = static_cast<Object::Endianness>(node.endianness);
+    object._contentSize = node.size == -1 ? 0 : node.size;
+    object._pos = object._contentSize;
+    object._type = _types[node.type];
+    object._name = name(node.name);
+    object._value = value(node.value);
+    if (node.extra != 0) {
+        readExtra(object, node.extra - 1);
+    }
+}
+
+bool ParseIndex::Writer::write(Object &root, const ParseIndex::Key &key, const std::string &path)
+{
+    root.explore(-1);
+
+    nodes.resize(1);
+    writeNode(0, root);
+    writeChildren(root, 0);
+    if (!_valid) {
+        return false;
+    }
+
+    ParseIndex::Header header;
+    std::memcpy(header.magic, INDEX_MAGIC, 4);
+    header.version = INDEX_VERSION;
+    header.key = key;
+    header.nodeCount = nodes.size();
+    header.typeOffset = sizeof(ParseIndex::Header) + nodes.size() * sizeof(ParseIndex::Node);
+    header.typeSize = _types.size();
+    header.stringOffset = header.typeOffset + header.typeSize;
+    header.stringSize = _strings.size();
+    header.extraOffset = header.stringOffset + header.stringSize;
+    header.extraSize = _extras.size();
+
+    // Written aside and renamed, so that an index is never read half written
+    const std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios_base::binary | std::ios_base::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(ParseIndex::Node));
+        file.write(_types.data(), _types.size());
+        file.write(_strings.data(), _strings.size());
+        file.write(_extras.data(), _extras.size());
+        file.close();
+        if (!file.good()) {
+            Log::error("Cannot write index ", path);
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+
+#if defined(PLATFORM_WIN32)
+    // Renaming does not replace an existing file
+    std::remove(path.c_str());
+#endif
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        Log::error("Cannot write index ", path);
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+void ParseIndex::Writer::writeNode(uint64_t index, const Object &object)
+{
+    ParseIndex::Node& node = nodes[index];
+    std::memset(&node, 0, sizeof(ParseIndex::Node));
+    node.beginningPos = object.beginningPos();
+    node.size = object.size();
+    node.endianness = object._endianness;
+    node.type = type(object.type());
+    node.name = string(object.name());
+    writeValue(node.value, object.value());
+    node.extra = extra(object);
+}
+
+void ParseIndex::Writer::writeChildren(Object &object, uint64_t index)
+{
+    const int64_t count = object.numberOfChildren();
+    const uint64_t firstChild = nodes.size();
+    nodes[index].firstChild = firstChild;
+    nodes[index].childCount = count;
+    nodes.resize(firstChild + count);
+
+    // Kept while its children are written
+    ++object._busyCount;
+    for (int64_t rank = 0; rank < count; ++rank) {
+        const uint64_t childIndex = firstChild + rank;
+        Object* child;
+        std::unique_ptr<Object> element;
+        if (object._virtualChildren) {
+            child = object._virtualChildren->element(rank);
+            if (child == nullptr) {
+                element.reset(object.buildVirtualChild(rank));
+                element->explore(-1);
+                child = element.get();
+            }
+        } else {
+            child = object._children[rank];
+        }
+
+        if (child != nullptr) {
+            writeNode(childIndex, *child);
+            writeChildren(*child, childIndex);
+        } else {
+            // Compact leaves are not expanded
+            ParseIndex::Node& node = nodes[childIndex];
+            std::memset(&node, 0, sizeof(ParseIndex::Node));
+            node.beginningPos = object._leaves.beginningPos(rank);
+            node.size = object._leaves.size(rank);
+            node.endianness = object._endianness;
+            node.type = type(object.root()._leafDictionary->type(object._leaves.typeIndex(rank)));
+            node.name = string(object._leaves.name(rank).str());
+            writeValue(node.value, object._leaves.value(rank));
+        }
+    }
+    --object._busyCount;
+}
+
+void ParseIndex::Writer::writeValue(ParseIndex::Value &record, const Variant &value)
+{
+    std::memset(&record, 0, sizeof(ParseIndex::Value));
+    record.type = value.type();
+    record.display = value.displayType();
+    switch (value.type()) {
+    case Variant::integerType:
+        record.payload = static_cast<uint64_t>(value.toInteger());
+        break;
+
+    case Variant::unsignedIntegerType:
+        record.payload = value.toUnsignedInteger();
+        break;
+
+    case Variant::floatingType:
+    {
+        const double floating = value.toDouble();
+        std::memcpy(&record.payload, &floating, sizeof(double));
+        break;
+    }
+
+    case Variant::stringType:
+        record.payload = string(value.toString());
+        break;
+
+    case Variant::objectType:
+        record.payload = type(value.toObjectType());
+        break;
+
+    default:
+        break;
+    }
+}
+
+uint32_t ParseIndex::Writer::extra(const Object &object)
+{
+    const ObjectAttributes* attributes = object._attributes;
+    if (attributes == nullptr && object._linkTo.isValueless()) {
+        return 0;
+    }
+
+    ExtraRecord record;
+    std::memset(&record, 0, sizeof(ExtraRecord));
+    record.hasLink = !object._linkTo.isValueless();
+    record.linkTo = record.hasLink ? object._linkTo.toUnsignedInteger() : 0;
+    record.numberedCount = attributes ? attributes->numberedCount() : 0;
+    record.namedCount = attributes ? attributes->fieldNames().size() : 0;
+
+    // Values are written first, since they may add types and strings
+    std::vector<ParseIndex::Value> values(record.numberedCount + record.namedCount);
+    std::vector<NamedRecord> names(record.namedCount);
+    for (uint32_t i = 0; i < record.numberedCount; ++i) {
+        writeValue(values[i], attributes->getNumbered(i));
+    }
+    for (uint32_t i = 0; i < record.namedCount; ++i) {
+        const std::string& name = attributes->fieldNames()[i];
+        names[i].name = string(name);
+        names[i].padding = 0;
+        writeValue(values[record.numberedCount + i], *attributes->getNamed(name));
+    }
+
+    const uint32_t offset = _extras.size();
+    append(_extras, record);
+    for (uint32_t i = 0; i < record.numberedCount; ++i) {
+        append(_extras, values[i]);
+    }
+    for (uint32_t i = 0; i < record.namedCount; ++i) {
+        append(_extras, names[i]);
+        append(_extras, values[record.numberedCount + i]);
+    }
+    return offset + 1;
+}
+
+uint32_t ParseIndex::Writer::type(const ObjectType &type)
+{
+    auto it = _typeIndices.find(type);
+    if (it != _typeIndices.end()) {
+        return it->second;
+    }
+
+    // The type is read back through the module, by the name of its template
+    const ObjectTypeTemplate& typeTemplate = type.typeTemplate();
+    if (!typeTemplate.isNull() && &_module.getTemplate(typeTemplate.name()) != &typeTemplate) {
+        Log::warning("Index cannot be written, type template ", typeTemplate.name(), " is not known to the module");
+        _valid = false;
+    }
+
+    // Types in parameters come first
+    std::vector<ParseIndex::Value> parameters(type.numberOfParameters());
+    for (int i = 0; i < type.numberOfParameters(); ++i) {
+        writeValue(parameters[i], type.parameterValue(i));
+    }
+
+    TypeRecord record;
+    record.templateName = string(typeTemplate.name());
+    record.name = string(type.name());
+    record.parameterCount = parameters.size();
+    record.padding = 0;
+    append(_types, record);
+    for (const ParseIndex::Value& parameter : parameters) {
+        append(_types, parameter);
+    }
+
+    const uint32_t index = _typeCount++;
+    _typeIndices.insert(std::make_pair(type, index));
+    return index;
+}
+
+uint32_t ParseIndex::Writer::string(const std::string &string)
+{
+    auto it = _stringOffsets.find(string);
+    if (it != _stringOffsets.end()) {
+        return it->second;
+    }
+
+    const uint32_t offset = _strings.size();
+    const uint32_t length = string.size();
+    append(_strings, length);
+    _strings.append(string);
+    _stringOffsets.insert(std::make_pair(string, offset));
+    return offset;
+}
@@ -0,0 +1,133 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef PARSEINDEX_H
+#define PARSEINDEX_H
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "core/file/mappedfile.h"
+#include "core/objecttype.h"
+#include "core/util/atom.h"
+
+class File;
+class Module;
+class Object;
+class VariableCollector;
+
+/**
+ * @brief Parsed tree of a \link File file\endlink saved next to it, so that
+ * the file can be opened again without being parsed
+ *
+ * The index records the position, size, endianness, type, name, value, attributes
+ * and link of every \link Object object\endlink of the tree, as fixed size records in native
+ * byte order, laid out so that the index is used straight from a memory
+ * mapping. The children of an object are stored contiguously, and rebuilt
+ * only when the object is accessed, the leaves being kept in \link LeafStore
+ * compact form\endlink.
+ *
+ * The index is only used if its \link Key key\endlink matches the one of the
+ * file and the \link Module module\endlink, otherwise the file must be parsed
+ * again.
+ */
+class ParseIndex
+{
+public:
+    struct Key
+    {
+        Key();
+
+        int64_t fileSize;
+        int64_t modificationTime;
+        /** @brief Hash of pages sampled across the file*/
+        uint64_t contentHash;
+        /** @brief \link ModuleLoader::fingerprint Fingerprint\endlink of the module parsing the file*/
+        uint64_t moduleHash;
+    };
+
+    ~ParseIndex();
+
+    static Key key(File& file, uint64_t moduleHash);
+
+    /** @brief Path of the index of a file*/
+    static std::string sidecarPath(const std::string& filePath);
+
+    /**
+     * @brief Parse the whole tree and write its index
+     *
+     * Types must be known by the \link Module module\endlink by the name of their
+     * template. Returns false if they are not or the index cannot be written.
+     */
+    static bool write(Object& root, const Module& module, const Key& key, const std::string& path);
+
+    /**
+     * @brief Build the root of the tree from the index
+     *
+     * Returns nullptr if the index cannot be read or its key does not match.
+     */
+    static Object* load(const std::string& path, const Key& key, const Module& module,
+                        File& file, VariableCollector& collector);
+
+private:
+    friend class Object;
+
+    struct Value;
+    struct Node;
+    struct Header;
+    class Writer;
+
+    ParseIndex();
+
+    bool open(const std::string& path, const Key& key, const Module& module);
+    bool readTypes(const char* data, uint64_t size, const Module& module);
+    // Checks that the types, children and extra records of the nodes are within the index
+    bool checkNodes() const;
+    bool checkExtra(uint64_t offset) const;
+    bool checkValue(const Value& value) const;
+    void readExtra(Object& object, uint64_t offset) const;
+
+    const Node& node(uint64_t index) const;
+    Variant value(const Value& value) const;
+    Atom name(uint32_t offset) const;
+    std::string string(uint32_t offset) const;
+
+    void loadChildren(Object& object) const;
+    bool isLeaf(const Node& node, const Node& parent) const;
+    void setUp(Object& object, const Node& node) const;
+
+    MappedFile _mapping;
+    const Node* _nodes;
+    uint64_t _nodeCount;
+    const char* _strings;
+    uint64_t _stringSize;
+    // Attributes and links of the objects which have some
+    const char* _extras;
+    uint64_t _extraSize;
+    std::vector<ObjectType> _types;
+    // Index of the types in the dictionary of the tree
+    std::vector<uint32_t> _dictionaryIndices;
+    mutable std::unordered_map<uint32_t, Atom> _names;
+
+    ParseIndex& operator=(const ParseIndex&) = delete;
+    ParseIndex(const ParseIndex&) = delete;
+};
+
+#endif // PARSEINDEX_H
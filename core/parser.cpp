@@ -33,6 +33,16 @@ Parser::Parser(Object& object)
 
 }
 
+void *Parser::operator new(size_t size)
+{
+    return Arena::allocateIn(Arena::current(), size);
+}
+
+void Parser::operator delete(void *pointer)
+{
+    Arena::deallocate(pointer);
+}
+
 void Parser::parseHead()
 {
     Object::Parsing parsing(object());
@@ -141,7 +151,7 @@ std::shared_ptr<std::pair<bool, ObjectType> > Parser::sharedType() const
 int64_t Parser::availableSize() const
 {
     if(_object.file().good()) {
-        return _object.size() - _object.pos();
+        return _object.remainingSize();
     } else {
         return -1;
     }
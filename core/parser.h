@@ -23,6 +23,7 @@
 class ParsingException;
 
 #include "core/object.h"
+#include "core/util/arena.h"
 
 /**
  * @brief Parse a bit of \link File file\endlink into an \link Object object\endlink
@@ -44,6 +45,11 @@ class Parser
 public:
     virtual ~Parser(){}
 
+    /** @brief Parsers are allocated in the current \link Arena arena\endlink,
+     * that of the tree of their object when created by a \link Module module\endlink*/
+    static void* operator new(size_t size);
+    static void operator delete(void* pointer);
+
     /**
      * @brief Parse what must be parsed as soon as possible
      */
@@ -0,0 +1,318 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "core/partitionedexplorer.h"
+#include "core/file/file.h"
+#include "core/module.h"
+#include "core/object.h"
+#include "core/parallelexplorer.h"
+
+// Number of packets that must begin with the syncbyte for a guess to be made
+#define CONFIRMED_PERIODS 4
+#define CHUNK_SIZE 65536
+
+/**
+ * @brief Reads a file by chunks, byte positions being absolute
+ */
+class PartitionedExplorer::Reader
+{
+public:
+    Reader(File& file, int64_t size) : _file(file), _size(size), _chunkBegin(0)
+    {
+    }
+
+    int64_t size() const
+    {
+        return _size;
+    }
+
+    /** @brief Byte at the position, -1 if it is not in the file*/
+    int byte(int64_t position)
+    {
+        if (!load(position)) {
+            return -1;
+        }
+        return static_cast<uint8_t>(_chunk[position - _chunkBegin]);
+    }
+
+    /** @brief Position of the first occurence of the byte from the position on, -1 if none*/
+    int64_t find(uint8_t value, int64_t position)
+    {
+        while (load(position)) {
+            const char* begin = _chunk.data() + (position - _chunkBegin);
+            const size_t count = _chunk.size() - (position - _chunkBegin);
+            const void* found = std::memchr(begin, value, count);
+            if (found != nullptr) {
+                return position + (static_cast<const char*>(found) - begin);
+            }
+            position += count;
+        }
+        return -1;
+    }
+
+private:
+    bool load(int64_t position)
+    {
+        if (position < 0 || position >= _size) {
+            return false;
+        }
+        if (position >= _chunkBegin && position < _chunkBegin + static_cast<int64_t>(_chunk.size())) {
+            return true;
+        }
+        const int64_t count = std::min<int64_t>(CHUNK_SIZE, _size - position);
+        _chunk.resize(count);
+        _chunkBegin = position;
+        if (!_file.readAt(8*position, _chunk.data(), 8*count)) {
+            _chunk.clear();
+            return false;
+        }
+        return true;
+    }
+
+    File& _file;
+    const int64_t _size;
+    int64_t _chunkBegin;
+    std::vector<char> _chunk;
+};
+
+PartitionedExplorer::PartitionedExplorer(uint8_t syncbyte, int packetLength, int threadCount, int64_t minimumRangeSize)
+    : _syncbyte(syncbyte),
+      _packetLength(packetLength),
+      _threadCount(threadCount > 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency())),
+      _minimumRangeSize(std::max<int64_t>(minimumRangeSize, packetLength))
+{
+}
+
+int PartitionedExplorer::threadCount() const
+{
+    return _threadCount;
+}
+
+std::vector<PartitionedExplorer::Run> PartitionedExplorer::partition(File &file, int64_t beginning) const
+{
+    std::vector<Run> runs;
+    if (beginning % 8 != 0 || _packetLength <= 0) {
+        return runs;
+    }
+
+    // Positions are in bytes until the runs are returned
+    const int64_t size = file.size() / 8;
+    const int64_t begin = beginning / 8;
+    const int64_t length = size - begin;
+    if (length < _packetLength) {
+        return runs;
+    }
+
+    const int64_t rangeCount = std::max<int64_t>(1, std::min<int64_t>(_threadCount, length / _minimumRangeSize));
+    std::vector<int64_t> bounds;
+    for (int64_t range = 0; range <= rangeCount; ++range) {
+        bounds.push_back(begin + range * length / rangeCount);
+    }
+
+    // The first range begins with a packet, the others guess where their first one is
+    std::vector<Scan> scans(rangeCount);
+    std::vector<std::thread> threads;
+    for (int64_t range = 1; range < rangeCount; ++range) {
+        threads.push_back(std::thread(&PartitionedExplorer::scan, this, std::ref(file),
+                                      bounds[range], bounds[range+1], true, std::ref(scans[range])));
+    }
+    scan(file, bounds[0], bounds[1], false, scans[0]);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    Reader reader(file, size);
+    runs = std::move(scans[0].runs);
+    int64_t next = scans[0].next;
+    for (int64_t range = 1; range < rangeCount && next != -1; ++range) {
+        const Scan& rangeScan = scans[range];
+        if (next >= bounds[range+1]) {
+            continue;
+        }
+
+        // A wrong guess is corrected by scanning from the end of the previous range
+        // until a packet found by the range is met, the same ones following from there
+        while (next != -1 && next < bounds[range+1] && !includes(rangeScan, next)) {
+            append(runs, next, 1);
+            next = findSync(reader, next + _packetLength, false);
+        }
+        if (next == -1 || next >= bounds[range+1]) {
+            continue;
+        }
+
+        auto run = std::upper_bound(rangeScan.runs.begin(), rangeScan.runs.end(), next,
+                                    [](int64_t position, const Run& run){return position < run.syncPos;}) - 1;
+        append(runs, next, run->count - (next - run->syncPos) / _packetLength);
+        for (++run; run != rangeScan.runs.end(); ++run) {
+            append(runs, run->syncPos, run->count);
+        }
+        next = rangeScan.next;
+    }
+
+    for (Run& run : runs) {
+        run.syncPos *= 8;
+    }
+    return runs;
+}
+
+void PartitionedExplorer::explore(Object &root, const Module &module) const
+{
+    // The packets are found on several threads even if they are then explored on one
+    if (_threadCount > 1) {
+        // The first two packets are added by the parsers, which also sets up the root
+        bool done = false;
+        while (!done && root._children.size() < 2) {
+            done = root.exploreSome(1);
+        }
+        if (!done && !root._virtualChildren && root._children.size() >= 2) {
+            const Object* previous = root._children[root._children.size() - 2];
+            const Object* last = root._children.back();
+
+            // The others are named as these two are, so that they must agree
+            if (previous != nullptr && last != nullptr
+             && previous->type() == last->type()
+             && previous->nameAtom() == last->nameAtom()
+             && previous->_size != -1 && last->_size != -1
+             && static_cast<int64_t>(previous->_beginningPos) + previous->_size == static_cast<int64_t>(last->_beginningPos)) {
+                addPackets(root, module, partition(root.file(), static_cast<int64_t>(last->_beginningPos) + last->_size));
+            }
+        }
+    }
+
+    ParallelExplorer explorer(_threadCount);
+    explorer.explore(root, module);
+}
+
+int64_t PartitionedExplorer::findSync(Reader &reader, int64_t position, bool confirmed) const
+{
+    while (true) {
+        const int64_t sync = reader.find(_syncbyte, position);
+        if (sync == -1 || sync + _packetLength > reader.size()) {
+            return -1;
+        }
+
+        bool periodic = true;
+        for (int period = 1; confirmed && period < CONFIRMED_PERIODS; ++period) {
+            const int64_t next = sync + period * _packetLength;
+            if (next + _packetLength > reader.size()) {
+                break;
+            }
+            if (reader.byte(next) != _syncbyte) {
+                periodic = false;
+                break;
+            }
+        }
+        if (periodic) {
+            return sync;
+        }
+        position = sync + 1;
+    }
+}
+
+void PartitionedExplorer::scan(File &file, int64_t begin, int64_t end, bool guess, Scan &result) const
+{
+    Reader reader(file, file.size() / 8);
+    int64_t sync = findSync(reader, begin, guess);
+    while (sync != -1 && sync < end) {
+        append(result.runs, sync, 1);
+        sync = findSync(reader, sync + _packetLength, false);
+    }
+    result.next = sync;
+}
+
+bool PartitionedExplorer::includes(const Scan &scan, int64_t position) const
+{
+    auto run = std::upper_bound(scan.runs.begin(), scan.runs.end(), position,
+                                [](int64_t position, const Run& run){return position < run.syncPos;});
+    if (run == scan.runs.begin()) {
+        return false;
+    }
+    --run;
+    const int64_t offset = position - run->syncPos;
+    return offset % _packetLength == 0 && offset / _packetLength < run->count;
+}
+
+void PartitionedExplorer::append(std::vector<Run> &runs, int64_t position, int64_t count) const
+{
+    if (!runs.empty() && runs.back().syncPos + runs.back().count * _packetLength == position) {
+        runs.back().count += count;
+    } else {
+        runs.push_back(Run{position, count});
+    }
+}
+
+void PartitionedExplorer::addPackets(Object &root, const Module &module, const std::vector<Run> &runs) const
+{
+    const Object& last = *root._children.back();
+    const ObjectType type = last.type();
+    const Atom name = last.nameAtom();
+    const int64_t packetSize = 8 * static_cast<int64_t>(_packetLength);
+    const int64_t rootBegin = static_cast<int64_t>(root._beginningPos);
+    const int64_t rootEnd = root._size == -1 ? -1 : rootBegin + root._size;
+    int64_t end = static_cast<int64_t>(last._beginningPos) + last._size;
+
+    FileAnchor anchor(root.file());
+    bool adding = true;
+    for (auto run = runs.begin(); adding && run != runs.end(); ++run) {
+        for (int64_t index = 0; adding && index < run->count; ++index) {
+            // A packet begins where the previous one ends, anything before its syncbyte included
+            const int64_t packetEnd = run->syncPos + index * packetSize + packetSize;
+            if (rootEnd != -1 && packetEnd > rootEnd) {
+                adding = false;
+                break;
+            }
+
+            root._pos = end - rootBegin;
+            root.seekObjectEnd();
+            Object* packet = module.handle(type, root);
+            if (packet == nullptr) {
+                adding = false;
+                break;
+            }
+
+            // The size is found as ContainerParser::addChild does
+            if (packet->_size == -1 && !packet->isSetToExpandOnAddition()) {
+                packet->parse();
+                packet->_size = packet->_contentSize;
+            }
+            if (packet->_size != packetEnd - end) {
+                // The parsers of the root go on from the packet the module disagrees on
+                delete packet;
+                adding = false;
+                break;
+            }
+
+            packet->_rank = static_cast<int64_t>(root._children.size());
+            if (!name.empty()) {
+                packet->setName(name);
+                root._lookUpTable.set(name, root._children.size());
+            }
+            root._children.push_back(packet);
+            end = packetEnd;
+        }
+    }
+
+    root._lastChild = nullptr;
+    root._pos = end - rootBegin;
+    if (root._contentSize < root._pos) {
+        root._contentSize = root._pos;
+    }
+}
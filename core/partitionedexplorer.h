@@ -0,0 +1,106 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef PARTITIONEDEXPLORER_H
+#define PARTITIONEDEXPLORER_H
+
+#include <stdint.h>
+#include <vector>
+
+class File;
+class Module;
+class Object;
+
+/**
+ * @brief Explores a file made of packets beginning with a syncbyte by ranges
+ *
+ * The packets of the formats detected by their \link SyncbyteFormatDetector syncbyte\endlink
+ * can be found without parsing them: each one begins at the first syncbyte following
+ * the previous one. The file is split into ranges scanned on several threads, each
+ * one guessing where its first packet begins from the periodic repetition of the
+ * syncbyte. The ranges are then stitched in order, and the guesses that do not
+ * follow from the previous range are corrected by scanning again from the end of it.
+ *
+ * The packets found are added to the root as if its parsers had, and then explored
+ * as \link ParallelExplorer::explore ParallelExplorer does\endlink, in order for the
+ * state carried from one packet to the next to be the same as with Object::explore.
+ */
+class PartitionedExplorer
+{
+public:
+    /** @brief Packets following each other without anything in between*/
+    struct Run
+    {
+        // Position of the syncbyte of the first packet, in bits
+        int64_t syncPos;
+        int64_t count;
+    };
+
+    /**
+     * @param packetLength is the length of the packets in bytes
+     * @param threadCount is the number of threads, that of the machine if 0
+     * @param minimumRangeSize is the number of bytes below which a range is not split further
+     */
+    PartitionedExplorer(uint8_t syncbyte, int packetLength, int threadCount = 0, int64_t minimumRangeSize = 1 << 22);
+
+    int threadCount() const;
+
+    /**
+     * @brief Find the packets lying entirely in the file after a position, in bits
+     *
+     * The runs are ordered, and the same as the ones found by scanning the file
+     * from the position on a single thread.
+     */
+    std::vector<Run> partition(File& file, int64_t beginning = 0) const;
+
+    /**
+     * @brief Explore the root object fully, as Object::explore(-1) does
+     *
+     * The root is parsed until its first two packets are added. If they have the
+     * same type and name, the following ones are found by partition and added
+     * alike, and the parsers of the root go on from the end of the last one.
+     * The packets are then explored on several threads if the \link Module module\endlink
+     * is \link Module::isThreadSafe thread safe\endlink, and in order on the calling
+     * thread otherwise.
+     */
+    void explore(Object& root, const Module& module) const;
+
+private:
+    // Packets found from the beginning of a range
+    struct Scan
+    {
+        std::vector<Run> runs;
+        // Position of the first packet after the range, -1 if there is none
+        int64_t next;
+    };
+
+    class Reader;
+
+    int64_t findSync(Reader& reader, int64_t position, bool confirmed) const;
+    void scan(File& file, int64_t begin, int64_t end, bool guess, Scan& result) const;
+    int64_t walk(Reader& reader, int64_t position, int64_t end, std::vector<Run>& runs, const Scan* stopAt) const;
+    bool includes(const Scan& scan, int64_t position) const;
+    void append(std::vector<Run>& runs, int64_t position, int64_t count) const;
+    void addPackets(Object& root, const Module& module, const std::vector<Run>& runs) const;
+
+    uint8_t _syncbyte;
+    int _packetLength;
+    int _threadCount;
+    int64_t _minimumRangeSize;
+};
+
+#endif // PARTITIONEDEXPLORER_H
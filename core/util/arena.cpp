@@ -0,0 +1,311 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <new>
+
+#include "core/util/arena.h"
+#include "core/util/osutil.h"
+
+#if defined(PLATFORM_LINUX)
+    #include <sys/mman.h>
+#endif
+
+// Blocks are multiples of the alignment, header included
+#define BLOCK_ALIGNMENT 16
+#define MAX_BLOCK_SIZE 1024
+#define FIRST_SLAB_SIZE 65536
+#define MAX_SLAB_SIZE 2097152
+#define CHUNK_SIZE 16384
+#define CACHED_ARENA_COUNT 4
+
+namespace {
+struct Header
+{
+    Arena* arena;
+    size_t blockSize;
+};
+static_assert(sizeof(Header) <= BLOCK_ALIGNMENT, "block header too big");
+}
+
+struct Arena::ThreadCache
+{
+    // Arenas are told apart by an id never reused, so that the cache of a destroyed one is never used
+    uint64_t arenaId;
+    char* position;
+    char* end;
+    void* freeBlocks[MAX_BLOCK_SIZE / BLOCK_ALIGNMENT];
+};
+
+thread_local Arena* Arena::_current = nullptr;
+std::atomic<bool> Arena::_useHugePages(false);
+std::atomic<size_t> Arena::_heapAllocationCount(0);
+std::atomic<uint64_t> Arena::_nextId(1);
+
+Arena::Arena()
+    : _id(_nextId++),
+      _freeBlocks(MAX_BLOCK_SIZE / BLOCK_ALIGNMENT, nullptr),
+      _slabPosition(nullptr),
+      _slabEnd(nullptr),
+      _nextSlabSize(FIRST_SLAB_SIZE),
+      _allocationCount(0),
+      _references(1),
+      _liveSize(0),
+      _released(false)
+{
+}
+
+Arena::~Arena()
+{
+    for (void* slab : _slabs) {
+        std::free(slab);
+    }
+}
+
+void *Arena::allocateIn(Arena *arena, size_t size)
+{
+    const size_t blockSize = (size + BLOCK_ALIGNMENT + BLOCK_ALIGNMENT - 1) & ~size_t(BLOCK_ALIGNMENT - 1);
+
+    Header* header;
+    if (arena && blockSize <= MAX_BLOCK_SIZE) {
+        header = static_cast<Header*>(arena->allocate(blockSize));
+    } else if (arena) {
+        header = static_cast<Header*>(arena->allocateFromHeap(blockSize));
+    } else {
+        header = static_cast<Header*>(std::malloc(size + BLOCK_ALIGNMENT));
+        if (header == nullptr) {
+            throw std::bad_alloc();
+        }
+        ++_heapAllocationCount;
+    }
+
+    header->arena = arena;
+    header->blockSize = blockSize;
+    return reinterpret_cast<char*>(header) + BLOCK_ALIGNMENT;
+}
+
+void Arena::deallocate(void *pointer)
+{
+    if (pointer == nullptr) {
+        return;
+    }
+
+    Header* header = reinterpret_cast<Header*>(static_cast<char*>(pointer) - BLOCK_ALIGNMENT);
+    if (header->arena) {
+        header->arena->free(header);
+    } else {
+        std::free(header);
+    }
+}
+
+void Arena::release()
+{
+    _released = true;
+    unreference();
+}
+
+Arena *Arena::current()
+{
+    return _current;
+}
+
+void Arena::setUseHugePages(bool useHugePages)
+{
+    _useHugePages = useHugePages;
+}
+
+size_t Arena::allocationCount() const
+{
+    return _allocationCount;
+}
+
+size_t Arena::liveCount() const
+{
+    return _references - (_released ? 0 : 1);
+}
+
+size_t Arena::liveSize() const
+{
+    return _liveSize;
+}
+
+size_t Arena::slabCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _slabs.size();
+}
+
+size_t Arena::heapAllocationCount()
+{
+    return _heapAllocationCount;
+}
+
+Arena::ThreadCache *Arena::threadCache(bool create)
+{
+    static thread_local ThreadCache caches[CACHED_ARENA_COUNT];
+    static thread_local size_t lastUsed = 0;
+
+    if (caches[lastUsed].arenaId == _id) {
+        return &caches[lastUsed];
+    }
+    for (size_t i = 0; i < CACHED_ARENA_COUNT; ++i) {
+        if (caches[i].arenaId == _id) {
+            lastUsed = i;
+            return &caches[i];
+        }
+    }
+    if (!create) {
+        return nullptr;
+    }
+
+    // Drops the arena used the longest ago, its blocks stay unused
+    static thread_local size_t nextDropped = 0;
+    ThreadCache& cache = caches[nextDropped];
+    lastUsed = nextDropped;
+    nextDropped = (nextDropped + 1) % CACHED_ARENA_COUNT;
+    cache.arenaId = _id;
+    cache.position = nullptr;
+    cache.end = nullptr;
+    std::fill(std::begin(cache.freeBlocks), std::end(cache.freeBlocks), nullptr);
+    return &cache;
+}
+
+void *Arena::allocate(size_t blockSize)
+{
+    ThreadCache& cache = *threadCache(true);
+    _allocationCount.fetch_add(1, std::memory_order_relaxed);
+    _references.fetch_add(1, std::memory_order_relaxed);
+    _liveSize.fetch_add(blockSize, std::memory_order_relaxed);
+
+    // Free blocks are chained through their first bytes
+    void*& freeBlock = cache.freeBlocks[blockSize / BLOCK_ALIGNMENT - 1];
+    if (freeBlock) {
+        void* block = freeBlock;
+        freeBlock = *static_cast<void**>(block);
+        return block;
+    }
+
+    if (cache.end - cache.position >= static_cast<std::ptrdiff_t>(blockSize)) {
+        void* block = cache.position;
+        cache.position += blockSize;
+        return block;
+    }
+
+    try {
+        return refill(cache, blockSize);
+    } catch (...) {
+        _allocationCount.fetch_sub(1, std::memory_order_relaxed);
+        _references.fetch_sub(1, std::memory_order_relaxed);
+        _liveSize.fetch_sub(blockSize, std::memory_order_relaxed);
+        throw;
+    }
+}
+
+void *Arena::refill(ThreadCache &cache, size_t blockSize)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    void*& sharedBlock = _freeBlocks[blockSize / BLOCK_ALIGNMENT - 1];
+    if (sharedBlock) {
+        void* block = sharedBlock;
+        cache.freeBlocks[blockSize / BLOCK_ALIGNMENT - 1] = *static_cast<void**>(block);
+        sharedBlock = nullptr;
+        return block;
+    }
+
+    if (_slabEnd - _slabPosition < static_cast<std::ptrdiff_t>(blockSize)) {
+        void* slab = nullptr;
+#if defined(PLATFORM_LINUX)
+        if (_nextSlabSize == MAX_SLAB_SIZE && _useHugePages
+         && posix_memalign(&slab, MAX_SLAB_SIZE, MAX_SLAB_SIZE) == 0) {
+            madvise(slab, MAX_SLAB_SIZE, MADV_HUGEPAGE);
+        }
+#endif
+        if (slab == nullptr) {
+            slab = std::malloc(_nextSlabSize);
+        }
+        if (slab == nullptr) {
+            throw std::bad_alloc();
+        }
+
+        _slabs.push_back(slab);
+        _slabPosition = static_cast<char*>(slab);
+        _slabEnd = _slabPosition + _nextSlabSize;
+        _nextSlabSize = std::min<size_t>(2 * _nextSlabSize, MAX_SLAB_SIZE);
+    }
+
+    const size_t chunkSize = std::min<size_t>(CHUNK_SIZE, _slabEnd - _slabPosition);
+    cache.position = _slabPosition + blockSize;
+    cache.end = _slabPosition + chunkSize;
+    void* block = _slabPosition;
+    _slabPosition += chunkSize;
+    return block;
+}
+
+void *Arena::allocateFromHeap(size_t blockSize)
+{
+    void* block = std::malloc(blockSize);
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    ++_heapAllocationCount;
+
+    _allocationCount.fetch_add(1, std::memory_order_relaxed);
+    _references.fetch_add(1, std::memory_order_relaxed);
+    _liveSize.fetch_add(blockSize, std::memory_order_relaxed);
+    return block;
+}
+
+void Arena::free(void *block)
+{
+    const size_t blockSize = static_cast<Header*>(block)->blockSize;
+    if (blockSize > MAX_BLOCK_SIZE) {
+        std::free(block);
+    } else if (ThreadCache* cache = threadCache(false)) {
+        void*& freeBlock = cache->freeBlocks[blockSize / BLOCK_ALIGNMENT - 1];
+        *static_cast<void**>(block) = freeBlock;
+        freeBlock = block;
+    } else {
+        // Left to the threads allocating from the arena
+        std::lock_guard<std::mutex> lock(_mutex);
+        void*& freeBlock = _freeBlocks[blockSize / BLOCK_ALIGNMENT - 1];
+        *static_cast<void**>(block) = freeBlock;
+        freeBlock = block;
+    }
+
+    _liveSize.fetch_sub(blockSize, std::memory_order_relaxed);
+    unreference();
+}
+
+void Arena::unreference()
+{
+    if (_references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete this;
+    }
+}
+
+Arena::Scope::Scope(Arena *arena) : _previous(Arena::_current)
+{
+    Arena::_current = arena;
+}
+
+Arena::Scope::~Scope()
+{
+    Arena::_current = _previous;
+}
@@ -0,0 +1,206 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Slab allocator for the nodes of a tree, which are mostly freed together
+ *
+ * Small blocks are carved from large slabs with a bump pointer, and blocks
+ * freed before the arena are kept on free lists by size for reuse. The slabs
+ * are all given back at once when the arena has been released by its owner
+ * and its last block has been freed.
+ *
+ * Each thread bumps through a chunk of a slab of its own and keeps its own
+ * free lists, so that allocating and freeing take no lock: only taking a new
+ * chunk does. A thread caches a few arenas at once, the chunk and free lists of
+ * the one it drops are left unused until the arena is destroyed.
+ *
+ * Blocks carry a small header pointing to their arena, so that they can be
+ * freed without knowing it. Blocks too big for the slabs, or allocated
+ * without an arena, come from the heap. The arena still accounts for the
+ * former, so that its \link liveSize() size\endlink covers the whole tree.
+ */
+class Arena
+{
+public:
+    Arena();
+
+    /**
+     * @brief Allocates a block from the arena, or from the heap if arena is null
+     */
+    static void* allocateIn(Arena* arena, size_t size);
+
+    /**
+     * @brief Frees a block allocated by allocateIn
+     */
+    static void deallocate(void* pointer);
+
+    /**
+     * @brief Gives up the ownership of the arena, which is destroyed with its
+     * last block
+     */
+    void release();
+
+    /**
+     * @brief Arena used for the allocations of objects and parsers of the
+     * current thread
+     */
+    static Arena* current();
+
+    /**
+     * @brief RAII object setting the current arena of the thread
+     */
+    class Scope
+    {
+    public:
+        Scope(Arena* arena);
+        ~Scope();
+    private:
+        Arena* _previous;
+    };
+
+    /**
+     * @brief Back the slabs allocated from now on by huge pages when the
+     * system allows it
+     */
+    static void setUseHugePages(bool useHugePages);
+
+    /** @brief Number of blocks handed out by the arena*/
+    size_t allocationCount() const;
+
+    /** @brief Number of blocks of the arena in use*/
+    size_t liveCount() const;
+
+    /** @brief Total size in bytes of the blocks of the arena in use, headers included*/
+    size_t liveSize() const;
+
+    /** @brief Number of slabs allocated by the arena*/
+    size_t slabCount() const;
+
+    /** @brief Number of blocks allocated from the heap through allocateIn*/
+    static size_t heapAllocationCount();
+
+private:
+    struct ThreadCache;
+
+    ~Arena();
+    Arena& operator=(const Arena&) = delete;
+    Arena(const Arena&) = delete;
+
+    void* allocate(size_t blockSize);
+    void* allocateFromHeap(size_t blockSize);
+    void free(void* block);
+    void unreference();
+
+    // Chunk and free lists of the thread for the arena, made if asked for
+    ThreadCache* threadCache(bool create);
+    // Gives the thread the free blocks of the size left by other threads, or a new chunk
+    void* refill(ThreadCache& cache, size_t blockSize);
+
+    const uint64_t _id;
+    mutable std::mutex _mutex;
+    std::vector<void*> _slabs;
+    std::vector<void*> _freeBlocks;
+    char* _slabPosition;
+    char* _slabEnd;
+    size_t _nextSlabSize;
+    std::atomic<size_t> _allocationCount;
+    // Blocks in use, plus one until the arena is released
+    std::atomic<size_t> _references;
+    std::atomic<size_t> _liveSize;
+    std::atomic<bool> _released;
+
+    static thread_local Arena* _current;
+    static std::atomic<bool> _useHugePages;
+    static std::atomic<size_t> _heapAllocationCount;
+    static std::atomic<uint64_t> _nextId;
+};
+
+/**
+ * @brief Deleter releasing an arena
+ */
+struct ArenaReleaser
+{
+    void operator()(Arena* arena) const
+    {
+        arena->release();
+    }
+};
+
+typedef std::unique_ptr<Arena, ArenaReleaser> ArenaOwner;
+
+/**
+ * @brief Standard allocator taking its blocks from an arena, the current one
+ * by default
+ */
+template<class T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    ArenaAllocator(Arena* arena = Arena::current()) : _arena(arena)
+    {
+    }
+
+    template<class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : _arena(other.arena())
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(Arena::allocateIn(_arena, n * sizeof(T)));
+    }
+
+    void deallocate(T* pointer, size_t /*n*/)
+    {
+        Arena::deallocate(pointer);
+    }
+
+    Arena* arena() const
+    {
+        return _arena;
+    }
+
+    // Blocks know their arena, so any allocator can free them
+    template<class U>
+    bool operator==(const ArenaAllocator<U>& /*other*/) const
+    {
+        return true;
+    }
+
+    template<class U>
+    bool operator!=(const ArenaAllocator<U>& /*other*/) const
+    {
+        return false;
+    }
+
+private:
+    Arena* _arena;
+};
+
+#endif // ARENA_H
@@ -0,0 +1,213 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include <atomic>
+#include <cctype>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+
+#include "core/util/atom.h"
+#include "core/util/strutil.h"
+
+// Strings are referenced from blocks which never move, so that reading them
+// needs no lock. Each block is twice as large as the previous one, so that the
+// blocks cover every identifier.
+#define FIRST_BLOCK_SIZE 4096
+#define BLOCK_COUNT 20
+
+namespace {
+// Largest number of a numbered string, whose index is the number plus one
+const uint64_t maxNumber = std::numeric_limits<uint32_t>::max() - 1;
+
+/*
+ * Splits a string ending its last run of digits with a number written without
+ * leading zero into its pattern and its number. The pattern is the string
+ * without the number, preceded by the position of the number, so that it can
+ * be put back in.
+ */
+bool splitNumber(const std::string& string, std::string& pattern, uint32_t& index)
+{
+    size_t end = string.size();
+    while (end > 0 && !std::isdigit(static_cast<unsigned char>(string[end - 1]))) {
+        --end;
+    }
+    size_t begin = end;
+    while (begin > 0 && std::isdigit(static_cast<unsigned char>(string[begin - 1]))) {
+        --begin;
+    }
+    if (begin == end || end - begin > 10 || (string[begin] == '0' && end - begin > 1)) {
+        return false;
+    }
+
+    uint64_t number = 0;
+    for (size_t i = begin; i < end; ++i) {
+        number = 10 * number + (string[i] - '0');
+    }
+    if (number > maxNumber) {
+        return false;
+    }
+
+    pattern = toStr(begin) + ":" + string.substr(0, begin) + string.substr(end);
+    index = static_cast<uint32_t>(number) + 1;
+    return true;
+}
+
+std::string joinNumber(const std::string& pattern, uint32_t index)
+{
+    const size_t separator = pattern.find(':');
+    const size_t position = std::stoul(pattern.substr(0, separator));
+    std::string string = pattern.substr(separator + 1);
+    return string.insert(position, toStr(index - 1));
+}
+
+class AtomTable
+{
+public:
+    AtomTable() : _count(0)
+    {
+        for (auto& block : _blocks) {
+            block = nullptr;
+        }
+        intern(std::string());
+    }
+
+    uint32_t intern(const std::string& string)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto insertion = _ids.insert(std::make_pair(string, _count));
+        if (insertion.second) {
+            size_t blockIndex;
+            size_t offset;
+            locate(_count, blockIndex, offset);
+            if (blockIndex >= BLOCK_COUNT) {
+                // Only reached once the strings have taken hundreds of gigabytes
+                _ids.erase(insertion.first);
+                throw std::bad_alloc();
+            }
+            const std::string** block = _blocks[blockIndex].load(std::memory_order_relaxed);
+            if (block == nullptr) {
+                block = new const std::string*[size_t(FIRST_BLOCK_SIZE) << blockIndex];
+                _blocks[blockIndex].store(block, std::memory_order_release);
+            }
+            block[offset] = &insertion.first->first;
+            ++_count;
+        }
+        return insertion.first->second;
+    }
+
+    bool find(const std::string& string, uint32_t& id)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _ids.find(string);
+        if (it == _ids.end()) {
+            return false;
+        }
+        id = it->second;
+        return true;
+    }
+
+    const std::string& str(uint32_t id) const
+    {
+        size_t blockIndex;
+        size_t offset;
+        locate(id, blockIndex, offset);
+        return *_blocks[blockIndex].load(std::memory_order_acquire)[offset];
+    }
+
+    size_t count()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _count;
+    }
+
+private:
+    static void locate(uint64_t id, size_t& blockIndex, size_t& offset)
+    {
+        // Block b starts at FIRST_BLOCK_SIZE * (2^b - 1)
+        const uint64_t scaled = id / FIRST_BLOCK_SIZE + 1;
+        blockIndex = 0;
+        while ((scaled >> (blockIndex + 1)) != 0) {
+            ++blockIndex;
+        }
+        offset = id - FIRST_BLOCK_SIZE * ((uint64_t(1) << blockIndex) - 1);
+    }
+
+    std::mutex _mutex;
+    // Nodes of the map are stable, the blocks point to its keys
+    std::unordered_map<std::string, uint32_t> _ids;
+    std::atomic<const std::string**> _blocks[BLOCK_COUNT];
+    uint32_t _count;
+};
+
+// Never destroyed, so that atoms can be used during static destruction
+AtomTable& table()
+{
+    static AtomTable* table = new AtomTable;
+    return *table;
+}
+}
+
+Atom::Atom() : _id(0), _index(0)
+{
+}
+
+Atom::Atom(const std::string &string) : _index(0)
+{
+    std::string pattern;
+    if (splitNumber(string, pattern, _index)) {
+        _id = table().intern(pattern);
+    } else {
+        _id = table().intern(string);
+    }
+}
+
+Atom::Atom(const char *string) : Atom(std::string(string))
+{
+}
+
+bool Atom::find(const std::string &string, Atom &atom)
+{
+    std::string pattern;
+    uint32_t index;
+    if (splitNumber(string, pattern, index)) {
+        if (!table().find(pattern, atom._id)) {
+            return false;
+        }
+        atom._index = index;
+        return true;
+    }
+    if (!table().find(string, atom._id)) {
+        return false;
+    }
+    atom._index = 0;
+    return true;
+}
+
+std::string Atom::str() const
+{
+    if (_index == 0) {
+        return table().str(_id);
+    }
+    return joinNumber(table().str(_id), _index);
+}
+
+size_t Atom::count()
+{
+    return table().count();
+}
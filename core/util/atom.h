@@ -0,0 +1,169 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef ATOM_H
+#define ATOM_H
+
+#include <algorithm>
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Interned string, copied, compared and hashed as a pair of integers
+ *
+ * The strings are stored once in a global table and kept for the lifetime of
+ * the program. A string ending its last run of digits with a number, such as
+ * the names of the elements of an array, is stored as its pattern without the
+ * number, interned once, and the number itself, so that numbered names do not
+ * fill the table. Atoms can be created and read from several threads at once.
+ */
+class Atom
+{
+public:
+    /** @brief Atom of the empty string*/
+    Atom();
+
+    /** @brief Interns the string if needed*/
+    explicit Atom(const std::string& string);
+    explicit Atom(const char* string);
+
+    /**
+     * @brief Finds the atom of a string without interning it
+     * @return false if the string was never interned
+     */
+    static bool find(const std::string& string, Atom& atom);
+
+    std::string str() const;
+
+    /** @brief Identifier of the string, or of its pattern for a numbered string*/
+    uint32_t id() const
+    {
+        return _id;
+    }
+
+    /** @brief Number of a numbered string plus one, 0 for other strings*/
+    uint32_t index() const
+    {
+        return _index;
+    }
+
+    bool empty() const
+    {
+        return _id == 0 && _index == 0;
+    }
+
+    /** @brief Number of strings interned*/
+    static size_t count();
+
+private:
+    uint32_t _id;
+    uint32_t _index;
+};
+
+inline bool operator==(Atom a, Atom b)
+{
+    return a.id() == b.id() && a.index() == b.index();
+}
+
+inline bool operator!=(Atom a, Atom b)
+{
+    return !(a == b);
+}
+
+inline bool operator<(Atom a, Atom b)
+{
+    return a.id() < b.id() || (a.id() == b.id() && a.index() < b.index());
+}
+
+/**
+ * @brief Associative container keyed by atoms, stored as a vector sorted by atom
+ *
+ * Meant for the few keys of an object, where it is both smaller and faster
+ * than a hash map.
+ */
+template<class T>
+class AtomMap
+{
+public:
+    typedef std::pair<Atom, T> value_type;
+
+    const T* find(Atom key) const
+    {
+        auto it = lowerBound(key);
+        if (it != _entries.end() && it->first == key) {
+            return &it->second;
+        } else {
+            return nullptr;
+        }
+    }
+
+    void set(Atom key, const T& value)
+    {
+        auto it = lowerBound(key);
+        if (it != _entries.end() && it->first == key) {
+            it->second = value;
+        } else {
+            _entries.insert(it, value_type(key, value));
+        }
+    }
+
+    bool empty() const
+    {
+        return _entries.empty();
+    }
+
+    size_t size() const
+    {
+        return _entries.size();
+    }
+
+private:
+    typename std::vector<value_type>::iterator lowerBound(Atom key)
+    {
+        return std::lower_bound(_entries.begin(), _entries.end(), key, [](const value_type& entry, Atom key) {
+            return entry.first < key;
+        });
+    }
+
+    typename std::vector<value_type>::const_iterator lowerBound(Atom key) const
+    {
+        return std::lower_bound(_entries.begin(), _entries.end(), key, [](const value_type& entry, Atom key) {
+            return entry.first < key;
+        });
+    }
+
+    std::vector<value_type> _entries;
+};
+
+/** @cond */
+namespace std
+{
+    template<>
+    struct hash<Atom>
+    {
+        std::size_t operator()(Atom atom) const
+        {
+            return std::hash<uint64_t>()(uint64_t(atom.id()) << 32 | atom.index());
+        }
+    };
+}
+/** @endcond */
+
+#endif // ATOM_H
@@ -50,3 +50,35 @@ uint8_t popCount(uint64_t x)
     x = (x + (x >> 4)) & m4;        //put count of each 8 bits into those 8 bits
     return (x * h01)>>56;  //returns left 8 bits of x + (x<<8) + (x<<16) + (x<<24) + ...
 }
+
+void copyBits(char* destination, const uint8_t* source, int bitOffset, int64_t count)
+{
+    if (count <= 0)
+        return;
+
+    //Fill the result from the right, one byte ending at bit "end" at a time
+    const int64_t resultSize = (count + 7) / 8;
+    int64_t end = bitOffset + count;
+    for (int64_t i = resultSize - 1; i >= 0; --i, end -= 8) {
+        const int shift = end & 0x7;
+        const int64_t index = (end >> 3) - 1;
+        if (shift == 0) {
+            destination[i] = source[index];
+        } else {
+            const uint8_t high = index >= 0 ? source[index] : 0;
+            destination[i] = static_cast<uint8_t>((high << shift) | (source[index + 1] >> (8 - shift)));
+        }
+    }
+
+    //Delete first bits
+    destination[0] &= lsbMask(count - 8 * (resultSize - 1));
+}
+
+uint64_t hashBytes(const void *data, size_t size, uint64_t hash)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
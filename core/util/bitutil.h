@@ -18,6 +18,7 @@
 #ifndef MASKUTIL_H
 #define MASKUTIL_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 /*!
@@ -36,4 +37,17 @@ uint8_t lsbMask(int n);
  */
 uint8_t popCount(uint64_t word);
 
+/**
+ * @brief Copy count bits starting at the bit offset (between 0 and 7) of the source
+ * into the destination, right aligned and zero padded on (count+7)/8 bytes.
+ *
+ * Only the bytes of the source holding the requested bits are read.
+ */
+void copyBits(char* destination, const uint8_t* source, int bitOffset, int64_t count);
+
+/**
+ * @brief Get the FNV-1a hash of the bytes, continuing the hash given
+ */
+uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL);
+
 #endif // MASKUTIL_H
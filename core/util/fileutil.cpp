@@ -16,6 +16,7 @@
 //Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "core/util/fileutil.h"
+#include "core/util/bitutil.h"
 #include "core/util/iterutil.h"
 
 #include <fstream>
@@ -85,3 +86,18 @@ bool fileCompare(const std::string &path1, const std::string &path2)
 
     return file1.eof() == file2.eof();
 }
+
+uint64_t fileDigest(const std::string &path)
+{
+    std::ifstream file(path, std::ios_base::binary);
+    if (!file.good()) {
+        return 0;
+    }
+
+    uint64_t hash = hashBytes(nullptr, 0);
+    char buffer[65536];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+        hash = hashBytes(buffer, file.gcount(), hash);
+    }
+    return hash;
+}
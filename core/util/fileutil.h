@@ -18,6 +18,7 @@
 #ifndef FILEUTIL_H
 #define FILEUTIL_H
 
+#include <stdint.h>
 #include <string>
 #include <vector>
 
@@ -39,4 +40,9 @@ void getDirContent(const std::string& path, std::vector<std::string>& content);
 
 bool fileCompare(const std::string& path1, const std::string& path2);
 
+/**
+ * @brief Get a hash of the content of a file, 0 if it cannot be read
+ */
+uint64_t fileDigest(const std::string& path);
+
 #endif // FILEUTIL_H
@@ -62,7 +62,8 @@ Variable ArrayScope::doGetField(const Variant &key, bool /*modifiable*/, bool cr
         }
     } else if (key.type() == Variant::stringType) {
 
-        const std::string& name = key.toString();
+        std::string buffer;
+        const std::string& name = key.toString(buffer);
         if (name[0] == '@') {
             auto it = reserved.find(name);
             if (it == reserved.end()) {
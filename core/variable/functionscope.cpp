@@ -30,7 +30,8 @@ Variable FunctionScope::doGetField(const Variant &key, bool /*modifiable*/, bool
             return Variable();
         }
     } else if (key.type() == Variant::stringType) {
-        const std::string& name = key.toString();
+        std::string buffer;
+        const std::string& name = key.toString(buffer);
         auto it = _namedFields.find(name);
         if (it != _namedFields.end()) {
             return it->second;
@@ -100,7 +100,8 @@ Variable ObjectAttributes::doGetField(const Variant &key, bool /*modifiable*/, b
             return Variable();
         }
     } else if (key.type() == Variant::stringType) {
-        const std::string& name = key.toString();
+        std::string buffer;
+        const std::string& name = key.toString(buffer);
         auto it = _namedFields.find(name);
         if (it != _namedFields.end()) {
             return collector().ref(it->second);
@@ -49,6 +49,23 @@ const std::unordered_map<std::string, int> reserved = {
     {"@parser",           A_PARSER}
 };
 
+// Names looked up by the scripts are interned once per thread, rather than
+// locking the atom table at each look up. The cache is emptied once full, since
+// scripts may look up the elements of large arrays by name.
+static Atom nameAtom(const std::string& name)
+{
+    static const size_t maxCachedNameCount = 4096;
+    static thread_local std::unordered_map<std::string, Atom> atoms;
+    auto it = atoms.find(name);
+    if (it == atoms.end()) {
+        if (atoms.size() >= maxCachedNameCount) {
+            atoms.clear();
+        }
+        it = atoms.insert(std::make_pair(name, Atom(name))).first;
+    }
+    return it->second;
+}
+
 class ObjectPosVariableImplementation : public VariableImplementation
 {
 public:
@@ -118,7 +135,7 @@ protected:
     }
 
     virtual Variant doGetValue() override {
-        return Variant((long long) _object.size());
+        return Variant((long long) _object.fullSize());
     }
 private:
     Object& _object;
@@ -186,10 +203,16 @@ protected:
     virtual Variant doGetValue() override {
         switch (_object.endianness()) {
             case Object::bigEndian:
-                return Variant("bigEndian");
+            {
+                static const std::string name("bigEndian");
+                return Variant::view(name);
+            }
 
             case Object::littleEndian:
-                return Variant("littleEndian");
+            {
+                static const std::string name("littleEndian");
+                return Variant::view(name);
+            }
         }
         return Variant();
     }
@@ -200,7 +223,8 @@ private:
 
 ObjectScope::ObjectScope(Object &object)
     : VariableImplementation(object.collector()),
-      _object(object)
+      _object(object),
+      _pin(&object)
 {
 }
 
@@ -213,6 +237,19 @@ ObjectScope::ObjectScope(std::shared_ptr<ContainerParser *> sharedParserAccess)
 {
 }
 
+ObjectScope::~ObjectScope()
+{
+    // Destroyed by the collector, under the lock the object revives its scope with
+    if (_pin.get() != nullptr) {
+        _object._scope = nullptr;
+    }
+}
+
+void ObjectScope::detach()
+{
+    _pin.reset();
+}
+
 void ObjectScope::collect(const VariableAdder &addAccessible)
 {
     addAccessible(_parserScope);
@@ -236,7 +273,8 @@ Variable ObjectScope::doGetField(const Variant &key, bool /*modifiable*/, bool c
 
     } else if (key.type() == Variant::stringType) {
 
-        const std::string& name = key.toString();
+        std::string buffer;
+        const std::string& name = key.toString(buffer);
         if (name[0] == '@')
         {
             auto it = reserved.find(name);
@@ -275,7 +313,7 @@ Variable ObjectScope::doGetField(const Variant &key, bool /*modifiable*/, bool c
                         return Variable(new ObjectAbsPosVariableImplementation(_object), true);
 
                     case A_REM:
-                        return collector().copy(_object.size() - _object.pos());
+                        return collector().copy(_object.remainingSize());
 
                     case A_NUMBER_OF_CHILDREN:
                         _object.explore(1);
@@ -318,7 +356,7 @@ Variable ObjectScope::doGetField(const Variant &key, bool /*modifiable*/, bool c
             }
         } else {
             if (_sharedType) {
-                Object* elem = _object.lookUp(name, false);
+                Object* elem = _object.lookUp(nameAtom(name), false);
                 if (elem != nullptr) {
                     return elem->variable();
                 } else {
@@ -333,7 +371,7 @@ Variable ObjectScope::doGetField(const Variant &key, bool /*modifiable*/, bool c
                     }
                 }
             } else {
-                Object* elem = _object.lookUp(name, true);
+                Object* elem = _object.lookUp(nameAtom(name), true);
                 if (elem != nullptr) {
                     return elem->variable();
                 } else {
@@ -11,8 +11,13 @@ class Object;
 class ObjectScope : public VariableImplementation
 {
 public:
+    /** @brief Scope of the \link Object::variable() variable\endlink of the object, pinning it*/
     ObjectScope(Object& object);
     ObjectScope(std::shared_ptr<ContainerParser*> sharedParserAccess);
+    ~ObjectScope();
+
+    /** @brief Forgets the object, destroyed before the scope*/
+    void detach();
 
     virtual void collect(const VariableAdder &addAccessible) override;
 protected:
@@ -25,6 +30,7 @@ private:
     std::shared_ptr< std::pair<bool, ObjectType> > _sharedType;
     std::shared_ptr< ContainerParser* > _sharedParserAccess;
     VariableMemory _parserScope;
+    Object::Pin _pin;
 };
 
 #endif // OBJECTSCOPEIMPLEMENTATION_H
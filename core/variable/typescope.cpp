@@ -61,6 +61,30 @@ private:
     const ObjectType& _type;
 };
 
+class TypeParameterVariableImplementation : public VariableImplementation
+{
+public:
+    TypeParameterVariableImplementation(VariableCollector& collector, ObjectType& type, size_t index)
+        : VariableImplementation(collector),
+          _type(type),
+          _index(index)
+    {
+
+    }
+
+protected:
+    virtual void doSetValue(const Variant& value) override {
+        _type.setParameter(_index, value);
+    }
+
+    virtual Variant doGetValue() override {
+        return _type.parameterValue(_index);
+    }
+private:
+    ObjectType& _type;
+    size_t _index;
+};
+
 class TypeElementTypeVariableImplementation : public VariableImplementation
 {
 public:
@@ -235,7 +259,7 @@ Variable AbstractTypeScope::doGetField(const Variant &key, bool modifiable, bool
 
     if (parameterIndex != -1) {
         if(mType) {
-            return collector().ref(mType->parameterValue(parameterIndex));
+            return Variable(new TypeParameterVariableImplementation(collector(), *mType, parameterIndex), true);
         } else {
             return collector().copy(cType.parameterValue(parameterIndex));
         }
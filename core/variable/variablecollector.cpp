@@ -25,6 +25,7 @@ VariableCollector::~VariableCollector()
 
 void VariableCollector::collect()
 {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
     compact();
 
     size_t i = 0;
@@ -72,6 +73,7 @@ void VariableCollector::collect()
 
 void VariableCollector::removeDirectlyAccessible(VariableImplementation *variable)
 {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
     auto rit = _directlyAccessible.rbegin();
     auto rend = _directlyAccessible.rend();
 
@@ -1,6 +1,7 @@
 #ifndef VARIABLECOLLECTOR_H
 #define VARIABLECOLLECTOR_H
 
+#include <mutex>
 #include <vector>
 #include <unordered_map>
 
@@ -8,6 +9,12 @@
 
 class VariableImplementation;
 
+/**
+ * @brief Owns the \link Variable variables\endlink and destroys those no longer accessible
+ *
+ * The variables of a tree may be created and destroyed by several threads exploring it
+ * at once, so that the bookkeeping is done under a lock.
+ */
 class VariableCollector
 {
 public:
@@ -17,14 +24,26 @@ public:
     void collect();
 
     inline void registerVariable(VariableImplementation* variable) {
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
         _accessibility.insert(std::make_pair(variable, false));
-        addDirectlyAccessible(variable);
+        _directlyAccessible.push_back(variable);
     }
     inline void addDirectlyAccessible(VariableImplementation* variable) {
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
         _directlyAccessible.push_back(variable);
     }
     void removeDirectlyAccessible(VariableImplementation* variable);
 
+    /**
+     * @brief Runs a function under the lock the variables are destroyed with, for the
+     * implementations only referred to weakly to be reset or revived safely
+     */
+    template<class Function>
+    inline void synchronize(const Function& function) {
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
+        function();
+    }
+
 
     /**
      * @brief Construct a \link Variable variable\endlink copying and then owning a value
@@ -91,6 +110,8 @@ public:
 private:
     void compact();
 
+    // Recursive since destroying a variable may release the ones it holds
+    std::recursive_mutex _mutex;
     bool _destroying;
     std::vector<VariableImplementation*> _directlyAccessible;
     std::unordered_map<VariableImplementation*, bool> _accessibility;
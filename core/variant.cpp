@@ -16,6 +16,7 @@
 //Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include <algorithm> //swap
+#include <cstring>
 #include <sstream>
 #include <iomanip>
 
@@ -49,8 +50,9 @@ Variant::Variant(const Variant& other)
             break;
 
         case stringType:
-            _data.s = other._data.s;
-            if (this != &other) {
+            _data = other._data;
+            std::memcpy(_rest, other._rest, sizeof(_rest));
+            if (this != &other && (_type & storageMask) == 0) {
                 ++_data.s->second;
             }
 
@@ -72,6 +74,7 @@ Variant::Variant(Variant&& other)
     : _data(other._data),
       _type(other._type)
 {
+    std::memcpy(_rest, other._rest, sizeof(_rest));
     other._type = undefinedType;
 }
 
@@ -130,19 +133,27 @@ Variant::Variant(double f) : _type(floatingType)
     _data.f = f;
 }
 
-Variant::Variant(const std::string& s) : _type(stringType)
+Variant::Variant(const std::string& s)
 {
-    _data.s = new std::pair<std::string, int>(s, 1);
+    setString(s.data(), s.size());
 }
 
-Variant::Variant(const char* s) : _type(stringType)
+Variant::Variant(const char* s)
 {
-    _data.s = new std::pair<std::string, int>(s, 1);
+    setString(s, std::strlen(s));
+}
+
+Variant Variant::view(const std::string &s)
+{
+    Variant variant;
+    variant._type = stringType | borrowedStorage;
+    variant._data.v = &s;
+    return variant;
 }
 
 Variant::Variant(const ObjectType& t) : _type(objectType)
 {
-    _data.t = new std::pair<ObjectType, int>(t, 1);
+    _data.t = new std::pair<ObjectType, std::atomic<int> >(t, 1);
 }
 
 Variant::~Variant()
@@ -156,6 +167,7 @@ void swap(Variant &a, Variant &b)
 
     swap(a._type, b._type);
     swap(a._data, b._data);
+    swap(a._rest, b._rest);
 }
 
 Variant& Variant::operator=(Variant other)
@@ -248,22 +260,20 @@ void Variant::setValue(double f)
 void Variant::setValue(const std::string& s)
 {
     clear();
-    _type = stringType;
-    _data.s = new std::pair<std::string, int>(s, 1);
+    setString(s.data(), s.size());
 }
 
 void Variant::setValue(const char* s)
 {
     clear();
-    _type = stringType;
-    _data.s = new std::pair<std::string, int>(s, 1);
+    setString(s, std::strlen(s));
 }
 
 void Variant::setValue(const ObjectType& t)
 {
     clear();
     _type = objectType;
-    _data.t = new std::pair<ObjectType, int>(t, 1);
+    _data.t = new std::pair<ObjectType, std::atomic<int> >(t, 1);
 }
 
 void Variant::clear()
@@ -271,7 +281,7 @@ void Variant::clear()
     switch(_type & superTypeMask)
     {
         case stringType:
-            if (!--_data.s->second) {
+            if ((_type & storageMask) == 0 && !--_data.s->second) {
                 delete _data.s;
             }
             break;
@@ -288,6 +298,55 @@ void Variant::clear()
     _type = valuelessType;
 }
 
+const char *Variant::stringData() const
+{
+    switch (_type & storageMask) {
+        case inlineStorage:
+            return reinterpret_cast<const char*>(this);
+        case borrowedStorage:
+            return _data.v->data();
+        default:
+            return _data.s->first.data();
+    }
+}
+
+size_t Variant::stringSize() const
+{
+    switch (_type & storageMask) {
+        case inlineStorage:
+            return static_cast<unsigned char>(_rest[sizeof(_rest) - 1]);
+        case borrowedStorage:
+            return _data.v->size();
+        default:
+            return _data.s->first.size();
+    }
+}
+
+void Variant::setString(const char *data, size_t size)
+{
+    static_assert(inlineCapacity + 1 == sizeof(Data) + sizeof(_rest) && sizeof(Variant) == inlineCapacity + 2,
+                  "Inline strings take every byte of the variant but the type");
+    if (size <= inlineCapacity) {
+        _type = stringType | inlineStorage;
+        std::memcpy(reinterpret_cast<char*>(this), data, size);
+        _rest[sizeof(_rest) - 1] = static_cast<char>(size);
+    } else {
+        _type = stringType;
+        _data.s = new std::pair<std::string, std::atomic<int> >(std::string(data, size), 1);
+    }
+}
+
+int Variant::compareStrings(const Variant &other) const
+{
+    const size_t size = stringSize();
+    const size_t otherSize = other.stringSize();
+    const int comparison = std::memcmp(stringData(), other.stringData(), std::min(size, otherSize));
+    if (comparison != 0) {
+        return comparison;
+    }
+    return size < otherSize ? -1 : (size > otherSize ? 1 : 0);
+}
+
 
 bool Variant::canConvertTo(Variant::Type otherType) const
 {
@@ -400,25 +459,46 @@ double Variant::toDouble() const
     }
 }
 
-const std::string& Variant::toString() const
+std::string Variant::toString() const
 {
     if((_type & typeMask) == stringType) {
-        return _data.s->first;
+        return std::string(stringData(), stringSize());
     } else {
         return emptyString;
     }
 }
 
+const std::string &Variant::toString(std::string &buffer) const
+{
+    if((_type & typeMask) != stringType) {
+        return emptyString;
+    }
+    switch (_type & storageMask) {
+        case inlineStorage:
+            buffer.assign(stringData(), stringSize());
+            return buffer;
+        case borrowedStorage:
+            return *_data.v;
+        default:
+            return _data.s->first;
+    }
+}
+
 std::string& Variant::toMutableString()
 {
     if((_type & typeMask) == stringType) {
-        // copy if shared
-        if (_data.s->second > 1) {
-            this->setValue(_data.s->first);
+        // copy if shared, inline or borrowed
+        if ((_type & storageMask) != 0 || _data.s->second > 1) {
+            std::pair<std::string, std::atomic<int> >* copy = new std::pair<std::string, std::atomic<int> >(toString(), 1);
+            clear();
+            _type = stringType;
+            _data.s = copy;
         }
     } else {
         Log::error("Invalid conversion from ", (*this), " to string");
-        this->setValue(emptyString);
+        clear();
+        _type = stringType;
+        _data.s = new std::pair<std::string, std::atomic<int> >(emptyString, 1);
     }
     return _data.s->first;
 }
@@ -457,7 +537,7 @@ bool Variant::toBool() const
         case floatingType:
             return _data.f != 0.;
         case stringType:
-            return !_data.s->first.empty();
+            return stringSize() != 0;
         case objectType:
             return !_data.t->first.isNull();
         default:
@@ -504,6 +584,21 @@ bool Variant::isValueless() const
     return (_type & superTypeMask) == valuelessType;
 }
 
+bool Variant::hasSharedData() const
+{
+    switch(_type & superTypeMask)
+    {
+        case stringType:
+            return (_type & storageMask) == 0;
+
+        case objectType:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
 bool Variant::isNull() const
 {
     return (_type & typeMask) == nullType;
@@ -519,6 +614,11 @@ void Variant::setDisplayType(Variant::Display display)
     _type = (_type & ~displayMask) | display;
 }
 
+Variant::Display Variant::displayType() const
+{
+    return static_cast<Display>(_type & displayMask);
+}
+
 void Variant::setDisplayBase(int base)
 {
     Variant::Display display;
@@ -605,7 +705,7 @@ std::ostream& Variant::display(std::ostream& out, bool setFlags) const
                 break;
 
             case stringType:
-                out<<_data.s->first;
+                out<<toString();
                 break;
 
             case objectType:
@@ -645,7 +745,7 @@ std::ostream& Variant::simpleDisplay(std::ostream& out) const
 			break;
 
 		case stringType:
-            out<<"\""<<_data.s->first<<"\"";
+            out<<"\""<<toString()<<"\"";
 			break;
 
 		case objectType:
@@ -687,7 +787,7 @@ bool operator==(const Variant& a, const Variant& b)
                 }
 
             case Variant::stringType:
-                return a._data.s->first == b._data.s->first;
+                return a.compareStrings(b) == 0;
 
             case Variant::objectType:
                 return a._data.t->first == b._data.t->first;
@@ -729,7 +829,7 @@ bool operator< (const Variant& a, const Variant& b)
                 }
 
             case Variant::stringType:
-                return a._data.s->first < b._data.s->first;
+                return a.compareStrings(b) < 0;
 
             case Variant::objectType:
                 return a._data.t->first < b._data.t->first;
@@ -763,7 +863,7 @@ bool operator<=(const Variant& a, const Variant& b)
                 }
 
             case Variant::stringType:
-                return a._data.s->first <= b._data.s->first;
+                return a.compareStrings(b) <= 0;
 
             case Variant::objectType:
                 return a._data.t->first <= b._data.t->first;
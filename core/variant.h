@@ -18,6 +18,7 @@
 #ifndef VARIANT_H
 #define VARIANT_H
 
+#include <atomic>
 #include <exception>
 #include <iostream>
 #include <string>
@@ -29,6 +30,9 @@ class ObjectType;
  *
  * Can hold: 64 bits signed integers (integer), 64 bits unsigned integers (unsignedInteger),
  * 64 bits floating points (floating), strings (string) and \link ObjectType object types\endlink (objectType).
+ *
+ * Short strings are stored inline, longer ones are shared between copies, and strings
+ * of immutable data can be \link view() borrowed\endlink.
  * By default the \link Variant variant\endlink's value is not defined and the type is unknown, in which case
  * most operations will fail, and the value is value is null.
  *
@@ -94,6 +98,12 @@ public:
     Variant(const std::string& s);
     Variant(const char* s);
 
+    /**
+     * @brief String borrowed without being copied, from an immutable string outliving
+     * the variant and all its copies, such as a static one
+     */
+    static Variant view(const std::string& s);
+
     Variant(const ObjectType& t);
 
     ~Variant();
@@ -130,7 +140,12 @@ public:
     long long          toInteger()         const;
     unsigned long long toUnsignedInteger() const;
     double             toDouble()          const;
-    const std::string& toString()          const;
+    std::string        toString()          const;
+    /**
+     * @brief String without a copy when it is shared or borrowed, inline ones
+     * being copied into the buffer
+     */
+    const std::string& toString(std::string& buffer) const;
     std::string&       toMutableString()        ;
     const ObjectType&  toObjectType()      const;
     ObjectType&        toMutableObjectType()    ;
@@ -141,6 +156,8 @@ public:
     bool isValueless() const;
     bool isNull() const;
     bool isUndefined() const;
+    /** @brief Checks if the value is shared with its copies, and must be released when cleared*/
+    bool hasSharedData() const;
 
     friend bool operator==(const Variant& a, const Variant& b);
     friend bool operator< (const Variant& a, const Variant& b);
@@ -171,6 +188,7 @@ public:
     bool operator!() const;
 
     void setDisplayType(Display display);
+    Display displayType() const;
     void setDisplayBase(int base);
 
     std::ostream& display(std::ostream& out, bool setFlags = true) const;
@@ -188,17 +206,31 @@ private:
         long long l;
         unsigned long long ul;
         double f;
-        std::pair<std::string, int>* s;
-        std::pair<ObjectType, int>* t;
+        // Shared between copies, counted atomically so that copies can be made from several threads
+        std::pair<std::string, std::atomic<int> >* s;
+        std::pair<ObjectType, std::atomic<int> >* t;
+        // Borrowed strings
+        const std::string* v;
     } Data;
 
+    const char* stringData() const;
+    size_t stringSize() const;
+    void setString(const char* data, size_t size);
+    int compareStrings(const Variant& other) const;
+
     Data    _data;
+    // Inline strings take the bytes of the data and of the rest, their size in the last one
+    char    _rest[7];
     uint8_t _type;
 
     static const uint8_t superTypeMask = 0x03;
     static const uint8_t typeMask = 0x0f;
     static const uint8_t displayMask = 0x30;
     static const uint8_t signedBit = 0x04;
+    static const uint8_t storageMask = 0xc0;
+    static const uint8_t inlineStorage = 0x40;
+    static const uint8_t borrowedStorage = 0x80;
+    static const size_t inlineCapacity = 14;
 };
 
 void swap(Variant& a, Variant& b);
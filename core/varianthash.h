@@ -4,6 +4,7 @@
 #include "core/variant.h"
 #include "core/objecttype.h"
 #include "core/objecttypetemplate.h"
+#include "core/util/bitutil.h"
 
 #include <functional>
 
@@ -40,14 +41,13 @@ namespace std
                 }
 
                 case Variant::stringType:
-                {
-                    result = std::hash<std::string>()(value._data.s->first);
+                    // The same bytes hash alike whether they are inline, shared or borrowed
+                    result = static_cast<std::size_t>(hashBytes(value.stringData(), value.stringSize()));
                     break;
-                }
 
                 case Variant::objectType:
                 {
-                    result = std::hash<std::string>()(value._data.t->first.typeTemplate().name());
+                    result = value._data.t->first.hash();
                     break;
                 }
 
@@ -0,0 +1,145 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "core/virtualchildren.h"
+#include "core/object.h"
+#include "core/util/strutil.h"
+
+namespace {
+// Elements kept built once no longer in use
+const size_t keptElementCount = 1024;
+}
+
+VirtualChildren::VirtualChildren(const Module &module, const ObjectType &elementType, std::streamoff firstPos,
+                                 std::streamoff elementSize, int64_t count, const std::vector<std::string> &nameParts)
+    : _module(module),
+      _elementType(elementType),
+      _firstPos(firstPos),
+      _elementSize(elementSize),
+      _count(count),
+      _nameParts(nameParts)
+{
+}
+
+VirtualChildren::~VirtualChildren()
+{
+    for (const auto& element : _elements) {
+        delete element.second.object;
+    }
+}
+
+const Module &VirtualChildren::module() const
+{
+    return _module;
+}
+
+const ObjectType &VirtualChildren::elementType() const
+{
+    return _elementType;
+}
+
+int64_t VirtualChildren::count() const
+{
+    return _count;
+}
+
+std::streamoff VirtualChildren::elementPos(int64_t index) const
+{
+    return _firstPos + index * _elementSize;
+}
+
+std::streamoff VirtualChildren::elementSize() const
+{
+    return _elementSize;
+}
+
+std::string VirtualChildren::elementName(int64_t index) const
+{
+    if (_nameParts.size() == 1) {
+        return _nameParts[0];
+    } else {
+        return join(_nameParts, toStr(index));
+    }
+}
+
+int64_t VirtualChildren::elementIndex(const std::string &name) const
+{
+    if (_nameParts.size() == 1) {
+        return (name == _nameParts[0] && _count > 0) ? _count - 1 : -1;
+    }
+
+    const std::string& prefix = _nameParts[0];
+    if (name.compare(0, prefix.size(), prefix) != 0) {
+        return -1;
+    }
+
+    size_t end = prefix.size();
+    while (end < name.size() && name[end] >= '0' && name[end] <= '9') {
+        ++end;
+    }
+    if (end == prefix.size() || end - prefix.size() > 18) {
+        return -1;
+    }
+
+    const int64_t index = std::stoll(name.substr(prefix.size(), end - prefix.size()));
+    if (index < _count && elementName(index) == name) {
+        return index;
+    } else {
+        return -1;
+    }
+}
+
+Object *VirtualChildren::element(int64_t index)
+{
+    const auto it = _elements.find(index);
+    if (it == _elements.end()) {
+        return nullptr;
+    }
+    _recentUse.splice(_recentUse.begin(), _recentUse, it->second.recentUse);
+    return it->second.object;
+}
+
+void VirtualChildren::setElement(int64_t index, Object *element)
+{
+    _recentUse.push_front(index);
+    _elements[index] = Element{element, _recentUse.begin()};
+}
+
+const std::map<int64_t, VirtualChildren::Element> &VirtualChildren::elements() const
+{
+    return _elements;
+}
+
+void VirtualChildren::freeElements(const std::function<bool (const Object &)> &isUnused)
+{
+    auto it = _recentUse.end();
+    while (_elements.size() > keptElementCount && it != _recentUse.begin()) {
+        --it;
+        const auto element = _elements.find(*it);
+        if (isUnused(*element->second.object)) {
+            delete element->second.object;
+            _elements.erase(element);
+            it = _recentUse.erase(it);
+        }
+    }
+}
+
+void VirtualChildren::releaseElements()
+{
+    _elements.clear();
+    _recentUse.clear();
+}
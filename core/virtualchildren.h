@@ -0,0 +1,106 @@
+//This file is part of the HexaMonkey project, a multimedia analyser
+//Copyright (C) 2013  Sevan Drapeau-Martin, Nicolas Fleury
+
+//This program is free software; you can redistribute it and/or
+//modify it under the terms of the GNU General Public License
+//as published by the Free Software Foundation; either version 2
+//of the License, or (at your option) any later version.
+
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with this program; if not, write to the Free Software
+//Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef VIRTUALCHILDREN_H
+#define VIRTUALCHILDREN_H
+
+#include <functional>
+#include <list>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "core/objecttype.h"
+
+class Module;
+class Object;
+
+/**
+ * @brief Children of an \link Object object\endlink made of a run of elements
+ * of the same fixed size, built only when accessed
+ *
+ * The position of every element is known beforehand, so the object can report
+ * its number of children right away and build any of them on demand through
+ * the \link Module module\endlink. The elements built are owned by the store,
+ * which keeps the most recently used ones and frees the others once they are
+ * no longer in use, to be built again when accessed.
+ *
+ * Explorations leave the elements not built yet unexplored, so that a large
+ * array costs nothing until its elements are accessed.
+ */
+class VirtualChildren
+{
+public:
+    /**
+     * @param nameParts are the parts of the name pattern around the index, or
+     * the fixed name of every element if there is only one
+     */
+    VirtualChildren(const Module& module, const ObjectType& elementType, std::streamoff firstPos,
+                    std::streamoff elementSize, int64_t count, const std::vector<std::string>& nameParts);
+    ~VirtualChildren();
+
+    const Module& module() const;
+    const ObjectType& elementType() const;
+    int64_t count() const;
+
+    /** @brief Position of the element relative to the beginning of the object*/
+    std::streamoff elementPos(int64_t index) const;
+    std::streamoff elementSize() const;
+
+    std::string elementName(int64_t index) const;
+
+    /** @brief Index of the element having the name, the last one for fixed names, -1 if none*/
+    int64_t elementIndex(const std::string& name) const;
+
+    struct Element
+    {
+        Object* object;
+        std::list<int64_t>::iterator recentUse;
+    };
+
+    /** @brief Element already built, nullptr otherwise, marked as used recently*/
+    Object* element(int64_t index);
+    void setElement(int64_t index, Object* element);
+
+    const std::map<int64_t, Element>& elements() const;
+
+    /**
+     * @brief Frees the least recently used elements over the number kept, among
+     * those the predicate tells are not in use
+     */
+    void freeElements(const std::function<bool(const Object&)>& isUnused);
+
+    /** @brief Gives up the ownership of the elements built*/
+    void releaseElements();
+
+private:
+    const Module& _module;
+    ObjectType _elementType;
+    std::streamoff _firstPos;
+    std::streamoff _elementSize;
+    int64_t _count;
+    std::vector<std::string> _nameParts;
+    std::map<int64_t, Element> _elements;
+    // Indices of the elements built, most recently used first
+    std::list<int64_t> _recentUse;
+
+    VirtualChildren& operator=(const VirtualChildren&) = delete;
+    VirtualChildren(const VirtualChildren&) = delete;
+};
+
+#endif // VIRTUALCHILDREN_H
@@ -19,8 +19,10 @@
 #include <QHBoxLayout>
 #include <QTableWidget>
 #include <QApplication>
+#include <QInputDialog>
 
 #include "core/moduleloader.h"
+#include "core/file/mappedfile.h"
 #include "core/interpreter/programloader.h"
 #include "core/modules/default/defaultmodule.h"
 #include "core/modules/stream/streammodule.h"
@@ -42,6 +44,7 @@ MainWindow::MainWindow(ModuleLoader &moduleLoader, const ProgramLoader &programL
     treeWidget = new TreeWidget(programLoader, this);
     hexFileWidget = new HexFileWidget(this);
     logWidget = new LogWidget();
+    applyMemoryBudget(QSettings().value("memoryBudget", 0).toInt());
 
     setCentralWidget(new QWidget(this));
     QHBoxLayout* layout = new QHBoxLayout(centralWidget());
@@ -92,7 +95,12 @@ void MainWindow::openFiles(QStringList paths)
 
 void MainWindow::openFile(const std::string& path)
 {
-    RealFile* file = new RealFile();
+    File* file;
+    if (mappedFileAct->isChecked()) {
+        file = new MappedFile();
+    } else {
+        file = new RealFile();
+    }
     file->setPath(path);
     if (!file->good())
     {
@@ -144,6 +152,40 @@ void MainWindow::createActions()
     refreshAct = new QAction(tr("Recompile scripts"), this);
     refreshAct->setShortcuts(QKeySequence::Refresh);
     connect(refreshAct, SIGNAL(triggered()), this, SLOT(refreshScripts()));
+
+    mappedFileAct = new QAction(tr("Memory-mapped files"), this);
+    mappedFileAct->setStatusTip(tr("Read files opened from now on through a memory mapping"));
+    mappedFileAct->setCheckable(true);
+    mappedFileAct->setChecked(QSettings().value("useMappedFiles", false).toBool());
+    connect(mappedFileAct, SIGNAL(toggled(bool)), this, SLOT(setUseMappedFiles(bool)));
+
+    memoryBudgetAct = new QAction(tr("Memory budget..."), this);
+    memoryBudgetAct->setStatusTip(tr("Bound the memory held by the tree of each file opened from now on"));
+    connect(memoryBudgetAct, SIGNAL(triggered()), this, SLOT(chooseMemoryBudget()));
+}
+
+void MainWindow::setUseMappedFiles(bool useMappedFiles)
+{
+    QSettings settings;
+    settings.setValue("useMappedFiles", useMappedFiles);
+}
+
+void MainWindow::chooseMemoryBudget()
+{
+    QSettings settings;
+    bool ok;
+    const int megabytes = QInputDialog::getInt(this, tr("Memory budget"),
+                                               tr("MiB held by the tree of each file opened from now on, 0 for no bound:"),
+                                               settings.value("memoryBudget", 0).toInt(), 0, 1 << 20, 64, &ok);
+    if (ok) {
+        settings.setValue("memoryBudget", megabytes);
+        applyMemoryBudget(megabytes);
+    }
+}
+
+void MainWindow::applyMemoryBudget(int megabytes)
+{
+    treeWidget->setMemoryBudget(megabytes > 0 ? qint64(megabytes) * 1024 * 1024 : -1);
 }
 
 void MainWindow::refreshScripts()
@@ -167,6 +209,8 @@ void MainWindow::createMenus()
     fileMenu = menuBar()->addMenu(tr("&File"));
     fileMenu->addAction(openAct);
     fileMenu->addAction(refreshAct);
+    fileMenu->addAction(mappedFileAct);
+    fileMenu->addAction(memoryBudgetAct);
     separatorAct = fileMenu->addSeparator();
     for (int i = 0; i < maxRecentFiles; ++i)
         fileMenu->addAction(recentFileActs[i]);
@@ -80,16 +80,21 @@ private slots:
     void openRecentFile();
     void updateRecentFileActions();
     void refreshScripts();
+    void setUseMappedFiles(bool useMappedFiles);
+    void chooseMemoryBudget();
 
 private:
     void openFiles(QStringList paths);
     void createActions();
     void createMenus();
+    void applyMemoryBudget(int megabytes);
 
 
     QMenu *fileMenu;
     QAction *openAct;
     QAction *refreshAct;
+    QAction *mappedFileAct;
+    QAction *memoryBudgetAct;
     QMenu *recentFilesMenu;
     QAction *separatorAct;
 
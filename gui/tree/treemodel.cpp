@@ -17,6 +17,7 @@
 
 #include <QMessageBox>
 
+#include "core/exploration.h"
 #include "core/modules/default/defaultmodule.h"
 #include "gui/tree/treemodel.h"
 #include "gui/tree/treeitem.h"
@@ -27,7 +28,8 @@ TreeModel::TreeModel(const QString &/*data*/, const ProgramLoader &programLoader
     QAbstractItemModel(parent),
     view(view),
     programLoader(programLoader),
-    threadQueue(new ThreadQueue(this))
+    threadQueue(new ThreadQueue(this)),
+    memoryBudget(-1)
 {
     QList<QVariant> rootData;
     rootData << "Struct" << "Beginning position" << "Size";
@@ -59,7 +61,11 @@ QModelIndex TreeModel::addFile(File* file, const Module& module)
     beginInsertRows(QModelIndex(),0,0);
 
     TreeFileItem& item = *(new TreeFileItem(programLoader, rootItem, file));
-    item.setObjectMemory(module.handleFile(DefaultModule::file(), item.file(), item.collector()));
+    Object* object = module.handleFile(DefaultModule::file(), item.file(), item.collector());
+    item.setObjectMemory(object);
+    if (object != nullptr && memoryBudget >= 0) {
+        object->setMemoryBudget(memoryBudget);
+    }
 
     QModelIndex itemIndex = index(realRowCount(QModelIndex())-1, 0, QModelIndex());
 
@@ -67,6 +73,11 @@ QModelIndex TreeModel::addFile(File* file, const Module& module)
     return itemIndex;
 }
 
+void TreeModel::setMemoryBudget(qint64 size)
+{
+    memoryBudget = size;
+}
+
 QModelIndex TreeModel::currentFileIndex() const
 {
     QModelIndex fileIndex = current;
@@ -283,7 +294,7 @@ void TreeModel::updateFilter(QString expression)
         if(!item.updateFilter(expression.toStdString()) && expression != "")
             emit invalidFilter();
 
-        populate(current, defaultPopulation, defaultPopulation/minPopulationRatio, populationTries);
+        populate(current, defaultPopulation, defaultPopulation/minPopulationRatio, populationTime);
     }
 }
 
@@ -293,11 +304,11 @@ void TreeModel::requestExpansion(const QModelIndex &i)
     {
         QModelIndex realIndex = index(i.row(), 0, i.parent());
         if(!static_cast<TreeItem*>(realIndex.internalPointer())->synchronised())
-            populate(realIndex, defaultPopulation, defaultPopulation/minPopulationRatio, populationTries);
+            populate(realIndex, defaultPopulation, defaultPopulation/minPopulationRatio, populationTime);
     }
 }
 
-void TreeModel::populate(const QModelIndex &index, unsigned int nominalCount, unsigned int minCount, unsigned int maxTries)
+void TreeModel::populate(const QModelIndex &index, unsigned int nominalCount, unsigned int minCount, int64_t maxTime)
 {
     TreeObjectItem& item = *static_cast<TreeObjectItem*>(index.internalPointer());
     Object& object = item.object();
@@ -309,16 +320,16 @@ void TreeModel::populate(const QModelIndex &index, unsigned int nominalCount, un
     } else {
         if (!item.synchronising()) {
             item.setSynchronising(true);
-            threadQueue->add([&object, nominalCount, minCount, maxTries] {
+            threadQueue->add([&object, nominalCount, minCount, maxTime] {
                 VariableCollectionGuard guard(object.collector());
 
-                int minNumberOfChildren = object.numberOfChildren() + minCount;
-
-                for (unsigned int tries = 0;
-                     object.numberOfChildren() < minNumberOfChildren && !object.parsed() && tries < maxTries;
-                     ++tries) {
-                     object.exploreSome(nominalCount);
-                }
+                // Stops once enough children are added, or stalled or out of time for
+                // the jobs queued after it to run
+                Exploration exploration(object, 1);
+                exploration.setBatchSize(nominalCount);
+                exploration.setNodeBudget(minCount);
+                exploration.setTimeBudget(maxTime);
+                exploration.run();
             }, [this, &index] (int id) {
                 parsingIds.insert(id, index);
             });
@@ -339,7 +350,7 @@ void TreeModel::updateCurrent(const QModelIndex &index)
                 int row = currentItem.row();
                 int totalRowCount = realRowCount(current.parent());
                 if (row>=totalRowCount-defaultPopulation/minPopulationRatio) {
-                    populate(current.parent(), defaultPopulation, defaultPopulation/minPopulationRatio, populationTries);
+                    populate(current.parent(), defaultPopulation, defaultPopulation/minPopulationRatio, populationTime);
                 }
             }
         }
@@ -371,65 +382,18 @@ int TreeModel::findItemChildByFilePosition(const QModelIndex &index, qint64 byte
     qint64 bitPos = 8*bytePos;
 
     if (object->includesPos(bitPos)) {
-        Object* currentObject = object;
-        QList<size_t> result;
-        bool success = false;
-
-        while (true) {
-            if (currentObject->parsed() && currentObject->numberOfChildren() == 0) {
-                success = true;
-                break;
-            } else {
-                bool found = false;
-                for (int i = 0; true; ++i) {
-                    Object* child = currentObject->access(i);
-                    if (child == nullptr) {
-                        break;
-                    } else if (child->includesPos(bitPos)) {
-                        currentObject = child;
-                        found = true;
-                        result.append(i);
-                        break;
-                    }
-                }
+        Object* descendant = object->descendantAtPosition(bitPos);
 
-                if (!found) {
-                    if (currentObject->parsed()) {
-                        success = true;
-                    }
-                    break;
-                }
+        if (descendant->parsed()) {
+            QList<size_t> result;
+            for (const Object* current = descendant; current != object; current = current->parent()) {
+                result.prepend(current->rank());
             }
-        }
-
-        if (success) {
             resultCallback(result);
         } else {
             threadQueue->add([object, bitPos] {
                 VariableCollectionGuard guard(object->collector());
-
-                Object* currentObject = object;
-                while (true) {
-                    if (currentObject->parsed() && currentObject->numberOfChildren() == 0) {
-                        break;
-                    } else {
-                        bool found = false;
-                        for (int i = 0; true; ++i) {
-                            Object* child = currentObject->access(i, true);
-                            if (child == nullptr) {
-                                break;
-                            } else if (child->includesPos(bitPos)) {
-                                currentObject = child;
-                                found = true;
-                                break;
-                            }
-                        }
-
-                        if (!found) {
-                            break;
-                        }
-                    }
-                }
+                object->descendantAtPosition(bitPos, true);
             }, [this, &index, &bytePos, &resultCallback] (int id) {
                 exploringIds.insert(id, std::make_tuple(index, bytePos, resultCallback));
             });
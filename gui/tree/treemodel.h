@@ -70,12 +70,13 @@ public:
     virtual int columnCount(const QModelIndex &parent = QModelIndex()) const final;
 
     QModelIndex addFile(File* file, const Module &module);
+    void setMemoryBudget(qint64 size);
     QModelIndex currentFileIndex() const;
     virtual bool removeRows(int position, int rows, const QModelIndex &parent) override;
 
     void removeItem(QModelIndex index);
 
-    void populate(const QModelIndex &index, unsigned int nominalCount, unsigned int minCount, unsigned int maxTries);
+    void populate(const QModelIndex &index, unsigned int nominalCount, unsigned int minCount, int64_t maxTime);
 
     QString rootPath();
     QString path(QModelIndex index) const;
@@ -106,13 +107,15 @@ signals:
 private:
     static const int defaultPopulation   = 64;
     static const int minPopulationRatio  = 2;
-    static const int populationTries     = 32;
+    static const int populationTime      = 500;
     QModelIndex addObject(Object &object, const QModelIndex &parent);
 
     TreeItem *rootItem;
     QModelIndex current;
     const ProgramLoader& programLoader;
     ThreadQueue* threadQueue;
+    // Bound set on the trees of the files added, negative for none
+    qint64 memoryBudget;
 
     QMap<int, QModelIndex> parsingIds;
     QMap<int, std::tuple<QModelIndex, qint64, std::function<void (const QList<size_t>&)> > > exploringIds;
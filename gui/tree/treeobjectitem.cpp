@@ -137,6 +137,7 @@ void TreeObjectItem::onChildrenRemoved()
 void TreeObjectItem::setObject(Object &object)
 {
     _object = &object;
+    _pin.reset(&object);
 }
 
 const std::string openMono = "<font face=\"Monaco,Lucia Console,DejaVu Sans Mono,Courier 10 Pitch,Nimbus Mono L,Courier New,Courier,monospace\" size=\"0\">";
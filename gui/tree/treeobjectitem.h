@@ -69,6 +69,8 @@ private:
    void doLoad() const override;
    bool isBitsetDisplay() const;
    Object* _object;
+   // Keeps the object from being evicted while it is shown
+   Object::Pin _pin;
    int64_t _index;
    Filter filter;
    bool _synchronised;
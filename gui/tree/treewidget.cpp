@@ -265,6 +265,11 @@ QModelIndex TreeWidget::addFile(File *file, const Module &module)
     return model->addFile(file, module);
 }
 
+void TreeWidget::setMemoryBudget(qint64 size)
+{
+    model->setMemoryBudget(size);
+}
+
 void TreeWidget::updatePath(QModelIndex currentIndex)
 {
     QString newPath = model->path(currentIndex);
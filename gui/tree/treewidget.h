@@ -67,6 +67,7 @@ signals:
 
 public slots:
     QModelIndex addFile(File* file, const Module &module);
+    void setMemoryBudget(qint64 size);
     void updatePath(QModelIndex currentIndex);
     void updatePosition(QModelIndex currentIndex);
     void setCurrentIndex(QModelIndex index);
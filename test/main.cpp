@@ -8,6 +8,7 @@
 #include "test_util.h"
 #include "test_variable.h"
 #include "test_parser.h"
+#include "test_file.h"
 
 #include "core/util/strutil.h"
 
@@ -23,8 +24,9 @@ int main(int argc, char** argv)
     TestUtil testUtil;
     TestVariable testVariable;
     TestParser testParser;
+    TestFile testFile;
 
-    std::vector<QObject*> testList = {&testVariant, &testFormatDetector, &testUtil, &testVariable, &testParser};
+    std::vector<QObject*> testList = {&testVariant, &testFormatDetector, &testUtil, &testVariable, &testParser, &testFile};
 
     int errorCount = 0;
     for (QObject* test : testList) {
@@ -24,7 +24,8 @@ HEADERS += \
         test_parser.h \
         ../gui/qtmodulesetup.h \
         ../gui/qtprogramloader.h \
-    test_variable.h
+    test_variable.h \
+    test_file.h
 
 SOURCES += \
 	main.cpp \
@@ -34,4 +35,5 @@ SOURCES += \
         test_parser.cpp \
         ../gui/qtmodulesetup.cpp \
         ../gui/qtprogramloader.cpp \
-    test_variable.cpp
+    test_variable.cpp \
+    test_file.cpp
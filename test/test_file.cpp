@@ -0,0 +1,598 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "test_file.h"
+#include "core/file/realfile.h"
+#include "core/file/mappedfile.h"
+#include "core/file/cachedfile.h"
+#include "core/file/prefetchingfile.h"
+#include "core/file/uringfile.h"
+#include "core/file/bitreader.h"
+#include "core/file/fragmentedfile.h"
+#include "core/util/bitutil.h"
+#include "core/moduleloader.h"
+#include "core/object.h"
+#include "core/modules/default/defaultmodule.h"
+#include "core/variable/variablecollector.h"
+
+namespace {
+const std::string filePath = "resources/format_detector/magic_ts.ts";
+
+bool sameRead(File& reference, File& file, int64_t position, int64_t count)
+{
+    const size_t byteCount = (count + 7) / 8;
+    std::vector<char> expected(byteCount, 0);
+    std::vector<char> actual(byteCount, 0);
+
+    reference.seekg(position, std::ios_base::beg);
+    reference.read(expected.data(), count);
+    file.seekg(position, std::ios_base::beg);
+    file.read(actual.data(), count);
+
+    return expected == actual && reference.tellg() == file.tellg();
+}
+
+bool sameReadAt(File& reference, File& file, int64_t position, int64_t count)
+{
+    const size_t byteCount = (count + 7) / 8;
+    std::vector<char> expected(byteCount, 0);
+    std::vector<char> actual(byteCount, 0);
+
+    reference.seekg(position, std::ios_base::beg);
+    reference.read(expected.data(), count);
+    const int64_t before = file.tellg();
+    file.readAt(position, actual.data(), count);
+
+    return expected == actual && file.tellg() == before;
+}
+
+const std::string largeFilePath = "resources/parser/test_mp3.mp3";
+// Widths of the fields of a transport stream packet header
+const int headerFields[] = {8, 1, 1, 1, 13, 2, 2, 4};
+
+// Unaligned read as implemented in RealFile before the BitReader
+void legacyRead(std::ifstream& file, char& bitPosition, char* s, int64_t count)
+{
+    if (bitPosition == 0 && count % 8 == 0) {
+        file.read(s,count/8);
+    } else {
+        int64_t bitCount = (count + bitPosition);
+        int64_t byteCount = (bitCount&7)? bitCount/8 + 1 : bitCount/8;
+        int8_t shift = byteCount*8 - bitCount;
+        uint8_t mask = lsbMask(8-bitPosition);
+
+        uint8_t buffer[byteCount];
+        file.read(reinterpret_cast<char*>(buffer),byteCount);
+
+        buffer[0] &= mask;
+        buffer[byteCount-1] >>= shift;
+        for(int i = byteCount-2; i>=0; i--) {
+            buffer[i+1] |= buffer[i] << (8-shift) ;
+            buffer[i] >>= shift;
+        }
+
+        int firstByte = (bitPosition+shift>=8)? 1 : 0;
+        for(int i = firstByte; i < byteCount; ++i) {
+            s[i-firstByte] = buffer[i];
+        }
+
+        if ((bitCount & 0x7) != 0) {
+            file.seekg(-1,std::ios_base::cur);
+        }
+        bitPosition = (count + bitPosition)  & 0x7;
+    }
+}
+
+// Reads packets at random positions, hinting the next one beforehand
+void randomRead(File& file, int64_t packetCount)
+{
+    std::srand(42);
+    int64_t next = std::rand() % (file.size() / 8 - 188);
+    for (int64_t i = 0; i < packetCount; ++i) {
+        const int64_t position = next;
+        next = std::rand() % (file.size() / 8 - 188);
+        file.prefetch(8 * next, 8 * 188);
+
+        char packet[188];
+        file.seekg(8 * position, std::ios_base::beg);
+        file.read(packet, 8 * 188);
+    }
+}
+}
+
+void TestFile::testMappedFile_read()
+{
+    RealFile realFile;
+    realFile.setPath(filePath);
+    MappedFile mappedFile;
+    mappedFile.setPath(filePath);
+
+    QVERIFY(mappedFile.good());
+    QCOMPARE(mappedFile.size(), realFile.size());
+
+    // aligned reads
+    QVERIFY(sameRead(realFile, mappedFile, 0, 8));
+    QVERIFY(sameRead(realFile, mappedFile, 8*188, 8*188));
+
+    // unaligned reads, with every bit offset and lengths up to 64 bits
+    std::srand(42);
+    for (int i = 0; i < 1000; ++i) {
+        int64_t count = 1 + std::rand() % 64;
+        int64_t position = std::rand() % (realFile.size() - count);
+        QVERIFY(sameRead(realFile, mappedFile, position, count));
+    }
+}
+
+void TestFile::testMappedFile_seekg()
+{
+    MappedFile file;
+    file.setPath(filePath);
+
+    file.seekg(-8, std::ios_base::end);
+    QCOMPARE(file.tellg(), file.size() - 8);
+
+    file.seekg(13, std::ios_base::beg);
+    file.seekg(5, std::ios_base::cur);
+    QCOMPARE(file.tellg(), int64_t(18));
+
+    // first sync byte of the transport stream
+    uint8_t syncbyte;
+    file.seekg(8*24, std::ios_base::beg);
+    file.read(reinterpret_cast<char*>(&syncbyte), 8);
+    QCOMPARE(syncbyte, uint8_t(0x47));
+    QCOMPARE(file.tellg(), int64_t(8*25));
+}
+
+void TestFile::testMappedFile_outOfFile()
+{
+    MappedFile file;
+    file.setPath(filePath);
+
+    uint16_t word;
+    file.seekg(-8, std::ios_base::end);
+    file.read(reinterpret_cast<char*>(&word), 16);
+    QVERIFY(!file.good());
+
+    file.clear();
+    QVERIFY(file.good());
+    file.seekg(0, std::ios_base::beg);
+    QCOMPARE(file.tellg(), int64_t(0));
+}
+
+void TestFile::testCachedFile_read()
+{
+    RealFile realFile;
+    realFile.setPath(filePath);
+    // Small pages so that reads cross page boundaries and pages get evicted
+    CachedFile cachedFile(new RealFile, 7, 3);
+    cachedFile.setPath(filePath);
+
+    QVERIFY(cachedFile.good());
+    QCOMPARE(cachedFile.size(), realFile.size());
+
+    QVERIFY(sameRead(realFile, cachedFile, 0, 8*100));
+
+    std::srand(42);
+    for (int i = 0; i < 1000; ++i) {
+        int64_t count = 1 + std::rand() % 64;
+        int64_t position = std::rand() % (realFile.size() - count);
+        QVERIFY(sameRead(realFile, cachedFile, position, count));
+    }
+
+    // The size is read once the underlying file is set up, not when it is wrapped
+    RealFile* underlyingFile = new RealFile;
+    CachedFile wrappedFile(underlyingFile, 7, 3);
+    underlyingFile->setPath(filePath);
+    QCOMPARE(wrappedFile.size(), realFile.size());
+    QVERIFY(sameRead(realFile, wrappedFile, 0, 8*100));
+}
+
+void TestFile::testCachedFile_hitCount()
+{
+    CachedFile file(new RealFile, 64, 2);
+    file.setPath(filePath);
+
+    uint8_t byte;
+    for (int i = 0; i < 64; ++i) {
+        file.read(reinterpret_cast<char*>(&byte), 8);
+    }
+    QCOMPARE(file.missCount(), uint64_t(1));
+    QCOMPARE(file.hitCount(), uint64_t(63));
+
+    // the third page evicts the first one
+    file.seekg(8*64*2, std::ios_base::beg);
+    file.read(reinterpret_cast<char*>(&byte), 8);
+    file.seekg(8*64*3, std::ios_base::beg);
+    file.read(reinterpret_cast<char*>(&byte), 8);
+    file.seekg(0, std::ios_base::beg);
+    file.read(reinterpret_cast<char*>(&byte), 8);
+    QCOMPARE(file.missCount(), uint64_t(4));
+}
+
+void TestFile::testReadAt()
+{
+    RealFile reference;
+    reference.setPath(filePath);
+    RealFile realFile;
+    realFile.setPath(filePath);
+    MappedFile mappedFile;
+    mappedFile.setPath(filePath);
+    CachedFile cachedFile(new RealFile, 7, 3);
+    cachedFile.setPath(filePath);
+
+    File* files[] = {&realFile, &mappedFile, &cachedFile};
+    for (File* file : files) {
+        QVERIFY(sameReadAt(reference, *file, 8*24, 8*188));
+
+        std::srand(42);
+        for (int i = 0; i < 200; ++i) {
+            int64_t count = 1 + std::rand() % 256;
+            int64_t position = std::rand() % (reference.size() - count);
+            QVERIFY(sameReadAt(reference, *file, position, count));
+        }
+
+        // missing bits are zero padded
+        char bytes[2] = {-1, -1};
+        QVERIFY(!file->readAt(file->size() - 8, bytes, 16));
+        QCOMPARE(bytes[1], char(0));
+    }
+}
+
+void TestFile::testCopyTo()
+{
+    RealFile reference;
+    reference.setPath(filePath);
+    RealFile realFile;
+    realFile.setPath(filePath);
+    MappedFile mappedFile;
+    mappedFile.setPath(filePath);
+    CachedFile cachedFile(new RealFile, 7, 3);
+    cachedFile.setPath(filePath);
+
+    // whole file, aligned range and unaligned range
+    const int64_t ranges[][2] = {{0, reference.size() / 8}, {8*24, 3*188}, {8*24 + 3, 188}};
+
+    File* files[] = {&realFile, &mappedFile, &cachedFile};
+    for (File* file : files) {
+        for (const auto& range : ranges) {
+            std::vector<char> expected(range[1]);
+            QVERIFY(reference.readAt(range[0], expected.data(), 8 * range[1]));
+
+            std::FILE* out = std::tmpfile();
+            QVERIFY(file->copyTo(range[0], range[1], fileno(out)));
+            std::vector<char> actual(range[1]);
+            std::rewind(out);
+            QCOMPARE(std::fread(actual.data(), 1, actual.size(), out), actual.size());
+            std::fclose(out);
+            QVERIFY(expected == actual);
+
+            std::ostringstream stream;
+            QVERIFY(file->copyTo(range[0], range[1], stream));
+            QVERIFY(stream.str() == std::string(expected.begin(), expected.end()));
+        }
+
+        std::FILE* out = std::tmpfile();
+        QVERIFY(!file->copyTo(file->size() - 8, 2, fileno(out)));
+        std::fclose(out);
+    }
+}
+
+namespace {
+// Fragments given beforehand
+class ListFragmentedFile : public FragmentedFile
+{
+public:
+    ListFragmentedFile(Object* object, const std::vector<Object*>& fragments)
+        : FragmentedFile(object), _pending(fragments), _next(0) {}
+
+    size_t importedCount() const
+    {
+        return _next;
+    }
+
+protected:
+    bool importNextFragment() override
+    {
+        if (_next == _pending.size()) {
+            return false;
+        }
+        addFragment(_pending[_next++]);
+        return true;
+    }
+
+private:
+    std::vector<Object*> _pending;
+    size_t _next;
+};
+}
+
+void TestFile::testFragmentedFile_splitBytes()
+{
+    ModuleLoader loader;
+    loader.addModule("", new DefaultModule);
+    const Module& module = loader.getModule("");
+
+    RealFile file;
+    file.setPath(filePath);
+    VariableCollector collector;
+    std::unique_ptr<Object> root(module.handleFile(DefaultModule::file, file, collector));
+
+    // Every other element of a tuple, so that bytes are split between fragments
+    for (int width : {12, 5, 3}) {
+        std::unique_ptr<Object> tuple(module.handle(DefaultModule::tuple(DefaultModule::uinteger(width), 300LL, std::string("e%")), *root));
+        std::vector<Object*> fragments;
+        std::vector<bool> bits;
+        for (int i = 0; i < 300; i += 2) {
+            Object* fragment = tuple->access(i);
+            QVERIFY(fragment != nullptr);
+            fragments.push_back(fragment);
+            for (int b = 0; b < width; ++b) {
+                char bit;
+                QVERIFY(file.readAt(fragment->beginningPos() + b, &bit, 1));
+                bits.push_back(bit & 1);
+            }
+        }
+        // The stream ends in the middle of a byte, padded with zeros
+        while (bits.size() % 8 != 0) {
+            bits.push_back(false);
+        }
+
+        ListFragmentedFile fragmentedFile(tuple.get(), fragments);
+        std::srand(width);
+        for (int i = 0; i < 200; ++i) {
+            const int64_t count = 1 + std::rand() % 64;
+            const int64_t position = std::rand() % (bits.size() - count);
+            std::vector<char> expected((count + 7) / 8, 0);
+            for (int64_t b = 0; b < count; ++b) {
+                const int64_t shift = count - 1 - b;
+                if (bits[position + b]) {
+                    expected[expected.size() - 1 - shift / 8] |= 1 << (shift % 8);
+                }
+            }
+            std::vector<char> actual(expected.size(), 0);
+            QVERIFY(fragmentedFile.readAt(position, actual.data(), count));
+            QVERIFY(expected == actual);
+        }
+
+        std::FILE* out = std::tmpfile();
+        QVERIFY(fragmentedFile.copyTo(0, bits.size() / 8, fileno(out)));
+        std::vector<char> actual(bits.size() / 8);
+        std::rewind(out);
+        QCOMPARE(std::fread(actual.data(), 1, actual.size(), out), actual.size());
+        std::fclose(out);
+        for (size_t i = 0; i < actual.size(); ++i) {
+            int byte = 0;
+            for (int b = 0; b < 8; ++b) {
+                byte = (byte << 1) | bits[8*i + b];
+            }
+            QCOMPARE(static_cast<uint8_t>(actual[i]), static_cast<uint8_t>(byte));
+        }
+
+        // A failed read leaves the position unchanged, and the file failed until cleared
+        char bytes[3];
+        fragmentedFile.seekg(bits.size() - 8, std::ios_base::beg);
+        QVERIFY(fragmentedFile.good());
+        fragmentedFile.read(bytes, 24);
+        QCOMPARE(fragmentedFile.tellg(), int64_t(bits.size() - 8));
+        QVERIFY(!fragmentedFile.good());
+        fragmentedFile.clear();
+        QVERIFY(fragmentedFile.good());
+    }
+}
+
+void TestFile::testFragmentedFile_lazySize()
+{
+    ModuleLoader loader;
+    loader.addModule("", new DefaultModule);
+    const Module& module = loader.getModule("");
+
+    RealFile file;
+    file.setPath(filePath);
+    VariableCollector collector;
+    std::unique_ptr<Object> root(module.handleFile(DefaultModule::file, file, collector));
+    std::unique_ptr<Object> tuple(module.handle(DefaultModule::tuple(DefaultModule::uinteger(8), 300LL, std::string("e%")), *root));
+    std::vector<Object*> fragments;
+    for (int i = 0; i < 300; ++i) {
+        fragments.push_back(tuple->access(i));
+    }
+
+    // The root of a stream leaves its size unknown, and reads only as far as asked
+    ListFragmentedFile fragmentedFile(tuple.get(), fragments);
+    std::unique_ptr<Object> streamRoot(module.handleFile(DefaultModule::file, fragmentedFile, collector));
+    QVERIFY(streamRoot != nullptr);
+    QCOMPARE(static_cast<int64_t>(streamRoot->size()), int64_t(-1));
+    QVERIFY(streamRoot->remainingSize() > 0);
+    QVERIFY(fragmentedFile.importedCount() < 300);
+
+    QCOMPARE(static_cast<int64_t>(streamRoot->fullSize()), int64_t(8*300));
+    QCOMPARE(fragmentedFile.importedCount(), size_t(300));
+    QCOMPARE(static_cast<int64_t>(streamRoot->size()), int64_t(8*300));
+    QCOMPARE(static_cast<int64_t>(streamRoot->remainingSize()), int64_t(8*300));
+}
+
+void TestFile::testReadAt_concurrent()
+{
+    RealFile reference;
+    reference.setPath(filePath);
+    const int64_t size = reference.size() / 8;
+    std::vector<char> expected(size);
+    reference.read(expected.data(), 8 * size);
+
+    CachedFile file(new RealFile, 64, 4);
+    file.setPath(filePath);
+
+    std::vector<int> mismatchCounts(4, 0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < mismatchCounts.size(); ++t) {
+        threads.emplace_back([&, t]() {
+            for (int64_t i = t; i + 188 <= size; i += 47) {
+                char packet[188];
+                file.readAt(8 * i, packet, 8 * 188);
+                if (!std::equal(packet, packet + 188, expected.begin() + i)) {
+                    ++mismatchCounts[t];
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (int mismatchCount : mismatchCounts) {
+        QCOMPARE(mismatchCount, 0);
+    }
+}
+
+void TestFile::testPrefetchingFile_read()
+{
+    RealFile realFile;
+    realFile.setPath(largeFilePath);
+    // Small windows so that the file spans many of them
+    PrefetchingFile prefetchingFile(new RealFile, 4096, 2);
+    prefetchingFile.setPath(largeFilePath);
+
+    QCOMPARE(prefetchingFile.size(), realFile.size());
+
+    // transport stream packet headers, read in sequence
+    for (int64_t position = 8*24; position + 8*188 <= realFile.size(); position += 8*188) {
+        QVERIFY(sameRead(realFile, prefetchingFile, position, 32));
+    }
+    for (int i = 0; i < 100 && prefetchingFile.prefetchedSize() == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    QVERIFY(prefetchingFile.prefetchedSize() > 0);
+
+    // strided jumps, then random accesses
+    for (int64_t position = 0; position + 8*10000 <= realFile.size(); position += 8*10000) {
+        QVERIFY(sameRead(realFile, prefetchingFile, position, 64));
+    }
+    std::srand(42);
+    for (int i = 0; i < 200; ++i) {
+        int64_t count = 1 + std::rand() % 64;
+        int64_t position = std::rand() % (realFile.size() - count);
+        QVERIFY(sameRead(realFile, prefetchingFile, position, count));
+    }
+
+    prefetchingFile.setPath(largeFilePath);
+    QVERIFY(sameRead(realFile, prefetchingFile, 0, 8*188));
+}
+
+void TestFile::testUringFile_read()
+{
+    RealFile realFile;
+    realFile.setPath(largeFilePath);
+    // Small pages so that reads cross page boundaries and pages get evicted
+    UringFile uringFile(1000, 8);
+    uringFile.setPath(largeFilePath);
+
+    QVERIFY(uringFile.good());
+    QCOMPARE(uringFile.size(), realFile.size());
+
+    QVERIFY(sameRead(realFile, uringFile, 0, 8*3000));
+    // bigger than half the pages, read directly
+    QVERIFY(sameRead(realFile, uringFile, 8*12345, 8*5000));
+
+    std::srand(42);
+    for (int i = 0; i < 1000; ++i) {
+        int64_t count = 1 + std::rand() % 256;
+        int64_t position = std::rand() % (realFile.size() - count);
+        if (i % 3 == 0) {
+            uringFile.prefetch(position + 8*4000, 8*2500);
+        }
+        QVERIFY(sameRead(realFile, uringFile, position, count));
+        QVERIFY(sameReadAt(realFile, uringFile, position, count));
+    }
+
+    uringFile.seekg(-8, std::ios_base::end);
+    uint16_t word;
+    uringFile.read(reinterpret_cast<char*>(&word), 16);
+    QVERIFY(!uringFile.good());
+
+    uringFile.prefetch(0, 8*4000);
+    uringFile.setPath(filePath);
+    uringFile.clear();
+    QVERIFY(uringFile.good());
+    QVERIFY(sameRead(realFile, uringFile, 0, 0));
+}
+
+void TestFile::testBitReader_readBits()
+{
+    std::istringstream stream(std::string("\x47\x1f\xff\x10\x01\x23\x45\x67\x89\xab\xcd\xef", 12));
+    BitReader reader(stream, 5);
+
+    QCOMPARE(reader.readBits(8), uint64_t(0x47));
+    QCOMPARE(reader.readBits(1), uint64_t(0));
+    QCOMPARE(reader.readBits(1), uint64_t(0));
+    QCOMPARE(reader.readBits(1), uint64_t(0));
+    QCOMPARE(reader.readBits(13), uint64_t(0x1fff));
+    QCOMPARE(reader.position(), int64_t(24));
+    QCOMPARE(reader.readBits(64), uint64_t(0x100123456789abcdULL));
+    QVERIFY(!reader.fail());
+
+    reader.seek(36);
+    QCOMPARE(reader.readBits(12), uint64_t(0x123));
+
+    reader.seek(88);
+    QCOMPARE(reader.readBits(16), uint64_t(0xef00));
+    QVERIFY(reader.fail());
+}
+
+void TestFile::benchmarkLegacyUnalignedRead()
+{
+    std::ifstream file(largeFilePath, std::ios::in | std::ios::binary);
+    file.seekg(0, std::ios::end);
+    const int64_t packetCount = file.tellg() / 4;
+
+    QBENCHMARK {
+        char bitPosition = 0;
+        file.seekg(0, std::ios::beg);
+        for (int64_t i = 0; i < packetCount; ++i) {
+            for (int width : headerFields) {
+                uint16_t value;
+                legacyRead(file, bitPosition, reinterpret_cast<char*>(&value), width);
+            }
+        }
+    }
+}
+
+void TestFile::benchmarkBitReaderUnalignedRead()
+{
+    RealFile file;
+    file.setPath(largeFilePath);
+    const int64_t packetCount = file.size() / 32;
+
+    QBENCHMARK {
+        file.seekg(0, std::ios::beg);
+        for (int64_t i = 0; i < packetCount; ++i) {
+            for (int width : headerFields) {
+                uint16_t value;
+                file.read(reinterpret_cast<char*>(&value), width);
+            }
+        }
+    }
+}
+
+void TestFile::benchmarkRealFileRandomRead()
+{
+    RealFile file;
+    file.setPath(largeFilePath);
+
+    QBENCHMARK {
+        randomRead(file, 10000);
+    }
+}
+
+void TestFile::benchmarkUringFileRandomRead()
+{
+    UringFile file(4096, 32);
+    file.setPath(largeFilePath);
+
+    QBENCHMARK {
+        randomRead(file, 10000);
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef TEST_FILE
+#define TEST_FILE
+
+#include <QtTest/QtTest>
+
+class TestFile : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testMappedFile_read();
+    void testMappedFile_seekg();
+    void testMappedFile_outOfFile();
+    void testCachedFile_read();
+    void testCachedFile_hitCount();
+    void testReadAt();
+    void testReadAt_concurrent();
+    void testCopyTo();
+    void testFragmentedFile_splitBytes();
+    void testFragmentedFile_lazySize();
+    void testPrefetchingFile_read();
+    void testUringFile_read();
+    void testBitReader_readBits();
+    void benchmarkLegacyUnalignedRead();
+    void benchmarkBitReaderUnalignedRead();
+    void benchmarkRealFileRandomRead();
+    void benchmarkUringFileRandomRead();
+};
+
+#endif // TEST_FILE
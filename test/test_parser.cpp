@@ -1,9 +1,24 @@
 #include "test_parser.h"
 
+#include <atomic>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#include "core/containerparser.h"
+#include "core/exploration.h"
+#include "core/leafstore.h"
+#include "core/mapmodule.h"
+#include "core/moduleloader.h"
 #include "core/modules/default/defaultmodule.h"
+#include "core/modules/ebml/ebmlmodule.h"
+#include "core/parallelexplorer.h"
+#include "core/partitionedexplorer.h"
+#include "core/parseindex.h"
 #include "core/variable/variablecollector.h"
 
 #include "core/util/fileutil.h"
+#include "core/util/strutil.h"
 #include "core/log/logmanager.h"
 
 TestParser::TestParser() : path("resources/parser/")
@@ -23,6 +38,726 @@ void TestParser::test_find()
     QVERIFY(checkFile("test_find.bin", -1, -1, "test_find"));
 }
 
+void TestParser::test_compactLeaves()
+{
+    const Module& module = moduleSetup.moduleLoader().getModule("test_default");
+    std::unique_ptr<OpenedFile> opened = openFile("test_default.bin", module);
+    QVERIFY(opened != nullptr);
+    Object* object = opened->object.get();
+    object->explore(-1);
+
+    // Leaves are expanded on access, once
+    Object* leaf = object->lookUp("v4242");
+    QVERIFY(leaf != nullptr);
+    QCOMPARE(leaf->value().toInteger(), 4242LL);
+    QCOMPARE(static_cast<int64_t>(leaf->beginningPos()), int64_t(8));
+    QCOMPARE(static_cast<int64_t>(leaf->size()), int64_t(16));
+    QCOMPARE(leaf->parent(), object);
+    QCOMPARE(leaf->rank(), int64_t(1));
+    QCOMPARE(object->lookUp("v4242"), leaf);
+    QCOMPARE(object->access(1), leaf);
+    QCOMPARE(*(object->begin() + 1), leaf);
+
+    int64_t position = 0;
+    for (Object* child : *object) {
+        QCOMPARE(static_cast<int64_t>(child->beginningPos()), position);
+        position += child->size();
+    }
+}
+
+void TestParser::test_leafStore()
+{
+    // Numbers are stored in the columns, other values aside
+    const int64_t leafCount = 10000;
+    LeafStore store;
+    store.reserve(0, leafCount - 1);
+    for (int64_t rank = 0; rank < leafCount; ++rank) {
+        Variant value = rank % 100 == 0 ? Variant("text") : Variant(3ULL * rank);
+        if (rank % 3 == 0) {
+            value.setDisplayType(Variant::hexadecimal);
+        }
+        store.add(rank, 1000 + 16 * rank, 16, rank % 7, Atom("leaf"), std::move(value));
+    }
+    for (int64_t rank = 0; rank < leafCount; ++rank) {
+        QCOMPARE(store.beginningPos(rank), 1000 + 16 * rank);
+        QCOMPARE(store.size(rank), int64_t(16));
+        QCOMPARE(store.typeIndex(rank), static_cast<uint32_t>(rank % 7));
+        QCOMPARE(store.name(rank), Atom("leaf"));
+        const Variant value = store.value(rank);
+        QCOMPARE(value.type(), rank % 100 == 0 ? Variant::stringType : Variant::unsignedIntegerType);
+        QCOMPARE(value.displayType(), rank % 3 == 0 ? Variant::hexadecimal : Variant::decimal);
+    }
+    QCOMPARE(store.value(200).toString(), std::string("text"));
+    QCOMPARE(store.value(201).toUnsignedInteger(), 603ULL);
+
+    const double bytesPerLeaf = static_cast<double>(store.byteCount()) / leafCount;
+    qDebug(concat("Compact leaf: ", bytesPerLeaf, " bytes").c_str());
+    QVERIFY(bytesPerLeaf < 32);
+
+    // Positions too far for 32 bits widen the columns
+    store.add(leafCount, int64_t(1) << 40, 8, 0, Atom(), Variant(-1.5));
+    store.add(leafCount + 1, 0, 8, 0, Atom(), Variant(-7LL));
+    QCOMPARE(store.beginningPos(leafCount), int64_t(1) << 40);
+    QCOMPARE(store.beginningPos(leafCount + 1), int64_t(0));
+    QCOMPARE(store.beginningPos(1), int64_t(1016));
+    QCOMPARE(store.value(leafCount).toDouble(), -1.5);
+    QCOMPARE(store.value(leafCount + 1).toInteger(), -7LL);
+    QCOMPARE(store.takeValue(200).toString(), std::string("text"));
+}
+
+void TestParser::test_memoryBudget()
+{
+    const Module& module = moduleSetup.moduleLoader().getModule("test_default");
+    std::unique_ptr<OpenedFile> opened = openFile("test_default.bin", module);
+    QVERIFY(opened != nullptr);
+    Object* object = opened->object.get();
+    object->setMemoryBudget(0);
+    QCOMPARE(object->memoryBudget(), int64_t(0));
+    object->explore(-1);
+
+    // Evicted objects are parsed again on access
+    QVERIFY(object->evictionCount() > 0);
+    Object* array = object->lookUp("array8");
+    QVERIFY(array != nullptr);
+    QCOMPARE(array->numberOfChildren(), 8);
+    QCOMPARE(static_cast<int64_t>(array->access(7)->beginningPos()), int64_t(2032));
+
+    Object* structure = object->lookUp("struct128");
+    QVERIFY(structure != nullptr);
+    QCOMPARE(structure->numberOfChildren(), 4);
+    QCOMPARE(structure->lookUp("uint32")->size(), std::streamoff(32));
+
+    QVERIFY(compareWithOrig(*object, "test_default.bin", ".budget"));
+}
+
+void TestParser::test_memoryBudgetScript()
+{
+    RealFile file;
+    file.setPath(path+"test_msgpack.msgpack");
+    const Module& module = moduleSetup.moduleLoader().getModule(file);
+    std::unique_ptr<OpenedFile> opened = openFile("test_msgpack.msgpack", module);
+    QVERIFY(opened != nullptr);
+    Object* object = opened->object.get();
+    object->setMemoryBudget(0);
+    object->explore(-1);
+    opened->collector.collect();
+
+    // Children looked up by name by the script are only pinned while the collector keeps their variables
+    QVERIFY(object->evictionCount() > 0);
+    const int64_t evictionCount = object->evictionCount();
+    QVERIFY(compareWithOrig(*object, "test_msgpack.msgpack", ".budget"));
+    QVERIFY(object->evictionCount() > evictionCount);
+}
+
+void TestParser::test_virtualChildren()
+{
+    const Module& module = moduleSetup.moduleLoader().getModule("");
+    std::unique_ptr<OpenedFile> opened = openFile("test_default.bin", module);
+    QVERIFY(opened != nullptr);
+    Object* root = opened->object.get();
+
+    // Elements of a fixed size are only built when accessed
+    std::unique_ptr<Object> tuple(module.handle(DefaultModule::tuple(DefaultModule::uint8, 352LL, std::string("byte%")), *root));
+    tuple->explore(-1);
+    QCOMPARE(tuple->numberOfChildren(), 352);
+    QCOMPARE(static_cast<int64_t>(tuple->size()), int64_t(2816));
+
+    Object* element = tuple->access(2);
+    QVERIFY(element != nullptr);
+    QCOMPARE(element->value().toInteger(), 0x92LL);
+    QCOMPARE(static_cast<int64_t>(element->beginningPos()), int64_t(16));
+    QCOMPARE(element->name(), std::string("byte2"));
+    QCOMPARE(element->rank(), int64_t(2));
+    QCOMPARE(tuple->lookUp("byte2"), element);
+    QCOMPARE(*(tuple->begin() + 2), element);
+    QVERIFY(tuple->lookUp("byte352") == nullptr);
+}
+
+void TestParser::test_virtualChildrenScan()
+{
+    const Module& module = moduleSetup.moduleLoader().getModule("");
+    std::unique_ptr<OpenedFile> opened = openFile("test_default.bin", module);
+    QVERIFY(opened != nullptr);
+    Object* root = opened->object.get();
+
+    // Far more elements than the ones kept
+    const int64_t count = 2816;
+    std::unique_ptr<Object> bits(module.handle(DefaultModule::tuple(DefaultModule::uinteger(1LL), count, std::string("bit%")), *root));
+    bits->explore(-1);
+    QCOMPARE(bits->numberOfChildren(), count);
+
+    const Object::Pin first(bits->access(0));
+    size_t liveCount = 0;
+    for (int64_t rank = 0; rank < count; ++rank) {
+        QCOMPARE(bits->access(rank)->rank(), rank);
+        if (rank == count / 2) {
+            liveCount = root->arena()->liveCount();
+        }
+    }
+
+    // Memory stays flat while scanning, and pinned elements are kept
+    QCOMPARE(root->arena()->liveCount(), liveCount);
+    QCOMPARE(bits->access(0), first.get());
+    QCOMPARE(bits->lookUp("bit2815")->rank(), count - 1);
+}
+
+void TestParser::test_parserPlan()
+{
+    const Module& module = moduleSetup.moduleLoader().getModule("");
+    std::unique_ptr<OpenedFile> opened = openFile("test_default.bin", module);
+    QVERIFY(opened != nullptr);
+    Object* root = opened->object.get();
+
+    // Types equal but for their name share nothing of the plan that would change the objects
+    const ObjectType plain = DefaultModule::tuple(DefaultModule::uint8, 4LL);
+    ObjectType named = plain;
+    named.setName("header");
+
+    std::unique_ptr<Object> first(module.handle(plain, *root));
+    std::unique_ptr<Object> second(module.handle(named, *root));
+    std::unique_ptr<Object> third(module.handle(plain, *root));
+    QVERIFY(first->type().isIdentical(plain));
+    QVERIFY(second->type().isIdentical(named));
+    QVERIFY(third->type().isIdentical(plain));
+    QCOMPARE(second->type().name(), std::string("header"));
+
+    for (int i = 0; i < 2; ++i) {
+        QCOMPARE(module.getFixedSize(plain), int64_t(32));
+        QCOMPARE(module.getFixedSize(named), int64_t(32));
+    }
+    third->explore(-1);
+    QCOMPARE(third->numberOfChildren(), 4);
+    QCOMPARE(static_cast<int64_t>(third->size()), int64_t(32));
+
+    // More types than the plans kept, of which only the least recently used are dropped
+    for (int size = 1; size <= 5000; ++size) {
+        QCOMPARE(module.getFixedSize(DefaultModule::uinteger(size)), int64_t(size));
+    }
+    QVERIFY(module.parserPlanCount() >= 4000);
+    QCOMPARE(module.getFixedSize(plain), int64_t(32));
+}
+
+namespace {
+class ShapeModule : public MapModule
+{
+public:
+    // Changes made once the module is loaded
+    void addSquareParser(int64_t size)
+    {
+        addParser("square");
+        setFixedSize("square", size);
+    }
+
+    void addCircle()
+    {
+        newTemplate("circle");
+        addFunction("area", {"radius"}, {false}, {Variant()}, [] functionLambda {
+            return Variable();
+        });
+    }
+
+protected:
+    bool doLoad() override
+    {
+        newTemplate("square");
+        newTemplate("shape");
+        return true;
+    }
+};
+
+class DrawingModule : public MapModule
+{
+protected:
+    void requestImportations(std::vector<std::string>& formatDetections) override
+    {
+        formatDetections.push_back("shapes");
+    }
+};
+}
+
+void TestParser::test_dispatchTables()
+{
+    // mkv imports ebml, which imports the default module
+    const Module& mkvModule = moduleSetup.moduleLoader().getModule("mkv");
+    const Module& ebmlModule = moduleSetup.moduleLoader().getModule("ebml");
+    const Module& defaultModule = moduleSetup.moduleLoader().getModule("");
+    QVERIFY(mkvModule.isLoaded());
+
+    QCOMPARE(&mkvModule.getTemplate("EBMLElement"), &EbmlModule::EBMLElement);
+    QCOMPARE(&mkvModule.getTemplate("uint"), &DefaultModule::uinteger);
+    QVERIFY(mkvModule.getTemplate("noSuchTemplate").isNull());
+
+    QCOMPARE(mkvModule.handler(EbmlModule::EBMLElement()), &ebmlModule);
+    QCOMPARE(mkvModule.handler(DefaultModule::uinteger(8)), &defaultModule);
+    QVERIFY(!mkvModule.canHandle(ObjectType()));
+
+    QCOMPARE(mkvModule.functionHandler("sizeof"), &defaultModule);
+    QVERIFY(mkvModule.canHandleFunction("sizeof"));
+    QVERIFY(!mkvModule.canHandleFunction("noSuchFunction"));
+
+    QCOMPARE(mkvModule.getFather(EbmlModule::EBMLFile()), DefaultModule::file());
+    QCOMPARE(mkvModule.getFixedSize(DefaultModule::uinteger(16)), int64_t(16));
+
+    // The modules importing a module see what it gets once they are loaded
+    ModuleLoader loader;
+    ShapeModule* shapeModule = new ShapeModule;
+    loader.addModule("shapes", shapeModule);
+    loader.addModule("drawing", new DrawingModule);
+    const Module& drawingModule = loader.getModule("drawing");
+    QVERIFY(drawingModule.isLoaded());
+    const ObjectTypeTemplate& square = drawingModule.getTemplate("square");
+    const ObjectTypeTemplate& shape = drawingModule.getTemplate("shape");
+    QVERIFY(!square.isNull());
+    QVERIFY(drawingModule.getFather(square()).isNull());
+
+    shapeModule->setExtension(square, shape());
+    QCOMPARE(drawingModule.getFather(square()), shape());
+    QVERIFY(drawingModule.isExtension(square(), shape()));
+
+    QVERIFY(!drawingModule.canHandle(square()));
+    shapeModule->addSquareParser(4);
+    QCOMPARE(drawingModule.handler(square()), shapeModule);
+    QCOMPARE(drawingModule.getFixedSize(square()), int64_t(4));
+    shapeModule->addSquareParser(8);
+    QCOMPARE(drawingModule.getFixedSize(square()), int64_t(8));
+
+    QVERIFY(drawingModule.getTemplate("circle").isNull());
+    QVERIFY(!drawingModule.canHandleFunction("area"));
+    shapeModule->addCircle();
+    QVERIFY(!drawingModule.getTemplate("circle").isNull());
+    QCOMPARE(drawingModule.functionHandler("area"), shapeModule);
+}
+
+void TestParser::test_position()
+{
+    const Module& module = moduleSetup.moduleLoader().getModule("test_default");
+    std::unique_ptr<OpenedFile> opened = openFile("test_default.bin", module);
+    QVERIFY(opened != nullptr);
+    Object* object = opened->object.get();
+
+    // Nothing is parsed yet, so the lookup only succeeds when forced
+    QVERIFY(object->childAtPosition(2032) == nullptr);
+    Object* descendant = object->descendantAtPosition(2032, true);
+    QVERIFY(descendant != nullptr);
+    QVERIFY(descendant != object);
+    QVERIFY(descendant->includesPos(2032));
+    QCOMPARE(descendant->numberOfChildren(), 0);
+    QVERIFY(!object->parsed());
+
+    Object* array = object->lookUp("array8");
+    QVERIFY(array != nullptr);
+    QCOMPARE(array->childAtPosition(2032), array->access(7));
+    QVERIFY(object->descendantAtPosition(-1) == nullptr);
+
+    const Module& defaultModule = moduleSetup.moduleLoader().getModule("");
+    std::unique_ptr<Object> tuple(defaultModule.handle(DefaultModule::tuple(DefaultModule::uint8, 352LL, std::string("byte%")), *object));
+    const int64_t tuplePos = tuple->beginningPos();
+    QCOMPARE(tuple->childAtPosition(tuplePos + 20), tuple->access(2));
+    QVERIFY(tuple->childAtPosition(tuplePos + 2816) == nullptr);
+}
+
+void TestParser::test_parseIndex()
+{
+    const Module& module = moduleSetup.moduleLoader().getModule("test_default");
+    std::unique_ptr<OpenedFile> opened = openFile("test_default.bin", module);
+    QVERIFY(opened != nullptr);
+    RealFile& file = opened->file;
+    VariableCollector& collector = opened->collector;
+    const ParseIndex::Key key = ParseIndex::key(file, moduleSetup.moduleLoader().fingerprint(module));
+    const std::string indexPath = path+"new/test_default.bin.hmi";
+    QVERIFY(ParseIndex::write(*opened->object, module, key, indexPath));
+
+    // The tree is read back without being parsed
+    std::unique_ptr<Object> object(ParseIndex::load(indexPath, key, module, file, collector));
+    QVERIFY(object != nullptr);
+    QVERIFY(compareWithOrig(*object, "test_default.bin", ".index"));
+
+    ParseIndex::Key otherKey = key;
+    ++otherKey.modificationTime;
+    QVERIFY(ParseIndex::load(indexPath, otherKey, module, file, collector) == nullptr);
+}
+
+void TestParser::test_exploration()
+{
+    const Module& module = moduleSetup.moduleLoader().getModule("test_default");
+    std::unique_ptr<OpenedFile> opened = openFile("test_default.bin", module);
+    QVERIFY(opened != nullptr);
+    Object* object = opened->object.get();
+
+    Exploration exploration(*object);
+    int64_t reportedCount = 0;
+    exploration.setProgressCallback([&reportedCount](const Exploration::Progress& progress) {
+        reportedCount = progress.nodeCount;
+    }, 1);
+
+    // A stopped exploration goes on from where it stopped
+    exploration.setBatchSize(1);
+    exploration.setNodeBudget(1);
+    QCOMPARE(exploration.run(), Exploration::outOfBudget);
+    QVERIFY(exploration.progress().nodeCount >= 1);
+    exploration.setNodeBudget(-1);
+    QCOMPARE(exploration.run(), Exploration::complete);
+    QCOMPARE(reportedCount, exploration.progress().nodeCount);
+    QCOMPARE(exploration.progress().coveredSize, static_cast<int64_t>(object->size() / 8));
+
+    // The children already parsed are not counted again
+    Exploration again(*object);
+    QCOMPARE(again.run(), Exploration::complete);
+    QCOMPARE(again.progress().nodeCount, int64_t(0));
+
+    std::unique_ptr<OpenedFile> other = openFile("test_default.bin", module);
+    QVERIFY(other != nullptr);
+    Exploration cancelledExploration(*other->object);
+    cancelledExploration.cancel();
+    QCOMPARE(cancelledExploration.run(), Exploration::cancelled);
+    QVERIFY(!other->object->parsed());
+}
+
+void TestParser::test_explorationPopulate()
+{
+    // As the tree view populates an object, by jobs adding a few children each
+    const Module& module = moduleSetup.moduleLoader().getModule("mkv");
+    std::unique_ptr<OpenedFile> opened = openFile("test_mkv.mkv", module);
+    QVERIFY(opened != nullptr);
+    Object* segment = opened->object->access(1, true);
+    QVERIFY(segment != nullptr);
+    const Object::Pin pin(segment);
+
+    int jobCount = 0;
+    while (!segment->parsed() && jobCount < 1000) {
+        const int64_t childCount = segment->numberOfChildren();
+        Exploration exploration(*segment, 1);
+        exploration.setBatchSize(4);
+        exploration.setNodeBudget(2);
+        exploration.setTimeBudget(500);
+        const Exploration::Status status = exploration.run();
+
+        QVERIFY(status == Exploration::outOfBudget || status == Exploration::complete);
+        QVERIFY(segment->numberOfChildren() > childCount);
+        QCOMPARE(exploration.progress().nodeCount, segment->numberOfChildren() - childCount);
+        ++jobCount;
+    }
+    QVERIFY(segment->parsed());
+    QVERIFY(jobCount > 1);
+}
+
+void TestParser::test_parallelExplore()
+{
+    const Module& module = moduleSetup.moduleLoader().getModule("test_default");
+    // Interpreted modules are parsed in parallel too
+    QVERIFY(module.isThreadSafe());
+    std::unique_ptr<OpenedFile> opened = openFile("test_default.bin", module);
+    QVERIFY(opened != nullptr);
+    Object* object = opened->object.get();
+
+    ParallelExplorer explorer(4);
+    QCOMPARE(explorer.threadCount(), 4);
+    explorer.explore(*object, module);
+    QCOMPARE(&object->file(), static_cast<File*>(&opened->file));
+    QVERIFY(compareWithOrig(*object, "test_default.bin", ".parallel"));
+}
+
+namespace {
+void writeTree(Object& object, std::ostream& out)
+{
+    out << object.beginningPos() << ' ' << object.size() << ' ' << object.type() << ' '
+        << object.name() << ' ' << object.value() << '\n';
+    for (Object* child : object) {
+        writeTree(*child, out);
+    }
+}
+}
+
+void TestParser::test_parallelExploreEbml()
+{
+    // As the scripts keeping no state in the root, the ebml module is thread safe, so that the subtrees are explored in parallel
+    const Module& module = moduleSetup.moduleLoader().getModule("mkv");
+    QVERIFY(module.isThreadSafe());
+
+    std::stringstream expected;
+    {
+        std::unique_ptr<OpenedFile> opened = openFile("test_mkv.mkv", module);
+        QVERIFY(opened != nullptr);
+        opened->object->explore(-1);
+        writeTree(*opened->object, expected);
+    }
+
+    for (int threadCount = 1; threadCount <= 8; ++threadCount) {
+        std::unique_ptr<OpenedFile> opened = openFile("test_mkv.mkv", module);
+        QVERIFY(opened != nullptr);
+        ParallelExplorer explorer(threadCount);
+        explorer.explore(*opened->object, module);
+        QCOMPARE(&opened->object->file(), static_cast<File*>(&opened->file));
+
+        std::stringstream tree;
+        writeTree(*opened->object, tree);
+        QCOMPARE(tree.str(), expected.str());
+    }
+}
+
+void TestParser::test_partition()
+{
+    RealFile file;
+    file.setPath("resources/format_detector/magic_ts.ts");
+    QVERIFY(file.good());
+
+    // Five packets follow 24 bytes of garbage, the last one being truncated
+    for (int threadCount : {1, 4}) {
+        PartitionedExplorer explorer(0x47, 188, threadCount, 188);
+        std::vector<PartitionedExplorer::Run> runs = explorer.partition(file);
+        QCOMPARE(runs.size(), size_t(1));
+        QCOMPARE(runs[0].syncPos, int64_t(8*24));
+        QCOMPARE(runs[0].count, int64_t(5));
+
+        runs = explorer.partition(file, 8*212);
+        QCOMPARE(runs.size(), size_t(1));
+        QCOMPARE(runs[0].syncPos, int64_t(8*212));
+        QCOMPARE(runs[0].count, int64_t(4));
+    }
+}
+
+namespace {
+const ObjectTypeTemplate packetTemplate("packet");
+
+int64_t findSyncbyte(File& file, int64_t position)
+{
+    char byte;
+    while (file.readAt(position, &byte, 8)) {
+        if (static_cast<uint8_t>(byte) == 0x47) {
+            return position;
+        }
+        position += 8;
+    }
+    return -1;
+}
+
+/**
+ * @brief Adds a packet at each syncbyte until the file ends, named alike or after their rank
+ */
+class PacketFileParser : public ContainerParser
+{
+public:
+    PacketFileParser(Object& object, const Module& module, bool numbered, int64_t& addedCount)
+        : ContainerParser(object, module), _numbered(numbered), _addedCount(addedCount) {}
+
+protected:
+    void doParseHead() override
+    {
+        object().setSize(object().file().size());
+    }
+
+    bool doParseSome(int hint) override
+    {
+        for (int i = 0; i < hint; ++i) {
+            const int64_t sync = findSyncbyte(object().file(), object().beginningPos() + object().pos());
+            if (sync == -1 || sync + 8*188 > object().file().size()) {
+                return true;
+            }
+            addVariable(packetTemplate(), _numbered ? "packet" + std::to_string(object().numberOfChildren()) : "#");
+            ++_addedCount;
+        }
+        return false;
+    }
+
+    void doParse() override
+    {
+        while (!doParseSome(64)) {
+        }
+    }
+
+private:
+    bool _numbered;
+    int64_t& _addedCount;
+};
+
+/**
+ * @brief Packet ending 188 bytes after its syncbyte, anything before it included
+ */
+class PacketParser : public ContainerParser
+{
+public:
+    PacketParser(Object& object, const Module& module) : ContainerParser(object, module) {}
+
+protected:
+    void doParseHead() override
+    {
+        const int64_t sync = findSyncbyte(object().file(), object().beginningPos());
+        object().setSize(sync - object().beginningPos() + 8*188);
+    }
+
+    void doParse() override
+    {
+        const int64_t sync = findSyncbyte(object().file(), object().beginningPos());
+        object().setPos(sync - object().beginningPos() + 8);
+        addVariable(DefaultModule::uinteger(16), "header");
+        addVariable(DefaultModule::uinteger(8), "flags");
+    }
+};
+
+class PacketModule : public MapModule
+{
+public:
+    PacketModule(bool numbered, bool threadSafe) : _numbered(numbered), _threadSafe(threadSafe), _addedCount(0) {}
+
+    /** @brief Number of packets added by the parsers of the files*/
+    int64_t addedCount() const
+    {
+        return _addedCount;
+    }
+
+protected:
+    void requestImportations(std::vector<std::string>& formatDetections) override
+    {
+        formatDetections.push_back("");
+    }
+
+    bool doLoad() override
+    {
+        const bool numbered = _numbered;
+        int64_t& addedCount = _addedCount;
+        addParser("File", [numbered, &addedCount](const ObjectType&, Object& object, const Module& module) -> Parser* {
+            return new PacketFileParser(object, module, numbered, addedCount);
+        });
+        addParser("packet", [](const ObjectType&, Object& object, const Module& module) -> Parser* {
+            return new PacketParser(object, module);
+        });
+        return true;
+    }
+
+    bool doIsThreadSafe() const override
+    {
+        return _threadSafe;
+    }
+
+private:
+    bool _numbered;
+    bool _threadSafe;
+    int64_t _addedCount;
+};
+}
+
+void TestParser::test_partitionedExplore()
+{
+    // Packets named alike are found ahead, the others are left to the parsers
+    for (bool numbered : {false, true}) {
+    for (bool threadSafe : {true, false}) {
+        ModuleLoader loader;
+        PacketModule* packetModule = new PacketModule(numbered, threadSafe);
+        loader.addModule("packets", packetModule);
+        const Module& module = loader.getModule("packets");
+        QCOMPARE(module.isThreadSafe(), threadSafe);
+
+        RealFile file;
+        file.setPath("resources/format_detector/magic_ts.ts");
+        QVERIFY(file.good());
+        VariableCollector collector;
+
+        std::stringstream expected;
+        {
+            std::unique_ptr<Object> object(module.handleFile(DefaultModule::file, file, collector));
+            QVERIFY(object != nullptr);
+            object->explore(-1);
+            writeTree(*object, expected);
+        }
+        QVERIFY(expected.str().find("packet") != std::string::npos);
+        const int64_t packetCount = packetModule->addedCount();
+
+        for (int threadCount : {1, 2, 4}) {
+            std::unique_ptr<Object> object(module.handleFile(DefaultModule::file, file, collector));
+            QVERIFY(object != nullptr);
+            const int64_t addedBefore = packetModule->addedCount();
+            PartitionedExplorer explorer(0x47, 188, threadCount, 188);
+            explorer.explore(*object, module);
+
+            std::stringstream tree;
+            writeTree(*object, tree);
+            QCOMPARE(tree.str(), expected.str());
+
+            // Whether the packets are explored in parallel or not, they are found ahead
+            const int64_t addedCount = packetModule->addedCount() - addedBefore;
+            if (threadCount > 1 && !numbered) {
+                QCOMPARE(addedCount, int64_t(2));
+            } else {
+                QCOMPARE(addedCount, packetCount);
+            }
+        }
+    }
+    }
+}
+
+void TestParser::test_partitionedExploreTs()
+{
+    // The packets carry the tables found so far in the root, so that they are explored in order
+    const Module& module = moduleSetup.moduleLoader().getModule("ts");
+    QVERIFY(!module.isThreadSafe());
+
+    RealFile file;
+    file.setPath("resources/format_detector/magic_ts.ts");
+    QVERIFY(file.good());
+    VariableCollector collector;
+
+    std::stringstream expected;
+    {
+        std::unique_ptr<Object> object(module.handleFile(DefaultModule::file, file, collector));
+        QVERIFY(object != nullptr);
+        object->explore(-1);
+        writeTree(*object, expected);
+    }
+
+    for (int threadCount : {1, 4}) {
+        std::unique_ptr<Object> object(module.handleFile(DefaultModule::file, file, collector));
+        QVERIFY(object != nullptr);
+        PartitionedExplorer explorer(0x47, 188, threadCount, 188);
+        explorer.explore(*object, module);
+
+        std::stringstream tree;
+        writeTree(*object, tree);
+        QCOMPARE(tree.str(), expected.str());
+    }
+}
+
+namespace {
+// Only the children published can be read while the tree is explored
+int64_t readChildren(const Object& object, int64_t& misplacedCount)
+{
+    int64_t count = 0;
+    const int64_t childCount = object.publishedChildCount();
+    for (int64_t rank = 0; rank < childCount; ++rank) {
+        const Object* child = object.publishedChild(rank);
+        if (child->rank() != rank || child->parent() != &object) {
+            ++misplacedCount;
+        }
+        count += 1 + readChildren(*child, misplacedCount);
+    }
+    return count;
+}
+}
+
+void TestParser::test_concurrentRead()
+{
+    const Module& module = moduleSetup.moduleLoader().getModule("test_default");
+    std::unique_ptr<OpenedFile> opened = openFile("test_default.bin", module);
+    QVERIFY(opened != nullptr);
+    Object* object = opened->object.get();
+
+    // The children added are read while the tree is explored
+    std::atomic<bool> explored(false);
+    int64_t misplacedCount = 0;
+    int64_t readCount = 0;
+    std::thread reader([&]() {
+        while (!explored) {
+            readChildren(*object, misplacedCount);
+        }
+        readCount = readChildren(*object, misplacedCount);
+    });
+    object->explore(-1);
+    explored = true;
+    reader.join();
+
+    QCOMPARE(misplacedCount, int64_t(0));
+    QCOMPARE(readCount, readChildren(*object, misplacedCount));
+}
+
 void TestParser::test_asf()
 {
     QVERIFY(checkFile("test_asf.asf", 3, 22));
@@ -111,10 +846,47 @@ void TestParser::test_zip()
     QVERIFY(checkFile("test_zip.zip"));
 }
 
-bool TestParser::checkFile(const std::string &fileName, int depth, int width, const std::string &moduleKey)
+void TestParser::benchmarkTsExplore()
 {
-    VariableCollector collector;
+    benchmarkTs(1);
+}
 
+void TestParser::benchmarkTsPartitionedExplore()
+{
+    benchmarkTs(4);
+}
+
+void TestParser::benchmarkTs(int threadCount)
+{
+    // The complete packets of the small stream repeated, for the file to be split in ranges
+    std::ifstream in("resources/format_detector/magic_ts.ts", std::ios::in | std::ios::binary);
+    std::vector<char> packets(4*188);
+    in.seekg(24);
+    QVERIFY(in.read(packets.data(), packets.size()));
+
+    QTemporaryFile stream;
+    QVERIFY(stream.open());
+    for (int i = 0; i < 8192; ++i) {
+        stream.write(packets.data(), packets.size());
+    }
+    stream.close();
+
+    const Module& module = moduleSetup.moduleLoader().getModule("ts");
+    RealFile file;
+    file.setPath(stream.fileName().toStdString());
+    QVERIFY(file.good());
+
+    QBENCHMARK {
+        VariableCollector collector;
+        std::unique_ptr<Object> object(module.handleFile(DefaultModule::file, file, collector));
+        PartitionedExplorer explorer(0x47, 188, threadCount, 1 << 20);
+        explorer.explore(*object, module);
+        QCOMPARE(object->numberOfChildren(), 4*8192);
+    }
+}
+
+bool TestParser::checkFile(const std::string &fileName, int depth, int width, const std::string &moduleKey)
+{
     Log::info("Checking ", fileName);
 
     RealFile file;
@@ -129,24 +901,46 @@ bool TestParser::checkFile(const std::string &fileName, int depth, int width, co
     ModuleLoader& moduleLoader = moduleSetup.moduleLoader();
     const Module& module = moduleKey.empty() ? moduleLoader.getModule(file) : moduleLoader.getModule(moduleKey);
 
-    Object* object = module.handleFile(DefaultModule::file, file, collector);
-
-    if (!object) {
+    std::unique_ptr<OpenedFile> opened = openFile(fileName, module);
+    if (!opened) {
         return false;
     }
 
     const std::string origPath = path+"orig/"+fileName+".txt";
     if (!fileExists(origPath)) {
-        writeObject(*object, origPath, depth, width);
+        writeObject(*opened->object, origPath, depth, width);
         return true;
     } else {
-        const std::string newPath = path+"new/"+fileName+".txt";
-        writeObject(*object, newPath, depth, width);
-        return fileCompare(origPath, newPath);
+        return compareWithOrig(*opened->object, fileName, "", depth, width);
     }
 
 }
 
+std::unique_ptr<TestParser::OpenedFile> TestParser::openFile(const std::string &fileName, const Module &module)
+{
+    std::unique_ptr<OpenedFile> opened(new OpenedFile);
+    opened->file.setPath(path+fileName);
+
+    if (!opened->file.good())
+    {
+        Log::error("File not found ", fileName);
+        return nullptr;
+    }
+
+    opened->object.reset(module.handleFile(DefaultModule::file, opened->file, opened->collector));
+    if (!opened->object) {
+        return nullptr;
+    }
+    return opened;
+}
+
+bool TestParser::compareWithOrig(Object &object, const std::string &fileName, const std::string &suffix, int depth, int width)
+{
+    const std::string newPath = path+"new/"+fileName+suffix+".txt";
+    writeObject(object, newPath, depth, width);
+    return fileCompare(path+"orig/"+fileName+".txt", newPath);
+}
+
 void TestParser::writeObject(Object &object, const std::string &outputPath, int depth, int width)
 {
     std::ofstream file;
@@ -195,6 +989,7 @@ void TestParser::writeObjectRecursive(Object &object, std::ofstream &file, int c
     int nextRemainingDepth = remainingDepth - 1;
 
     for (int i = 0; i < n; ++i) {
-        writeObjectRecursive(*object.access(i), file, nextCurrentDepth, nextRemainingDepth, width);
+        Object::Pin child(object.access(i));
+        writeObjectRecursive(*child.get(), file, nextCurrentDepth, nextRemainingDepth, width);
     }
 }
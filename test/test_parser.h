@@ -5,7 +5,11 @@
 
 #include <QObject>
 #include <fstream>
+#include <memory>
 
+#include "core/object.h"
+#include "core/file/realfile.h"
+#include "core/variable/variablecollector.h"
 #include "gui/qtmodulesetup.h"
 
 class TestParser : public QObject
@@ -17,6 +21,24 @@ public:
 private slots:
     void test_default();
     void test_find();
+    void test_compactLeaves();
+    void test_leafStore();
+    void test_memoryBudget();
+    void test_memoryBudgetScript();
+    void test_virtualChildren();
+    void test_virtualChildrenScan();
+    void test_parserPlan();
+    void test_dispatchTables();
+    void test_position();
+    void test_parseIndex();
+    void test_exploration();
+    void test_explorationPopulate();
+    void test_parallelExplore();
+    void test_parallelExploreEbml();
+    void test_partition();
+    void test_partitionedExplore();
+    void test_partitionedExploreTs();
+    void test_concurrentRead();
 
     void test_asf();
     void test_avi();
@@ -35,11 +57,31 @@ private slots:
     void test_tiff();
     void test_wave();
     void test_zip();
+    void benchmarkTsExplore();
+    void benchmarkTsPartitionedExplore();
 
 private:
+    /** @brief Explores a stream of packets repeated with the ts module on a number of threads*/
+    void benchmarkTs(int threadCount);
 
     bool checkFile(const std::string& fileName, int depth = -1, int width = -1, const std::string &moduleKey = "");
 
+    /**
+     * @brief File of the resources handled by a module, with what its tree refers to
+     */
+    struct OpenedFile
+    {
+        VariableCollector collector;
+        RealFile file;
+        std::unique_ptr<Object> object;
+    };
+
+    /** @brief Opens a file of the resources and handles it, null if it cannot be*/
+    std::unique_ptr<OpenedFile> openFile(const std::string& fileName, const Module& module);
+
+    /** @brief Writes the tree of the object and compares it with the one expected for the file*/
+    bool compareWithOrig(Object& object, const std::string& fileName, const std::string& suffix, int depth = -1, int width = -1);
+
     void writeObject(Object& object, const std::string& outputPath, int depth, int width);
     void writeObjectRecursive(Object& object, std::ofstream& file, int currentDepth, int remainingDepth, int width);
 
@@ -1,7 +1,11 @@
 
+#include <set>
 #include <sstream>
+#include <thread>
 
 #include "test_util.h"
+#include "core/util/arena.h"
+#include "core/util/atom.h"
 #include "core/util/bitutil.h"
 #include "core/util/csvreader.h"
 #include "core/util/fileutil.h"
@@ -274,3 +278,137 @@ void TestUtil::testIterationWrapper()
     QCOMPARE(*(++str_it), std::string("a"));
     QCOMPARE(++str_it, reverse(strings).end());
 }
+
+void TestUtil::testArena()
+{
+    Arena* arena = new Arena;
+    {
+        Arena::Scope scope(arena);
+        QCOMPARE(Arena::current(), arena);
+
+        void* first = Arena::allocateIn(Arena::current(), 40);
+        void* second = Arena::allocateIn(Arena::current(), 40);
+        QCOMPARE(first != second, true);
+        QCOMPARE(arena->allocationCount(), size_t(2));
+        QCOMPARE(arena->liveCount(), size_t(2));
+        QCOMPARE(arena->liveSize(), size_t(128));
+        QCOMPARE(arena->slabCount(), size_t(1));
+
+        // freed blocks are reused for blocks of the same size class
+        Arena::deallocate(first);
+        QCOMPARE(arena->liveCount(), size_t(1));
+        QCOMPARE(Arena::allocateIn(Arena::current(), 33), first);
+
+        std::vector<int, ArenaAllocator<int> > values;
+        for (int i = 0; i < 100; ++i) {
+            values.push_back(i);
+        }
+        QCOMPARE(values[99], 99);
+        QCOMPARE(values.get_allocator().arena(), arena);
+
+        Arena::deallocate(first);
+        Arena::deallocate(second);
+    }
+    QCOMPARE(Arena::current() == nullptr, true);
+
+    // threads allocate from chunks of their own, and may free each other's blocks
+    std::vector<std::vector<void*> > blocks(4);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        threads.emplace_back([arena, &blocks, i]() {
+            for (int j = 0; j < 10000; ++j) {
+                blocks[i].push_back(Arena::allocateIn(arena, 16 + j % 200));
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    std::set<void*> distinct;
+    for (const std::vector<void*>& threadBlocks : blocks) {
+        distinct.insert(threadBlocks.begin(), threadBlocks.end());
+    }
+    QCOMPARE(distinct.size(), size_t(40000));
+    QCOMPARE(arena->liveCount(), size_t(40000));
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        threads.emplace_back([&blocks, i]() {
+            for (void* block : blocks[(i + 1) % blocks.size()]) {
+                Arena::deallocate(block);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    QCOMPARE(arena->liveCount(), size_t(0));
+    QCOMPARE(arena->liveSize(), size_t(0));
+
+    const size_t heapAllocationCount = Arena::heapAllocationCount();
+    void* block = Arena::allocateIn(nullptr, 16);
+    QCOMPARE(Arena::heapAllocationCount(), heapAllocationCount + 1);
+    Arena::deallocate(block);
+
+    arena->release();
+}
+
+void TestUtil::testAtom()
+{
+    const Atom empty;
+    QCOMPARE(empty.empty(), true);
+    QCOMPARE(empty.str(), std::string());
+
+    const Atom pid("PID");
+    QCOMPARE(pid.str(), std::string("PID"));
+    QCOMPARE(Atom(std::string("PID")) == pid, true);
+    QCOMPARE(Atom("payload") != pid, true);
+    QCOMPARE(Atom("PID").id(), pid.id());
+
+    // finding a string does not intern it
+    Atom found;
+    QCOMPARE(Atom::find("PID", found), true);
+    QCOMPARE(found == pid, true);
+    const size_t count = Atom::count();
+    QCOMPARE(Atom::find("never interned", found), false);
+    QCOMPARE(Atom::count(), count);
+
+    AtomMap<int> map;
+    map.set(Atom("b"), 2);
+    map.set(Atom("a"), 1);
+    map.set(Atom("b"), 3);
+    QCOMPARE(map.size(), size_t(2));
+    QCOMPARE(*map.find(Atom("a")), 1);
+    QCOMPARE(*map.find(Atom("b")), 3);
+    QCOMPARE(map.find(Atom("c")) == nullptr, true);
+}
+
+void TestUtil::testAtom_numberedNames()
+{
+    // the elements of an array share the pattern of their name
+    const size_t count = Atom::count();
+    const int64_t lastNumber = int64_t(70) << 20;
+    for (int64_t number = 0; number <= lastNumber; number += 997) {
+        const std::string name = "item" + toStr(number);
+        const Atom atom(name);
+        QCOMPARE(atom.str(), name);
+    }
+    QVERIFY(Atom::count() <= count + 1);
+
+    const Atom last("item" + toStr(lastNumber));
+    Atom found;
+    QCOMPARE(Atom::find("item" + toStr(lastNumber), found), true);
+    QCOMPARE(found == last, true);
+    QCOMPARE(Atom("item12") != Atom("item13"), true);
+    QCOMPARE(Atom("item12") != Atom("track12"), true);
+
+    // numbers are put back where they were
+    QCOMPARE(Atom("track5_data").str(), std::string("track5_data"));
+    QCOMPARE(Atom("mp4a").str(), std::string("mp4a"));
+    QCOMPARE(Atom("12").str(), std::string("12"));
+    QCOMPARE(Atom("x4294967294").str(), std::string("x4294967294"));
+    QCOMPARE(Atom("x4294967295").str(), std::string("x4294967295"));
+
+    // numbers with leading zeros are kept as they are
+    QCOMPARE(Atom("item007").str(), std::string("item007"));
+    QCOMPARE(Atom("item007") != Atom("item7"), true);
+}
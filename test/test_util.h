@@ -29,6 +29,9 @@ private slots:
     void testStrUtil_join();
     void testOptOwnPtr();
     void testIterationWrapper();
+    void testArena();
+    void testAtom();
+    void testAtom_numberedNames();
 };
 
 #endif // TEST_UTIL
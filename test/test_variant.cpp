@@ -1,10 +1,13 @@
 
 #include "test_variant.h"
 
+#include <sstream>
 #include <unordered_map>
 
 #include "core/variant.h"
 #include "core/objecttype.h"
+#include "core/objecttypetemplate.h"
+#include "core/varianthash.h"
 
 void TestVariant::unknown()
 {
@@ -262,6 +265,51 @@ void TestVariant::string()
     QCOMPARE(var || false, true);
 }
 
+void TestVariant::stringStorage()
+{
+    // Short strings are inline, long ones shared and views borrowed
+    const std::string longString = "a string too long to be stored inline";
+    const std::string shortString = "fourcc";
+    Variant shortVar("fourcc");
+    Variant longVar(longString);
+    Variant viewVar = Variant::view(shortString);
+    Variant longViewVar = Variant::view(longString);
+
+    QCOMPARE(shortVar.toString(), std::string("fourcc"));
+    QCOMPARE(longVar.toString(), longString);
+    QCOMPARE(viewVar.type(), Variant::stringType);
+    QCOMPARE(viewVar == shortVar, true);
+    QCOMPARE(longViewVar == longVar, true);
+    QCOMPARE(shortVar < longVar, false);
+    QCOMPARE(Variant("fourc") < viewVar, true);
+    QCOMPARE(Variant("") < viewVar, true);
+    QCOMPARE(!Variant(""), true);
+    QCOMPARE(std::hash<Variant>()(viewVar), std::hash<Variant>()(shortVar));
+    QCOMPARE(std::hash<Variant>()(longViewVar), std::hash<Variant>()(longVar));
+
+    // Only inline strings are copied to be referenced
+    std::string buffer;
+    QCOMPARE(&longViewVar.toString(buffer), &longString);
+    QCOMPARE(&viewVar.toString(buffer), &shortString);
+    QCOMPARE(&shortVar.toString(buffer), &buffer);
+    QCOMPARE(buffer, shortString);
+    QCOMPARE(longVar.toString(buffer), longString);
+
+    Variant copy(shortVar);
+    copy.toMutableString() += "s";
+    QCOMPARE(copy, Variant("fourccs"));
+    QCOMPARE(shortVar, Variant("fourcc"));
+
+    Variant viewCopy = viewVar;
+    viewCopy.toMutableString()[0] = 'F';
+    QCOMPARE(viewCopy, Variant("Fourcc"));
+    QCOMPARE(viewVar, Variant("fourcc"));
+
+    std::stringstream S;
+    S << viewVar << longVar;
+    QCOMPARE(S.str(), "fourcc"+longString);
+}
+
 void TestVariant::objectType()
 {
     ObjectType ot;
@@ -278,6 +326,98 @@ void TestVariant::objectType()
     // ObjectType ot3 = var.toObjectType();
 }
 
+void TestVariant::objectTypeInterning()
+{
+    ObjectTypeTemplate tpl("interned", {"size", "mode"});
+
+    // Types with the same template and parameters are equal, whichever way they were built
+    ObjectType a = tpl(32, "fast");
+    ObjectType b(tpl);
+    b.setParameters(32, "fast");
+    ObjectType c(tpl);
+    c.setParameter(0, 32);
+    c.setParameter(1, "fast");
+    QCOMPARE(a == b, true);
+    QCOMPARE(a == c, true);
+    QCOMPARE(a.hash(), c.hash());
+    QCOMPARE(std::hash<ObjectType>()(a), std::hash<ObjectType>()(b));
+    QCOMPARE(a < b || b < a, false);
+
+    // Parameters are compared by value, but keep their own type
+    ObjectType d = tpl(32U, "fast");
+    QCOMPARE(a == d, true);
+    QCOMPARE(a.hash(), d.hash());
+    QCOMPARE(a < d || d < a, false);
+    QCOMPARE(d.parameterValue(0).type(), Variant::unsignedIntegerType);
+    QCOMPARE(tpl(32.0, "fast") == a, true);
+    QCOMPARE(tpl(32.5, "fast") == a, false);
+
+    // Ordered by template, then by the values of the parameters
+    ObjectTypeTemplate other("other", {"size"});
+    QCOMPARE(tpl(64, "fast") < tpl(128U, "fast"), true);
+    QCOMPARE(tpl(128, "fast") < tpl(64, "fast"), false);
+    QCOMPARE(tpl(64, "fast") < tpl(64, "slow"), true);
+    QCOMPARE(tpl(64, "fast") < other(1), true);
+    QCOMPARE(other(1) < tpl(64, "fast"), false);
+
+    // Modifying a copy leaves the original untouched
+    ObjectType e = a;
+    e.setParameter(0, 64);
+    QCOMPARE(a.parameterValue(0).toInteger(), 32LL);
+    QCOMPARE(e.parameterValue(0).toInteger(), 64LL);
+    QCOMPARE(a == e, false);
+
+    // Setting a name does not change the identity of the type
+    ObjectType f = a;
+    f.setName("renamed");
+    QCOMPARE(f.name(), std::string("renamed"));
+    QCOMPARE(a == f, true);
+    QCOMPARE(a.hash(), f.hash());
+
+    std::unordered_map<Variant, int> byType;
+    byType[Variant(a)] = 1;
+    QCOMPARE(byType.count(Variant(c)), size_t(1));
+    QCOMPARE(byType.count(Variant(e)), size_t(0));
+}
+
+void TestVariant::objectTypeRelease()
+{
+    ObjectTypeTemplate tpl("released", {"size", "mode"});
+    const ObjectType kept = tpl(8, "fast");
+    const size_t nodeCount = ObjectType::nodeCount();
+
+    // The nodes no type refers to any more are freed, intermediate ones included
+    {
+        std::vector<ObjectType> types;
+        for (int i = 0; i < 1000; ++i) {
+            ObjectType type(tpl);
+            type.setParameter(0, i);
+            type.setParameter(1, "slow");
+            type.setName("released" + std::to_string(i));
+            types.push_back(type);
+        }
+        QVERIFY(ObjectType::nodeCount() >= nodeCount + 2000);
+        QCOMPARE(types[8] == tpl(8, "slow"), true);
+    }
+    QCOMPARE(ObjectType::nodeCount(), nodeCount);
+
+    // Types equal to the ones kept still share their nodes
+    ObjectType again(tpl);
+    again.setParameters(8, "fast");
+    QCOMPARE(again.isIdentical(kept), true);
+    QCOMPARE(ObjectType::nodeCount(), nodeCount);
+
+    // Types referred to by the attributes of others are kept with them
+    ObjectType array(tpl);
+    {
+        ObjectType element = tpl(16, "slow");
+        array.setElementType(element);
+    }
+    QCOMPARE(array.elementType() == tpl(16, "slow"), true);
+    array = ObjectType();
+    QCOMPARE(ObjectType::nodeCount(), nodeCount);
+}
+
 void TestVariant::conversion()
 {
     // setValue resets the Variant (including the type)
@@ -13,7 +13,10 @@ private slots:
     void unsignedInteger();
     void floating();
     void string();
+    void stringStorage();
     void objectType();
+    void objectTypeInterning();
+    void objectTypeRelease();
     void conversion();
 };
 